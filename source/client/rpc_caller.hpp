@@ -1,5 +1,7 @@
 /*
     rpc客户端调用：同步/异步/回调
+    * 可选的请求合并：同一连接上相同方法、相同参数的请求还没有收到响应时，
+      新的调用不再发送，直接等待并共享那次请求的响应
 */
 #pragma once
 #include "requestor.hpp"
@@ -17,11 +19,18 @@ namespace rpc
             using JsonResponseCallback = std::function<void(const Json::Value &)>;
 
             RpcCaller(const Requestor::ptr &requestor)
-                :_requestor(requestor)
+                :_requestor(requestor),
+                _coalesce(false)
             {
                 
             }
 
+            // 开启/关闭请求合并，默认关闭；只应对结果只取决于参数的方法开启
+            void setCoalesce(bool enable)
+            {
+                _coalesce = enable;
+            }
+
             // 同步：阻塞等待
             bool call(const BaseConnection::ptr &conn, const std::string &method, const Json::Value &params, Json::Value &result)
             {
@@ -35,7 +44,8 @@ namespace rpc
                 BaseMessage::ptr rsp_msg;
 
                 // 2.发送请求
-                bool ret = _requestor->send(conn, std::dynamic_pointer_cast<BaseMessage>(req_msg), rsp_msg);
+                bool ret = _coalesce ? syncSend(conn, req_msg, rsp_msg)
+                                     : _requestor->send(conn, std::dynamic_pointer_cast<BaseMessage>(req_msg), rsp_msg);
                 if(ret == false)
                 {
                     ELOG("同步Rpc请求失败！");
@@ -74,7 +84,7 @@ namespace rpc
                 auto json_promise = std::make_shared<std::promise<Json::Value>>();
                 result = json_promise->get_future();
                 Requestor::RequestCallback cb = std::bind(&RpcCaller::Callback, this, json_promise, std::placeholders::_1);
-                bool ret = _requestor->send(conn, std::dynamic_pointer_cast<BaseMessage>(req_msg), cb);
+                bool ret = send(conn, req_msg, cb);
                 if(ret == false)
                 {
                     ELOG("异步Rpc请求失败！");
@@ -94,7 +104,7 @@ namespace rpc
                 req_msg->setParams(params);
 
                 Requestor::RequestCallback req_cb = std::bind(&RpcCaller::Callback1, this, cb, std::placeholders::_1);
-                bool ret = _requestor->send(conn, std::dynamic_pointer_cast<BaseMessage>(req_msg), req_cb);
+                bool ret = send(conn, req_msg, req_cb);
                 if (ret == false)
                 {
                     ELOG("回调Rpc请求失败！");
@@ -105,6 +115,125 @@ namespace rpc
             }
 
         private:
+            // 正在等待响应、可以被合并的一次请求
+            struct Flight
+            {
+                using ptr = std::shared_ptr<Flight>;
+
+                BaseConnection *conn;                              // 发送请求的连接
+                std::string method;
+                Json::Value params;
+                std::vector<Requestor::RequestCallback> callbacks; // 等待这次响应的所有调用
+                std::chrono::steady_clock::time_point start;       // 发送时间，超时的请求不再合并
+            };
+
+            // 以回调的方式发送请求，开启合并时相同的请求只发送一次
+            bool send(const BaseConnection::ptr &conn, const RpcRequest::ptr &req, Requestor::RequestCallback &cb)
+            {
+                if(_coalesce == false)
+                {
+                    return _requestor->send(conn, std::dynamic_pointer_cast<BaseMessage>(req), cb);
+                }
+
+                uint64_t key = flightKey(conn, req);
+                auto flight = std::make_shared<Flight>();
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    auto now = std::chrono::steady_clock::now();
+                    auto it = _flights.find(key);
+                    if(it != _flights.end() && now - it->second->start < std::chrono::seconds(1))
+                    {
+                        Flight &cur = *it->second;
+                        if(cur.conn == conn.get() && cur.method == req->method() && cur.params == req->params())
+                        {
+                            cur.callbacks.push_back(cb);
+                            return true;
+                        }
+
+                        // 哈希冲突：不合并，也不覆盖正在等待的请求
+                        return _requestor->send(conn, std::dynamic_pointer_cast<BaseMessage>(req), cb);
+                    }
+
+                    flight->conn = conn.get();
+                    flight->method = req->method();
+                    flight->params = req->params();
+                    flight->callbacks.push_back(cb);
+                    flight->start = now;
+                    _flights[key] = flight;
+                }
+
+                Requestor::RequestCallback flight_cb = std::bind(&RpcCaller::onFlightResponse, this, key, flight, std::placeholders::_1);
+                if(_requestor->send(conn, std::dynamic_pointer_cast<BaseMessage>(req), flight_cb))
+                {
+                    return true;
+                }
+
+                // 发送失败：自己的调用由返回值通知，期间合并进来的调用回复连接断开
+                auto callbacks = takeFlight(key, flight);
+                auto rsp = MessageFactory::create<RpcResponse>();
+                rsp->setId(req->rid());
+                rsp->setMType(MType::RSP_RPC);
+                rsp->setRCode(RCode::RCODE_DISCONNECTED);
+                for(size_t i = 1; i < callbacks.size(); i++)
+                {
+                    callbacks[i](rsp);
+                }
+
+                return false;
+            }
+
+            // 开启合并时的同步请求：以回调方式发送，等待响应，超时时间与 Requestor 的同步请求一致
+            bool syncSend(const BaseConnection::ptr &conn, const RpcRequest::ptr &req, BaseMessage::ptr &rsp)
+            {
+                auto rsp_promise = std::make_shared<std::promise<BaseMessage::ptr>>();
+                auto rsp_future = rsp_promise->get_future();
+                Requestor::RequestCallback cb = [rsp_promise](const BaseMessage::ptr &msg) { rsp_promise->set_value(msg); };
+                if(send(conn, req, cb) == false)
+                {
+                    return false;
+                }
+
+                if(rsp_future.wait_for(std::chrono::seconds(1)) != std::future_status::ready)
+                {
+                    ELOG("同步请求等待响应超时: %s", req->rid().c_str());
+                    return false;
+                }
+
+                rsp = rsp_future.get();
+                return true;
+            }
+
+            // 合并请求收到响应：同一个响应分发给所有等待的调用
+            void onFlightResponse(uint64_t key, const Flight::ptr &flight, const BaseMessage::ptr &msg)
+            {
+                for(auto &cb : takeFlight(key, flight))
+                {
+                    cb(msg);
+                }
+            }
+
+            // 取出一次请求上的所有回调；key 已经被新的请求占用时不删除
+            std::vector<Requestor::RequestCallback> takeFlight(uint64_t key, const Flight::ptr &flight)
+            {
+                std::vector<Requestor::RequestCallback> callbacks;
+                std::unique_lock<std::mutex> lock(_mutex);
+                auto it = _flights.find(key);
+                if(it != _flights.end() && it->second == flight)
+                {
+                    _flights.erase(it);
+                }
+
+                callbacks.swap(flight->callbacks);
+                return callbacks;
+            }
+
+            // 合并的key：连接 + 方法名 + 参数的规范化哈希
+            uint64_t flightKey(const BaseConnection::ptr &conn, const RpcRequest::ptr &req)
+            {
+                uint64_t seed = JSON::hash(Json::Value(req->method())) ^ (uint64_t)(uintptr_t)conn.get();
+                return JSON::hash(req->params(), seed);
+            }
+
             // 回调调用的回调
             void Callback1(const JsonResponseCallback &cb, const BaseMessage::ptr &msg)
             {
@@ -165,6 +294,9 @@ namespace rpc
 
         private:
             Requestor::ptr _requestor;  // 发送消息到服务器
+            std::atomic<bool> _coalesce; // 是否合并相同的请求
+            std::mutex _mutex;
+            std::unordered_map<uint64_t, Flight::ptr> _flights; // key：请求哈希，val：等待响应的请求
         };
     }
 }
\ No newline at end of file
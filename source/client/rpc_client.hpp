@@ -10,6 +10,10 @@
 #include "rpc_caller.hpp"
 #include "rpc_registry.hpp"
 #include "rpc_topic.hpp"
+#include "rpc_executor.hpp"
+#include <set>
+#include <thread>
+#include <condition_variable>
 
 
 namespace rpc
@@ -24,17 +28,29 @@ namespace rpc
 
             // 构造函数传入注册中心的地址信息，用于连接注册中心
             RegistryClient(const std::string &ip, int port)
+                : RegistryClient(std::vector<Address>(1, Address(ip, port)))
+            {
+            }
+
+            // 注册中心集群：连接其中一个副本，断开后切换到其他副本并重新注册
+            RegistryClient(const std::vector<Address> &registry_addrs)
                 : _requestor(std::make_shared<Requestor>()),
                 _provider(std::make_shared<client::Provider>(_requestor)),
-                _dispatcher(std::make_shared<Dispatcher>())
+                _dispatcher(std::make_shared<Dispatcher>()),
+                _stop(false)
             {
                 auto rsp_cb = std::bind(&client::Requestor::onResponse, _requestor.get(), std::placeholders::_1, std::placeholders::_2);
                 _dispatcher->registerHandler<BaseMessage>(MType::RSP_SERVICE, rsp_cb);
 
                 auto message_cb = std::bind(&Dispatcher::onMessage, _dispatcher.get(), std::placeholders::_1, std::placeholders::_2);
 
-                _client = ClientFactory::create(ip, port);
+                // 与注册中心断线（例如注册中心重启）后自动重连，重连成功后重新注册所有服务
+                auto connection_cb = std::bind(&client::Provider::reregistry, _provider.get(), std::placeholders::_1);
+
+                _client = ClientFactory::createFailover(registry_addrs);
                 _client->setMessageCallback(message_cb);
+                _client->setConnectionCallback(connection_cb);
+                _client->enableRetry();
                 _client->connect();
             }
 
@@ -44,6 +60,59 @@ namespace rpc
                 return _provider->registryMethod(_client->connection(), method, host);
             }
 
+            // 批量注册，所有服务只需要一次往返
+            bool registryMethods(const std::vector<std::string> &methods, const Address &host)
+            {
+                return _provider->registryMethods(_client->connection(), methods, host);
+            }
+
+            // 提供者的元数据（权重、区域、版本等），注册时携带，修改后随心跳更新
+            void setMeta(const Json::Value &meta)
+            {
+                _provider->setMeta(meta);
+            }
+
+            // 报告当前负载（0~100）
+            void setLoad(int load)
+            {
+                _provider->setLoad(load);
+            }
+
+            ~RegistryClient()
+            {
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _stop = true;
+                }
+
+                _cond.notify_all();
+                if (_heartbeat.joinable())
+                {
+                    _heartbeat.join();
+                }
+            }
+
+            // 开启心跳：每 interval_ms 向注册中心续约一次，注册中心在租期内收不到心跳就把本机做下线处理
+            void enableHeartbeat(int interval_ms)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (_heartbeat.joinable())
+                {
+                    return;
+                }
+
+                _heartbeat = std::thread([this, interval_ms]()
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    while (_cond.wait_for(lock, std::chrono::milliseconds(interval_ms), [this]() { return _stop; }) == false)
+                    {
+                        lock.unlock();
+                        _provider->heartbeat(_client->connection());
+                        lock.lock();
+                    }
+                });
+            }
+
         private:
             // 犯了一个最愚蠢的错误：初始化列表的初始化顺序！导致 _provider 拿到的是一个还没构造好的 _requestor（空指针），然后在里面加锁直接炸成 std::system_error；
             // 回调 + 线程里，用同步原语（CountDownLatch 等）时，唤醒顺序也要保证被唤醒线程看到的是“完全初始化好的状态”。
@@ -54,6 +123,11 @@ namespace rpc
             client::Provider::ptr _provider; // 注册中心注册
             Dispatcher::ptr _dispatcher;     // 注册中心响应
             BaseClient::ptr _client;         // rpc客户端（与注册中心建立连接）
+
+            std::mutex _mutex;
+            std::condition_variable _cond;
+            bool _stop;
+            std::thread _heartbeat;          // 定期发送心跳的线程
         };
 
 
@@ -66,6 +140,12 @@ namespace rpc
 
             // 构造函数传入注册中心的地址信息，用于连接注册中心
             DiscoveryClient(const std::string &ip, int port, const Discoverer::OfflineCallback &cb)
+                : DiscoveryClient(std::vector<Address>(1, Address(ip, port)), cb)
+            {
+            }
+
+            // 注册中心集群：连接其中一个副本，断开后切换到其他副本并重新同步
+            DiscoveryClient(const std::vector<Address> &registry_addrs, const Discoverer::OfflineCallback &cb)
                 : _requestor(std::make_shared<Requestor>()),
                   _discoverer(std::make_shared<client::Discoverer>(_requestor, cb)),
                   _dispatcher(std::make_shared<Dispatcher>())
@@ -78,8 +158,13 @@ namespace rpc
 
                 auto message_cb = std::bind(&Dispatcher::onMessage, _dispatcher.get(), std::placeholders::_1, std::placeholders::_2);
 
-                _client = ClientFactory::create(ip, port);
+                // 与注册中心断线后自动重连，重连成功后从已知版本重新同步所有发现过的服务
+                auto connection_cb = std::bind(&client::Discoverer::resync, _discoverer.get(), std::placeholders::_1);
+
+                _client = ClientFactory::createFailover(registry_addrs);
                 _client->setMessageCallback(message_cb);
+                _client->setConnectionCallback(connection_cb);
+                _client->enableRetry();
                 _client->connect();
             }
 
@@ -89,6 +174,30 @@ namespace rpc
                 return _discoverer->serviceDiscovery(_client->connection(), method, host);
             }
 
+            // 批量服务发现：一次往返发现多个方法（每条请求最多 32 个）
+            bool serviceDiscovery(const std::vector<std::string> &methods)
+            {
+                return _discoverer->serviceDiscovery(_client->connection(), methods);
+            }
+
+            // 发现名称以 prefix 开头的所有方法，methods 返回发现到的方法
+            bool prefixDiscovery(const std::string &prefix, std::vector<std::string> &methods)
+            {
+                return _discoverer->prefixDiscovery(_client->connection(), prefix, methods);
+            }
+
+            // 已经发现的某个方法的所有提供者
+            std::vector<Address> methodHosts(const std::string &method)
+            {
+                return _discoverer->methodHosts(method);
+            }
+
+            // 客户端所在区域，选择提供者时优先同区域
+            void setZone(const std::string &zone)
+            {
+                _discoverer->setZone(zone);
+            }
+
         private:
             Requestor::ptr _requestor;           // rpc请求发送和响应接收
             client::Discoverer::ptr _discoverer; // 从注册中心查询服务的提供者
@@ -106,6 +215,12 @@ namespace rpc
 
             // enableDiscovery：是否启用服务发现功能，这决定了传入的地址信息是注册中心的地址，还是服务提供者的地址
             RpcClient (bool enableDiscovery, const std::string &ip, int port)
+                : RpcClient(enableDiscovery, std::vector<Address>(1, Address(ip, port)))
+            {
+            }
+
+            // 传入多个地址：启用服务发现时是注册中心集群的各个副本，否则是同一服务的多个提供者（断开后切换）
+            RpcClient (bool enableDiscovery, const std::vector<Address> &addrs)
                 :_enableDiscovery(enableDiscovery),
                 _requestor(std::make_shared<Requestor>()),
                 _dispatcher(std::make_shared<Dispatcher>()),
@@ -120,12 +235,12 @@ namespace rpc
                 if(_enableDiscovery)
                 {
                     auto offline_cb = std::bind(&RpcClient::delClient, this, std::placeholders::_1);
-                    _discovery_client = std::make_shared<DiscoveryClient>(ip, port, offline_cb);
+                    _discovery_client = std::make_shared<DiscoveryClient>(addrs, offline_cb);
                 }
                 else
                 {
                     auto message_cb = std::bind(&Dispatcher::onMessage, _dispatcher.get(), std::placeholders::_1, std::placeholders::_2);
-                    _rpc_client = ClientFactory::create(ip, port);
+                    _rpc_client = ClientFactory::createFailover(addrs);
                     _rpc_client->setMessageCallback(message_cb);
                     _rpc_client->connect();
                 }
@@ -166,7 +281,91 @@ namespace rpc
                 return _caller->call(client->connection(), method, params, cb);
             }
 
+            // 请求合并：同一连接上相同方法、相同参数的调用还在等待响应时，不再重复发送
+            void setCoalesce(bool enable)
+            {
+                _caller->setCoalesce(enable);
+            }
+
+            // 客户端所在区域，启用服务发现时优先调用同区域的提供者
+            void setZone(const std::string &zone)
+            {
+                if (_enableDiscovery)
+                {
+                    _discovery_client->setZone(zone);
+                }
+            }
+
+            // 启动时预热：批量发现这些方法，connect 为 true 时再和它们的所有提供者建立连接，
+            // 避免每个方法第一次调用时都要等一次注册中心的往返和建连（直连模式下什么都不做）
+            bool prefetch(const std::vector<std::string> &methods, bool connect = true)
+            {
+                if (_enableDiscovery == false)
+                {
+                    return true;
+                }
+
+                bool ret = _discovery_client->serviceDiscovery(methods);
+                if (connect)
+                {
+                    preconnect(methods);
+                }
+                return ret;
+            }
+
+            // 按前缀预热：发现名称以 prefix 开头的所有方法（例如 "user." 下的全部服务）
+            bool prefetch(const std::string &prefix, bool connect = true)
+            {
+                if (_enableDiscovery == false)
+                {
+                    return true;
+                }
+
+                std::vector<std::string> methods;
+                bool ret = _discovery_client->prefixDiscovery(prefix, methods);
+                if (connect)
+                {
+                    preconnect(methods);
+                }
+                return ret;
+            }
+
         private:
+            // 和这些方法的所有提供者建立连接：每个主机一个线程并行连接，单个主机不可达不会拖慢其他主机
+            void preconnect(const std::vector<std::string> &methods)
+            {
+                std::set<Address> hosts;
+                for (auto &method : methods)
+                {
+                    for (auto &host : _discovery_client->methodHosts(method))
+                    {
+                        if (getClient(host).get() == nullptr)
+                        {
+                            hosts.insert(host);
+                        }
+                    }
+                }
+
+                std::vector<std::thread> threads;
+                for (auto &host : hosts)
+                {
+                    threads.emplace_back([this, host]() { getOrCreateClient(host); });
+                    if (threads.size() >= _preconnect_parallel)
+                    {
+                        for (auto &t : threads)
+                        {
+                            t.join();
+                        }
+                        threads.clear();
+                    }
+                }
+
+                for (auto &t : threads)
+                {
+                    t.join();
+                }
+            }
+
             BaseClient::ptr newClient(const Address &host)
             {
                 auto message_cb = std::bind(&Dispatcher::onMessage, _dispatcher.get(), std::placeholders::_1, std::placeholders::_2);
@@ -273,6 +472,7 @@ namespace rpc
             Dispatcher::ptr _dispatcher;            // 分发响应消息
             BaseClient::ptr _rpc_client;            // 和服务提供者通信的客户端
             std::mutex _mutex;
+            const size_t _preconnect_parallel = 16; // 预热时同时建立的连接数
 
             // 已连接rpc客户端的表，key：主机地址信息，val：rpc客户端
             std::unordered_map<Address, BaseClient::ptr, AddressHash> _rpc_clients;
@@ -287,7 +487,8 @@ namespace rpc
             TopicClient(const std::string &ip,int port)
                 :_requestor(std::make_shared<Requestor>()),
                 _dispatcher(std::make_shared<Dispatcher>()),
-                _topic_manager(std::make_shared<TopicManager>(_requestor))
+                _topic_manager(std::make_shared<TopicManager>(_requestor)),
+                _stop(false)
             {
                 auto rsp_cb = std::bind(&client::Requestor::onResponse, _requestor.get(), std::placeholders::_1, std::placeholders::_2);
                 _dispatcher->registerHandler<BaseMessage>(MType::RSP_TOPIC, rsp_cb);
@@ -307,6 +508,24 @@ namespace rpc
                 return _topic_manager->create(_rpc_client->connection(), key);
             }
 
+            // 创建主题并保留最近 retain 条消息，供之后的订阅者回放
+            bool create(const std::string &key, size_t retain)
+            {
+                return _topic_manager->create(_rpc_client->connection(), key, retain);
+            }
+
+            // 创建持久化主题（服务端需要开启持久化）
+            bool createDurable(const std::string &key)
+            {
+                return _topic_manager->createDurable(_rpc_client->connection(), key);
+            }
+
+            // 创建合并主题：每个键只保留最新值，新订阅者先收到所有键的最新值
+            bool createConflated(const std::string &key)
+            {
+                return _topic_manager->createConflated(_rpc_client->connection(), key);
+            }
+
             bool remove(const std::string &key)
             {
                 return _topic_manager->remove(_rpc_client->connection(), key);
@@ -318,6 +537,49 @@ namespace rpc
                 return _topic_manager->subscribe(_rpc_client->connection(), key, cb);
             }
 
+            // 可靠订阅（至少一次）：收到的消息处理完后按批确认，没有确认的服务端会重发；
+            // 同时开启自动刷新，不满一批的确认最多延迟 _ack_interval_ms 发出
+            bool subscribeReliable(const std::string &key, const TopicManager::SubCallback &cb, const std::string &session = "")
+            {
+                enableAutoFlush(_ack_interval_ms);
+                return _topic_manager->subscribeReliable(_rpc_client->connection(), key, cb, session);
+            }
+
+            // 以消费组成员的身份订阅主题，组内每条消息只发给一个成员
+            bool subscribeGroup(const std::string &key, const std::string &group, const TopicManager::SubCallback &cb,
+                                GroupBalance balance = GroupBalance::LEAST_LOADED, bool reliable = false)
+            {
+                if (reliable)
+                {
+                    enableAutoFlush(_ack_interval_ms);
+                }
+                return _topic_manager->subscribeGroup(_rpc_client->connection(), key, group, cb, balance, reliable);
+            }
+
+            // 订阅主题，先回放保留的序号从 seq 开始的消息（断线重连后传 lastSeq(key) + 1）
+            bool subscribeFrom(const std::string &key, uint64_t seq, const TopicManager::SubCallback &cb)
+            {
+                return _topic_manager->subscribeFrom(_rpc_client->connection(), key, seq, cb);
+            }
+
+            // 订阅主题，先回放保留的最近 count 条消息
+            bool subscribeLast(const std::string &key, size_t count, const TopicManager::SubCallback &cb)
+            {
+                return _topic_manager->subscribeLast(_rpc_client->connection(), key, count, cb);
+            }
+
+            // 从 offset 为 from 的消息开始消费持久化主题，先拉取历史消息，追上之后接收实时消息
+            bool consume(const std::string &key, uint64_t from, const TopicManager::SubCallback &cb)
+            {
+                return _topic_manager->consume(_rpc_client->connection(), key, from, cb);
+            }
+
+            // 该主题收到的最新消息序号
+            uint64_t lastSeq(const std::string &key)
+            {
+                return _topic_manager->lastSeq(key);
+            }
+
             // 取消订阅
             bool cancel(const std::string &key)
             {
@@ -329,9 +591,102 @@ namespace rpc
                 return _topic_manager->publish(_rpc_client->connection(), key, msg);
             }
 
-            // 关闭rpc客户端
+            // 带分区键的发布（按键哈希的消费组中同一个键发给同一个成员）
+            bool publishKeyed(const std::string &key, const std::string &msg_key, const std::string &msg)
+            {
+                return _topic_manager->publishKeyed(_rpc_client->connection(), key, msg_key, msg);
+            }
+
+            // 不等待服务端响应的发布
+            bool publishNoAck(const std::string &key, const std::string &msg)
+            {
+                return _topic_manager->publishNoAck(_rpc_client->connection(), key, msg);
+            }
+
+            // 批量发布：多条消息打包成尽量少的帧发送，ack 为 true 时每帧等待一次响应
+            bool publishBatch(const std::vector<TopicManager::Message> &msgs, bool ack = false)
+            {
+                return _topic_manager->publishBatch(_rpc_client->connection(), msgs, ack);
+            }
+
+            // 异步发布：攒够一批（或者 flush、自动刷新）再打包发出，不等待响应
+            bool publishAsync(const std::string &key, const std::string &msg)
+            {
+                return _topic_manager->publishAsync(_rpc_client->connection(), key, msg);
+            }
+
+            bool flush()
+            {
+                return _topic_manager->flush();
+            }
+
+            // 订阅回调交给 thread_num 个回调线程执行，回调慢也不会耽误网络线程处理其他响应；
+            // 同一主题的回调按收到的顺序依次执行，不同主题的回调并行执行，在订阅之前调用
+            void setCallbackThreads(size_t thread_num)
+            {
+                _callback_pool = std::make_shared<WorkerPool>(thread_num);
+                std::weak_ptr<WorkerPool> weak = _callback_pool;
+                _topic_manager->setExecutor([weak](const std::function<void()> &task)
+                {
+                    // 客户端析构时回调线程已经退出，剩下的直接执行
+                    auto pool = weak.lock();
+                    if (pool)
+                    {
+                        pool->submit(task);
+                        return;
+                    }
+                    task();
+                });
+            }
+
+            // 订阅回调交给自定义的执行器（例如业务自己的线程池），在订阅之前调用
+            void setExecutor(const TopicManager::Executor &executor)
+            {
+                _topic_manager->setExecutor(executor);
+            }
+
+            // 每 interval_ms 把异步发布攒下的消息发出一次，消息最多延迟这么久
+            void enableAutoFlush(int interval_ms)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (_flusher.joinable())
+                {
+                    return;
+                }
+
+                _flusher = std::thread([this, interval_ms]()
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    while (_cond.wait_for(lock, std::chrono::milliseconds(interval_ms), [this]() { return _stop; }) == false)
+                    {
+                        lock.unlock();
+                        _topic_manager->flush();
+                        lock.lock();
+                    }
+                });
+            }
+
+            ~TopicClient()
+            {
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _stop = true;
+                }
+
+                _cond.notify_all();
+                if (_flusher.joinable())
+                {
+                    _flusher.join();
+                }
+
+                // 等回调线程执行完已经收到的消息，回调中仍然可以使用客户端
+                _callback_pool.reset();
+            }
+
+            // 关闭rpc客户端（先把还没发出的异步发布消息发出去）
             void shutdown()
             {
+                _topic_manager->flush();
                 _rpc_client->shutdown();
             }
 
@@ -340,6 +695,13 @@ namespace rpc
             TopicManager::ptr _topic_manager; // 处理主题（创建、订阅、发布、删除）
             Dispatcher::ptr _dispatcher;      // 处理主题的响应
             BaseClient::ptr _rpc_client;      // rpc客户端（与服务提供者通信）
+
+            std::mutex _mutex;
+            std::condition_variable _cond;
+            bool _stop;
+            std::thread _flusher;             // 异步发布（和可靠订阅确认）的定时刷新线程
+            WorkerPool::ptr _callback_pool;   // 执行订阅回调的线程，为空时回调在网络线程中执行
+            const int _ack_interval_ms = 100; // 可靠订阅时自动刷新的间隔，要小于服务端的重发超时
         };
     }
 }
\ No newline at end of file
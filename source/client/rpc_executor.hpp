@@ -0,0 +1,94 @@
+/*
+    回调线程池：订阅回调等业务代码不在网络线程中执行
+    * 固定数量的工作线程从同一个队列中按提交顺序取任务执行
+    * 析构时先执行完已经提交的任务（包括执行过程中新提交的）再退出
+*/
+#pragma once
+#include "../common/detail.hpp"
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+namespace rpc
+{
+    namespace client
+    {
+        class WorkerPool
+        {
+        public:
+            using ptr = std::shared_ptr<WorkerPool>;
+            using Task = std::function<void()>;
+
+            // thread_num 为 0 时按 1 个线程处理
+            WorkerPool(size_t thread_num)
+                : _stop(false)
+            {
+                thread_num = thread_num == 0 ? 1 : thread_num;
+                for (size_t i = 0; i < thread_num; i++)
+                {
+                    _workers.emplace_back(&WorkerPool::workerEntry, this);
+                }
+            }
+
+            ~WorkerPool()
+            {
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _stop = true;
+                }
+
+                _cond.notify_all();
+                for (auto &worker : _workers)
+                {
+                    worker.join();
+                }
+            }
+
+            void submit(const Task &task)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _tasks.push_back(task);
+                }
+                _cond.notify_one();
+            }
+
+            // 排队中还没开始执行的任务数
+            size_t pending()
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                return _tasks.size();
+            }
+
+        private:
+            void workerEntry()
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                while (true)
+                {
+                    _cond.wait(lock, [this]() { return _stop || _tasks.empty() == false; });
+                    if (_tasks.empty())
+                    {
+                        return;
+                    }
+
+                    Task task = std::move(_tasks.front());
+                    _tasks.pop_front();
+                    lock.unlock();
+                    task();
+                    lock.lock();
+                }
+            }
+
+        private:
+            std::mutex _mutex;
+            std::condition_variable _cond;
+            bool _stop;
+            std::deque<Task> _tasks;
+            std::vector<std::thread> _workers;
+        };
+    }
+}
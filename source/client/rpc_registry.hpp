@@ -1,10 +1,12 @@
 /*
-    服务提供者：向注册中心注册服务
+    服务提供者：向注册中心注册服务，定期发送心跳续约
     服务-主机管理：同一服务可能存在多个提供者（负载均衡）
     服务发现者：从注册中心发现服务并管理服务提供者
 */
 #pragma once
 #include "requestor.hpp"
+#include <map>
+#include <algorithm>
 
 
 namespace rpc
@@ -26,18 +28,155 @@ namespace rpc
             // 向注册中心注册某个服务，该服务由……主机提供
             bool registryMethod(const BaseConnection::ptr &conn, const std::string &method, const Address &host)
             {
+                auto msg_req = MessageFactory::create<ServiceRequest>();
+                msg_req->setMethod(method);
+                return registry(conn, msg_req, host, method);
+            }
+
+            // 批量注册：一次请求注册该主机提供的所有服务，只需要一次往返
+            bool registryMethods(const BaseConnection::ptr &conn, const std::vector<std::string> &methods, const Address &host)
+            {
+                if (methods.empty())
+                {
+                    return true;
+                }
+
+                auto msg_req = MessageFactory::create<ServiceRequest>();
+                msg_req->setMethods(methods);
+                return registry(conn, msg_req, host, methods.size() == 1 ? methods[0] : "批量");
+            }
+
+            // 设置提供者的元数据（权重、区域、版本等），之后的注册都会携带；
+            // 已经注册过的，随下一次心跳发送给注册中心
+            void setMeta(const Json::Value &meta)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                Json::Value load = _meta.isObject() ? _meta[KEY_META_LOAD] : Json::Value();
+                _meta = meta.isObject() ? meta : Json::Value();
+                if (load.isNull() == false && _meta.isMember(KEY_META_LOAD) == false)
+                {
+                    _meta[KEY_META_LOAD] = load;
+                }
+                _meta_dirty = true;
+            }
+
+            // 报告当前负载（0~100），负载越高被选中的概率越低；只有变化时才随心跳发送
+            void setLoad(int load)
+            {
+                load = std::max(0, std::min(load, 100));
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (_meta.isObject() && _meta.isMember(KEY_META_LOAD) && _meta[KEY_META_LOAD].isInt() && _meta[KEY_META_LOAD].asInt() == load)
+                {
+                    return;
+                }
+                _meta[KEY_META_LOAD] = load;
+                _meta_dirty = true;
+            }
+
+            // 发送一次心跳（异步，不等待响应），还没有注册过任何服务时不发送
+            void heartbeat(const BaseConnection::ptr &conn)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    if (_registered.empty())
+                    {
+                        return;
+                    }
+                }
+
+                if (!conn || conn->connected() == false)
+                {
+                    return;
+                }
+
                 auto msg_req = MessageFactory::create<ServiceRequest>();
                 msg_req->setId(UUID::uuid());
                 msg_req->setMType(MType::REQ_SERVICE);
-                msg_req->setMethod(method);
+                msg_req->setOptype(ServiceOptype::SERVICE_HEARTBEAT);
+                {
+                    // 元数据变化过才随心跳携带，平时的心跳保持最小
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    if (_meta_dirty)
+                    {
+                        msg_req->setMeta(_meta);
+                        _meta_dirty = false;
+                    }
+                }
+
+                Requestor::RequestCallback cb = std::bind(&Provider::onHeartbeatResponse, this, conn, std::placeholders::_1);
+                _requestor->send(conn, msg_req, cb);
+            }
+
+            // 把注册成功过的服务重新注册一遍（重连注册中心、租约失效之后）
+            // 通常在网络线程中调用，只能异步发送
+            void reregistry(const BaseConnection::ptr &conn)
+            {
+                std::map<Address, std::vector<std::string>> registered;
+                Json::Value meta;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    registered = _registered;
+                    meta = _meta;
+                }
+
+                for (auto &item : registered)
+                {
+                    auto msg_req = MessageFactory::create<ServiceRequest>();
+                    msg_req->setId(UUID::uuid());
+                    msg_req->setMType(MType::REQ_SERVICE);
+                    msg_req->setOptype(ServiceOptype::SERVICE_REGISTRY);
+                    msg_req->setHost(item.first);
+                    msg_req->setMethods(item.second);
+                    if (meta.isNull() == false)
+                    {
+                        msg_req->setMeta(meta);
+                    }
+
+                    Requestor::RequestCallback cb = [](const BaseMessage::ptr &msg)
+                    {
+                        auto rsp = std::dynamic_pointer_cast<ServiceResponse>(msg);
+                        if (!rsp || rsp->rcode() != RCode::RCODE_OK)
+                        {
+                            ELOG("服务重新注册失败！");
+                        }
+                    };
+                    _requestor->send(conn, msg_req, cb);
+                }
+            }
+
+        private:
+            // 注册中心已经不认识这个提供者（租约过期后才恢复），重新注册
+            void onHeartbeatResponse(const BaseConnection::ptr &conn, const BaseMessage::ptr &msg)
+            {
+                auto service_rsp = std::dynamic_pointer_cast<ServiceResponse>(msg);
+                if (!service_rsp || service_rsp->rcode() != RCode::RCODE_NOT_FOUND_SERVICE)
+                {
+                    return;
+                }
+
+                ILOG("租约已失效，重新注册服务！");
+                reregistry(conn);
+            }
+
+            bool registry(const BaseConnection::ptr &conn, const ServiceRequest::ptr &msg_req, const Address &host, const std::string &name)
+            {
+                msg_req->setId(UUID::uuid());
+                msg_req->setMType(MType::REQ_SERVICE);
                 msg_req->setHost(host);
                 msg_req->setOptype(ServiceOptype::SERVICE_REGISTRY);
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    if (_meta.isNull() == false)
+                    {
+                        msg_req->setMeta(_meta);
+                    }
+                }
                 BaseMessage::ptr msg_rsp;
 
                 bool ret = _requestor->send(conn, msg_req, msg_rsp);
                 if(ret == false)
                 {
-                    ELOG("%s 服务注册失败！", method.c_str());
+                    ELOG("%s 服务注册失败！", name.c_str());
                     return false;
                 }
 
@@ -54,40 +193,72 @@ namespace rpc
                     return false;
                 }
 
+                // 记录注册成功的服务，租约失效时用于重新注册
+                std::unique_lock<std::mutex> lock(_mutex);
+                auto &methods = _registered[host];
+                for (auto &method : msg_req->methods())
+                {
+                    if (std::find(methods.begin(), methods.end(), method) == methods.end())
+                    {
+                        methods.push_back(method);
+                    }
+                }
                 return true;
             }
 
         private:
             Requestor::ptr _requestor; // 用于发送请求、接收响应
+            std::mutex _mutex;
+            std::map<Address, std::vector<std::string>> _registered; // key：主机，val：该主机注册成功的服务
+            Json::Value _meta;                                       // 提供者的元数据，随注册携带
+            bool _meta_dirty = false;                                // 元数据变化后还没有随心跳发送
         };
 
 
 
         // 将rpc方法对应多个提供服务的主机进行管理
+        // 按主机的元数据选择：优先同区域的主机，再按权重（随负载降低）做平滑加权轮询；
+        // 没有元数据时所有主机权重相同，等同于普通轮询
         class MethodHost
         {
         public:
             using ptr = std::shared_ptr<MethodHost>;
 
             MethodHost()
-                :_idx(0)
             {
                 
             }
 
-            MethodHost(const std::vector<Address> &hosts)
-                : _hosts(hosts.begin(), hosts.end()),
-                  _idx(0)
+            // metas 与 hosts 一一对应（可以为空，表示都没有元数据）
+            MethodHost(const std::vector<Address> &hosts, const std::vector<Json::Value> &metas = std::vector<Json::Value>())
             {
-                
+                for (size_t i = 0; i < hosts.size(); i++)
+                {
+                    _hosts.push_back(makeEntry(hosts[i], i < metas.size() ? metas[i] : Json::Value()));
+                }
             }
 
-            // 添加一个主机信息（服务上线）
-            void appendHost(const Address &host)
+            // 添加一个主机信息（服务上线），已经存在时更新它的元数据
+            void appendHost(const Address &host, const Json::Value &meta = Json::Value())
             {
                 // 中途收到服务上线请求后被调用
+                // 上线通知是合并后延迟发送的，可能晚于服务发现的响应到达，已经存在的主机不再重复添加
                 std::unique_lock<std::mutex> lock(_mutex);
-                _hosts.push_back(host);
+                for (auto &entry : _hosts)
+                {
+                    if (entry.host == host)
+                    {
+                        if (meta.isNull() == false)
+                        {
+                            int current = entry.current;
+                            entry = makeEntry(host, meta);
+                            entry.current = current;
+                        }
+                        return;
+                    }
+                }
+
+                _hosts.push_back(makeEntry(host, meta));
             }
 
             // 删除一个主机信息（服务下线）
@@ -97,7 +268,7 @@ namespace rpc
                 std::unique_lock<std::mutex> lock(_mutex);
                 for (auto it = _hosts.begin(); it != _hosts.end(); it++)
                 {
-                    if(*it == host)
+                    if(it->host == host)
                     {
                         _hosts.erase(it);
                         break;
@@ -105,7 +276,8 @@ namespace rpc
                 }
             }
 
-            Address chooseHost()
+            // zone：调用方所在的区域，为空或者该区域没有主机时在所有主机中选择
+            Address chooseHost(const std::string &zone = std::string())
             {
                 std::unique_lock<std::mutex> lock(_mutex);
 
@@ -117,8 +289,60 @@ namespace rpc
                     return Address();
                 }
 
-                size_t pos = _idx++ % _hosts.size();
-                return _hosts[pos];
+                bool local = false;
+                if (zone.empty() == false)
+                {
+                    for (auto &entry : _hosts)
+                    {
+                        if (entry.zone == zone)
+                        {
+                            local = true;
+                            break;
+                        }
+                    }
+                }
+
+                // 平滑加权轮询：每个候选主机加上自己的权重，选出当前值最大的，再减去总权重
+                Entry *best = nullptr;
+                int total = 0;
+                for (auto &entry : _hosts)
+                {
+                    if (local && entry.zone != zone)
+                    {
+                        continue;
+                    }
+
+                    entry.current += entry.weight;
+                    total += entry.weight;
+                    if (best == nullptr || entry.current > best->current)
+                    {
+                        best = &entry;
+                    }
+                }
+
+                best->current -= total;
+                return best->host;
+            }
+
+            // 用全量列表替换当前主机，返回被移除的主机
+            std::vector<Address> reset(const std::vector<Address> &hosts, const std::vector<Json::Value> &metas = std::vector<Json::Value>())
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                std::vector<Address> removed;
+                for (auto &entry : _hosts)
+                {
+                    if (std::find(hosts.begin(), hosts.end(), entry.host) == hosts.end())
+                    {
+                        removed.push_back(entry.host);
+                    }
+                }
+
+                _hosts.clear();
+                for (size_t i = 0; i < hosts.size(); i++)
+                {
+                    _hosts.push_back(makeEntry(hosts[i], i < metas.size() ? metas[i] : Json::Value()));
+                }
+                return removed;
             }
 
             // 看看是否有可用的主机
@@ -128,10 +352,68 @@ namespace rpc
                 return _hosts.empty();
             }
 
+            // 当前所有的主机（用于提前建立连接）
+            std::vector<Address> hosts()
+            {
+                std::vector<Address> result;
+                std::unique_lock<std::mutex> lock(_mutex);
+                for (auto &entry : _hosts)
+                {
+                    result.push_back(entry.host);
+                }
+                return result;
+            }
+
+        private:
+            // 一个主机和从元数据中取出的选择依据
+            struct Entry
+            {
+                Address host;
+                std::string zone;
+                int weight;  // 有效权重：配置的权重按负载折算，至少为 1
+                int current; // 平滑加权轮询的当前值
+            };
+
+            // 把元数据中的整数限制在 [low, high] 内；超出 int 范围的（很大的 uint64 等）直接取边界，asInt 会抛异常
+            static int clampMeta(const Json::Value &val, int low, int high)
+            {
+                if (val.isInt())
+                {
+                    return std::max(low, std::min(val.asInt(), high));
+                }
+                return val.asDouble() < 0 ? low : high;
+            }
+
+            Entry makeEntry(const Address &host, const Json::Value &meta)
+            {
+                int weight = _default_weight;
+                int load = 0;
+                std::string zone;
+                if (meta.isObject())
+                {
+                    if (meta[KEY_META_WEIGHT].isIntegral())
+                    {
+                        weight = clampMeta(meta[KEY_META_WEIGHT], 1, _max_weight);
+                    }
+                    if (meta[KEY_META_LOAD].isIntegral())
+                    {
+                        load = clampMeta(meta[KEY_META_LOAD], 0, 100);
+                    }
+                    if (meta[KEY_META_ZONE].isString())
+                    {
+                        zone = meta[KEY_META_ZONE].asString();
+                    }
+                }
+
+                // 负载 0~100 线性折算：满载的主机只保留最小权重，仍然偶尔被选中以便观察它的恢复
+                return Entry{host, zone, std::max(1, weight * (100 - load) / 100), 0};
+            }
+
         private:
+            const int _default_weight = 100; // 没有配置权重时的默认值
+            const int _max_weight = 10000;   // 权重上限，避免累加溢出
             std::mutex _mutex;
-            size_t _idx;                 // 轮询的下标索引
-            std::vector<Address> _hosts; // 主机信息数组/列表
+            std::vector<Entry> _hosts;       // 主机信息数组/列表
         };
 
         
@@ -150,6 +432,13 @@ namespace rpc
                 
             }
 
+            // 设置客户端所在的区域，选择主机时优先同区域的提供者
+            void setZone(const std::string &zone)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _zone = zone;
+            }
+
             // 服务发现，如果本地已经有主机列表就直接返回，反之就发起请求，请求注册中心提供主机列表
             bool serviceDiscovery(const BaseConnection::ptr &conn, const std::string &method, Address &host)
             {
@@ -161,7 +450,7 @@ namespace rpc
                     {
                         if (it->second->empty() == false)
                         {
-                            host = it->second->chooseHost();
+                            host = it->second->chooseHost(_zone);
                             return true;
                         }
                     }
@@ -196,58 +485,301 @@ namespace rpc
 
                 // 能走到这里，代表当前是没有对应的服务提供主机的
                 std::unique_lock<std::mutex> lock(_mutex);
-                auto method_host = std::make_shared<MethodHost>(service_rsp->hosts());
+                auto method_host = std::make_shared<MethodHost>(service_rsp->hosts(), service_rsp->metas());
                 if (method_host->empty())
                 {
                     ELOG("%s 服务发现失败！没有能够提供服务的主机！", method.c_str());
                     return false;
                 }
 
-                host = method_host->chooseHost();
+                host = method_host->chooseHost(_zone);
                 _method_hosts[method] = method_host;
+                _revisions[method] = Revision{service_rsp->epoch(), service_rsp->revision()};
                 return true;
             }
 
+            // 批量服务发现：本地还没有主机列表的方法合并成订阅请求（每条最多 _watch_batch 个方法），
+            // 注册中心对没有同步过的方法返回全量，之后和单个发现的方法一样接收上下线通知
+            // 全部请求都成功时返回 true（没有提供者的方法也算成功，首次调用时再按需发现）
+            bool serviceDiscovery(const BaseConnection::ptr &conn, const std::vector<std::string> &methods)
+            {
+                std::vector<ServiceRequest::ptr> reqs;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    for (auto &method : methods)
+                    {
+                        auto it = _method_hosts.find(method);
+                        if (it != _method_hosts.end() && it->second->empty() == false)
+                        {
+                            continue;
+                        }
+
+                        if (reqs.empty() || reqs.back()->watches().size() >= _watch_batch)
+                        {
+                            reqs.push_back(watchRequest());
+                        }
+                        reqs.back()->appendWatch(method, 0, std::string());
+                    }
+                }
+
+                bool ok = true;
+                for (auto &msg_req : reqs)
+                {
+                    ok = (watch(conn, msg_req) && ok);
+                }
+
+                return ok;
+            }
+
+            // 按前缀批量发现：找出注册中心上名称以 prefix 开头、当前有提供者的所有方法（分页请求），
+            // 通过 methods 返回这些方法
+            bool prefixDiscovery(const BaseConnection::ptr &conn, const std::string &prefix, std::vector<std::string> &methods)
+            {
+                std::string after;
+                while (true)
+                {
+                    auto msg_req = watchRequest();
+                    msg_req->setPrefix(prefix, after);
+
+                    bool more = false;
+                    std::vector<std::string> page;
+                    if (watch(conn, msg_req, &more, &page) == false)
+                    {
+                        return false;
+                    }
+
+                    methods.insert(methods.end(), page.begin(), page.end());
+                    if (more == false || page.empty())
+                    {
+                        return true;
+                    }
+                    after = page.back();
+                }
+            }
+
+            // 本地保存的某个方法的所有主机
+            std::vector<Address> methodHosts(const std::string &method)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                auto it = _method_hosts.find(method);
+                if (it == _method_hosts.end())
+                {
+                    return std::vector<Address>();
+                }
+
+                return it->second->hosts();
+            }
+
+            // 与注册中心的连接（重新）建立后调用：把所有已经发现过的方法从各自的版本开始重新同步，
+            // 注册中心按方法应答增量或全量，断线期间丢失的上下线通知由此补齐。
+            // 在网络线程中调用，只能异步等待响应
+            void resync(const BaseConnection::ptr &conn)
+            {
+                std::vector<ServiceRequest::ptr> reqs;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    for (auto &item : _method_hosts)
+                    {
+                        // 每条请求最多订阅 _watch_batch 个方法，避免响应超过协议的最大帧长
+                        if (reqs.empty() || reqs.back()->watches().size() >= _watch_batch)
+                        {
+                            reqs.push_back(watchRequest());
+                        }
+
+                        // 没有记录过版本的方法（例如只通过推送得知）用空的实例标识，注册中心会返回全量
+                        auto it = _revisions.find(item.first);
+                        if (it == _revisions.end())
+                        {
+                            reqs.back()->appendWatch(item.first, 0, std::string());
+                        }
+                        else
+                        {
+                            reqs.back()->appendWatch(item.first, it->second.revision, it->second.epoch);
+                        }
+                    }
+                }
+
+                for (auto &msg_req : reqs)
+                {
+                    Requestor::RequestCallback cb = std::bind(&Discoverer::onWatchResponse, this, std::placeholders::_1);
+                    if (_requestor->send(conn, msg_req, cb) == false)
+                    {
+                        ELOG("服务重新同步请求发送失败！");
+                    }
+                }
+            }
+
             // 这个接口是提供给Dispatcher模块进行服务上线下线请求处理的回调函数（收到SERVICE_ONLINE/SERVICE_OFFLINE时调用）
             void onServiceRequest(const BaseConnection::ptr &conn, const ServiceRequest::ptr &msg)
             {
-                // 1. 判断是上线还是下线请求，如果都不是那就不用处理了
+                // 0. 合并后的变更消息：按顺序逐条处理
+                if (msg->optype() == ServiceOptype::SERVICE_DELTA)
+                {
+                    for (auto &change : msg->changes())
+                    {
+                        onServiceRequest(conn, change);
+                    }
+                    return;
+                }
+
+                // 1. 判断是上线还是下线请求，如果都不是那就不用处理了（一条通知可能包含多个方法）
                 auto optype = msg->optype();
-                std::string method = msg->method();
+                auto methods = msg->methods();
+                Address host = msg->host();
+                Json::Value meta = msg->meta();
                 std::unique_lock<std::mutex> lock(_mutex);
                 if (optype == ServiceOptype::SERVICE_ONLINE)
                 {
-                    // 2. 上线请求：找到MethodHost，向其中新增一个主机地址
-                    auto it = _method_hosts.find(method);
-                    if (it == _method_hosts.end())
+                    // 2. 上线请求：找到MethodHost，向其中新增一个主机地址（已经存在的只更新元数据）
+                    for (auto &method : methods)
                     {
-                        auto method_host = std::make_shared<MethodHost>();
-                        method_host->appendHost(msg->host());
-                        _method_hosts[method] = method_host;
+                        auto it = _method_hosts.find(method);
+                        if (it == _method_hosts.end())
+                        {
+                            auto method_host = std::make_shared<MethodHost>();
+                            method_host->appendHost(host, meta);
+                            _method_hosts[method] = method_host;
+                        }
+                        else
+                        {
+                            it->second->appendHost(host, meta);
+                        }
                     }
-                    else
+                }
+                else if (optype == ServiceOptype::SERVICE_OFFLINE)
+                {
+                    // 3. 下线请求：找到MethodHost，从其中删除一个主机地址，并触发下线回调（同一主机只回调一次）
+                    bool removed = false;
+                    for (auto &method : methods)
+                    {
+                        auto it = _method_hosts.find(method);
+                        if (it == _method_hosts.end())
+                        {
+                            continue;
+                        }
+                        it->second->removeHost(host);
+                        removed = true;
+                    }
+
+                    if (removed)
                     {
-                        it->second->appendHost(msg->host());
+                        _offline_callback(host);
                     }
                 }
-                else if (optype == ServiceOptype::SERVICE_OFFLINE)
+            }
+
+        private:
+            ServiceRequest::ptr watchRequest()
+            {
+                auto msg_req = MessageFactory::create<ServiceRequest>();
+                msg_req->setId(UUID::uuid());
+                msg_req->setMType(MType::REQ_SERVICE);
+                msg_req->setOptype(ServiceOptype::SERVICE_WATCH);
+                return msg_req;
+            }
+
+            // 同步发送一条订阅请求并应用响应，more/names 返回前缀发现是否还有下一页、响应中包含的方法
+            bool watch(const BaseConnection::ptr &conn, const ServiceRequest::ptr &msg_req,
+                       bool *more = nullptr, std::vector<std::string> *names = nullptr)
+            {
+                BaseMessage::ptr msg_rsp;
+                if (_requestor->send(conn, msg_req, msg_rsp) == false)
                 {
-                    // 3. 下线请求：找到MethodHost，从其中删除一个主机地址，并触发下线回调
-                    auto it = _method_hosts.find(method);
-                    if (it == _method_hosts.end())
+                    ELOG("批量服务发现失败！");
+                    return false;
+                }
+
+                auto service_rsp = std::dynamic_pointer_cast<ServiceResponse>(msg_rsp);
+                if (!service_rsp || service_rsp->rcode() != RCode::RCODE_OK)
+                {
+                    ELOG("批量服务发现失败！");
+                    return false;
+                }
+
+                if (more != nullptr)
+                {
+                    *more = service_rsp->more();
+                }
+                applyWatch(service_rsp, names);
+                return true;
+            }
+
+            // 重新同步的响应
+            void onWatchResponse(const BaseMessage::ptr &msg)
+            {
+                auto service_rsp = std::dynamic_pointer_cast<ServiceResponse>(msg);
+                if (!service_rsp || service_rsp->rcode() != RCode::RCODE_OK)
+                {
+                    ELOG("服务重新同步失败！");
+                    return;
+                }
+
+                applyWatch(service_rsp);
+            }
+
+            // 应用订阅响应：全量的直接替换主机列表，增量的按顺序应用，然后更新版本号
+            void applyWatch(const ServiceResponse::ptr &service_rsp, std::vector<std::string> *names = nullptr)
+            {
+                std::string epoch = service_rsp->epoch();
+                std::unique_lock<std::mutex> lock(_mutex);
+                for (auto &result : service_rsp->watchResults())
+                {
+                    if (names != nullptr)
                     {
-                        return;
+                        names->push_back(result.method);
                     }
-                    it->second->removeHost(msg->host());
-                    _offline_callback(msg->host());
+
+                    auto &method_host = _method_hosts[result.method];
+                    if (!method_host)
+                    {
+                        method_host = std::make_shared<MethodHost>();
+                    }
+
+                    std::vector<Address> removed;
+                    if (result.snapshot)
+                    {
+                        removed = method_host->reset(result.hosts, result.metas);
+                    }
+                    else
+                    {
+                        for (auto &change : result.changes)
+                        {
+                            if (change.optype == ServiceOptype::SERVICE_ONLINE)
+                            {
+                                method_host->appendHost(change.host, change.meta);
+                            }
+                            else if (change.optype == ServiceOptype::SERVICE_OFFLINE)
+                            {
+                                method_host->removeHost(change.host);
+                                removed.push_back(change.host);
+                            }
+                        }
+                    }
+
+                    for (auto &host : removed)
+                    {
+                        _offline_callback(host);
+                    }
+
+                    _revisions[result.method] = Revision{epoch, result.revision};
                 }
             }
 
+            // 某个方法已经同步到的版本
+            struct Revision
+            {
+                std::string epoch;
+                uint64_t revision;
+            };
+
         private:
             OfflineCallback _offline_callback; // 当主机下线要进行通知
             std::mutex _mutex;
             std::unordered_map<std::string, MethodHost::ptr> _method_hosts; // key：服务，val：主机列表
+            std::unordered_map<std::string, Revision> _revisions;           // key：服务，val：已经同步到的版本
             Requestor::ptr _requestor;                                      // 用于发送服务发现请求
+            const size_t _watch_batch = 32;                                 // 每条重新同步请求最多包含的方法数
+            std::string _zone;                                              // 客户端所在区域，为空时不区分区域
         };
     }
 }
\ No newline at end of file
@@ -1,9 +1,18 @@
 /*
     主题请求：创建、删除、订阅、取消订阅、发布
+    * 订阅可以用 '+'、'#' 通配符，收到的消息交给所有匹配的订阅回调，回调拿到的是实际的主题名称
+    * 记录每个主题收到的最新序号，断线重连后可以从下一条开始重新订阅，回放期间错过的消息
+    * 持久化主题按 offset 分批拉取历史消息，追上之后转为订阅实时消息
+    * 可靠订阅：按投递序号去掉重发的重复消息，处理完之后按批累计确认，不满一批的确认在 flush 时发出
+    * 消费组订阅：同一个组的多个订阅者分摊一个主题的消息，发布时可以带分区键
+    * 订阅回调可以交给执行器（例如回调线程池）执行：网络线程只把收到的消息放进所属主题的队列，
+      同一主题的回调按收到的顺序依次执行，不同主题的回调可以并行；队列里放的是收到的消息本身，消息内容不复制
 */
 #pragma once
 #include "requestor.hpp"
 #include <unordered_set>
+#include <set>
+#include <deque>
 
 
 namespace rpc
@@ -16,17 +25,99 @@ namespace rpc
         public:
             using SubCallback = std::function<void(const std::string &key, const std::string &msg)>;
             using ptr = std::shared_ptr<TopicManager>;
+            using Message = std::pair<std::string, std::string>; // 主题名称、消息内容
+            using Executor = std::function<void(const std::function<void()> &task)>; // 执行订阅回调：把 task 交给某个线程执行
 
             TopicManager(const Requestor::ptr &requestor)
-                : _requestor(requestor)
+                : _subscriptions(std::make_shared<Subscriptions>()),
+                  _requestor(requestor)
             {
             }
 
+            // 订阅回调交给 executor 执行（为空时在网络线程中直接执行，默认如此），在订阅之前调用；
+            // 同一主题的回调按收到的顺序依次执行，不同主题的回调可能同时执行（通配符订阅的回调要能并发调用）；
+            // executor 要在 TopicManager 销毁之前执行完交给它的任务
+            void setExecutor(const Executor &executor)
+            {
+                std::unique_lock<std::mutex> lock(_strand_mutex);
+                _executor = executor;
+            }
+
             bool create(const BaseConnection::ptr &conn, const std::string &key)
             {
                 return commonRequest(conn, key, TopicOptype::TOPIC_CREATE);
             }
 
+            // 创建主题并保留最近 retain 条消息，供之后的订阅者回放
+            bool create(const BaseConnection::ptr &conn, const std::string &key, size_t retain)
+            {
+                auto msg_req = topicRequest(key, TopicOptype::TOPIC_CREATE);
+                msg_req->setRetain(retain);
+                return waitResponse(conn, msg_req);
+            }
+
+            // 创建持久化主题（服务端需要开启持久化）：消息写入服务端的日志，可以从任意 offset 开始消费
+            bool createDurable(const BaseConnection::ptr &conn, const std::string &key)
+            {
+                auto msg_req = topicRequest(key, TopicOptype::TOPIC_CREATE);
+                msg_req->setDurable(true);
+                return waitResponse(conn, msg_req);
+            }
+
+            // 创建合并主题：服务端按 publishKeyed 的分区键记住每个键的最新消息，新订阅者先收到所有键的最新值；
+            // 订阅者积压时同一个键只保留最新的一条（没有分区键的消息算作同一个键）
+            bool createConflated(const BaseConnection::ptr &conn, const std::string &key)
+            {
+                auto msg_req = topicRequest(key, TopicOptype::TOPIC_CREATE);
+                msg_req->setConflate(true);
+                return waitResponse(conn, msg_req);
+            }
+
+            // 从 offset 为 from 的消息开始消费持久化主题（断线重连后传 lastSeq(key) + 1）：
+            // 先按批拉取日志中的历史消息（每批等一次响应，消费者不会被大量积压淹没），追上之后订阅实时消息
+            bool consume(const BaseConnection::ptr &conn, const std::string &key, uint64_t from, const SubCallback &cb)
+            {
+                addSubscribe(key, cb);
+
+                uint64_t next = std::max<uint64_t>(from, 1);
+                while (true)
+                {
+                    while (true)
+                    {
+                        // 这一批的消息先于响应到达，已经交给了回调
+                        auto msg_req = topicRequest(key, TopicOptype::TOPIC_FETCH);
+                        msg_req->setFrom(next);
+                        auto msg_rsp = topicResponse(conn, msg_req);
+                        if (!msg_rsp)
+                        {
+                            delSubscribe(key);
+                            return false;
+                        }
+
+                        next = msg_rsp->seq();
+                        if (msg_rsp->more() == false)
+                        {
+                            break;
+                        }
+                    }
+
+                    // 拉取结束到订阅生效之间发布的消息由订阅时的回放补上；这期间发布太多、服务端拒绝回放时继续拉取
+                    auto msg_req = topicRequest(key, TopicOptype::TOPIC_SUBSCRIBE);
+                    msg_req->setFrom(next);
+                    RCode rcode = RCode::RCODE_OK;
+                    if (topicResponse(conn, msg_req, &rcode))
+                    {
+                        return true;
+                    }
+
+                    if (rcode != RCode::RCODE_REPLAY_TOO_FAR)
+                    {
+                        delSubscribe(key);
+                        return false;
+                    }
+                }
+            }
+
             bool remove(const BaseConnection::ptr &conn, const std::string &key)
             {
                 return commonRequest(conn, key, TopicOptype::TOPIC_REMOVE);
@@ -34,16 +125,59 @@ namespace rpc
 
             bool subscribe(const BaseConnection::ptr &conn, const std::string &key, const SubCallback &cb)
             {
-                addSubscribe(key, cb);
+                return subscribeRequest(conn, key, cb, topicRequest(key, TopicOptype::TOPIC_SUBSCRIBE));
+            }
 
-                bool ret = commonRequest(conn, key, TopicOptype::TOPIC_SUBSCRIBE);
-                if (ret == false)
+            // 订阅并先回放主题保留的、序号从 seq 开始的消息（通常是 lastSeq(key) + 1）
+            bool subscribeFrom(const BaseConnection::ptr &conn, const std::string &key, uint64_t seq, const SubCallback &cb)
+            {
+                auto msg_req = topicRequest(key, TopicOptype::TOPIC_SUBSCRIBE);
+                msg_req->setFrom(seq);
+                return subscribeRequest(conn, key, cb, msg_req);
+            }
+
+            // 订阅并先回放主题保留的最近 count 条消息
+            bool subscribeLast(const BaseConnection::ptr &conn, const std::string &key, size_t count, const SubCallback &cb)
+            {
+                auto msg_req = topicRequest(key, TopicOptype::TOPIC_SUBSCRIBE);
+                msg_req->setLast(count);
+                return subscribeRequest(conn, key, cb, msg_req);
+            }
+
+            // 可靠订阅（至少一次）：服务端推送给这个连接的消息带投递序号，处理完确认之前会超时重发，重复的消息在这里去掉；
+            // session 不为空时，连接断开后未确认的消息保留在服务端，新连接用同一个会话名称可靠订阅时接着收到
+            bool subscribeReliable(const BaseConnection::ptr &conn, const std::string &key, const SubCallback &cb, const std::string &session = "")
+            {
+                auto msg_req = topicRequest(key, TopicOptype::TOPIC_SUBSCRIBE);
+                msg_req->setReliable(true);
+                if (session.empty() == false)
                 {
-                    delSubscribe(key);
-                    return false;
+                    msg_req->setSession(session);
+                }
+                return subscribeRequest(conn, key, cb, msg_req);
+            }
+
+            // 以消费组 group 的成员身份订阅：组内每条消息只发给一个成员，balance 决定怎么选（由组内第一个成员决定）；
+            // reliable 为 true 时同时开启可靠投递，按负载选择时未确认的消息也算负载，处理慢的成员分到的少
+            bool subscribeGroup(const BaseConnection::ptr &conn, const std::string &key, const std::string &group, const SubCallback &cb,
+                                GroupBalance balance = GroupBalance::LEAST_LOADED, bool reliable = false)
+            {
+                auto msg_req = topicRequest(key, TopicOptype::TOPIC_SUBSCRIBE);
+                msg_req->setGroup(group);
+                msg_req->setBalance(balance);
+                if (reliable)
+                {
+                    msg_req->setReliable(true);
                 }
+                return subscribeRequest(conn, key, cb, msg_req);
+            }
 
-                return true;
+            // 该主题收到的最新一条消息的序号，还没有收到过时为 0
+            uint64_t lastSeq(const std::string &key)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                auto it = _last_seqs.find(key);
+                return it == _last_seqs.end() ? 0 : it->second;
             }
 
             bool cancel(const BaseConnection::ptr &conn, const std::string &key)
@@ -57,6 +191,97 @@ namespace rpc
                 return commonRequest(conn, key, TopicOptype::TOPIC_PUBLISH, msg);
             }
 
+            // 带分区键的发布：按键哈希的消费组中，同一个键的消息总是发给同一个成员
+            bool publishKeyed(const BaseConnection::ptr &conn, const std::string &key, const std::string &msg_key, const std::string &msg)
+            {
+                auto msg_req = topicRequest(key, TopicOptype::TOPIC_PUBLISH);
+                msg_req->setTopicMsg(msg);
+                msg_req->setMsgKey(msg_key);
+                return waitResponse(conn, msg_req);
+            }
+
+            // 不需要响应的发布：发出去就返回，不等待服务端确认（主题不存在时消息被丢弃）
+            bool publishNoAck(const BaseConnection::ptr &conn, const std::string &key, const std::string &msg)
+            {
+                auto msg_req = topicRequest(key, TopicOptype::TOPIC_PUBLISH);
+                msg_req->setTopicMsg(msg);
+                msg_req->setAck(false);
+                return sendNoAck(conn, msg_req);
+            }
+
+            // 批量发布：多条消息（可以属于不同主题）打包成尽量少的帧，每帧不超过 _batch_bytes；
+            // ack 为 true 时每帧等待一次响应，全部成功才返回 true
+            bool publishBatch(const BaseConnection::ptr &conn, const std::vector<Message> &msgs, bool ack = false)
+            {
+                bool ret = true;
+                TopicRequest::ptr msg_req;
+                size_t bytes = 0;
+                for (auto &msg : msgs)
+                {
+                    size_t cost = batchCost(msg.first, msg.second);
+                    if (msg_req && bytes + cost > _batch_bytes)
+                    {
+                        ret = sendBatch(conn, msg_req, ack) && ret;
+                        msg_req.reset();
+                    }
+
+                    if (!msg_req)
+                    {
+                        msg_req = batchRequest(ack);
+                        bytes = 0;
+                    }
+                    msg_req->appendBatch(msg.first, msg.second);
+                    bytes += cost;
+                }
+
+                if (msg_req)
+                {
+                    ret = sendBatch(conn, msg_req, ack) && ret;
+                }
+                return ret;
+            }
+
+            // 异步发布：消息先放进待发送的批次，批次满了（或者调用 flush）才打包成一帧发出，不等待响应
+            // 同一个 TopicManager 上的异步发布按调用顺序到达服务端
+            bool publishAsync(const BaseConnection::ptr &conn, const std::string &key, const std::string &msg)
+            {
+                bool ret = true;
+                size_t cost = batchCost(key, msg);
+                std::unique_lock<std::mutex> lock(_batch_mutex);
+                if (_pending && (_pending_conn != conn || _pending_bytes + cost > _batch_bytes))
+                {
+                    ret = sendNoAck(_pending_conn, _pending);
+                    _pending.reset();
+                }
+
+                if (!_pending)
+                {
+                    _pending = batchRequest(false);
+                    _pending_conn = conn;
+                    _pending_bytes = 0;
+                }
+                _pending->appendBatch(key, msg);
+                _pending_bytes += cost;
+                return ret;
+            }
+
+            // 把待发送的异步发布消息和可靠订阅攒下的确认立即发出
+            bool flush()
+            {
+                flushAcks();
+
+                std::unique_lock<std::mutex> lock(_batch_mutex);
+                if (!_pending)
+                {
+                    return true;
+                }
+
+                bool ret = sendNoAck(_pending_conn, _pending);
+                _pending.reset();
+                _pending_conn.reset();
+                return ret;
+            }
+
             void onPublish(const BaseConnection::ptr &conn, const TopicRequest::ptr &msg)
             {
                 // 先判断消息类型是否属于请求
@@ -67,93 +292,414 @@ namespace rpc
                     return;
                 }
 
-                // 取出消息主题名称和内容
+                // 可靠投递的消息：重发的、已经处理过（或者正在排队处理）的只补发确认
+                uint64_t delivery = msg->delivery();
+                if (delivery > 0 && acceptDelivery(conn, delivery) == false)
+                {
+                    sendAck(conn, true);
+                    return;
+                }
+
                 std::string topic_key = msg->topicKey();
-                std::string topic_msg = msg->topicMsg();
+                Received item{conn, msg, topic_key, delivery};
+                Executor executor;
+                bool start = false;
+                {
+                    std::unique_lock<std::mutex> lock(_strand_mutex);
+                    if (_executor)
+                    {
+                        // 放进主题的队列，队列空闲时交给执行器开始处理
+                        Strand &strand = _strands[topic_key];
+                        strand.queue.push_back(std::move(item));
+                        start = strand.running == false;
+                        strand.running = true;
+                        executor = _executor;
+                    }
+                }
 
-                // 通过主题找到对应的回调函数进行处理，有则处理，无则报错
-                auto callback = getSubscribe(topic_key);
-                if (!callback)
+                if (!executor)
                 {
-                    ELOG("收到了 %s 主题消息，但是该消息无主题处理回调函数！", topic_key.c_str());
-                    return;
+                    return dispatch(item);
                 }
 
-                return callback(topic_key, topic_msg);
+                if (start)
+                {
+                    executor([this, topic_key]() { drain(topic_key); });
+                }
             }
 
         private:
-            // 添加订阅
+            // 订阅表的快照：订阅变化时整体替换，处理消息时只在拿快照时短暂加锁
+            struct Subscriptions
+            {
+                std::unordered_map<std::string, SubCallback> topics;    // key：主题，val：对应回调
+                std::unordered_map<std::string, SubCallback> wildcards; // key：带通配符的过滤条件，val：对应回调
+            };
+
+            // 收到的一条发布消息（执行器模式下在主题队列中排队）
+            struct Received
+            {
+                BaseConnection::ptr conn;
+                TopicRequest::ptr msg;  // 收到的消息本身，消息内容在处理时才取出
+                std::string topic_key;
+                uint64_t delivery;      // 可靠投递的序号，不是可靠投递时为 0
+            };
+
+            // 一个主题的待处理消息：running 表示已经交给执行器，还没处理完
+            struct Strand
+            {
+                std::deque<Received> queue;
+                bool running = false;
+            };
+
+            TopicRequest::ptr topicRequest(const std::string &key, TopicOptype type)
+            {
+                auto msg_req = MessageFactory::create<TopicRequest>();
+                msg_req->setId(UUID::uuid());
+                msg_req->setMType(MType::REQ_TOPIC);
+                msg_req->setOptype(type);
+                msg_req->setTopicKey(key);
+                return msg_req;
+            }
+
+            // 处理一条收到的消息：取出消息内容（只取一次，所有匹配的回调共用），交给精确订阅和匹配的通配符订阅的回调
+            void dispatch(const Received &item)
+            {
+                updateSeq(item.topic_key, item.msg->seq());
+
+                std::shared_ptr<const Subscriptions> subscriptions;
+                {
+                    std::unique_lock<std::mutex> lock(_sub_mutex);
+                    subscriptions = _subscriptions;
+                }
+
+                std::string topic_msg = item.msg->topicMsg();
+                bool handled = false;
+                auto it = subscriptions->topics.find(item.topic_key);
+                if (it != subscriptions->topics.end())
+                {
+                    it->second(item.topic_key, topic_msg);
+                    handled = true;
+                }
+
+                for (auto &filter : subscriptions->wildcards)
+                {
+                    if (TopicFilter::match(filter.first, item.topic_key))
+                    {
+                        filter.second(item.topic_key, topic_msg);
+                        handled = true;
+                    }
+                }
+
+                if (handled == false)
+                {
+                    ELOG("收到了 %s 主题消息，但是该消息无主题处理回调函数！", item.topic_key.c_str());
+                }
+
+                // 回调处理完才确认，处理过程中进程退出的消息会被重发
+                if (item.delivery > 0)
+                {
+                    finishDelivery(item.conn, item.delivery);
+                    sendAck(item.conn, false);
+                }
+            }
+
+            // 在执行器中依次处理主题队列里的消息；连续处理 _strand_batch 条后重新排队，让其他主题也有机会执行
+            void drain(const std::string &topic_key)
+            {
+                for (size_t count = 0;; count++)
+                {
+                    Received item;
+                    Executor executor;
+                    {
+                        std::unique_lock<std::mutex> lock(_strand_mutex);
+                        auto it = _strands.find(topic_key);
+                        if (it->second.queue.empty())
+                        {
+                            _strands.erase(it);
+                            return;
+                        }
+
+                        if (count == _strand_batch)
+                        {
+                            executor = _executor;
+                        }
+                        else
+                        {
+                            item = std::move(it->second.queue.front());
+                            it->second.queue.pop_front();
+                        }
+                    }
+
+                    if (executor)
+                    {
+                        executor([this, topic_key]() { drain(topic_key); });
+                        return;
+                    }
+                    dispatch(item);
+                }
+            }
+
+            // 可靠投递的消息到达：已经处理过或者正在排队处理的（重发的）返回 false，否则记为处理中
+            bool acceptDelivery(const BaseConnection::ptr &conn, uint64_t seq)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                Delivery &state = _deliveries[conn];
+                if (seq <= state.received || state.ahead.count(seq) > 0 || state.inflight.count(seq) > 0)
+                {
+                    return false;
+                }
+
+                state.inflight.insert(seq);
+                return true;
+            }
+
+            // 可靠投递的消息处理完：连续处理完的部分推进 received，跳过的（服务端丢弃后会重发，或者其他主题还没处理完）记在 ahead 里
+            void finishDelivery(const BaseConnection::ptr &conn, uint64_t seq)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                Delivery &state = _deliveries[conn];
+                state.inflight.erase(seq);
+                if (seq != state.received + 1)
+                {
+                    state.ahead.insert(seq);
+                    return;
+                }
+
+                state.received = seq;
+                while (state.ahead.empty() == false && *state.ahead.begin() == state.received + 1)
+                {
+                    state.received++;
+                    state.ahead.erase(state.ahead.begin());
+                }
+            }
+
+            // 发送累计确认：攒够 _ack_batch 条才发，force 时只要收到过就发（对方在重发，说明之前的确认还没到）
+            void sendAck(const BaseConnection::ptr &conn, bool force)
+            {
+                uint64_t seq = 0;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    auto it = _deliveries.find(conn);
+                    if (it == _deliveries.end() || it->second.received == 0)
+                    {
+                        return;
+                    }
+
+                    Delivery &state = it->second;
+                    if (force == false && state.received - state.acked < _ack_batch)
+                    {
+                        return;
+                    }
+                    state.acked = state.received;
+                    seq = state.acked;
+                }
+
+                auto msg_req = topicRequest("", TopicOptype::TOPIC_ACK);
+                msg_req->setSeq(seq);
+                sendNoAck(conn, msg_req);
+            }
+
+            // 发出所有连接上还没发出的确认
+            void flushAcks()
+            {
+                std::vector<BaseConnection::ptr> conns;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    for (auto &it : _deliveries)
+                    {
+                        if (it.second.received > it.second.acked)
+                        {
+                            conns.push_back(it.first);
+                        }
+                    }
+                }
+
+                for (auto &conn : conns)
+                {
+                    sendAck(conn, true);
+                }
+            }
+
+            // 先登记回调再发送订阅请求（回放的消息可能先于响应到达），失败时撤销
+            bool subscribeRequest(const BaseConnection::ptr &conn, const std::string &key, const SubCallback &cb, const TopicRequest::ptr &msg_req)
+            {
+                addSubscribe(key, cb);
+
+                bool ret = waitResponse(conn, msg_req);
+                if (ret == false)
+                {
+                    delSubscribe(key);
+                    return false;
+                }
+
+                return true;
+            }
+
+            TopicRequest::ptr batchRequest(bool ack)
+            {
+                auto msg_req = MessageFactory::create<TopicRequest>();
+                msg_req->setId(UUID::uuid());
+                msg_req->setMType(MType::REQ_TOPIC);
+                msg_req->setOptype(TopicOptype::TOPIC_PUBLISH_BATCH);
+                if (ack == false)
+                {
+                    msg_req->setAck(false);
+                }
+                return msg_req;
+            }
+
+            // 一条消息在批量发布正文中大约占用的字节数
+            size_t batchCost(const std::string &key, const std::string &msg)
+            {
+                return key.size() + msg.size() + _item_overhead;
+            }
+
+            bool sendBatch(const BaseConnection::ptr &conn, const TopicRequest::ptr &msg_req, bool ack)
+            {
+                if (ack)
+                {
+                    return waitResponse(conn, msg_req);
+                }
+                return sendNoAck(conn, msg_req);
+            }
+
+            bool sendNoAck(const BaseConnection::ptr &conn, const TopicRequest::ptr &msg_req)
+            {
+                if (!conn || conn->connected() == false)
+                {
+                    ELOG("主题发布失败，连接已断开！");
+                    return false;
+                }
+
+                conn->send(msg_req);
+                return true;
+            }
+
+            // 添加订阅：复制一份订阅表改好后替换，处理消息时拿到的订阅表不会再变
             void addSubscribe(const std::string &key, const SubCallback &cb)
             {
                 std::unique_lock<std::mutex> lock(_mutex);
-                _topic_callbacks.insert(std::make_pair(key, cb));
+                auto next = std::make_shared<Subscriptions>(*_subscriptions);
+                if (TopicFilter::isWildcard(key))
+                {
+                    next->wildcards.insert(std::make_pair(key, cb));
+                }
+                else
+                {
+                    next->topics.insert(std::make_pair(key, cb));
+                }
+
+                std::unique_lock<std::mutex> sub_lock(_sub_mutex);
+                _subscriptions = next;
             }
 
             // 删除订阅
             void delSubscribe(const std::string &key)
             {
                 std::unique_lock<std::mutex> lock(_mutex);
-                _topic_callbacks.erase(key);
+                auto next = std::make_shared<Subscriptions>(*_subscriptions);
+                next->topics.erase(key);
+                next->wildcards.erase(key);
+
+                std::unique_lock<std::mutex> sub_lock(_sub_mutex);
+                _subscriptions = next;
             }
 
-            // 获取订阅回调
-            const SubCallback getSubscribe(const std::string &key)
+            // 记录主题收到的最新序号（旧版本服务端的消息没有序号，不记录）
+            void updateSeq(const std::string &key, uint64_t seq)
             {
-                std::unique_lock<std::mutex> lock(_mutex);
-                auto it = _topic_callbacks.find(key);
-                if (it == _topic_callbacks.end())
+                if (seq == 0)
                 {
-                    return SubCallback();
+                    return;
                 }
 
-                return it->second;
+                std::unique_lock<std::mutex> lock(_mutex);
+                _last_seqs[key] = seq;
             }
 
             // 发送请求：目标服务器连接对象、主题名称、主题操作、消息
             bool commonRequest(const BaseConnection::ptr &conn, const std::string &key, TopicOptype type, const std::string &msg = "")
             {
                 // 1. 构造请求对象，并填充数据
-                auto msg_req = MessageFactory::create<TopicRequest>();
-                msg_req->setId(UUID::uuid());
-                msg_req->setMType(MType::REQ_TOPIC);
-                msg_req->setOptype(type);
-                msg_req->setTopicKey(key);
+                auto msg_req = topicRequest(key, type);
                 if (type == TopicOptype::TOPIC_PUBLISH)
                 {
                     msg_req->setTopicMsg(msg);
                 }
 
-                // 2. 向服务端发送请求，等待响应
+                return waitResponse(conn, msg_req);
+            }
+
+            // 向服务端发送请求，等待响应并判断是否处理成功
+            bool waitResponse(const BaseConnection::ptr &conn, const TopicRequest::ptr &msg_req)
+            {
+                return topicResponse(conn, msg_req) != nullptr;
+            }
+
+            // 同上，成功时返回响应，失败时返回空；rcode 不为空时带回服务端的响应码
+            TopicResponse::ptr topicResponse(const BaseConnection::ptr &conn, const TopicRequest::ptr &msg_req, RCode *rcode = nullptr)
+            {
+                // 1. 发送请求，等待响应
                 BaseMessage::ptr msg_rsp;
                 bool ret = _requestor->send(conn, msg_req, msg_rsp);
                 if (ret == false)
                 {
                     ELOG("主题操作请求失败！");
-                    return false;
+                    return TopicResponse::ptr();
                 }
 
-                // 3. 判断请求处理是否成功
+                // 2. 判断请求处理是否成功
                 auto topic_rsp_msg = std::dynamic_pointer_cast<TopicResponse>(msg_rsp);
                 if (!topic_rsp_msg)
                 {
                     ELOG("主题操作响应，向下类型转换失败！");
-                    return false;
+                    return TopicResponse::ptr();
+                }
+
+                if (rcode)
+                {
+                    *rcode = topic_rsp_msg->rcode();
                 }
 
                 if (topic_rsp_msg->rcode() != RCode::RCODE_OK)
                 {
                     ELOG("主题操作请求出错：%s", errReason(topic_rsp_msg->rcode()).c_str());
-                    return false;
+                    return TopicResponse::ptr();
                 }
 
-                return true;
+                return topic_rsp_msg;
             }
 
         private:
             std::mutex _mutex;
-            std::unordered_map<std::string, SubCallback> _topic_callbacks; // key：主题，val：对应回调
+            std::unordered_map<std::string, uint64_t> _last_seqs;          // key：主题，val：收到的最新序号
+            std::mutex _sub_mutex;                                         // 只保护 _subscriptions 指针本身
+            std::shared_ptr<const Subscriptions> _subscriptions;
+
+            std::mutex _strand_mutex;
+            Executor _executor;                                            // 为空时在网络线程中直接执行回调
+            std::unordered_map<std::string, Strand> _strands;              // key：主题，val：等待执行器处理的消息
+            const size_t _strand_batch = 64;                               // 一个主题连续处理这么多条后让出执行器
+
+            // 一个连接上可靠投递的接收状态
+            struct Delivery
+            {
+                uint64_t received = 0;     // 连续收到（已处理）的最大投递序号
+                uint64_t acked = 0;        // 已经确认到的投递序号
+                std::set<uint64_t> ahead;  // 跳过 received + 1 先处理完的投递序号
+                std::set<uint64_t> inflight; // 收到了、还在排队或者处理中的投递序号
+            };
+            std::unordered_map<BaseConnection::ptr, Delivery> _deliveries; // key：连接，val：可靠投递的接收状态
+            const uint64_t _ack_batch = 64;                                // 每收到这么多条确认一次
             Requestor::ptr _requestor;                                     // rpc远端服务通信
+
+            std::mutex _batch_mutex;
+            TopicRequest::ptr _pending;            // 待发送的异步发布批次
+            BaseConnection::ptr _pending_conn;     // 待发送批次的目标连接
+            size_t _pending_bytes = 0;             // 待发送批次的大致字节数
+            const size_t _batch_bytes = 32 * 1024; // 每帧批量发布的正文上限，远小于协议的最大帧长
+            const size_t _item_overhead = 32;      // 每条消息在正文中的字段名、引号等额外开销
         };
     }
 }
\ No newline at end of file
@@ -76,6 +76,8 @@ namespace rpc
         // 从缓冲区解析消息
         virtual bool onMessage(const BaseBuffer::ptr &buf, BaseMessage::ptr &msg) = 0;
         virtual std::string serialize(const BaseMessage::ptr &msg) = 0;
+        // 正文已经序列化好（内容固定的响应等）时直接组帧
+        virtual std::string serialize(MType mtype, const std::string &id, const std::string &body) = 0;
 
         // 判断一条消息是否完整
         virtual bool canProcessed(const BaseBuffer::ptr &buf) = 0;
@@ -88,8 +90,45 @@ namespace rpc
     public:
         using ptr = std::shared_ptr<BaseConnection>;
         virtual void send(const BaseMessage::ptr &msg) = 0;
+        virtual void sendRaw(const std::string &frame) = 0; // 发送已经按协议编码好的完整消息帧
         virtual void shutdown() = 0;    // 关闭连接
         virtual bool connected() = 0;   // 是否已连接
+
+        // 发送一段连续的、已经编码好的消息帧（可以是多帧），data 只需要在调用期间有效
+        virtual void sendBytes(const char *data, size_t len)
+        {
+            sendRaw(std::string(data, len));
+        }
+
+        // 立即关闭连接，不等待发送缓冲中的数据发完（对端不再读取数据时 shutdown 无法完成）
+        virtual void forceClose()
+        {
+            shutdown();
+        }
+
+        // 发送缓冲积压达到 mark 字节时回调 on_high，之后积压全部发完时回调一次 on_drain（都在网络线程中）
+        // 不支持的连接不回调，相当于永远不积压
+        virtual void setHighWaterMarkCallback(size_t /*mark*/, const std::function<void()> &/*on_high*/, const std::function<void()> &/*on_drain*/)
+        {
+        }
+
+        // 连接所在网络线程（事件循环）的标识，同一个网络线程上的连接返回相同的值；没有网络线程的连接返回 nullptr
+        virtual const void *loop()
+        {
+            return nullptr;
+        }
+
+        // 在连接所在的网络线程中执行 task（当前就在该线程中时立即执行），没有网络线程的连接直接执行
+        virtual void runInLoop(const std::function<void()> &task)
+        {
+            task();
+        }
+
+        // 把 task 放到连接所在网络线程的任务队列末尾（当前就在该线程中也不立即执行），没有网络线程的连接直接执行
+        virtual void queueInLoop(const std::function<void()> &task)
+        {
+            task();
+        }
     };
 
 
@@ -123,6 +162,7 @@ namespace rpc
         }
 
         virtual void start() = 0;   // 启动服务器
+        virtual void setThreadNum(int /*num*/) {} // 网络线程数（不含监听线程），在 start 之前调用；不支持的服务器忽略
 
     protected:
         ConnectionCallback _cb_connection;
@@ -156,6 +196,7 @@ namespace rpc
         virtual void shutdown() = 0;                     // 关闭连接
         virtual bool connected() = 0;                    // 是否已经连接
         virtual BaseConnection::ptr connection() = 0;    // 获取底层连接对象
+        virtual void enableRetry() {}                    // 连接断开后自动重连（需在 connect 之前调用）
 
     protected:
         ConnectionCallback _cb_connection;
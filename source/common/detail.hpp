@@ -2,7 +2,9 @@
     实现项目中用到的一些琐碎功能代码
     * 日志宏的定义
     * json的序列化和反序列化
+    * json的规范化哈希（相同内容得到相同哈希，与对象成员的插入顺序无关）
     * uuid的生成
+    * 主题过滤条件（层级主题与通配符）的解析和匹配
 */
 #pragma once
 #include <cstdio>
@@ -17,6 +19,9 @@
 #include <random>   // 随机数生成器
 #include <atomic>
 #include <iomanip>  // 格式化输出
+#include <cstring>
+#include <cstdint>
+#include <vector>
 
 namespace rpc
 {
@@ -80,6 +85,84 @@ namespace rpc
 
             return true;
         }
+
+        // 计算 Json::Value 的规范化哈希（FNV-1a），直接遍历值树，不经过序列化
+        // jsoncpp 对象成员按键名有序存储，所以成员的插入顺序不影响结果
+        static uint64_t hash(const Json::Value &val, uint64_t seed = 14695981039346656037ULL)
+        {
+            int type = (int)val.type();
+            uint64_t h = hashBytes(seed, &type, sizeof(type));
+
+            switch (val.type())
+            {
+            case Json::nullValue:
+                break;
+            case Json::intValue:
+            {
+                Json::LargestInt v = val.asLargestInt();
+                h = hashBytes(h, &v, sizeof(v));
+                break;
+            }
+            case Json::uintValue:
+            {
+                Json::LargestUInt v = val.asLargestUInt();
+                h = hashBytes(h, &v, sizeof(v));
+                break;
+            }
+            case Json::realValue:
+            {
+                double v = val.asDouble();
+                h = hashBytes(h, &v, sizeof(v));
+                break;
+            }
+            case Json::stringValue:
+            {
+                const char *begin = nullptr, *end = nullptr;
+                val.getString(&begin, &end);
+                h = hashBytes(h, begin, end - begin);
+                break;
+            }
+            case Json::booleanValue:
+            {
+                bool v = val.asBool();
+                h = hashBytes(h, &v, sizeof(v));
+                break;
+            }
+            case Json::arrayValue:
+                for (Json::ArrayIndex i = 0; i < val.size(); i++)
+                {
+                    h = hash(val[i], h);
+                }
+                break;
+            case Json::objectValue:
+                for (auto it = val.begin(); it != val.end(); ++it)
+                {
+                    const char *end = nullptr;
+                    const char *name = it.memberName(&end);
+                    h = hashBytes(h, name, end - name);
+                    h = hash(*it, h);
+                }
+                break;
+            }
+
+            return h;
+        }
+
+    private:
+        static uint64_t hashBytes(uint64_t h, const void *data, size_t len)
+        {
+            const unsigned char *p = static_cast<const unsigned char *>(data);
+            for (size_t i = 0; i < len; i++)
+            {
+                h ^= p[i];
+                h *= 1099511628211ULL;
+            }
+
+            // 每段数据后混入长度，避免 {"ab":"c"} 与 {"a":"bc"} 这类拼接歧义
+            h ^= len;
+            h *= 1099511628211ULL;
+            return h;
+        }
     };
 
 
@@ -91,11 +174,10 @@ namespace rpc
             std::stringstream ss;
 
             // 1. 构造一个机器随机数对象
-            std::random_device rd;
-
             // 2. 以机器随机数种子初始化一个伪随机数对象（基于梅森旋转算法，mt19937）
-            // 用rd()生成的真随机数作为种子，确保每次程序运行时，生成的随机序列不同
-            std::mt19937 generator(rd());
+            // 用 random_device 生成的真随机数作为种子，确保每次程序运行时，生成的随机序列不同
+            // 每个线程只初始化一次：每次调用都重新构造和播种的开销比生成 UUID 本身大得多（发布消息等高频路径每条都要生成）
+            static thread_local std::mt19937 generator(std::random_device{}());
 
             // 3. 构造限定数据范围的对象
             // 0-255是1个字节（8位二进制）的取值范围，方便后续转换为2个十六进制字符
@@ -132,4 +214,95 @@ namespace rpc
             return ss.str();
         }
     };
+
+
+    // 主题名称用 '/' 分成多层，例如 "sensor/room1/temp"
+    // 订阅时的过滤条件可以带通配符：'+' 匹配任意一层，'#' 匹配剩下的所有层（包括零层），
+    // 通配符必须独占一层，'#' 只能是最后一层，例如 "sensor/+/temp"、"sensor/#"
+    class TopicFilter
+    {
+    public:
+        // 按 '/' 拆分层级，空层也保留（"a//b" 是三层）
+        static std::vector<std::string> split(const std::string &topic)
+        {
+            std::vector<std::string> levels;
+            size_t begin = 0;
+            while (true)
+            {
+                size_t pos = topic.find('/', begin);
+                if (pos == std::string::npos)
+                {
+                    levels.push_back(topic.substr(begin));
+                    return levels;
+                }
+
+                levels.push_back(topic.substr(begin, pos - begin));
+                begin = pos + 1;
+            }
+        }
+
+        // 过滤条件是否带通配符
+        static bool isWildcard(const std::string &filter)
+        {
+            for (auto &level : split(filter))
+            {
+                if (level == "+" || level == "#")
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // 主题名称（创建、发布时）中不能有通配符层，通配符只用于订阅的过滤条件
+        static bool validName(const std::string &topic)
+        {
+            return topic.find_first_of("+#") == std::string::npos || isWildcard(topic) == false;
+        }
+
+        // 检查过滤条件的格式：通配符独占一层，'#' 只能在最后
+        static bool valid(const std::string &filter)
+        {
+            auto levels = split(filter);
+            for (size_t i = 0; i < levels.size(); i++)
+            {
+                auto &level = levels[i];
+                if (level.size() > 1 && level.find_first_of("+#") != std::string::npos)
+                {
+                    return false;
+                }
+
+                if (level == "#" && i + 1 != levels.size())
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // 主题是否和过滤条件匹配（过滤条件需要先用 valid 检查过）
+        static bool match(const std::string &filter, const std::string &topic)
+        {
+            auto filter_levels = split(filter);
+            auto topic_levels = split(topic);
+            for (size_t i = 0; i < filter_levels.size(); i++)
+            {
+                if (filter_levels[i] == "#")
+                {
+                    return true;
+                }
+
+                if (i == topic_levels.size())
+                {
+                    return false;
+                }
+
+                if (filter_levels[i] != "+" && filter_levels[i] != topic_levels[i])
+                {
+                    return false;
+                }
+            }
+            return filter_levels.size() == topic_levels.size();
+        }
+    };
 }
\ No newline at end of file
@@ -12,12 +12,39 @@ namespace rpc
     #define KEY_PARAMS      "parameters"   // 方法参数（RPC调用时的参数列表）
     #define KEY_TOPIC_KEY   "topic_key"    // 主题关键字/名称（用于发布/订阅）
     #define KEY_TOPIC_MSG   "topic_msg"    // 主题消息内容（发布的消息内容）
+    #define KEY_TOPIC_ACK   "ack"          // 发布是否需要响应（没有该字段时需要）
+    #define KEY_TOPIC_BATCH "batch"        // 批量发布的消息列表（每一项包含主题名称和消息内容）
+    #define KEY_TOPIC_SEQ   "seq"          // 发布消息在主题中的序号（服务端转发时填写，从 1 开始连续递增）
+    #define KEY_TOPIC_RETAIN "retain"      // 创建主题时指定保留的最近消息条数（供新订阅者回放）
+    #define KEY_TOPIC_FROM  "from"         // 订阅时从该序号开始回放保留的消息
+    #define KEY_TOPIC_LAST  "last"         // 订阅时回放最近的若干条保留消息
+    #define KEY_TOPIC_DURABLE "durable"    // 创建持久化主题（消息写入服务端的日志文件）
+    #define KEY_TOPIC_MAX_BYTES "max_bytes" // 按 offset 读取持久化主题时，一次最多返回的字节数
+    #define KEY_TOPIC_RELIABLE "reliable"  // 可靠订阅：推送的消息带投递序号，订阅者确认之前服务端会重发
+    #define KEY_TOPIC_SESSION "session"    // 可靠订阅的会话名称（连接断开后未确认的消息留给同名的新连接）
+    #define KEY_TOPIC_GROUP "group"        // 订阅时加入的消费组（组内每条消息只发给一个成员）
+    #define KEY_TOPIC_BALANCE "balance"    // 消费组选择成员的方式（见 GroupBalance）
+    #define KEY_TOPIC_MSG_KEY "msg_key"    // 发布消息的分区键：按键哈希的消费组中，同一个键的消息发给同一个成员
+    #define KEY_TOPIC_CONFLATE "conflate"  // 创建合并主题：每个键只关心最新值，积压时同一个键只保留最新的一条
     #define KEY_OPTYPE      "optype"       // 操作类型（区分具体操作行为）
     #define KEY_HOST        "host"         // 主机地址/信息（可包含IP和端口）
     #define KEY_HOST_IP     "ip"           // 主机IP地址
     #define KEY_HOST_PORT   "port"         // 主机端口号
     #define KEY_RCODE       "rcode"        // 返回/响应码（表示RPC调用状态）
     #define KEY_RESULT      "result"       // 返回/调用结果（RPC响应内容）
+    #define KEY_METHODS     "methods"      // 方法名称列表（批量注册/批量上下线通知）
+    #define KEY_CHANGES     "changes"      // 服务变更列表（合并后的上下线通知）
+    #define KEY_REVISION    "revision"     // 服务的版本号（每次上下线递增）
+    #define KEY_EPOCH       "epoch"        // 注册中心实例标识（重启后变化，版本号只在同一实例内可比较）
+    #define KEY_WATCH       "watch"        // 订阅列表/订阅结果（从某个版本开始同步服务变化）
+    #define KEY_META        "meta"         // 提供者的元数据（注册、心跳时携带，随主机信息下发给发现者）
+    #define KEY_META_WEIGHT "weight"       // 元数据：权重（正整数，默认 100）
+    #define KEY_META_ZONE   "zone"         // 元数据：所在区域（发现者优先选择同区域的主机）
+    #define KEY_META_VERSION "version"     // 元数据：版本标签
+    #define KEY_META_LOAD   "load"         // 元数据：当前负载（0~100，负载越高分到的请求越少）
+    #define KEY_PREFIX      "prefix"       // 按方法名前缀批量发现
+    #define KEY_AFTER       "after"        // 前缀发现的分页位置（上一页最后一个方法名）
+    #define KEY_MORE        "more"         // 前缀发现还有下一页
 
     // 消息类型定义（用于消息格式第二个：4字节消息类型）
     enum class MType
@@ -42,7 +69,9 @@ namespace rpc
         RCODE_NOT_FOUND_SERVICE, // 没有找到对应的服务（服务未注册/下线）
         RCODE_INVALID_OPTYPE,    // 无效的操作类型
         RCODE_NOT_FOUND_TOPIC,   // 没有找到对应的主题
-        RCODE_INTERNAL_ERROR     // 内部错误
+        RCODE_INTERNAL_ERROR,    // 内部错误
+        RCODE_OVERLOAD,          // 服务过载，请求被拒绝
+        RCODE_REPLAY_TOO_FAR     // 订阅要回放的消息太多，需要先按 offset 拉取
     };
 
     // 错误码定义
@@ -58,7 +87,9 @@ namespace rpc
             {RCode::RCODE_NOT_FOUND_SERVICE, "没有找到对应的服务！"},
             {RCode::RCODE_INVALID_OPTYPE, "无效的操作类型！"},
             {RCode::RCODE_NOT_FOUND_TOPIC, "没有找到对应的主题！"},
-            {RCode::RCODE_INTERNAL_ERROR, "内部错误！"}};
+            {RCode::RCODE_INTERNAL_ERROR, "内部错误！"},
+            {RCode::RCODE_OVERLOAD, "服务过载，请求被拒绝！"},
+            {RCode::RCODE_REPLAY_TOO_FAR, "要回放的消息太多，请先按 offset 拉取！"}};
 
         auto it = err_map.find(code);
         if (it == err_map.end())
@@ -80,11 +111,21 @@ namespace rpc
     // Topic（主题）操作类型
     enum class TopicOptype
     {
-        TOPIC_CREATE = 0, // 创建主题
-        TOPIC_REMOVE,     // 删除
-        TOPIC_SUBSCRIBE,  // 订阅
-        TOPIC_CANCEL,     // 取消订阅
-        TOPIC_PUBLISH     // 发布主题消息
+        TOPIC_CREATE = 0,    // 创建主题
+        TOPIC_REMOVE,        // 删除
+        TOPIC_SUBSCRIBE,     // 订阅
+        TOPIC_CANCEL,        // 取消订阅
+        TOPIC_PUBLISH,       // 发布主题消息
+        TOPIC_PUBLISH_BATCH, // 批量发布（一帧包含多条消息，可以属于不同主题）
+        TOPIC_FETCH,         // 按 offset 读取持久化主题的消息（消息以发布帧推送，响应中带下一次读取的 offset）
+        TOPIC_ACK            // 订阅者累计确认可靠投递的消息（投递序号放在 seq 中，不需要响应）
+    };
+
+    // 消费组选择成员的方式
+    enum class GroupBalance
+    {
+        LEAST_LOADED = 0, // 排队和未确认的消息最少的成员，相同时轮流
+        KEY_HASH          // 按消息的分区键哈希，同一个键总是发给同一个成员（没有键的消息按负载选择）
     };
 
     // Service（服务）操作类型
@@ -94,6 +135,10 @@ namespace rpc
         SERVICE_DISCOVERY,    // 服务发现
         SERVICE_ONLINE,       // 服务上线
         SERVICE_OFFLINE,      // 服务下线
+        SERVICE_DELTA,        // 服务变更（一段时间内合并的多条上线/下线）
+        SERVICE_WATCH,        // 从指定版本同步服务（应答增量或全量）
+        SERVICE_HEARTBEAT,    // 提供者心跳（续约）
+        SERVICE_SYNC,         // 注册中心副本之间同步各自的提供者（格式同服务变更）
         SERVICE_UNKNOW        // 服务未知
     };
 }
\ No newline at end of file
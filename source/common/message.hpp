@@ -116,7 +116,7 @@ namespace rpc
             _body[KEY_METHOD] = method_name;
         }
 
-        Json::Value params()
+        const Json::Value &params()
         {
             return _body[KEY_PARAMS];
         }
@@ -138,6 +138,65 @@ namespace rpc
 
         virtual bool check() override
         {
+            if (_body.isMember(KEY_TOPIC_ACK) == true && _body[KEY_TOPIC_ACK].isBool() == false)
+            {
+                ELOG("主题请求中响应标志类型错误！");
+                return false;
+            }
+
+            if ((_body.isMember(KEY_TOPIC_SEQ) == true && _body[KEY_TOPIC_SEQ].isUInt64() == false) ||
+                (_body.isMember(KEY_TOPIC_FROM) == true && _body[KEY_TOPIC_FROM].isUInt64() == false) ||
+                (_body.isMember(KEY_TOPIC_RETAIN) == true && _body[KEY_TOPIC_RETAIN].isUInt() == false) ||
+                (_body.isMember(KEY_TOPIC_LAST) == true && _body[KEY_TOPIC_LAST].isUInt() == false) ||
+                (_body.isMember(KEY_TOPIC_MAX_BYTES) == true && _body[KEY_TOPIC_MAX_BYTES].isUInt() == false))
+            {
+                ELOG("主题请求中序号或回放条数类型错误！");
+                return false;
+            }
+
+            if ((_body.isMember(KEY_TOPIC_DURABLE) == true && _body[KEY_TOPIC_DURABLE].isBool() == false) ||
+                (_body.isMember(KEY_TOPIC_CONFLATE) == true && _body[KEY_TOPIC_CONFLATE].isBool() == false))
+            {
+                ELOG("主题请求中持久化或合并标志类型错误！");
+                return false;
+            }
+
+            if ((_body.isMember(KEY_TOPIC_RELIABLE) == true && _body[KEY_TOPIC_RELIABLE].isBool() == false) ||
+                (_body.isMember(KEY_TOPIC_SESSION) == true && _body[KEY_TOPIC_SESSION].isString() == false))
+            {
+                ELOG("主题请求中可靠订阅字段类型错误！");
+                return false;
+            }
+
+            if ((_body.isMember(KEY_TOPIC_GROUP) == true && _body[KEY_TOPIC_GROUP].isString() == false) ||
+                (_body.isMember(KEY_TOPIC_BALANCE) == true && _body[KEY_TOPIC_BALANCE].isIntegral() == false) ||
+                (_body.isMember(KEY_TOPIC_MSG_KEY) == true && _body[KEY_TOPIC_MSG_KEY].isString() == false))
+            {
+                ELOG("主题请求中消费组字段类型错误！");
+                return false;
+            }
+
+            // 批量发布：每一项都要有主题名称和消息内容，不需要单独的主题名称
+            if (_body[KEY_OPTYPE].isIntegral() == true && _body[KEY_OPTYPE].asInt() == (int)TopicOptype::TOPIC_PUBLISH_BATCH)
+            {
+                if (_body[KEY_TOPIC_BATCH].isArray() == false)
+                {
+                    ELOG("批量发布请求中没有消息列表！");
+                    return false;
+                }
+
+                for (auto &item : _body[KEY_TOPIC_BATCH])
+                {
+                    if (item.isObject() == false || item[KEY_TOPIC_KEY].isString() == false || item[KEY_TOPIC_MSG].isString() == false)
+                    {
+                        ELOG("批量发布请求中消息错误！");
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+
             if(_body[KEY_TOPIC_KEY].isNull() == true || _body[KEY_TOPIC_KEY].isString() == false)
             {
                 ELOG("主题请求中没有主题名称或者主题名称类型错误！");
@@ -189,6 +248,182 @@ namespace rpc
         {
             _body[KEY_TOPIC_MSG] = msg;
         }
+
+        // 发布者是否需要响应：不需要时服务端只转发消息，成功与否都不回复
+        bool ack()
+        {
+            return _body.isMember(KEY_TOPIC_ACK) == false || _body[KEY_TOPIC_ACK].asBool();
+        }
+
+        void setAck(bool ack)
+        {
+            _body[KEY_TOPIC_ACK] = ack;
+        }
+
+        // 批量发布中的消息（主题名称、消息内容），按发布顺序排列
+        const Json::Value &batch()
+        {
+            return _body[KEY_TOPIC_BATCH];
+        }
+
+        void appendBatch(const std::string &key, const std::string &msg)
+        {
+            Json::Value item;
+            item[KEY_TOPIC_KEY] = key;
+            item[KEY_TOPIC_MSG] = msg;
+            _body[KEY_TOPIC_BATCH].append(item);
+        }
+
+        // 发布消息在主题中的序号，没有时为 0
+        uint64_t seq()
+        {
+            return _body.isMember(KEY_TOPIC_SEQ) ? _body[KEY_TOPIC_SEQ].asUInt64() : 0;
+        }
+
+        void setSeq(uint64_t seq)
+        {
+            _body[KEY_TOPIC_SEQ] = (Json::UInt64)seq;
+        }
+
+        // 创建主题时指定的保留消息条数
+        bool hasRetain()
+        {
+            return _body.isMember(KEY_TOPIC_RETAIN);
+        }
+
+        size_t retain()
+        {
+            return _body[KEY_TOPIC_RETAIN].asUInt();
+        }
+
+        void setRetain(size_t count)
+        {
+            _body[KEY_TOPIC_RETAIN] = (Json::UInt)count;
+        }
+
+        // 订阅时的回放起点：从序号 from 开始，没有时为 0（不回放）
+        uint64_t from()
+        {
+            return _body.isMember(KEY_TOPIC_FROM) ? _body[KEY_TOPIC_FROM].asUInt64() : 0;
+        }
+
+        void setFrom(uint64_t seq)
+        {
+            _body[KEY_TOPIC_FROM] = (Json::UInt64)seq;
+        }
+
+        // 订阅时回放最近的 last 条消息，没有时为 0（不回放）
+        size_t last()
+        {
+            return _body.isMember(KEY_TOPIC_LAST) ? _body[KEY_TOPIC_LAST].asUInt() : 0;
+        }
+
+        void setLast(size_t count)
+        {
+            _body[KEY_TOPIC_LAST] = (Json::UInt)count;
+        }
+
+        // 创建的是否是持久化主题
+        bool durable()
+        {
+            return _body.isMember(KEY_TOPIC_DURABLE) && _body[KEY_TOPIC_DURABLE].asBool();
+        }
+
+        void setDurable(bool durable)
+        {
+            _body[KEY_TOPIC_DURABLE] = durable;
+        }
+
+        // 创建的是否是合并主题（按消息的分区键只保留最新值）
+        bool conflate()
+        {
+            return _body.isMember(KEY_TOPIC_CONFLATE) && _body[KEY_TOPIC_CONFLATE].asBool();
+        }
+
+        void setConflate(bool conflate)
+        {
+            _body[KEY_TOPIC_CONFLATE] = conflate;
+        }
+
+        // 读取持久化主题时一次最多返回的字节数，没有时为 0（使用服务端的默认值）
+        size_t maxBytes()
+        {
+            return _body.isMember(KEY_TOPIC_MAX_BYTES) ? _body[KEY_TOPIC_MAX_BYTES].asUInt() : 0;
+        }
+
+        void setMaxBytes(size_t bytes)
+        {
+            _body[KEY_TOPIC_MAX_BYTES] = (Json::UInt)bytes;
+        }
+
+        // 订阅时要求可靠投递
+        bool reliable()
+        {
+            return _body.isMember(KEY_TOPIC_RELIABLE) && _body[KEY_TOPIC_RELIABLE].asBool();
+        }
+
+        void setReliable(bool reliable)
+        {
+            _body[KEY_TOPIC_RELIABLE] = reliable;
+        }
+
+        std::string session()
+        {
+            return _body[KEY_TOPIC_SESSION].asString();
+        }
+
+        void setSession(const std::string &session)
+        {
+            _body[KEY_TOPIC_SESSION] = session;
+        }
+
+        // 订阅时加入的消费组，为空表示普通订阅
+        std::string group()
+        {
+            return _body[KEY_TOPIC_GROUP].asString();
+        }
+
+        void setGroup(const std::string &group)
+        {
+            _body[KEY_TOPIC_GROUP] = group;
+        }
+
+        GroupBalance balance()
+        {
+            return (GroupBalance)_body[KEY_TOPIC_BALANCE].asInt();
+        }
+
+        void setBalance(GroupBalance balance)
+        {
+            _body[KEY_TOPIC_BALANCE] = (int)balance;
+        }
+
+        // 发布消息的分区键，没有时为空
+        std::string msgKey()
+        {
+            if (_body.isMember(KEY_TOPIC_MSG_KEY) == false)
+            {
+                return std::string();
+            }
+            return _body[KEY_TOPIC_MSG_KEY].asString();
+        }
+
+        void setMsgKey(const std::string &key)
+        {
+            _body[KEY_TOPIC_MSG_KEY] = key;
+        }
+
+        // 可靠投递的序号：服务端推送给可靠订阅者时把消息 ID 换成 "#序号"（不改正文，不需要重新序列化），
+        // 不是可靠投递的消息返回 0
+        uint64_t delivery()
+        {
+            std::string id = rid();
+            if (id.size() < 2 || id[0] != '#')
+            {
+                return 0;
+            }
+            return strtoull(id.c_str() + 1, nullptr, 10);
+        }
     };
 
 
@@ -202,7 +437,98 @@ namespace rpc
 
         virtual bool check() override
         {
-            if(_body[KEY_METHOD].isNull() == true || _body[KEY_METHOD].isString() == false)
+            // 服务变更（以及副本同步）消息由多条变更组成，每一条都是一个完整的上线/下线请求
+            if (_body[KEY_OPTYPE].isIntegral() == true &&
+                (_body[KEY_OPTYPE].asInt() == (int)ServiceOptype::SERVICE_DELTA || _body[KEY_OPTYPE].asInt() == (int)ServiceOptype::SERVICE_SYNC))
+            {
+                if (_body[KEY_CHANGES].isArray() == false)
+                {
+                    ELOG("服务变更消息中没有变更列表！");
+                    return false;
+                }
+
+                // 每一条变更都要是对象，之后才能当作单独的请求检查
+                for (auto &change : _body[KEY_CHANGES])
+                {
+                    if (change.isObject() == false)
+                    {
+                        ELOG("服务变更消息中变更错误！");
+                        return false;
+                    }
+                }
+
+                for (auto &change : changes())
+                {
+                    if (change->check() == false ||
+                        (change->optype() != ServiceOptype::SERVICE_ONLINE && change->optype() != ServiceOptype::SERVICE_OFFLINE))
+                    {
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+
+            // 订阅请求：每一项都要有方法名称和版本号；按前缀批量发现时可以没有订阅列表
+            if (_body[KEY_OPTYPE].isIntegral() == true && _body[KEY_OPTYPE].asInt() == (int)ServiceOptype::SERVICE_WATCH)
+            {
+                if (_body.isMember(KEY_PREFIX) == true &&
+                    (_body[KEY_PREFIX].isString() == false || (_body.isMember(KEY_AFTER) == true && _body[KEY_AFTER].isString() == false)))
+                {
+                    ELOG("服务订阅请求中前缀错误！");
+                    return false;
+                }
+
+                if (_body.isMember(KEY_WATCH) ? _body[KEY_WATCH].isArray() == false : _body.isMember(KEY_PREFIX) == false)
+                {
+                    ELOG("服务订阅请求中没有订阅列表！");
+                    return false;
+                }
+
+                for (auto &item : _body[KEY_WATCH])
+                {
+                    if (item.isObject() == false || item[KEY_METHOD].isString() == false || item[KEY_REVISION].isUInt64() == false ||
+                        (item.isMember(KEY_EPOCH) == true && item[KEY_EPOCH].isString() == false))
+                    {
+                        ELOG("服务订阅请求中订阅项错误！");
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+
+            if (_body.isMember(KEY_META) == true && checkMeta(_body[KEY_META]) == false)
+            {
+                ELOG("服务请求中元数据错误！");
+                return false;
+            }
+
+            // 心跳只需要操作类型，提供者由连接确定（可以携带更新后的元数据）
+            if (_body[KEY_OPTYPE].isIntegral() == true && _body[KEY_OPTYPE].asInt() == (int)ServiceOptype::SERVICE_HEARTBEAT)
+            {
+                return true;
+            }
+
+            // 携带方法名称列表（批量操作）时可以没有单个方法名称
+            if (_body.isMember(KEY_METHODS) == true)
+            {
+                if (_body[KEY_METHODS].isArray() == false)
+                {
+                    ELOG("服务请求中方法名称列表类型错误！");
+                    return false;
+                }
+
+                for (auto &name : _body[KEY_METHODS])
+                {
+                    if (name.isString() == false)
+                    {
+                        ELOG("服务请求中方法名称列表类型错误！");
+                        return false;
+                    }
+                }
+            }
+            else if(_body[KEY_METHOD].isNull() == true || _body[KEY_METHOD].isString() == false)
             {
                 ELOG("服务请求中没有方法名称或者方法名称类型错误！");
                 return false;
@@ -239,6 +565,125 @@ namespace rpc
             _body[KEY_METHOD] = name;
         }
 
+        // 请求涉及的所有方法：批量请求返回方法名称列表，单个请求返回只有一个元素的列表
+        std::vector<std::string> methods()
+        {
+            std::vector<std::string> names;
+            if (_body.isMember(KEY_METHODS) == false)
+            {
+                names.push_back(_body[KEY_METHOD].asString());
+                return names;
+            }
+
+            for (auto &name : _body[KEY_METHODS])
+            {
+                names.push_back(name.asString());
+            }
+
+            return names;
+        }
+
+        void setMethods(const std::vector<std::string> &names)
+        {
+            Json::Value val(Json::arrayValue);
+            for (auto &name : names)
+            {
+                val.append(name);
+            }
+            _body[KEY_METHODS] = val;
+        }
+
+        // 服务变更消息中的每一条变更（按顺序处理）
+        std::vector<ServiceRequest::ptr> changes()
+        {
+            std::vector<ServiceRequest::ptr> result;
+            for (auto &change : _body[KEY_CHANGES])
+            {
+                auto req = std::make_shared<ServiceRequest>();
+                req->setId(rid());
+                req->setMType(mtype());
+                req->_body = change;
+                result.push_back(req);
+            }
+
+            return result;
+        }
+
+        // 订阅项：方法名称 + 客户端已经同步到的版本号 + 该版本号所属的注册中心实例
+        struct Watch
+        {
+            std::string method;
+            uint64_t revision;
+            std::string epoch;
+        };
+
+        std::vector<Watch> watches()
+        {
+            std::vector<Watch> result;
+            for (auto &item : _body[KEY_WATCH])
+            {
+                result.push_back(Watch{item[KEY_METHOD].asString(), item[KEY_REVISION].asUInt64(), item[KEY_EPOCH].asString()});
+            }
+
+            return result;
+        }
+
+        void appendWatch(const std::string &method, uint64_t revision, const std::string &epoch)
+        {
+            Json::Value item;
+            item[KEY_METHOD] = method;
+            item[KEY_REVISION] = (Json::UInt64)revision;
+            item[KEY_EPOCH] = epoch;
+            _body[KEY_WATCH].append(item);
+        }
+
+        // 按方法名前缀批量发现：订阅所有名称以 prefix 开头的方法（按名称排序分页，after 为上一页最后一个方法名）
+        bool hasPrefix()
+        {
+            return _body.isMember(KEY_PREFIX);
+        }
+
+        std::string prefix()
+        {
+            return _body[KEY_PREFIX].asString();
+        }
+
+        std::string after()
+        {
+            return _body[KEY_AFTER].asString();
+        }
+
+        void setPrefix(const std::string &prefix, const std::string &after = std::string())
+        {
+            _body[KEY_PREFIX] = prefix;
+            if (after.empty() == false)
+            {
+                _body[KEY_AFTER] = after;
+            }
+        }
+
+        // 追加一条变更（optype 为 SERVICE_ONLINE/SERVICE_OFFLINE），上线变更可以携带主机的元数据
+        void appendChange(ServiceOptype optype, const Address &host, const std::vector<std::string> &names,
+                          const Json::Value &meta = Json::Value())
+        {
+            ServiceRequest change;
+            change.setOptype(optype);
+            change.setHost(host);
+            if (meta.isNull() == false)
+            {
+                change.setMeta(meta);
+            }
+            if (names.size() == 1)
+            {
+                change.setMethod(names[0]);
+            }
+            else
+            {
+                change.setMethods(names);
+            }
+            _body[KEY_CHANGES].append(change._body);
+        }
+
         ServiceOptype optype()
         {
             return (ServiceOptype)_body[KEY_OPTYPE].asInt();
@@ -264,6 +709,36 @@ namespace rpc
             val[KEY_HOST_PORT] = host.second;
             _body[KEY_HOST] = val;
         }
+
+        // 提供者的元数据，没有携带时为 null
+        Json::Value meta()
+        {
+            return _body.isMember(KEY_META) ? _body[KEY_META] : Json::Value();
+        }
+
+        void setMeta(const Json::Value &meta)
+        {
+            _body[KEY_META] = meta;
+        }
+
+        // 元数据必须是对象，约定的字段类型要正确，其他字段不限
+        static bool checkMeta(const Json::Value &meta)
+        {
+            if (meta.isObject() == false)
+            {
+                return false;
+            }
+
+            if ((meta.isMember(KEY_META_WEIGHT) && meta[KEY_META_WEIGHT].isIntegral() == false) ||
+                (meta.isMember(KEY_META_LOAD) && meta[KEY_META_LOAD].isIntegral() == false) ||
+                (meta.isMember(KEY_META_ZONE) && meta[KEY_META_ZONE].isString() == false) ||
+                (meta.isMember(KEY_META_VERSION) && meta[KEY_META_VERSION].isString() == false))
+            {
+                return false;
+            }
+
+            return true;
+        }
     };
 
 
@@ -306,11 +781,67 @@ namespace rpc
 
 
 
+    // 结果已经提前序列化好的rpc响应（响应缓存、合并请求等场景），发送时直接拼接结果，不再重复序列化
+    // 同一份结果可以被多个响应共享，只需要替换各自的rid
+    class RawRpcResponse : public RpcResponse
+    {
+    public:
+        using ptr = std::shared_ptr<RawRpcResponse>;
+
+        virtual std::string serialize() override
+        {
+            if (!_raw_result)
+            {
+                return RpcResponse::serialize();
+            }
+
+            std::string body;
+            body.reserve(_raw_result->size() + 32);
+            body.append("{\"" KEY_RCODE "\":");
+            body.append(std::to_string((int)rcode()));
+            body.append(",\"" KEY_RESULT "\":");
+            body.append(*_raw_result);
+            body.append("}");
+            return body;
+        }
+
+        void setRawResult(const std::shared_ptr<const std::string> &raw_result)
+        {
+            _raw_result = raw_result;
+        }
+
+    private:
+        std::shared_ptr<const std::string> _raw_result; // 序列化好的结果（json文本）
+    };
+
+
+
     class TopicResponse : public JsonResponse
     {
     public:
         using ptr = std::shared_ptr<TopicResponse>;
 
+        // 按 offset 读取时，下一次读取的 offset
+        uint64_t seq()
+        {
+            return _body.isMember(KEY_TOPIC_SEQ) ? _body[KEY_TOPIC_SEQ].asUInt64() : 0;
+        }
+
+        void setSeq(uint64_t seq)
+        {
+            _body[KEY_TOPIC_SEQ] = (Json::UInt64)seq;
+        }
+
+        // 按 offset 读取时，后面是否还有消息
+        bool more()
+        {
+            return _body.isMember(KEY_MORE) && _body[KEY_MORE].asBool();
+        }
+
+        void setMore(bool more)
+        {
+            _body[KEY_MORE] = more;
+        }
     };
 
 
@@ -348,6 +879,14 @@ namespace rpc
                 return false;
             }
 
+            if (_body[KEY_OPTYPE].asInt() == (int)ServiceOptype::SERVICE_WATCH &&
+                _body[KEY_RCODE].asInt() == (int)RCode::RCODE_OK &&
+                _body[KEY_WATCH].isNull() == false && _body[KEY_WATCH].isArray() == false)
+            {
+                ELOG("服务订阅响应中订阅结果错误！");
+                return false;
+            }
+
             return true;
         }
 
@@ -382,6 +921,12 @@ namespace rpc
             }
         }
 
+        // 主机列表连同每个主机的元数据（metas 与 addrs 一一对应，null 表示没有元数据）
+        void setHost(const std::vector<Address> &addrs, const std::vector<Json::Value> &metas)
+        {
+            _body[KEY_HOST] = encodeHosts(addrs, metas);
+        }
+
         std::vector<Address> hosts()
         {
             std::vector<Address> addrs;
@@ -396,6 +941,145 @@ namespace rpc
 
             return addrs;
         }
+
+        // 与 hosts() 一一对应的元数据
+        std::vector<Json::Value> metas()
+        {
+            return decodeMetas(_body[KEY_HOST]);
+        }
+
+        uint64_t revision()
+        {
+            return _body[KEY_REVISION].asUInt64();
+        }
+
+        void setRevision(uint64_t revision)
+        {
+            _body[KEY_REVISION] = (Json::UInt64)revision;
+        }
+
+        std::string epoch()
+        {
+            return _body[KEY_EPOCH].asString();
+        }
+
+        void setEpoch(const std::string &epoch)
+        {
+            _body[KEY_EPOCH] = epoch;
+        }
+
+        // 订阅结果中的一条增量变化，上线（包括元数据更新）时携带主机的元数据
+        struct WatchChange
+        {
+            ServiceOptype optype;
+            Address host;
+            Json::Value meta;
+        };
+
+        // 订阅结果：每个方法要么是全量的主机列表，要么是从客户端版本开始的增量变化
+        struct WatchResult
+        {
+            std::string method;
+            uint64_t revision = 0;                                // 该方法当前的版本号
+            bool snapshot = false;                                // true：hosts 是全量列表；false：changes 是增量变化
+            std::vector<Address> hosts;
+            std::vector<Json::Value> metas;                       // 与 hosts 一一对应的元数据
+            std::vector<WatchChange> changes;
+        };
+
+        std::vector<WatchResult> watchResults()
+        {
+            std::vector<WatchResult> results;
+            for (auto &item : _body[KEY_WATCH])
+            {
+                WatchResult result;
+                result.method = item[KEY_METHOD].asString();
+                result.revision = item[KEY_REVISION].asUInt64();
+                result.snapshot = item.isMember(KEY_HOST);
+                for (auto &host : item[KEY_HOST])
+                {
+                    result.hosts.push_back(Address(host[KEY_HOST_IP].asString(), host[KEY_HOST_PORT].asInt()));
+                }
+                result.metas = decodeMetas(item[KEY_HOST]);
+                for (auto &change : item[KEY_CHANGES])
+                {
+                    Address host(change[KEY_HOST][KEY_HOST_IP].asString(), change[KEY_HOST][KEY_HOST_PORT].asInt());
+                    Json::Value meta = change.isMember(KEY_META) ? change[KEY_META] : Json::Value();
+                    result.changes.push_back(WatchChange{(ServiceOptype)change[KEY_OPTYPE].asInt(), host, meta});
+                }
+                results.push_back(result);
+            }
+
+            return results;
+        }
+
+        // 前缀发现是否还有下一页
+        bool more()
+        {
+            return _body[KEY_MORE].asBool();
+        }
+
+        void setMore(bool more)
+        {
+            _body[KEY_MORE] = more;
+        }
+
+        void appendWatchResult(const WatchResult &result)
+        {
+            Json::Value item;
+            item[KEY_METHOD] = result.method;
+            item[KEY_REVISION] = (Json::UInt64)result.revision;
+            if (result.snapshot)
+            {
+                item[KEY_HOST] = encodeHosts(result.hosts, result.metas);
+            }
+            else
+            {
+                item[KEY_CHANGES] = Json::Value(Json::arrayValue);
+                for (auto &change : result.changes)
+                {
+                    Json::Value val;
+                    val[KEY_OPTYPE] = (int)change.optype;
+                    val[KEY_HOST][KEY_HOST_IP] = change.host.first;
+                    val[KEY_HOST][KEY_HOST_PORT] = change.host.second;
+                    if (change.meta.isNull() == false)
+                    {
+                        val[KEY_META] = change.meta;
+                    }
+                    item[KEY_CHANGES].append(val);
+                }
+            }
+            _body[KEY_WATCH].append(item);
+        }
+
+    private:
+        // 主机列表：每个主机一个对象（ip、port，有元数据时带上 meta）
+        static Json::Value encodeHosts(const std::vector<Address> &addrs, const std::vector<Json::Value> &metas)
+        {
+            Json::Value hosts(Json::arrayValue);
+            for (size_t i = 0; i < addrs.size(); i++)
+            {
+                Json::Value val;
+                val[KEY_HOST_IP] = addrs[i].first;
+                val[KEY_HOST_PORT] = addrs[i].second;
+                if (i < metas.size() && metas[i].isNull() == false)
+                {
+                    val[KEY_META] = metas[i];
+                }
+                hosts.append(val);
+            }
+            return hosts;
+        }
+
+        static std::vector<Json::Value> decodeMetas(const Json::Value &hosts)
+        {
+            std::vector<Json::Value> metas;
+            for (auto &host : hosts)
+            {
+                metas.push_back(host.isMember(KEY_META) ? host[KEY_META] : Json::Value());
+            }
+            return metas;
+        }
     };
 
 
@@ -17,6 +17,8 @@
 #include <unordered_map>
 #include <thread>
 #include <chrono>
+#include <random>
+#include <condition_variable>
 
 
 namespace rpc
@@ -148,9 +150,12 @@ namespace rpc
 
         virtual std::string serialize(const BaseMessage::ptr &msg) override
         {
-            std::string body = msg->serialize();
-            std::string id = msg->rid();
-            auto mtype = htonl((int32_t)msg->mtype());
+            return serialize(msg->mtype(), msg->rid(), msg->serialize());
+        }
+
+        virtual std::string serialize(MType msg_type, const std::string &id, const std::string &body) override
+        {
+            auto mtype = htonl((int32_t)msg_type);
             int32_t idlen = htonl(id.size());
             int32_t h_total_len = mtypeFieldsLength + idlenFieldsLength + id.size() + body.size();
             int32_t n_total_len = htonl(h_total_len);
@@ -235,6 +240,18 @@ namespace rpc
             _conn->send(body);
         }
 
+        // 同一条消息发给多个连接时，只需要编码一次
+        virtual void sendRaw(const std::string &frame) override
+        {
+            _conn->send(frame);
+        }
+
+        // 在网络线程中且发送缓冲为空时 muduo 直接从 data 写 socket，否则拷贝一次进发送缓冲
+        virtual void sendBytes(const char *data, size_t len) override
+        {
+            _conn->send(data, len);
+        }
+
         // 关闭连接
         virtual void shutdown() override
         {
@@ -247,6 +264,52 @@ namespace rpc
             return _conn->connected();
         }
 
+        virtual void forceClose() override
+        {
+            _conn->forceClose();
+        }
+
+        // 积压达到高水位时才挂上写完成回调，平时的发送不会因为写完成回调多一次排队
+        virtual void setHighWaterMarkCallback(size_t mark, const std::function<void()> &on_high, const std::function<void()> &on_drain) override
+        {
+            muduo::net::TcpConnectionPtr conn = _conn;
+            _conn->getLoop()->runInLoop([conn, mark, on_high, on_drain]()
+            {
+                conn->setHighWaterMarkCallback([on_high, on_drain](const muduo::net::TcpConnectionPtr &tcp_conn, size_t)
+                {
+                    on_high();
+
+                    // 高水位回调是排队执行的，执行之前积压可能已经发完了，这时不会再有写完成通知
+                    if (tcp_conn->outputBuffer()->readableBytes() == 0)
+                    {
+                        on_drain();
+                        return;
+                    }
+
+                    tcp_conn->setWriteCompleteCallback([on_drain](const muduo::net::TcpConnectionPtr &drained_conn)
+                    {
+                        drained_conn->setWriteCompleteCallback(muduo::net::WriteCompleteCallback());
+                        on_drain();
+                    });
+                }, mark);
+            });
+        }
+
+        virtual const void *loop() override
+        {
+            return _conn->getLoop();
+        }
+
+        virtual void runInLoop(const std::function<void()> &task) override
+        {
+            _conn->getLoop()->runInLoop(task);
+        }
+
+        virtual void queueInLoop(const std::function<void()> &task) override
+        {
+            _conn->getLoop()->queueInLoop(task);
+        }
+
     private:
         BaseProtocol::ptr _protocol;
         muduo::net::TcpConnectionPtr _conn;
@@ -284,6 +347,12 @@ namespace rpc
             _server.start();
             _baseloop.loop();
         }
+
+        // 为 0 时所有连接都在监听线程中处理
+        virtual void setThreadNum(int num) override
+        {
+            _server.setThreadNum(num);
+        }
     private:
         void onConnection(const muduo::net::TcpConnectionPtr& conn)
         {
@@ -450,6 +519,12 @@ namespace rpc
             return _client.disconnect();
         }
 
+        // 断线后由 muduo 按退避间隔自动重连，重连成功时同样会调用连接建立回调
+        virtual void enableRetry() override
+        {
+            _client.enableRetry();
+        }
+
         virtual bool send(const BaseMessage::ptr &msg) override
         {
             BaseConnection::ptr conn;
@@ -487,9 +562,10 @@ namespace rpc
             {
                 std::cout << "连接建立！" << std::endl;
                 // _conn 在网络线程写入，业务线程会读取，这里加锁避免数据竞争
+                BaseConnection::ptr base_conn = ConnectionFactory::create(conn, _protocol);
                 {
                     std::unique_lock<std::mutex> lock(_conn_mutex);
-                    _conn = ConnectionFactory::create(conn, _protocol);
+                    _conn = base_conn;
                 }
 
                 // 之前的代码在这里可能发生了线程切换/竞争！
@@ -498,13 +574,25 @@ namespace rpc
                 {
                     _downlatch.countDown(); // 唤醒 connect() 等待
                 }
+
+                // 首次连接和重连成功都会通知上层（例如重连后重新同步状态）
+                if (_cb_connection)
+                {
+                    _cb_connection(base_conn);
+                }
             }
             else
             {
                 std::cout << "连接断开！" << std::endl;
+                BaseConnection::ptr base_conn;
                 {
                     std::unique_lock<std::mutex> lock(_conn_mutex);
-                    _conn.reset();
+                    base_conn.swap(_conn);
+                }
+
+                if (_cb_close && base_conn)
+                {
+                    _cb_close(base_conn);
                 }
 
                 // 连接失败也要唤醒等待线程，避免永久阻塞
@@ -576,6 +664,184 @@ namespace rpc
         muduo::net::TcpClient _client; // muduo的tcp客户端
     };
 
+
+
+    // 多地址客户端：同时连接一组等价的服务端（例如注册中心的多个副本），选其中一个作为当前连接
+    // * 起始地址随机选择，把客户端分散到各个副本上
+    // * 当前连接断开时切换到另一个已连接的地址，并调用连接建立回调（上层据此重新注册/重新同步）
+    // * 每个地址都会自动重连，恢复的副本重新成为候选
+    class FailoverClient : public BaseClient
+    {
+    public:
+        using ptr = std::shared_ptr<FailoverClient>;
+
+        FailoverClient(const std::vector<Address> &addrs)
+            : _start(0),
+              _active(-1),
+              _attempts(0)
+        {
+            for (auto &addr : addrs)
+            {
+                _members.push_back(std::make_shared<MuduoClient>(addr.first, addr.second));
+            }
+
+            if (_members.empty() == false)
+            {
+                _start = std::random_device()() % _members.size();
+            }
+        }
+
+        ~FailoverClient()
+        {
+            for (auto &connector : _connectors)
+            {
+                connector.join();
+            }
+        }
+
+        virtual void connect() override
+        {
+            for (size_t i = 0; i < _members.size(); i++)
+            {
+                _members[i]->setMessageCallback([this](const BaseConnection::ptr &conn, BaseMessage::ptr &msg)
+                {
+                    if (_cb_message)
+                    {
+                        _cb_message(conn, msg);
+                    }
+                });
+                _members[i]->setConnectionCallback(std::bind(&FailoverClient::onMemberConnection, this, i, std::placeholders::_1));
+                _members[i]->setCloseCallback(std::bind(&FailoverClient::onMemberClose, this, i, std::placeholders::_1));
+                _members[i]->enableRetry();
+            }
+
+            // 同时连接所有地址（从随机位置开始发起），有一个连上或者全部失败就返回，
+            // 不可达的地址最多耽误一次连接超时，而不是逐个累加；没连上的在后台继续连接
+            for (size_t i = 0; i < _members.size(); i++)
+            {
+                size_t idx = (_start + i) % _members.size();
+                _connectors.emplace_back([this, idx]()
+                {
+                    _members[idx]->connect();
+                    {
+                        std::unique_lock<std::mutex> lock(_mutex);
+                        _attempts++;
+                    }
+                    _cond.notify_all();
+                });
+            }
+
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cond.wait(lock, [this]() { return _active >= 0 || _attempts == _members.size(); });
+        }
+
+        virtual void shutdown() override
+        {
+            for (auto &member : _members)
+            {
+                member->shutdown();
+            }
+        }
+
+        virtual bool send(const BaseMessage::ptr &msg) override
+        {
+            auto member = activeMember();
+            if (!member)
+            {
+                ELOG("没有可用的连接！");
+                return false;
+            }
+
+            return member->send(msg);
+        }
+
+        virtual BaseConnection::ptr connection() override
+        {
+            auto member = activeMember();
+            return member ? member->connection() : BaseConnection::ptr();
+        }
+
+        virtual bool connected() override
+        {
+            auto member = activeMember();
+            return member && member->connected();
+        }
+
+    private:
+        MuduoClient::ptr activeMember()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            return _active < 0 ? MuduoClient::ptr() : _members[_active];
+        }
+
+        // 某个地址连接成功：当前没有可用连接时把它作为当前连接
+        void onMemberConnection(size_t idx, const BaseConnection::ptr &conn)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (_active >= 0 && _members[_active]->connected())
+                {
+                    return;
+                }
+                _active = idx;
+            }
+            _cond.notify_all();
+
+            if (_cb_connection)
+            {
+                _cb_connection(conn);
+            }
+        }
+
+        // 某个地址断开：是当前连接时切换到下一个已连接的地址
+        void onMemberClose(size_t idx, const BaseConnection::ptr &conn)
+        {
+            BaseConnection::ptr next;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (_active != (int)idx)
+                {
+                    return;
+                }
+
+                _active = -1;
+                for (size_t i = 1; i < _members.size(); i++)
+                {
+                    size_t candidate = (idx + i) % _members.size();
+                    if (_members[candidate]->connected())
+                    {
+                        _active = candidate;
+                        next = _members[candidate]->connection();
+                        break;
+                    }
+                }
+            }
+
+            if (_cb_close)
+            {
+                _cb_close(conn);
+            }
+
+            if (next)
+            {
+                ILOG("当前连接断开，切换到其他地址！");
+                if (_cb_connection)
+                {
+                    _cb_connection(next);
+                }
+            }
+        }
+
+    private:
+        std::vector<MuduoClient::ptr> _members; // 每个地址一个客户端
+        size_t _start;                          // 随机的起始地址
+        int _active;                            // 当前使用的地址下标，-1 表示没有可用连接
+        size_t _attempts;                       // 已经结束（成功或失败）的首次连接数
+        std::mutex _mutex;
+        std::condition_variable _cond;          // 有地址连上或者首次连接全部结束时通知 connect
+        std::vector<std::thread> _connectors;   // 每个地址一个首次连接的线程
+    };
+
     class ClientFactory
     {
     public:
@@ -584,5 +850,17 @@ namespace rpc
         {
             return std::make_shared<MuduoClient>(std::forward<Args>(args)...);
         }
+
+        // 一组等价的地址：只有一个时就是普通客户端
+        // （单独命名：和 create 同名时，非 const 的 vector 左值会匹配到上面的模板）
+        static BaseClient::ptr createFailover(const std::vector<Address> &addrs)
+        {
+            if (addrs.size() == 1)
+            {
+                return std::make_shared<MuduoClient>(addrs[0].first, addrs[0].second);
+            }
+
+            return std::make_shared<FailoverClient>(addrs);
+        }
     };
 }
\ No newline at end of file
@@ -0,0 +1,225 @@
+/*
+    RPC响应缓存：针对"结果只取决于参数"的纯函数方法，缓存序列化好的结果
+    * 以参数的规范化哈希为key，命中后再比较一次参数，避免哈希冲突返回错误结果
+    * 每个条目有过期时间（TTL），条目数有上限
+    * 满了以后用 CLOCK（二次机会）算法淘汰：最近被访问过的条目会被跳过一次
+    请求合并（single-flight）：相同参数的并发请求只执行一次，结果分发给所有请求
+*/
+#pragma once
+#include "../common/detail.hpp"
+#include "../common/message.hpp"
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+
+namespace rpc
+{
+    namespace server
+    {
+        class ResponseCache
+        {
+        public:
+            using ptr = std::shared_ptr<ResponseCache>;
+            using Clock = std::chrono::steady_clock;
+            using RawResult = std::shared_ptr<const std::string>;
+
+            // ttl_ms：条目有效期，capacity：最多缓存的条目数
+            ResponseCache(int ttl_ms, size_t capacity)
+                : _ttl(std::chrono::milliseconds(ttl_ms)),
+                  _capacity(capacity == 0 ? 1 : capacity),
+                  _hand(0),
+                  _hits(0),
+                  _misses(0)
+            {
+                _slots.reserve(_capacity);
+            }
+
+            // 查找缓存，未命中（或已过期）返回空指针
+            RawResult get(uint64_t key, const Json::Value &params)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                auto it = _index.find(key);
+                if (it == _index.end())
+                {
+                    _misses++;
+                    return RawResult();
+                }
+
+                Slot &slot = _slots[it->second];
+                if (Clock::now() >= slot.expire)
+                {
+                    evict(it->second);
+                    _misses++;
+                    return RawResult();
+                }
+
+                if (slot.params != params)
+                {
+                    _misses++;
+                    return RawResult();
+                }
+
+                slot.referenced = true;
+                _hits++;
+                return slot.result;
+            }
+
+            // 写入缓存，key 已存在时直接覆盖
+            void put(uint64_t key, const Json::Value &params, const RawResult &result)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                size_t pos;
+                auto it = _index.find(key);
+                if (it != _index.end())
+                {
+                    pos = it->second;
+                }
+                else if (_slots.size() < _capacity)
+                {
+                    pos = _slots.size();
+                    _slots.emplace_back();
+                }
+                else
+                {
+                    pos = victim();
+                    evict(pos);
+                }
+
+                Slot &slot = _slots[pos];
+                slot.used = true;
+                slot.referenced = false;
+                slot.key = key;
+                slot.params = params;
+                slot.result = result;
+                slot.expire = Clock::now() + _ttl;
+                _index[key] = pos;
+            }
+
+            size_t hits() { return _hits.load(); }     // 命中次数
+            size_t misses() { return _misses.load(); } // 未命中次数
+
+        private:
+            struct Slot
+            {
+                bool used = false;       // 槽位是否存放了有效条目
+                bool referenced = false; // CLOCK 访问位
+                uint64_t key = 0;
+                Json::Value params;      // 原始参数，用于排除哈希冲突
+                RawResult result;        // 序列化好的结果
+                Clock::time_point expire;
+            };
+
+            // 转动时钟指针，找到一个可以淘汰的槽位：空槽、已过期或者访问位为0
+            size_t victim()
+            {
+                auto now = Clock::now();
+                while (true)
+                {
+                    size_t pos = _hand;
+                    _hand = (_hand + 1) % _slots.size();
+
+                    Slot &slot = _slots[pos];
+                    if (slot.used == false || now >= slot.expire || slot.referenced == false)
+                    {
+                        return pos;
+                    }
+
+                    slot.referenced = false;
+                }
+            }
+
+            void evict(size_t pos)
+            {
+                Slot &slot = _slots[pos];
+                if (slot.used == false)
+                {
+                    return;
+                }
+
+                _index.erase(slot.key);
+                slot.used = false;
+                slot.referenced = false;
+                slot.params = Json::Value();
+                slot.result.reset();
+            }
+
+        private:
+            std::mutex _mutex;
+            Clock::duration _ttl;
+            size_t _capacity;
+            size_t _hand;                                // CLOCK 的时钟指针
+            std::vector<Slot> _slots;                    // 固定容量的环形槽位
+            std::unordered_map<uint64_t, size_t> _index; // key：参数哈希，val：槽位下标
+            std::atomic<size_t> _hits;
+            std::atomic<size_t> _misses;
+        };
+
+
+
+        // 请求合并：同一方法、相同参数的请求正在执行时，后来的请求挂到它上面，不再重复执行
+        class SingleFlight
+        {
+        public:
+            using ptr = std::shared_ptr<SingleFlight>;
+
+            // 一个等待结果的请求
+            struct Waiter
+            {
+                BaseConnection::ptr conn;
+                RpcRequest::ptr request;
+            };
+
+            // 加入一次执行：返回 true 表示当前请求需要自己执行；
+            // 返回 false 表示已经挂到正在执行的相同请求上，等待其完成后统一回复
+            bool join(uint64_t key, const BaseConnection::ptr &conn, const RpcRequest::ptr &request)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                auto it = _flights.find(key);
+                if (it == _flights.end())
+                {
+                    _flights[key].params = request->params();
+                    return true;
+                }
+
+                // 哈希冲突（参数不同）时不合并，各自执行
+                if (it->second.params != request->params())
+                {
+                    return true;
+                }
+
+                it->second.waiters.push_back(Waiter{conn, request});
+                _merged++;
+                return false;
+            }
+
+            size_t merged() { return _merged.load(); } // 被合并（没有实际执行）的请求数
+
+            // 执行完成：取出所有挂在这次执行上的请求
+            std::vector<Waiter> finish(uint64_t key, const Json::Value &params)
+            {
+                std::vector<Waiter> waiters;
+                std::unique_lock<std::mutex> lock(_mutex);
+                auto it = _flights.find(key);
+                if (it == _flights.end() || it->second.params != params)
+                {
+                    return waiters;
+                }
+
+                waiters.swap(it->second.waiters);
+                _flights.erase(it);
+                return waiters;
+            }
+
+        private:
+            struct Flight
+            {
+                Json::Value params;          // 正在执行的请求参数
+                std::vector<Waiter> waiters; // 等待同一结果的其他请求
+            };
+
+            std::mutex _mutex;
+            std::unordered_map<uint64_t, Flight> _flights; // key：参数哈希，val：正在执行的请求
+            std::atomic<size_t> _merged{0};
+        };
+    }
+}
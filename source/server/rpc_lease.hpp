@@ -0,0 +1,173 @@
+/*
+    提供者租约：提供者定期发送心跳续约，注册中心用时间轮统一处理过期
+    * 时间轮的槽数覆盖一个租期，每个租约只在一个槽里有一个条目
+    * 续约只更新截止刻度，不移动条目（O(1)）；转到该槽时再检查，未到期的条目挪到新截止刻度所在的槽
+    * 因此每个租约在一个租期内最多被扫描一次，和心跳频率无关
+    * 过期回调在锁外、在时间轮线程中调用
+*/
+#pragma once
+#include "../common/net.hpp"
+#include <vector>
+#include <thread>
+#include <unordered_map>
+#include <condition_variable>
+
+namespace rpc
+{
+    namespace server
+    {
+        class LeaseWheel
+        {
+        public:
+            using ptr = std::shared_ptr<LeaseWheel>;
+            using ExpireCallback = std::function<void(const BaseConnection::ptr &)>;
+
+            // ttl_ms：租期，tick_ms：时间轮的刻度（过期判定的精度）
+            LeaseWheel(int ttl_ms, int tick_ms, const ExpireCallback &cb)
+                : _tick_ms(tick_ms <= 0 ? 1 : tick_ms),
+                  _ttl_ticks((ttl_ms + _tick_ms - 1) / _tick_ms),
+                  _slots(_ttl_ticks + 1),
+                  _expire_callback(cb),
+                  _now(0),
+                  _next_id(0),
+                  _stop(false),
+                  _scanned(0),
+                  _expired(0)
+            {
+                if (_ttl_ticks == 0)
+                {
+                    _ttl_ticks = 1;
+                    _slots.resize(2);
+                }
+
+                _ticker = std::thread(&LeaseWheel::tickEntry, this);
+            }
+
+            ~LeaseWheel()
+            {
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _stop = true;
+                }
+
+                _cond.notify_all();
+                _ticker.join();
+            }
+
+            // 续约（第一次续约即创建租约）
+            void renew(const BaseConnection::ptr &conn)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                uint64_t deadline = _now + _ttl_ticks;
+                auto it = _leases.find(conn);
+                if (it != _leases.end())
+                {
+                    it->second.deadline = deadline;
+                    return;
+                }
+
+                uint64_t id = ++_next_id;
+                _leases[conn] = Lease{id, deadline};
+                _slots[deadline % _slots.size()].push_back(Entry{conn, id});
+            }
+
+            // 删除租约（连接断开等），槽里残留的条目转到时会被跳过
+            void remove(const BaseConnection::ptr &conn)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _leases.erase(conn);
+            }
+
+            size_t size()
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                return _leases.size();
+            }
+
+            size_t scanned() { return _scanned.load(); } // 时间轮累计扫描的条目数
+            size_t expired() { return _expired.load(); } // 累计过期的租约数
+
+        private:
+            struct Lease
+            {
+                uint64_t id;       // 区分同一连接先后创建的租约
+                uint64_t deadline; // 截止刻度
+            };
+
+            struct Entry
+            {
+                BaseConnection::ptr conn;
+                uint64_t id;
+            };
+
+            void tickEntry()
+            {
+                auto next = std::chrono::steady_clock::now();
+                while (true)
+                {
+                    next += std::chrono::milliseconds(_tick_ms);
+                    std::vector<BaseConnection::ptr> expired;
+                    {
+                        std::unique_lock<std::mutex> lock(_mutex);
+                        _cond.wait_until(lock, next, [this]() { return _stop; });
+                        if (_stop)
+                        {
+                            return;
+                        }
+
+                        advance(expired);
+                    }
+
+                    for (auto &conn : expired)
+                    {
+                        _expire_callback(conn);
+                    }
+                }
+            }
+
+            // 前进一个刻度，处理当前槽里的条目（加锁调用）
+            void advance(std::vector<BaseConnection::ptr> &expired)
+            {
+                _now++;
+                std::vector<Entry> entries;
+                entries.swap(_slots[_now % _slots.size()]);
+                _scanned += entries.size();
+
+                for (auto &entry : entries)
+                {
+                    auto it = _leases.find(entry.conn);
+                    if (it == _leases.end() || it->second.id != entry.id)
+                    {
+                        continue;
+                    }
+
+                    if (it->second.deadline > _now)
+                    {
+                        _slots[it->second.deadline % _slots.size()].push_back(std::move(entry));
+                        continue;
+                    }
+
+                    expired.push_back(entry.conn);
+                    _leases.erase(it);
+                }
+
+                _expired += expired.size();
+            }
+
+        private:
+            int _tick_ms;
+            uint64_t _ttl_ticks;                                         // 租期对应的刻度数
+            std::vector<std::vector<Entry>> _slots;                      // 时间轮，槽数 = 租期刻度数 + 1
+            std::unordered_map<BaseConnection::ptr, Lease> _leases;      // key：提供者连接，val：租约
+            ExpireCallback _expire_callback;
+            uint64_t _now;                                               // 当前刻度
+            uint64_t _next_id;
+            bool _stop;
+            std::mutex _mutex;
+            std::condition_variable _cond;
+            std::atomic<size_t> _scanned;
+            std::atomic<size_t> _expired;
+            std::thread _ticker;                                         // 推动时间轮的后台线程
+        };
+    }
+}
@@ -4,11 +4,24 @@
     * 服务提供者注册 → ProviderManager记录 → DiscovererManager通知发现者
     * 客户端服务发现 → DiscovererManager记录 → ProviderManager查询提供者
     * 服务提供者下线 → ProviderManager清理 → DiscovererManager通知发现者
+    * 上下线通知先在一个短窗口内合并，再由后台线程给每个发现者发一条变更消息
+    * 发送过心跳的提供者持有租约，租约过期（提供者卡死但连接未断）同样按下线处理
+    * 开启持久化时，上下线变化写入本地日志；重启后先用恢复出的主机提供服务发现，等提供者重新注册确认
+    * 多个副本组成集群时，各副本互相推送本机提供者的变化，任何副本都能应答服务发现
 */
 #pragma once
 #include "../common/net.hpp"
 #include "../common/message.hpp"
+#include "rpc_lease.hpp"
+#include "rpc_store.hpp"
+#include "rpc_replica.hpp"
 #include <set>
+#include <map>
+#include <unordered_set>
+#include <deque>
+#include <algorithm>
+#include <thread>
+#include <condition_variable>
 
 
 namespace rpc
@@ -16,10 +29,34 @@ namespace rpc
     namespace server
     {
         // 管理服务提供者
+        // 每个方法维护一个单调递增的版本号和最近的变化历史，客户端可以从某个版本开始增量同步
+        // 同一个主机可能同时由多个提供者对象代表（本机注册的、其他副本同步来的、恢复出的占位），
+        // 按主机计数：第一个出现时才算上线，最后一个消失时才算下线
+        // 按方法名分片加锁：不同方法的注册和发现互不阻塞；连接到提供者的映射单独一把锁，只在查找/增删连接时短暂持有
+        // 加锁顺序：_mutex 或 提供者的锁 → 分片的锁 → 持久化的锁，_mutex 和提供者的锁不会同时持有
         class ProviderManager
         {
         public:
             using ptr = std::shared_ptr<ProviderManager>;
+            using WatchResult = ServiceResponse::WatchResult;
+            using ChangeCallback = std::function<void(ServiceOptype, const std::string &, const Address &, const Json::Value &)>;
+            using HostMethods = Replicator::HostMethods;
+            using HostList = std::shared_ptr<const std::vector<Address>>;
+            using Body = std::shared_ptr<const std::string>;
+
+            // max_history：每个方法最多保留的变化条数，客户端的版本比历史更旧时返回全量
+            // shard_num：方法状态的分片数
+            ProviderManager(size_t max_history = 1024, size_t shard_num = 16)
+                : _epoch(UUID::uuid()),
+                  _max_history(max_history),
+                  _shards(shard_num == 0 ? 1 : shard_num),
+                  _empty(std::make_shared<const std::vector<Address>>()),
+                  _encoded(0),
+                  _live(0),
+                  _compact_due(false)
+            {
+                _not_found = std::make_shared<const std::string>(encodeDiscovery(std::string(), 0, *_empty, std::vector<Json::Value>()));
+            }
 
             // 一个服务提供者节点
             struct Provider
@@ -27,30 +64,31 @@ namespace rpc
                 using ptr = std::shared_ptr<Provider>;
 
                 std::mutex _mutex;
-                BaseConnection::ptr conn;         // 服务提供者与注册中心的连接
+                BaseConnection::ptr conn;         // 服务提供者与注册中心的连接（占位条目为空）
                 Address host;                     // 服务提供者的主机信息
                 std::vector<std::string> methods; // 服务提供者能提供的服务（函数名）
+                Json::Value meta;                 // 元数据（权重、区域等），没有时为 null
+                bool removed = false;             // 已经被删除，之后的注册不再生效
 
                 Provider(const BaseConnection::ptr &c, const Address &h)
                     :conn(c),host(h)
                 {
                     
                 }
-
-                // 添加一个提供（函数名）的服务
-                void appendMethod(const std::string &method)
-                {
-                    std::unique_lock<std::mutex> lock(_mutex);
-                    methods.emplace_back(method);
-                }
             };
 
             // 当一个新的服务提供者进行服务注册的时候进行调用
             void addProvider(const BaseConnection::ptr &c, const Address &h, const std::string &method)
             {
-                Provider::ptr provider;
+                return addProvider(c, h, std::vector<std::string>(1, method));
+            }
 
-                // 查找连接所关联的服务提供者对象，找到就直接过去，没找到就创建并建立关联
+            // 批量注册：找到（或创建）连接所关联的提供者，再逐个方法登记
+            // meta：提供者的元数据，为 null 时保留之前的元数据
+            void addProvider(const BaseConnection::ptr &c, const Address &h, const std::vector<std::string> &methods,
+                             const Json::Value &meta = Json::Value())
+            {
+                Provider::ptr provider;
                 {
                     std::unique_lock<std::mutex> lock(_mutex);
                     auto it = _conns.find(c);
@@ -63,14 +101,41 @@ namespace rpc
                         provider = std::make_shared<Provider>(c, h);
                         _conns.insert(std::make_pair(c, provider));
                     }
+                }
 
-                    // method方法所提供的主机要增加一个（_provider要新增数据）
-                    auto &providers = _providers[method];
-                    providers.insert(provider);
+                // 持有提供者的锁登记，和 delProvider 串行：删除之后到达的注册不会留下残余条目
+                {
+                    std::unique_lock<std::mutex> lock(provider->_mutex);
+                    if (provider->removed)
+                    {
+                        return;
+                    }
+
+                    for (auto &method : methods)
+                    {
+                        if (std::find(provider->methods.begin(), provider->methods.end(), method) == provider->methods.end())
+                        {
+                            provider->methods.push_back(method);
+                        }
+                    }
+
+                    // 每个method方法所提供的主机要增加一个
+                    // 重新注册了恢复出的条目时，主机本来就在列表里，只是换成有连接的提供者，不算一次变化
+                    const Json::Value &host_meta = meta.isNull() ? provider->meta : meta;
+                    for (auto &method : methods)
+                    {
+                        auto &shard = shardOf(method);
+                        std::unique_lock<std::mutex> shard_lock(shard.mutex);
+                        auto &state = shard.methods[method];
+                        link(method, state, provider, host_meta);
+                        revalidate(method, state, h);
+                    }
+
+                    // 元数据变了，之前注册的服务也要更新
+                    applyMeta(provider, meta);
                 }
 
-                // 向服务对象中新增一个所能提供的服务的名称
-                provider->appendMethod(method);
+                commit();
             }
 
             // 当一个服务提供者断开连接的时候，获取他的信息（用于服务的下线通知）
@@ -86,62 +151,867 @@ namespace rpc
                 return Provider::ptr();
             }
 
-            // 当一个服务提供者断开连接的时候，删除他所关联的信息
-            void delProvider(const BaseConnection::ptr &c)
+            // 更新提供者的元数据（心跳携带），有变化时返回 true，并给出提供者的全部服务（用于同步给其他副本）
+            bool updateMeta(const Provider::ptr &provider, const Json::Value &meta, std::vector<std::string> &methods)
             {
-                std::unique_lock<std::mutex> lock(_mutex);
-                auto it = _conns.find(c);
-                if(it == _conns.end())
                 {
-                    return;
+                    std::unique_lock<std::mutex> lock(provider->_mutex);
+                    if (provider->removed || applyMeta(provider, meta) == false)
+                    {
+                        return false;
+                    }
+                    methods = provider->methods;
                 }
 
-                // 在每一个注册了方法名的提供者进行删除
-                // 如果是服务提供者，看看具体提供的服务是什么，从提供信息中删除当前服务提供者
-                for(auto &method:it->second->methods)
+                commit();
+                return true;
+            }
+
+            // 当一个服务提供者断开连接（或租约过期）的时候，删除他所关联的信息，返回被删除的提供者
+            // 从连接映射中摘除在同一把锁内完成，连接断开和租约过期同时发生时只有一方会拿到提供者
+            Provider::ptr delProvider(const BaseConnection::ptr &c)
+            {
+                Provider::ptr provider;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    auto it = _conns.find(c);
+                    if(it == _conns.end())
+                    {
+                        return Provider::ptr();
+                    }
+
+                    provider = it->second;
+                    _conns.erase(it);
+                }
+
+                // 看看具体提供的服务是什么，从每个方法的提供者中删除当前服务提供者
+                {
+                    std::unique_lock<std::mutex> lock(provider->_mutex);
+                    provider->removed = true;
+                    for (auto &method : provider->methods)
+                    {
+                        auto &shard = shardOf(method);
+                        std::unique_lock<std::mutex> shard_lock(shard.mutex);
+                        auto it = shard.methods.find(method);
+                        if (it != shard.methods.end())
+                        {
+                            unlink(method, it->second, provider);
+                        }
+                    }
+                }
+
+                commit();
+                return provider;
+            }
+
+            // 预先生成的主机列表（主机上下线后的第一次发现时重建一次，之后直接复用），连同对应的版本号一起返回
+            // 两者在同一把分片锁内读取，彼此一致；返回的列表不会再被修改，可以在锁外直接使用
+            HostList hostList(const std::string &method, uint64_t &revision)
+            {
+                auto &shard = shardOf(method);
+                std::unique_lock<std::mutex> lock(shard.mutex);
+                auto it = shard.methods.find(method);
+                if (it == shard.methods.end())
                 {
-                    auto &providers = _providers[method];
-                    providers.erase(it->second);
+                    revision = 0;
+                    return _empty;
                 }
 
-                // 删除连接（与服务提供者的关联关系）
-                _conns.erase(it);
+                revision = it->second.revision;
+                return hostsOf(it->second);
             }
 
+            // 服务发现响应的正文（不含 rid），按方法缓存，主机上下线、元数据变化时失效
+            // 缓存未命中时在锁外编码，编码期间方法没有发生变化才放入缓存
+            Body discoveryBody(const std::string &method)
+            {
+                auto &shard = shardOf(method);
+                uint64_t revision = 0;
+                std::vector<Address> hosts;
+                std::vector<Json::Value> metas;
+                {
+                    std::unique_lock<std::mutex> lock(shard.mutex);
+                    auto it = shard.methods.find(method);
+                    if (it == shard.methods.end())
+                    {
+                        return _not_found;
+                    }
+
+                    if (it->second.body)
+                    {
+                        return it->second.body;
+                    }
+
+                    revision = it->second.revision;
+                    for (auto &entry : it->second.hosts)
+                    {
+                        hosts.push_back(entry.host);
+                        metas.push_back(entry.meta);
+                    }
+                }
+
+                auto body = std::make_shared<const std::string>(encodeDiscovery(method, revision, hosts, metas));
+                _encoded++;
+
+                std::unique_lock<std::mutex> lock(shard.mutex);
+                auto it = shard.methods.find(method);
+                if (it != shard.methods.end() && it->second.revision == revision && !it->second.body)
+                {
+                    it->second.body = body;
+                }
+                return body;
+            }
+
+            size_t encoded() { return _encoded.load(); } // 实际编码的服务发现响应数（缓存未命中的次数）
+
             // 找到每一个函数名对应的提供者主机信息
             std::vector<Address> methodHosts(const std::string &method)
             {
-                std::unique_lock<std::mutex> lock(_mutex);
+                uint64_t revision = 0;
+                return *hostList(method, revision);
+            }
+
+            // 同时返回主机列表对应的版本号
+            std::vector<Address> methodHosts(const std::string &method, uint64_t &revision)
+            {
+                return *hostList(method, revision);
+            }
+
+            // 从 since 版本开始同步一个方法：历史足够且注册中心没有重启过时返回增量，否则返回全量
+            WatchResult watch(const std::string &method, uint64_t since, const std::string &epoch)
+            {
+                WatchResult result;
+                result.method = method;
+
+                auto &shard = shardOf(method);
+                std::unique_lock<std::mutex> lock(shard.mutex);
+                auto it = shard.methods.find(method);
+                if (it == shard.methods.end())
+                {
+                    result.revision = 0;
+                    result.snapshot = (epoch != _epoch || since > 0);
+                    return result;
+                }
+
+                auto &state = it->second;
+                result.revision = state.revision;
+
+                bool covered = (epoch == _epoch) && since <= result.revision;
+                if (covered && since < result.revision)
+                {
+                    covered = (state.history.empty() == false && state.history.front().revision <= since + 1);
+                }
+
+                // 增量比全量还大时（例如频繁上下线）直接返回全量
+                if (covered && result.revision - since <= state.hosts.size() + 1)
+                {
+                    for (auto &change : state.history)
+                    {
+                        if (change.revision > since)
+                        {
+                            result.changes.push_back(ServiceResponse::WatchChange{change.optype, change.host, change.meta});
+                        }
+                    }
+                    return result;
+                }
+
+                result.snapshot = true;
+                for (auto &entry : state.hosts)
+                {
+                    result.hosts.push_back(entry.host);
+                    result.metas.push_back(entry.meta);
+                }
+
+                return result;
+            }
+
+            // 名称以 prefix 开头、排在 after 之后、当前有提供者的方法，按名称顺序最多返回 limit 个，
+            // 并且全量主机列表的估算大小合计不超过 max_bytes（至少返回一个）；后面还有时 more 为 true（用于分页的批量服务发现）
+            // 从有序索引中 after 的位置开始取，每页的开销只和页的大小有关，和方法总数无关
+            std::vector<std::string> matchMethods(const std::string &prefix, const std::string &after, size_t limit,
+                                                  size_t max_bytes, bool &more)
+            {
+                std::vector<std::string> names;
+                {
+                    std::unique_lock<std::mutex> lock(_index_mutex);
+                    auto it = after < prefix ? _live_methods.lower_bound(prefix) : _live_methods.upper_bound(after);
+
+                    for (; it != _live_methods.end() && names.size() <= limit; ++it)
+                    {
+                        if (it->compare(0, prefix.size(), prefix) != 0)
+                        {
+                            break;
+                        }
+                        names.push_back(*it);
+                    }
+                }
+
+                // 多取的一个只用来判断后面还有没有
+                more = names.size() > limit;
+                names.resize(std::min(names.size(), limit));
+
+                size_t bytes = 0;
+                for (size_t i = 0; i < names.size(); i++)
+                {
+                    bytes += snapshotCost(names[i]);
+                    if (bytes > max_bytes && i > 0)
+                    {
+                        names.resize(i);
+                        more = true;
+                        break;
+                    }
+                }
+                return names;
+            }
+
+            // 注册中心实例标识
+            const std::string &epoch()
+            {
+                return _epoch;
+            }
+
+            // 从持久化存储中恢复，之后的变化都会写入存储；恢复出的主机没有连接，但立即可以被发现
+            bool recover(const RegistryStore::ptr &store, size_t &recovered)
+            {
+                std::set<RegistryStore::Entry> state;
+                if (store->open(state) == false)
+                {
+                    return false;
+                }
+
+                for (auto &entry : state)
+                {
+                    auto &shard = shardOf(entry.first);
+                    std::unique_lock<std::mutex> lock(shard.mutex);
+                    auto &method_state = shard.methods[entry.first];
+                    auto provider = placeholder(method_state, entry.second);
+                    method_state.providers.insert(provider);
+                    auto host = addHost(entry.first, method_state, entry.second, Json::Value());
+                    host->refs = 1;
+                    host->placeholder = provider;
+                }
+
+                {
+                    std::unique_lock<std::mutex> lock(_store_mutex);
+                    _live = state.size();
+                    _store = store;
+                }
+                recovered = state.size();
+                return true;
+            }
 
-                auto it = _providers.find(method);
-                if(it == _providers.end())
+            // 宽限期结束：把还没有被重新注册（或重新同步）确认的占位条目全部删除，返回删除的主机数
+            size_t expireRecovered()
+            {
+                std::set<Address> stale;
+                for (auto &shard : _shards)
                 {
-                    return std::vector<Address>();
+                    std::unique_lock<std::mutex> lock(shard.mutex);
+                    for (auto &item : shard.methods)
+                    {
+                        std::vector<Provider::ptr> placeholders;
+                        for (auto &provider : item.second.providers)
+                        {
+                            if (!provider->conn)
+                            {
+                                placeholders.push_back(provider);
+                            }
+                        }
+
+                        for (auto &provider : placeholders)
+                        {
+                            unlink(item.first, item.second, provider);
+                            stale.insert(provider->host);
+                        }
+                    }
                 }
 
-                std::vector<Address> result;
-                for(auto &provider : it->second)
+                for (auto &host : stale)
                 {
-                    result.push_back(provider->host);
+                    ILOG("提供者 %s:%d 没有被重新确认，做下线处理！", host.first.c_str(), host.second);
+                }
+
+                commit();
+                return stale.size();
+            }
+
+            // 主机真正上线/下线时的回调（在持有分片锁时调用，回调里不能再调用 ProviderManager）
+            void setChangeCallback(const ChangeCallback &cb)
+            {
+                _change_callback = cb;
+            }
+
+            // 本机注册的全部提供者（同步给其他副本）
+            HostMethods localProviders()
+            {
+                std::vector<Provider::ptr> providers;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    for (auto &item : _conns)
+                    {
+                        providers.push_back(item.second);
+                    }
+                }
+
+                HostMethods result;
+                for (auto &provider : providers)
+                {
+                    std::unique_lock<std::mutex> lock(provider->_mutex);
+                    if (provider->removed == false)
+                    {
+                        result.push_back(Replicator::HostInfo{provider->host, provider->methods, provider->meta});
+                    }
                 }
-                
                 return result;
             }
 
+            // 其他副本同步过来的提供者上线（或元数据更新），peer 是与该副本的连接
+            void addMirror(const BaseConnection::ptr &peer, const Address &h, const std::vector<std::string> &methods,
+                           const Json::Value &meta = Json::Value())
+            {
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    auto &provider = _mirrors[peer][h];
+                    if (!provider)
+                    {
+                        provider = std::make_shared<Provider>(peer, h);
+                    }
+
+                    for (auto &method : methods)
+                    {
+                        if (std::find(provider->methods.begin(), provider->methods.end(), method) == provider->methods.end())
+                        {
+                            provider->methods.push_back(method);
+                        }
+
+                        auto &shard = shardOf(method);
+                        std::unique_lock<std::mutex> shard_lock(shard.mutex);
+                        auto &state = shard.methods[method];
+                        link(method, state, provider, meta.isNull() ? provider->meta : meta);
+                        revalidate(method, state, h);
+                    }
+                    applyMeta(provider, meta);
+                }
+
+                commit();
+            }
+
+            // 其他副本同步过来的提供者下线
+            void delMirror(const BaseConnection::ptr &peer, const Address &h, const std::vector<std::string> &methods)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    auto it = _mirrors.find(peer);
+                    if (it == _mirrors.end())
+                    {
+                        return;
+                    }
+
+                    auto host = it->second.find(h);
+                    if (host == it->second.end())
+                    {
+                        return;
+                    }
+
+                    auto &names = host->second->methods;
+                    for (auto &method : methods)
+                    {
+                        auto pos = std::find(names.begin(), names.end(), method);
+                        if (pos == names.end())
+                        {
+                            continue;
+                        }
+
+                        names.erase(pos);
+                        auto &shard = shardOf(method);
+                        std::unique_lock<std::mutex> shard_lock(shard.mutex);
+                        auto state = shard.methods.find(method);
+                        if (state != shard.methods.end())
+                        {
+                            unlink(method, state->second, host->second);
+                        }
+                    }
+
+                    if (names.empty())
+                    {
+                        it->second.erase(host);
+                    }
+                }
+
+                commit();
+            }
+
+            // 与某个副本的连接断开：它同步过来的提供者转成占位条目，
+            // 这些提供者通常很快会切换到其他副本重新注册，宽限期内被确认的不会产生上下线通知
+            bool orphanMirrors(const BaseConnection::ptr &peer)
+            {
+                bool orphaned = false;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    auto it = _mirrors.find(peer);
+                    if (it == _mirrors.end())
+                    {
+                        return false;
+                    }
+
+                    for (auto &item : it->second)
+                    {
+                        for (auto &method : item.second->methods)
+                        {
+                            // 先挂上占位再摘掉原来的，主机计数不会归零
+                            auto &shard = shardOf(method);
+                            std::unique_lock<std::mutex> shard_lock(shard.mutex);
+                            auto &state = shard.methods[method];
+                            link(method, state, placeholder(state, item.first), Json::Value());
+                            unlink(method, state, item.second);
+                        }
+                    }
+
+                    orphaned = it->second.empty() == false;
+                    _mirrors.erase(it);
+                }
+
+                commit();
+                return orphaned;
+            }
+
+        private:
+            // 一次上线/下线变化（元数据更新记为一次上线）
+            struct Change
+            {
+                uint64_t revision;
+                ServiceOptype optype;
+                Address host;
+                Json::Value meta;
+            };
+
+            // 一个在线主机：代表它的提供者个数和最新的元数据
+            struct HostEntry
+            {
+                Address host;
+                size_t refs;
+                Json::Value meta;
+                Provider::ptr placeholder; // 该主机的占位提供者（恢复出的、或者副本断开后留下的），没有时为空
+            };
+
+            // 一个方法的全部状态：提供者、在线主机、预先生成的主机列表、版本号和最近的变化历史
+            // 在线主机连续存放（生成主机列表时顺序遍历），另有按地址的索引，单个方法有大量主机时上下线也不用线性查找
+            struct MethodState
+            {
+                std::unordered_set<Provider::ptr> providers;    // 提供该方法的全部提供者对象
+                std::vector<HostEntry> hosts;                   // 在线主机（删除时用最后一个填补空位，顺序不固定）
+                std::map<Address, size_t> host_index;           // key：主机地址，val：在 hosts 中的位置
+                HostList list;                                  // 在线主机列表，主机变化时置空，下次发现时重建
+                Body body;                                      // 编码好的服务发现响应正文，主机或元数据变化时置空
+                uint64_t revision = 0;
+                std::deque<Change> history;
+            };
+
+            struct Shard
+            {
+                std::mutex mutex;
+                std::unordered_map<std::string, MethodState> methods; // key：函数名，val：方法的状态
+            };
+
+            Shard &shardOf(const std::string &method)
+            {
+                return _shards[std::hash<std::string>()(method) % _shards.size()];
+            }
+
+            // 方法的全量主机列表编码后的估算大小（和通知的估算方式相同）
+            size_t snapshotCost(const std::string &method)
+            {
+                auto &shard = shardOf(method);
+                std::unique_lock<std::mutex> lock(shard.mutex);
+                size_t cost = method.size() + 64;
+                auto it = shard.methods.find(method);
+                if (it == shard.methods.end())
+                {
+                    return cost;
+                }
+
+                for (auto &entry : it->second.hosts)
+                {
+                    cost += entry.host.first.size() + 40 + (entry.meta.isNull() ? 0 : entry.meta.toStyledString().size());
+                }
+                return cost;
+            }
+
+            // 方法有了第一个在线主机 / 失去最后一个在线主机时更新有序索引（持有分片锁调用，锁顺序：分片锁 -> 索引锁）
+            void indexMethod(const std::string &method, bool live)
+            {
+                std::unique_lock<std::mutex> lock(_index_mutex);
+                if (live)
+                {
+                    _live_methods.insert(method);
+                }
+                else
+                {
+                    _live_methods.erase(method);
+                }
+            }
+
+            // 方法当前的主机列表，失效时重新生成（需持有分片锁）
+            HostList hostsOf(MethodState &state)
+            {
+                if (state.hosts.empty())
+                {
+                    return _empty;
+                }
+
+                if (!state.list)
+                {
+                    rebuild(state);
+                }
+                return state.list;
+            }
+
+            // 编码服务发现响应的正文，rid 在发送时和正文一起组帧
+            std::string encodeDiscovery(const std::string &method, uint64_t revision,
+                                        const std::vector<Address> &hosts, const std::vector<Json::Value> &metas)
+            {
+                auto msg_rsp = MessageFactory::create<ServiceResponse>();
+                msg_rsp->setOptype(ServiceOptype::SERVICE_DISCOVERY);
+                msg_rsp->setRevision(revision);
+                msg_rsp->setEpoch(_epoch);
+                if (hosts.empty())
+                {
+                    msg_rsp->setRCode(RCode::RCODE_NOT_FOUND_SERVICE);
+                    return msg_rsp->serialize();
+                }
+
+                msg_rsp->setRCode(RCode::RCODE_OK);
+                msg_rsp->setMethod(method);
+                msg_rsp->setHost(hosts, metas);
+                return msg_rsp->serialize();
+            }
+
+            // 重新生成方法的主机列表（需持有分片锁）
+            void rebuild(MethodState &state)
+            {
+                auto list = std::make_shared<std::vector<Address>>();
+                list->reserve(state.hosts.size());
+                for (auto &entry : state.hosts)
+                {
+                    list->push_back(entry.host);
+                }
+                state.list = list;
+            }
+
+            // 记录一次变化：版本号加一，通知回调，开启持久化时同时写入日志（需持有分片锁）
+            // update：只是已在线主机的元数据变化，不写入持久化（元数据由提供者重新注册时带上）
+            void record(const std::string &method, MethodState &state, ServiceOptype optype, const Address &host,
+                        const Json::Value &meta, bool update = false)
+            {
+                if (_change_callback)
+                {
+                    _change_callback(optype, method, host, meta);
+                }
+
+                state.revision++;
+                state.history.push_back(Change{state.revision, optype, host, meta});
+                if (state.history.size() > _max_history)
+                {
+                    state.history.pop_front();
+                }
+
+                if (update)
+                {
+                    return;
+                }
+
+                std::unique_lock<std::mutex> lock(_store_mutex);
+                if (optype == ServiceOptype::SERVICE_ONLINE)
+                {
+                    _live++;
+                }
+                else if (_live > 0)
+                {
+                    _live--;
+                }
+                if (!_store)
+                {
+                    return;
+                }
+
+                // 压缩需要所有分片的状态，留到释放分片锁之后再做
+                _store->append(optype, method, host);
+                if (_store->needCompact(_live))
+                {
+                    _compact_due = true;
+                }
+            }
+
+            // 一次变更处理完、回复之前调用（不能持有任何分片锁）：先把日志落盘，日志足够长时再压缩
+            void commit()
+            {
+                RegistryStore::ptr store;
+                {
+                    std::unique_lock<std::mutex> lock(_store_mutex);
+                    store = _store;
+                }
+
+                if (store)
+                {
+                    store->sync();
+                }
+                compactIfDue();
+            }
+
+            // 日志足够长时用全部在线条目重写快照（不能持有任何分片锁调用）
+            // 依次锁住所有分片再写快照，期间不会有新的变化写入日志
+            void compactIfDue()
+            {
+                if (_compact_due.load() == false)
+                {
+                    return;
+                }
+
+                std::vector<std::unique_lock<std::mutex>> locks;
+                for (auto &shard : _shards)
+                {
+                    locks.emplace_back(shard.mutex);
+                }
+
+                std::unique_lock<std::mutex> lock(_store_mutex);
+                if (_compact_due.exchange(false) == false || !_store)
+                {
+                    return;
+                }
+
+                std::vector<RegistryStore::Entry> entries;
+                entries.reserve(_live);
+                for (auto &shard : _shards)
+                {
+                    for (auto &item : shard.methods)
+                    {
+                        for (auto &entry : item.second.hosts)
+                        {
+                            entries.push_back(RegistryStore::Entry(item.first, entry.host));
+                        }
+                    }
+                }
+                _store->compact(entries);
+            }
+
+            // 把提供者加入方法的提供者集合，主机第一次出现时记录上线（需持有分片锁）
+            // meta 不为 null 且与主机当前的元数据不同时，同时更新元数据
+            void link(const std::string &method, MethodState &state, const Provider::ptr &provider, const Json::Value &meta)
+            {
+                if (state.providers.insert(provider).second)
+                {
+                    auto host = findHost(state, provider->host);
+                    bool online = host == state.hosts.end();
+                    if (online)
+                    {
+                        host = addHost(method, state, provider->host, meta);
+                    }
+                    host->refs++;
+                    if (!provider->conn)
+                    {
+                        host->placeholder = provider;
+                    }
+
+                    if (online)
+                    {
+                        return record(method, state, ServiceOptype::SERVICE_ONLINE, provider->host, meta);
+                    }
+                }
+
+                updateHostMeta(method, state, provider->host, meta);
+            }
+
+            std::vector<HostEntry>::iterator findHost(MethodState &state, const Address &host)
+            {
+                auto it = state.host_index.find(host);
+                if (it == state.host_index.end())
+                {
+                    return state.hosts.end();
+                }
+                return state.hosts.begin() + it->second;
+            }
+
+            // 把主机加入方法的在线主机，返回它的条目（需持有分片锁）
+            std::vector<HostEntry>::iterator addHost(const std::string &method, MethodState &state, const Address &host,
+                                                     const Json::Value &meta)
+            {
+                if (state.hosts.empty())
+                {
+                    indexMethod(method, true);
+                }
+                state.host_index[host] = state.hosts.size();
+                state.hosts.push_back(HostEntry{host, 0, meta, Provider::ptr()});
+                state.list.reset();
+                state.body.reset();
+                return state.hosts.end() - 1;
+            }
+
+            // 把主机从方法的在线主机中删除，用最后一个条目填补空位（需持有分片锁）
+            void removeHost(const std::string &method, MethodState &state, std::vector<HostEntry>::iterator host)
+            {
+                size_t pos = host - state.hosts.begin();
+                state.host_index.erase(host->host);
+                if (pos + 1 != state.hosts.size())
+                {
+                    *host = std::move(state.hosts.back());
+                    state.host_index[host->host] = pos;
+                }
+                state.hosts.pop_back();
+                if (state.hosts.empty())
+                {
+                    indexMethod(method, false);
+                }
+                state.list.reset();
+                state.body.reset();
+            }
+
+            // 更新在线主机的元数据，有变化时记录为一次上线（需持有分片锁）
+            bool updateHostMeta(const std::string &method, MethodState &state, const Address &host, const Json::Value &meta)
+            {
+                if (meta.isNull())
+                {
+                    return false;
+                }
+
+                auto it = findHost(state, host);
+                if (it == state.hosts.end() || it->meta == meta)
+                {
+                    return false;
+                }
+
+                it->meta = meta;
+                state.body.reset();
+                record(method, state, ServiceOptype::SERVICE_ONLINE, host, meta, true);
+                return true;
+            }
+
+            // 更新提供者的元数据并应用到它的所有服务上，返回是否有变化
+            // （需独占 provider->methods：本机提供者持有它的锁，同步来的提供者持有 _mutex；不能持有分片锁）
+            bool applyMeta(const Provider::ptr &provider, const Json::Value &meta)
+            {
+                if (meta.isNull() || provider->meta == meta)
+                {
+                    return false;
+                }
+
+                provider->meta = meta;
+                for (auto &method : provider->methods)
+                {
+                    auto &shard = shardOf(method);
+                    std::unique_lock<std::mutex> shard_lock(shard.mutex);
+                    auto it = shard.methods.find(method);
+                    if (it != shard.methods.end())
+                    {
+                        updateHostMeta(method, it->second, provider->host, meta);
+                    }
+                }
+                return true;
+            }
+
+            // 把提供者从方法的提供者集合中移除，主机的最后一个提供者也移除时记录下线（需持有分片锁）
+            void unlink(const std::string &method, MethodState &state, const Provider::ptr &provider)
+            {
+                if (state.providers.erase(provider) == 0)
+                {
+                    return;
+                }
+
+                auto host = findHost(state, provider->host);
+                if (host == state.hosts.end())
+                {
+                    return;
+                }
+
+                if (host->placeholder == provider)
+                {
+                    host->placeholder.reset();
+                }
+
+                if (--host->refs == 0)
+                {
+                    removeHost(method, state, host);
+                    record(method, state, ServiceOptype::SERVICE_OFFLINE, provider->host, Json::Value());
+                }
+            }
+
+            // 取得方法中主机的占位提供者（恢复出的、或者副本断开后留下的），没有就新建一个（需持有分片锁）
+            Provider::ptr placeholder(MethodState &state, const Address &host)
+            {
+                auto it = findHost(state, host);
+                if (it != state.hosts.end() && it->placeholder)
+                {
+                    return it->placeholder;
+                }
+
+                return std::make_shared<Provider>(BaseConnection::ptr(), host);
+            }
+
+            // 某个方法被重新注册（或重新同步）确认：摘掉对应的占位（需持有分片锁，调用前已经挂上了确认的提供者）
+            void revalidate(const std::string &method, MethodState &state, const Address &host)
+            {
+                auto it = findHost(state, host);
+                if (it != state.hosts.end() && it->placeholder)
+                {
+                    auto stale = it->placeholder;
+                    unlink(method, state, stale);
+                }
+            }
+
         private:
-            std::mutex _mutex;
-            std::unordered_map<std::string, std::set<Provider::ptr>> _providers; // key：函数名，val：一组服务提供者
+            std::mutex _mutex;                                                   // 保护 _conns、_mirrors
             std::unordered_map<BaseConnection::ptr, Provider::ptr> _conns;       // key：连接，val：服务提供者
+            std::unordered_map<BaseConnection::ptr, std::map<Address, Provider::ptr>> _mirrors; // key：与其他副本的连接，val：它同步过来的提供者
+            std::string _epoch;                                                  // 注册中心实例标识，重启后变化
+            size_t _max_history;                                                 // 每个方法保留的变化条数
+            std::vector<Shard> _shards;                                          // 按方法名分片的方法状态
+            std::mutex _index_mutex;                                             // 保护 _live_methods
+            std::set<std::string> _live_methods;                                 // 当前有在线主机的方法名（有序，用于前缀发现分页）
+            HostList _empty;                                                     // 没有提供者时返回的空列表
+            Body _not_found;                                                     // 从未注册过的方法的服务发现响应正文
+            std::atomic<size_t> _encoded;
+            ChangeCallback _change_callback;                                     // 主机真正上线/下线时的回调
+
+            std::mutex _store_mutex;                                             // 保护 _live、_store
+            size_t _live;                                                        // 在线的（方法，主机）条目数
+            RegistryStore::ptr _store;                                           // 持久化存储，未开启时为空
+            std::atomic<bool> _compact_due;                                      // 日志需要压缩
         };
 
 
 
         // 服务发现客户端的管理
+        // 方法到发现者的映射按方法名分片加锁，发现请求之间、发现请求和上下线通知之间只在同一分片上竞争
+        // 加锁顺序：发现者的锁 → 分片的锁 → _mutex（通知队列）
         class DiscovererManager
         {
         public:
             using ptr = std::shared_ptr<DiscovererManager>;
 
+            // window_ms：上下线通知的合并窗口，窗口内的所有变化合并成每个发现者一条消息
+            // shard_num：方法到发现者映射的分片数
+            DiscovererManager(int window_ms = 10, size_t shard_num = 16)
+                : _shards(shard_num == 0 ? 1 : shard_num),
+                  _window(window_ms),
+                  _protocol(ProtocolFactory::create()),
+                  _deadline_set(false),
+                  _stop(false),
+                  _flushed(0),
+                  _encoded(0)
+            {
+                _flusher = std::thread(&DiscovererManager::flushEntry, this);
+            }
+
+            ~DiscovererManager()
+            {
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _stop = true;
+                }
+
+                _cond.notify_all();
+                _flusher.join();
+            }
+
             // 一个正在进行服务发现的客户端
             struct Discoverer
             {
@@ -149,7 +1019,8 @@ namespace rpc
 
                 std::mutex _mutex;
                 BaseConnection::ptr conn;         // 与发现者客户端的连接
-                std::vector<std::string> methods; // 发现过哪些服务（函数名）
+                std::vector<std::string> methods; // 发现过哪些服务（函数名，不重复）
+                bool removed = false;             // 连接已经断开，之后的发现不再登记
 
                 Discoverer(const BaseConnection::ptr &c)
                     :conn(c)
@@ -157,11 +1028,15 @@ namespace rpc
                     
                 }
 
-                // 添加一个发现到的服务（函数名）
-                void appendMethod(const std::string &method)
+                // 添加一个发现到的服务（函数名），已经发现过时返回 false（需持有 _mutex）
+                bool appendMethod(const std::string &method)
                 {
-                    std::unique_lock<std::mutex> lock(_mutex);
+                    if (std::find(methods.begin(), methods.end(), method) != methods.end())
+                    {
+                        return false;
+                    }
                     methods.push_back(method);
+                    return true;
                 }
             };
 
@@ -169,9 +1044,8 @@ namespace rpc
             Discoverer::ptr addDiscoverer(const BaseConnection::ptr &c, const std::string &method)
             {
                 Discoverer::ptr discoverer;
-
                 {
-                    std::unique_lock<std::mutex> lock(_mutex);
+                    std::unique_lock<std::mutex> lock(_conns_mutex);
                     auto it = _conns.find(c);
                     if (it != _conns.end())
                     {
@@ -182,76 +1056,366 @@ namespace rpc
                         discoverer = std::make_shared<Discoverer>(c);
                         _conns.insert(std::make_pair(c, discoverer));
                     }
-
-                    auto &discoverers = _discoverers[method];
-                    discoverers.insert(discoverer);
                 }
 
-                discoverer->appendMethod(method);
+                // 同一个方法重复发现时只登记一次，分片里的发现者列表不会有重复
+                std::unique_lock<std::mutex> lock(discoverer->_mutex);
+                if (discoverer->removed == false && discoverer->appendMethod(method))
+                {
+                    auto &shard = shardOf(method);
+                    std::unique_lock<std::mutex> shard_lock(shard.mutex);
+                    shard.discoverers[method].push_back(discoverer);
+                }
                 return discoverer;
             }
 
             // 发现者客户端断开连接时，要先找到发现者的信息，再删除所有关联数据
             void delDiscoverer(const BaseConnection::ptr &c)
             {
-                std::unique_lock<std::mutex> lock(_mutex);
-
-                auto it = _conns.find(c);
-                if (it == _conns.end())
+                Discoverer::ptr discoverer;
                 {
-                    return;
+                    std::unique_lock<std::mutex> lock(_conns_mutex);
+                    auto it = _conns.find(c);
+                    if (it == _conns.end())
+                    {
+                        return;
+                    }
+
+                    discoverer = it->second;
+                    _conns.erase(it);
                 }
-                
-                for(auto &method: it->second->methods)
+
+                std::unique_lock<std::mutex> lock(discoverer->_mutex);
+                discoverer->removed = true;
+                for(auto &method: discoverer->methods)
                 {
-                    auto& discoverers = _discoverers[method];
-                    discoverers.erase(it->second);
-                }
+                    auto &shard = shardOf(method);
+                    std::unique_lock<std::mutex> shard_lock(shard.mutex);
+                    auto it = shard.discoverers.find(method);
+                    if (it == shard.discoverers.end())
+                    {
+                        continue;
+                    }
 
-                _conns.erase(it);
+                    auto &discoverers = it->second;
+                    auto pos = std::find(discoverers.begin(), discoverers.end(), discoverer);
+                    if (pos != discoverers.end())
+                    {
+                        *pos = discoverers.back();
+                        discoverers.pop_back();
+                    }
+                    if (discoverers.empty())
+                    {
+                        shard.discoverers.erase(it);
+                    }
+                }
             }
 
             // 当一个新的服务提供者上线时，进行上线通知（通知所有查询过该方法的客户端）
-            void onlineNotify(const std::string method, const Address &host)
+            // meta：主机的元数据（已在线的主机元数据变化时同样发送上线通知）
+            void onlineNotify(const std::string method, const Address &host, const Json::Value &meta = Json::Value())
+            {
+                return notify(std::vector<std::string>(1, method), host, ServiceOptype::SERVICE_ONLINE, meta);
+            }
+
+            // 批量上线通知
+            void onlineNotify(const std::vector<std::string> &methods, const Address &host, const Json::Value &meta = Json::Value())
             {
-                return notify(method, host, ServiceOptype::SERVICE_ONLINE);
+                return notify(methods, host, ServiceOptype::SERVICE_ONLINE, meta);
             }
 
             // 当一个服务提供者断开连接时，进行下线通知
             void offlineNotify(const std::string method, const Address &host)
             {
-                return notify(method, host, ServiceOptype::SERVICE_OFFLINE);
+                return notify(std::vector<std::string>(1, method), host, ServiceOptype::SERVICE_OFFLINE, Json::Value());
             }
 
+            // 批量下线通知
+            void offlineNotify(const std::vector<std::string> &methods, const Address &host)
+            {
+                return notify(methods, host, ServiceOptype::SERVICE_OFFLINE, Json::Value());
+            }
+
+            size_t flushed() { return _flushed.load(); }   // 实际发出的通知消息数
+            size_t encoded() { return _encoded.load(); }   // 实际编码的通知消息数（内容相同的消息只编码一次）
+
         private:
-            // 进行通知（上线/下线）
-            void notify(const std::string method, const Address &host, ServiceOptype optype)
+            // 一次上线/下线事件
+            struct Event
+            {
+                std::string method;
+                Address host;
+                ServiceOptype optype;
+                Json::Value meta;
+            };
+
+            // 一个分片：方法到发现者的映射
+            struct Shard
+            {
+                std::mutex mutex;
+                std::unordered_map<std::string, std::vector<Discoverer::ptr>> discoverers; // key：函数名，val：一组服务发现者
+            };
+
+            Shard &shardOf(const std::string &method)
+            {
+                return _shards[std::hash<std::string>()(method) % _shards.size()];
+            }
+
+            // 记录通知事件，由后台线程在窗口结束后合并发送
+            void notify(const std::vector<std::string> &methods, const Address &host, ServiceOptype optype, const Json::Value &meta)
+            {
+                bool wakeup = false;
+                for (auto &method : methods)
+                {
+                    auto &shard = shardOf(method);
+                    std::unique_lock<std::mutex> shard_lock(shard.mutex);
+                    auto it = shard.discoverers.find(method);
+                    if (it == shard.discoverers.end() || it->second.empty())
+                    {
+                        continue;
+                    }
+
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    uint32_t idx = _events.size();
+                    _events.push_back(Event{method, host, optype, meta});
+                    for (auto &discoverer : it->second)
+                    {
+                        _pending[discoverer].push_back(idx);
+                    }
+
+                    // 窗口从第一条待发送的事件开始计时
+                    if (_deadline_set == false)
+                    {
+                        _deadline = std::chrono::steady_clock::now() + _window;
+                        _deadline_set = true;
+                        wakeup = true;
+                    }
+                }
+
+                if (wakeup)
+                {
+                    _cond.notify_one();
+                }
+            }
+
+            void flushEntry()
             {
                 std::unique_lock<std::mutex> lock(_mutex);
+                while (true)
+                {
+                    _cond.wait(lock, [this]() { return _stop || _deadline_set; });
+                    if (_stop == false)
+                    {
+                        // 等窗口结束，期间到达的事件一起合并
+                        _cond.wait_until(lock, _deadline, [this]() { return _stop; });
+                    }
+
+                    std::vector<Event> events;
+                    std::unordered_map<Discoverer::ptr, std::vector<uint32_t>> pending;
+                    events.swap(_events);
+                    pending.swap(_pending);
+                    _deadline_set = false;
+                    bool stop = _stop;
+
+                    // 组织和发送都在锁外进行
+                    lock.unlock();
+                    flush(events, pending);
+                    lock.lock();
+
+                    if (stop)
+                    {
+                        return;
+                    }
+                }
+            }
 
-                auto it = _discoverers.find(method);
-                if (it == _discoverers.end())
+            // 每个发现者发一条消息；关心的事件完全相同的发现者共用同一份编码好的消息帧
+            void flush(const std::vector<Event> &events, const std::unordered_map<Discoverer::ptr, std::vector<uint32_t>> &pending)
+            {
+                std::map<std::vector<uint32_t>, std::vector<std::string>> frames;
+                for (auto &item : pending)
                 {
-                    return;
+                    auto &conn = item.first->conn;
+                    if (!conn || conn->connected() == false)
+                    {
+                        continue;
+                    }
+
+                    auto it = frames.find(item.second);
+                    if (it == frames.end())
+                    {
+                        it = frames.insert(std::make_pair(item.second, encode(events, item.second))).first;
+                        _encoded += it->second.size();
+                    }
+
+                    for (auto &frame : it->second)
+                    {
+                        conn->sendRaw(frame);
+                        _flushed++;
+                    }
+                }
+            }
+
+            // 合并一个发现者在窗口内的事件：同一方法同一主机的多次变化只保留第一次和最后一次，
+            // 两者相同时只保留一次（例如 下线->上线->下线 等价于一次下线，下线->上线 仍需两条以便客户端重建连接）
+            std::vector<std::string> encode(const std::vector<Event> &events, const std::vector<uint32_t> &idxs)
+            {
+                struct Span
+                {
+                    uint32_t first;
+                    uint32_t last;
+                };
+                std::vector<Span> spans;
+                std::unordered_map<std::string, size_t> index;
+                for (auto idx : idxs)
+                {
+                    auto &ev = events[idx];
+                    std::string key = ev.method + '\0' + ev.host.first + ':' + std::to_string(ev.host.second);
+                    auto it = index.find(key);
+                    if (it == index.end())
+                    {
+                        index[key] = spans.size();
+                        spans.push_back(Span{idx, idx});
+                    }
+                    else
+                    {
+                        spans[it->second].last = idx;
+                    }
+                }
+
+                // 两个阶段：先发"第一次"变化，再发"最后一次"变化，每个阶段内按（操作，主机）归并方法
+                // 元数据属于主机，一组里取最新的那次事件携带的元数据
+                struct Group
+                {
+                    std::vector<std::string> methods;
+                    uint32_t latest = 0;
+                };
+                std::map<std::pair<ServiceOptype, Address>, Group> methods[2];
+                auto append = [&events](Group &group, uint32_t idx)
+                {
+                    group.methods.push_back(events[idx].method);
+                    group.latest = std::max(group.latest, idx);
+                };
+                for (auto &span : spans)
+                {
+                    auto &first = events[span.first];
+                    auto &last = events[span.last];
+                    if (first.optype != last.optype)
+                    {
+                        append(methods[0][std::make_pair(first.optype, first.host)], span.first);
+                    }
+                    append(methods[1][std::make_pair(last.optype, last.host)], span.last);
+                }
+
+                // 按顺序切分成多条消息，保证每条消息不超过协议允许的长度
+                std::vector<std::string> frames;
+                std::vector<Change> changes;
+                size_t size = 0;
+                for (int phase = 0; phase < 2; phase++)
+                {
+                    for (auto &group : methods[phase])
+                    {
+                        auto &meta = events[group.second.latest].meta;
+                        size_t meta_cost = meta.isNull() ? 0 : meta.toStyledString().size();
+                        Change change{group.first.first, group.first.second, std::vector<std::string>(), meta};
+                        for (auto &method : group.second.methods)
+                        {
+                            size_t cost = method.size() + 8;
+                            if (size + cost + 160 + meta_cost > _max_body && (change.methods.empty() == false || changes.empty() == false))
+                            {
+                                if (change.methods.empty() == false)
+                                {
+                                    changes.push_back(change);
+                                    change.methods.clear();
+                                }
+                                frames.push_back(encodeMessage(changes));
+                                changes.clear();
+                                size = 0;
+                            }
+
+                            if (change.methods.empty())
+                            {
+                                size += 160 + meta_cost;
+                            }
+                            change.methods.push_back(method);
+                            size += cost;
+                        }
+
+                        changes.push_back(change);
+                    }
+                }
+
+                if (changes.empty() == false)
+                {
+                    frames.push_back(encodeMessage(changes));
                 }
 
+                return frames;
+            }
+
+            // 一条变更：某个主机上的一组方法上线/下线（上线时带上主机的元数据）
+            struct Change
+            {
+                ServiceOptype optype;
+                Address host;
+                std::vector<std::string> methods;
+                Json::Value meta;
+            };
+
+            std::string encodeMessage(const std::vector<Change> &changes)
+            {
                 auto msg_req = MessageFactory::create<ServiceRequest>();
                 msg_req->setId(UUID::uuid());
                 msg_req->setMType(MType::REQ_SERVICE);
-                msg_req->setMethod(method);
-                msg_req->setHost(host);
-                msg_req->setOptype(optype);
-
-                for (auto &discoverer : it->second)
+                if (changes.size() == 1)
+                {
+                    // 只有一条变更时保持原来的消息格式
+                    msg_req->setOptype(changes[0].optype);
+                    msg_req->setHost(changes[0].host);
+                    if (changes[0].meta.isNull() == false)
+                    {
+                        msg_req->setMeta(changes[0].meta);
+                    }
+                    if (changes[0].methods.size() == 1)
+                    {
+                        msg_req->setMethod(changes[0].methods[0]);
+                    }
+                    else
+                    {
+                        msg_req->setMethods(changes[0].methods);
+                    }
+                }
+                else
                 {
-                    discoverer->conn->send(msg_req);
+                    msg_req->setOptype(ServiceOptype::SERVICE_DELTA);
+                    for (auto &change : changes)
+                    {
+                        msg_req->appendChange(change.optype, change.host, change.methods, change.meta);
+                    }
                 }
+
+                return _protocol->serialize(msg_req);
             }
 
         private:
-            std::mutex _mutex;
-            std::unordered_map<std::string, std::set<Discoverer::ptr>> _discoverers; // key：函数名，val：一组服务发现者
-            std::unordered_map<BaseConnection::ptr, Discoverer::ptr> _conns;         // key：连接，val：服务发现者
+            std::vector<Shard> _shards;                                          // 按方法名分片的发现者
+            std::mutex _conns_mutex;
+            std::unordered_map<BaseConnection::ptr, Discoverer::ptr> _conns;     // key：连接，val：服务发现者
+
+            std::mutex _mutex;                                                   // 保护通知队列
+
+            std::chrono::milliseconds _window;                                   // 通知合并的时间窗口
+            const size_t _max_body = 32 * 1024;                                  // 单条通知正文的估算上限，远小于协议的最大帧长
+            BaseProtocol::ptr _protocol;                                         // 用于把通知编码成消息帧
+            std::vector<Event> _events;                                          // 窗口内的所有事件
+            std::unordered_map<Discoverer::ptr, std::vector<uint32_t>> _pending; // key：发现者，val：它关心的事件下标
+            bool _deadline_set;                                                  // 当前是否有待发送的窗口
+            std::chrono::steady_clock::time_point _deadline;                     // 当前窗口的结束时间
+            bool _stop;
+            std::condition_variable _cond;
+            std::atomic<size_t> _flushed;
+            std::atomic<size_t> _encoded;
+            std::thread _flusher;                                                // 合并发送通知的后台线程
         };
 
 
@@ -262,11 +1426,84 @@ namespace rpc
         public:
             using ptr=std::shared_ptr<PDManager>;
 
-            PDManager()
+            // lease_ms：提供者租约的租期，tick_ms：租约过期检查的精度
+            PDManager(int lease_ms = 3000, int tick_ms = 100)
                 :_providers(std::make_shared<ProviderManager>()),
-                _discoverers(std::make_shared<DiscovererManager>())
+                _discoverers(std::make_shared<DiscovererManager>()),
+                _protocol(ProtocolFactory::create()),
+                _leases(std::make_shared<LeaseWheel>(lease_ms, tick_ms, std::bind(&PDManager::onLeaseExpire, this, std::placeholders::_1))),
+                _grace(30000),
+                _stop(false),
+                _revalidate_pending(false)
+            {
+                // 主机真正上线/下线（按主机去重之后）时才通知发现者
+                _providers->setChangeCallback([this](ServiceOptype optype, const std::string &method, const Address &host, const Json::Value &meta)
+                {
+                    if (optype == ServiceOptype::SERVICE_ONLINE)
+                    {
+                        _discoverers->onlineNotify(method, host, meta);
+                    }
+                    else
+                    {
+                        _discoverers->offlineNotify(method, host);
+                    }
+                });
+
+                // 心跳响应的正文是固定的，提前序列化好，每次只需要拼上 rid
+                for (RCode rcode : {RCode::RCODE_OK, RCode::RCODE_NOT_FOUND_SERVICE})
+                {
+                    auto msg_rsp = MessageFactory::create<ServiceResponse>();
+                    msg_rsp->setRCode(rcode);
+                    msg_rsp->setOptype(ServiceOptype::SERVICE_HEARTBEAT);
+                    _heartbeat_bodies[rcode == RCode::RCODE_OK ? 0 : 1] = msg_rsp->serialize();
+                }
+            }
+
+            ~PDManager()
+            {
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _stop = true;
+                }
+
+                _cond.notify_all();
+                if (_revalidator.joinable())
+                {
+                    _revalidator.join();
+                }
+            }
+
+            // 开启持久化并从 dir 恢复上次的注册信息（在开始服务之前调用）
+            // 恢复出的主机在 grace_ms 内没有被提供者重新注册确认的，按下线处理
+            bool recover(const std::string &dir, int grace_ms = 30000)
+            {
+                _grace = grace_ms;
+                size_t recovered = 0;
+                if (_providers->recover(std::make_shared<RegistryStore>(dir), recovered) == false)
+                {
+                    return false;
+                }
+
+                ILOG("从 %s 恢复了 %zu 个服务提供条目，等待提供者重新注册！", dir.c_str(), recovered);
+                if (recovered > 0)
+                {
+                    scheduleRevalidation();
+                }
+
+                return true;
+            }
+
+            // 与其他副本组成集群（在开始服务之前调用）：把本机提供者的变化推送给 peers，
+            // 同时接收它们推送过来的提供者，任何副本都能应答服务发现
+            void replicate(const std::vector<Address> &peers)
             {
+                if (peers.empty())
+                {
+                    return;
+                }
 
+                _replicator = std::make_shared<Replicator>(peers, std::bind(&ProviderManager::localProviders, _providers.get()));
+                _replicator->start();
             }
 
             // 处理服务请求（注册/发现）
@@ -274,10 +1511,15 @@ namespace rpc
             {
                 ServiceOptype optype = msg->optype();
 
-                if(optype == ServiceOptype::SERVICE_REGISTRY)   // 提供者注册服务
+                if(optype == ServiceOptype::SERVICE_REGISTRY)   // 提供者注册服务（单个或批量）
                 {
-                    _providers->addProvider(conn, msg->host(), msg->method());
-                    _discoverers->onlineNotify(msg->method(), msg->host());
+                    auto methods = msg->methods();
+                    auto meta = msg->meta();
+                    _providers->addProvider(conn, msg->host(), methods, meta);
+                    if (_replicator)
+                    {
+                        _replicator->forward(ServiceOptype::SERVICE_ONLINE, msg->host(), methods, meta);
+                    }
                     return registryResponse(conn, msg);
                 }
                 else if(optype == ServiceOptype::SERVICE_DISCOVERY) // 发现者查找范围
@@ -285,6 +1527,59 @@ namespace rpc
                     _discoverers->addDiscoverer(conn, msg->method());
                     return discoveryResponse(conn, msg);
                 }
+                else if(optype == ServiceOptype::SERVICE_WATCH) // 发现者从已知版本重新同步（通常是重连之后），或者批量发现
+                {
+                    // 按前缀批量发现：匹配到的方法（一页）都按没有同步过处理，返回全量
+                    auto watches = msg->watches();
+                    bool more = false;
+                    if (msg->hasPrefix())
+                    {
+                        for (auto &method : _providers->matchMethods(msg->prefix(), msg->after(), _prefix_page, _prefix_bytes, more))
+                        {
+                            watches.push_back(ServiceRequest::Watch{method, 0, std::string()});
+                        }
+                    }
+
+                    for (auto &watch : watches)
+                    {
+                        _discoverers->addDiscoverer(conn, watch.method);
+                    }
+                    return watchResponse(conn, msg, watches, more);
+                }
+                else if(optype == ServiceOptype::SERVICE_HEARTBEAT) // 提供者续约
+                {
+                    // 提供者已经被移除（例如租约过期后才恢复）时告知对方，由提供者重新注册
+                    auto provider = _providers->getProvider(conn);
+                    if (provider.get() == nullptr)
+                    {
+                        return heartbeatResponse(conn, msg, RCode::RCODE_NOT_FOUND_SERVICE);
+                    }
+
+                    _leases->renew(conn);
+
+                    // 携带了新的元数据（负载变化等）：更新后通知发现者，并同步给其他副本
+                    auto meta = msg->meta();
+                    std::vector<std::string> methods;
+                    if (meta.isNull() == false && _providers->updateMeta(provider, meta, methods) && _replicator)
+                    {
+                        _replicator->forward(ServiceOptype::SERVICE_ONLINE, provider->host, methods, meta);
+                    }
+                    return heartbeatResponse(conn, msg, RCode::RCODE_OK);
+                }
+                else if(optype == ServiceOptype::SERVICE_SYNC) // 其他副本推送它的提供者变化（不需要应答）
+                {
+                    for (auto &change : msg->changes())
+                    {
+                        if (change->optype() == ServiceOptype::SERVICE_ONLINE)
+                        {
+                            _providers->addMirror(conn, change->host(), change->methods(), change->meta());
+                        }
+                        else
+                        {
+                            _providers->delMirror(conn, change->host(), change->methods());
+                        }
+                    }
+                }
                 else
                 {
                     ELOG("收到服务操作请求，但是操作类型错误！");
@@ -295,22 +1590,40 @@ namespace rpc
             // 连接断开
             void onConnShutdown(const BaseConnection::ptr &conn)
             {
-                auto provider = _providers->getProvider(conn);
+                _leases->remove(conn);
+                auto provider = _providers->delProvider(conn);
 
-                // 如果是提供者要对他提供的服务进行下线通知
-                if(provider.get() != nullptr)
+                // 如果是提供者，发现者的下线通知由 ProviderManager 的变化回调发出，这里只需要告诉其他副本
+                if(provider.get() != nullptr && _replicator)
                 {
-                    for(auto &method : provider->methods)
-                    {
-                        _discoverers->offlineNotify(method, provider->host);
-                    }
+                    _replicator->forward(ServiceOptype::SERVICE_OFFLINE, provider->host, provider->methods);
+                }
 
-                    _providers->delProvider(conn);
+                // 如果是其他副本，它同步过来的提供者等待重新确认
+                if (_providers->orphanMirrors(conn))
+                {
+                    ILOG("与注册中心副本的连接断开，等待其提供者切换过来！");
+                    scheduleRevalidation();
                 }
 
                 _discoverers->delDiscoverer(conn);
             }
 
+            ProviderManager::ptr providers()
+            {
+                return _providers;
+            }
+
+            DiscovererManager::ptr discoverers()
+            {
+                return _discoverers;
+            }
+
+            LeaseWheel::ptr leases()
+            {
+                return _leases;
+            }
+
         private:
             // 错误响应
             void errorResponse(const BaseConnection::ptr &conn, const ServiceRequest::ptr &msg)
@@ -334,32 +1647,112 @@ namespace rpc
                 conn->send(msg_rsp);
             }
 
-            // 服务发现响应
+            // 服务发现响应：正文（提供者主机列表、版本号等）按方法缓存，只需要拼上 rid 组帧
+            // 客户端重连后可以从响应中的版本开始增量同步
             void discoveryResponse(const BaseConnection::ptr &conn, const ServiceRequest::ptr &msg)
             {
-                auto msg_rsp = MessageFactory::create<ServiceResponse>();
-                msg_rsp->setId(msg->rid());
-                msg_rsp->setMType(MType::RSP_SERVICE);
-                msg_rsp->setOptype(ServiceOptype::SERVICE_DISCOVERY);
+                auto body = _providers->discoveryBody(msg->method());
+                conn->sendRaw(_protocol->serialize(MType::RSP_SERVICE, msg->rid(), *body));
+            }
 
-                // 找到函数名对应的提供者
-                std::vector<Address> hosts = _providers->methodHosts(msg->method());
+            // 租约过期：提供者还连着但已经不再续约，按下线处理（连接保留，提供者恢复后可以重新注册）
+            void onLeaseExpire(const BaseConnection::ptr &conn)
+            {
+                auto provider = _providers->delProvider(conn);
+                if(provider.get() != nullptr)
+                {
+                    ILOG("提供者 %s:%d 租约过期，做下线处理！", provider->host.first.c_str(), provider->host.second);
+                    if (_replicator)
+                    {
+                        _replicator->forward(ServiceOptype::SERVICE_OFFLINE, provider->host, provider->methods);
+                    }
+                }
+            }
 
-                if (hosts.empty())
+            // 宽限期从最后一次产生占位条目时开始计算，到期后统一清理没有被确认的占位
+            void scheduleRevalidation()
+            {
                 {
-                    msg_rsp->setRCode(RCode::RCODE_NOT_FOUND_SERVICE);
-                    return conn->send(msg_rsp);
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _revalidate_at = std::chrono::steady_clock::now() + std::chrono::milliseconds(_grace);
+                    _revalidate_pending = true;
+                    if (_revalidator.joinable() == false)
+                    {
+                        _revalidator = std::thread(&PDManager::revalidateEntry, this);
+                    }
+                }
+
+                _cond.notify_all();
+            }
+
+            void revalidateEntry()
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                while (true)
+                {
+                    _cond.wait(lock, [this]() { return _stop || _revalidate_pending; });
+                    while (_stop == false && std::chrono::steady_clock::now() < _revalidate_at)
+                    {
+                        _cond.wait_until(lock, _revalidate_at);
+                    }
+
+                    if (_stop)
+                    {
+                        return;
+                    }
+
+                    _revalidate_pending = false;
+                    lock.unlock();
+                    _providers->expireRecovered();
+                    lock.lock();
                 }
-                
+            }
+
+            // 心跳响应：使用提前序列化好的正文
+            void heartbeatResponse(const BaseConnection::ptr &conn, const ServiceRequest::ptr &msg, RCode rcode)
+            {
+                const std::string &body = _heartbeat_bodies[rcode == RCode::RCODE_OK ? 0 : 1];
+                conn->sendRaw(_protocol->serialize(MType::RSP_SERVICE, msg->rid(), body));
+            }
+
+            // 订阅响应：每个方法一项，增量或者全量；more 表示前缀发现还有下一页
+            void watchResponse(const BaseConnection::ptr &conn, const ServiceRequest::ptr &msg,
+                               const std::vector<ServiceRequest::Watch> &watches, bool more)
+            {
+                auto msg_rsp = MessageFactory::create<ServiceResponse>();
+                msg_rsp->setId(msg->rid());
+                msg_rsp->setMType(MType::RSP_SERVICE);
+                msg_rsp->setOptype(ServiceOptype::SERVICE_WATCH);
                 msg_rsp->setRCode(RCode::RCODE_OK);
-                msg_rsp->setMethod(msg->method());
-                msg_rsp->setHost(hosts);
-                return conn->send(msg_rsp);
+                msg_rsp->setEpoch(_providers->epoch());
+                for (auto &watch : watches)
+                {
+                    msg_rsp->appendWatchResult(_providers->watch(watch.method, watch.revision, watch.epoch));
+                }
+                if (more)
+                {
+                    msg_rsp->setMore(true);
+                }
+                conn->send(msg_rsp);
             }
 
         private:
             ProviderManager::ptr _providers;     // 管理全部的提供者
             DiscovererManager::ptr _discoverers; // 管理全部的发现者
+            Replicator::ptr _replicator;         // 与其他副本的同步，没有组成集群时为空
+            BaseProtocol::ptr _protocol;         // 用于给提前序列化好的响应（心跳、服务发现）组帧
+            std::string _heartbeat_bodies[2];    // 心跳响应正文：续约成功 / 提供者未注册
+            const size_t _prefix_page = 32;      // 前缀发现每页最多的方法数
+            const size_t _prefix_bytes = 48 * 1024; // 前缀发现每页主机列表的估算大小上限，留出余量，避免响应超过协议的最大帧长（64KB）
+            LeaseWheel::ptr _leases;             // 提供者租约（晚于 _providers、_discoverers 构造、先于它们析构，过期回调不会访问已析构的成员）
+
+            int _grace;                          // 占位条目等待重新确认的宽限期（毫秒）
+            std::mutex _mutex;
+            std::condition_variable _cond;
+            bool _stop;
+            bool _revalidate_pending;            // 是否有等待清理的占位条目
+            std::chrono::steady_clock::time_point _revalidate_at; // 清理时间
+            std::thread _revalidator;            // 宽限期结束时清理没有被重新确认的占位条目
         };
     }
 }
\ No newline at end of file
@@ -0,0 +1,153 @@
+/*
+    注册中心副本之间的同步（按归属划分的复制）
+    * 每个副本只对"连在自己身上的提供者"负责，并把这部分提供者的上下线推送给其他所有副本
+    * 每个副本主动连接其他副本，连上后先推送本机提供者的全量，之后推送增量（SERVICE_SYNC，不需要应答）
+    * 收到的副本把这些提供者挂在入站连接上（ProviderManager 的 mirror），所以任何副本都能应答服务发现
+    * 副本宕机时，它同步过来的提供者转成占位条目，等提供者切换到其他副本重新注册
+    * 只转发本机提供者的变化，同步来的变化不再转发，不会形成环路
+*/
+#pragma once
+#include "../common/net.hpp"
+#include "../common/message.hpp"
+#include <thread>
+
+namespace rpc
+{
+    namespace server
+    {
+        class Replicator
+        {
+        public:
+            using ptr = std::shared_ptr<Replicator>;
+
+            // 一个提供者主机：提供的服务和元数据
+            struct HostInfo
+            {
+                Address host;
+                std::vector<std::string> methods;
+                Json::Value meta;
+            };
+            using HostMethods = std::vector<HostInfo>;
+            using SnapshotCallback = std::function<HostMethods()>;
+
+            // peers：其他副本的地址，cb：获取本机全部提供者（连上某个副本时推送全量）
+            Replicator(const std::vector<Address> &peers, const SnapshotCallback &cb)
+                : _peers(peers),
+                  _snapshot_callback(cb),
+                  _protocol(ProtocolFactory::create())
+            {
+            }
+
+            ~Replicator()
+            {
+                if (_connector.joinable())
+                {
+                    _connector.join();
+                }
+            }
+
+            // 在后台连接所有副本（副本可能还没有启动，断开后自动重连），不阻塞注册中心启动
+            void start()
+            {
+                for (auto &peer : _peers)
+                {
+                    auto client = ClientFactory::create(peer.first, peer.second);
+                    client->setConnectionCallback(std::bind(&Replicator::onPeerConnection, this, std::placeholders::_1));
+                    client->enableRetry();
+                    _clients.push_back(client);
+                }
+
+                _connector = std::thread([this]()
+                {
+                    for (auto &client : _clients)
+                    {
+                        client->connect();
+                    }
+                });
+            }
+
+            // 本机提供者上线/下线（上线时携带元数据，元数据更新也按上线推送），推送给所有已连接的副本
+            void forward(ServiceOptype optype, const Address &host, const std::vector<std::string> &methods,
+                         const Json::Value &meta = Json::Value())
+            {
+                HostMethods changes(1, HostInfo{host, methods, meta});
+                std::unique_lock<std::mutex> lock(_mutex);
+                auto frames = encode(optype, changes);
+                for (auto &client : _clients)
+                {
+                    auto conn = client->connection();
+                    if (!conn || conn->connected() == false)
+                    {
+                        continue;
+                    }
+
+                    for (auto &frame : frames)
+                    {
+                        conn->sendRaw(frame);
+                    }
+                }
+            }
+
+        private:
+            // 连上（或重连上）一个副本：推送本机全部提供者
+            // 取全量和发送都在锁内，与 forward 串行，对方收到的顺序和本机变化的顺序一致
+            void onPeerConnection(const BaseConnection::ptr &conn)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                for (auto &frame : encode(ServiceOptype::SERVICE_ONLINE, _snapshot_callback()))
+                {
+                    conn->sendRaw(frame);
+                }
+            }
+
+            // 编码成若干条同步消息，每条不超过 _max_body，保证不超过协议的最大帧长
+            std::vector<std::string> encode(ServiceOptype optype, const HostMethods &changes)
+            {
+                std::vector<std::string> frames;
+                ServiceRequest::ptr msg_req;
+                size_t estimate = 0;
+                for (auto &change : changes)
+                {
+                    size_t size = change.host.first.size() + 128 + (change.meta.isNull() ? 0 : change.meta.toStyledString().size());
+                    for (auto &method : change.methods)
+                    {
+                        size += method.size() + 16;
+                    }
+
+                    if (msg_req && estimate + size > _max_body)
+                    {
+                        frames.push_back(_protocol->serialize(msg_req));
+                        msg_req.reset();
+                    }
+
+                    if (!msg_req)
+                    {
+                        msg_req = MessageFactory::create<ServiceRequest>();
+                        msg_req->setId(UUID::uuid());
+                        msg_req->setMType(MType::REQ_SERVICE);
+                        msg_req->setOptype(ServiceOptype::SERVICE_SYNC);
+                        estimate = 0;
+                    }
+
+                    msg_req->appendChange(optype, change.host, change.methods, change.meta);
+                    estimate += size;
+                }
+
+                if (msg_req)
+                {
+                    frames.push_back(_protocol->serialize(msg_req));
+                }
+                return frames;
+            }
+
+        private:
+            std::vector<Address> _peers;
+            SnapshotCallback _snapshot_callback;
+            BaseProtocol::ptr _protocol;
+            const size_t _max_body = 32 * 1024; // 单条同步消息正文的估算上限
+            std::mutex _mutex;
+            std::vector<BaseClient::ptr> _clients; // 每个副本一个客户端
+            std::thread _connector;                // 在后台连接各个副本
+        };
+    }
+}
@@ -2,68 +2,79 @@
     RPC路由：收到RPC请求后，找到对应的业务函数，检查参数，然后调用执行。
     * 用函数名做key映射完整函数
     * rpc请求查找->参数校->函数调用->响应组织
+    * 业务处理交给 RpcScheduler 的工作线程，过载时快速返回 RCODE_OVERLOAD
+    * 标记为可缓存的纯函数方法，相同参数的请求直接返回缓存的结果
+    * 开启请求合并的方法，相同参数的并发请求只执行一次，结果回复给所有请求方
 */
 #pragma once
 #include "../common/net.hpp"
 #include "../common/message.hpp"
+#include "rpc_scheduler.hpp"
+#include "rpc_cache.hpp"
+#include "rpc_schema.hpp"
 
 namespace rpc
 {
     namespace server
     {
-        // 字段类型（用于参数/返回值）
-        enum class VType
-        {
-            BOOL = 0, // bool
-            INTEGRAL, // 整数
-            NUMERIC,  // 数字（小数）
-            STRING,   // string
-            ARRAY,    // 数组
-            OBJECT    // 对象
-        };
-
-
-
         // rpc服务的所有信息
         class ServiceDescribe
         {
         public:
             using ptr = std::shared_ptr<ServiceDescribe>;
             using ServiceCallback = std::function<void(const Json::Value &, Json::Value &)>;
-            using ParamsDescribe = std::pair<std::string, VType>;   // 字段（也就是形参）+类型
+            using ParamsDescribe = ParamsSchema::FieldDescribe;     // 字段（也就是形参）路径+类型+是否必选
 
-            // 参数分别是函数名、参数列表信息（字段/形参+类型）、返回值类型、处理回调
-            ServiceDescribe(const std::string &&mname, std::vector<ParamsDescribe> &&desc, VType vtype, const ServiceCallback &&handler)
+            // 参数分别是函数名、参数列表信息（字段/形参+类型）、返回值类型、处理回调、优先级、最大并发数（0表示不限制）、
+            // 结果缓存有效期（0表示不缓存）、结果缓存条目上限、是否合并相同参数的并发请求
+            ServiceDescribe(const std::string &&mname, std::vector<ParamsDescribe> &&desc, VType vtype, const ServiceCallback &&handler,
+                            Priority priority = Priority::NORMAL, size_t max_concurrency = 0,
+                            int cache_ttl_ms = 0, size_t cache_capacity = 0, bool single_flight = false)
                 :_method_name(std::move(mname)),
                 _callback(std::move(handler)),
-                _params_desc(std::move(desc)),
-                _return_type(std::move(vtype))
+                _return_type(std::move(vtype)),
+                _priority(priority)
             {
+                // 参数描述在注册时编译一次，描述有冲突时该方法拒绝所有请求
+                if (_params_schema.compile(desc) == false)
+                {
+                    ELOG("%s 参数描述存在冲突！", _method_name.c_str());
+                }
 
+                if (max_concurrency > 0)
+                {
+                    _limit = std::make_shared<ConcurrencyLimit>(max_concurrency);
+                }
+
+                if (cache_ttl_ms > 0)
+                {
+                    _cache = std::make_shared<ResponseCache>(cache_ttl_ms, cache_capacity);
+                }
+
+                if (single_flight)
+                {
+                    _flight = std::make_shared<SingleFlight>();
+                }
             }
 
             const std::string &method() { return _method_name; }
 
+            Priority priority() { return _priority; }
+
+            // 方法的并发限制，为空表示不限制
+            const ConcurrencyLimit::ptr &limit() { return _limit; }
+
+            // 方法的结果缓存，为空表示不可缓存
+            const ResponseCache::ptr &cache() { return _cache; }
+
+            // 方法的请求合并表，为空表示不合并
+            const SingleFlight::ptr &flight() { return _flight; }
+
             bool paramCheck(const Json::Value &params)
             {
                 // 对params进行参数校验：判断所描述的字段是否存在，类型一不一致
-                // 分别判断形参是否存在和类型是否与之匹配
-                for (auto &desc : _params_desc)
-                {
-                    if (params.isMember(desc.first) == false)
-                    {
-                        ELOG("参数校验失败，存在缺失字段：%s", desc.first.c_str());
-                        return false;
-                    }
-
-                    if(check(desc.second, params[desc.first]) == false)
-                    {
-                        ELOG("%s 参数类型校验失败！", desc.first.c_str());
-                        return false;
-                    }
-                }
-
-                return true;
+                // 校验程序在注册时已经编译好，这里只需遍历一次参数对象
+                return _params_schema.check(params);
             }
 
             bool call(const Json::Value &params, Json::Value &result)
@@ -81,35 +92,18 @@ namespace rpc
         private:
             bool rtypeCheck(const Json::Value &val)
             {
-                return check(_return_type, val);
-            }
-
-            bool check(VType vtype, const Json::Value &val)
-            {
-                switch(vtype)
-                {
-                    case VType::BOOL:
-                        return val.isBool();
-                    case VType::INTEGRAL:
-                        return val.isIntegral();
-                    case VType::NUMERIC:
-                        return val.isNumeric();
-                    case VType::STRING:
-                        return val.isString();
-                    case VType::ARRAY:
-                        return val.isArray();
-                    case VType::OBJECT:
-                        return val.isObject();
-                }
-
-                return false;
+                return ParamsSchema::checkType(_return_type, val);
             }
 
         private:
             std::string _method_name;                 // 方法的名称
             ServiceCallback _callback;                // 实际的业务的回调函数
-            std::vector<ParamsDescribe> _params_desc; // 参数字段格式的描述
+            ParamsSchema _params_schema;              // 编译好的参数校验程序
             VType _return_type;                       // 结果作为返回值类型的描述
+            Priority _priority;                       // 调度优先级
+            ConcurrencyLimit::ptr _limit;             // 并发限制
+            ResponseCache::ptr _cache;                // 结果缓存
+            SingleFlight::ptr _flight;                // 正在执行的请求（用于合并）
         };
 
 
@@ -128,19 +122,54 @@ namespace rpc
                 _return_type = vtype;
             }
 
+            // pname 可以是嵌套路径："user.name" 表示 user 对象的 name 字段，
+            // "tags[]" 表示 tags 数组的每个元素，"items[].id" 表示 items 数组中每个对象的 id 字段
             void setParamsDesc(const std::string &pname, VType vtype)
             {
                 _params_desc.push_back(ServiceDescribe::ParamsDescribe(pname, vtype));
             }
 
+            // 可选字段：不存在时不报错，存在时校验类型
+            void setOptionalParamsDesc(const std::string &pname, VType vtype)
+            {
+                _params_desc.push_back(ServiceDescribe::ParamsDescribe(pname, vtype, false));
+            }
+
             void setCallback(const ServiceDescribe::ServiceCallback &cb)
             {
                 _callback = cb;
             }
 
+            // 设置调度优先级，默认 NORMAL
+            void setPriority(Priority priority)
+            {
+                _priority = priority;
+            }
+
+            // 设置同一时刻最多执行的请求数，默认 0 表示不限制
+            void setMaxConcurrency(size_t max_concurrency)
+            {
+                _max_concurrency = max_concurrency;
+            }
+
+            // 标记为纯函数方法（结果只取决于参数），相同参数的结果缓存 ttl_ms 毫秒，最多缓存 capacity 条
+            void setCacheable(int ttl_ms, size_t capacity = 1024)
+            {
+                _cache_ttl_ms = ttl_ms;
+                _cache_capacity = capacity;
+            }
+
+            // 开启请求合并：相同参数的请求正在执行时，新请求不再重复执行，而是等待并共享这次的结果
+            // 适用于结果只取决于参数、且执行代价较高的方法（如缓存未命中后的回源查询）
+            void setSingleFlight(bool enable)
+            {
+                _single_flight = enable;
+            }
+
             ServiceDescribe::ptr build()
             {
-                return std::make_shared<ServiceDescribe>(std::move(_method_name), std::move(_params_desc), _return_type, std::move(_callback));
+                return std::make_shared<ServiceDescribe>(std::move(_method_name), std::move(_params_desc), _return_type, std::move(_callback),
+                                                         _priority, _max_concurrency, _cache_ttl_ms, _cache_capacity, _single_flight);
             }
 
         private:
@@ -148,6 +177,11 @@ namespace rpc
             ServiceDescribe::ServiceCallback _callback;                // 实际的业务回调函数
             std::vector<ServiceDescribe::ParamsDescribe> _params_desc; // 参数字段格式描述
             VType _return_type;                                        // 结果作为返回值类型的描述
+            Priority _priority = Priority::NORMAL;                     // 调度优先级
+            size_t _max_concurrency = 0;                               // 最大并发数，0表示不限制
+            int _cache_ttl_ms = 0;                                     // 结果缓存有效期，0表示不缓存
+            size_t _cache_capacity = 0;                                // 结果缓存条目上限
+            bool _single_flight = false;                               // 是否合并相同参数的并发请求
         };
 
         
@@ -200,8 +234,11 @@ namespace rpc
         public:
             using ptr = std::shared_ptr<RpcRouter>;
 
-            RpcRouter()
-                :_service_manager(std::make_shared<ServiceManager>())
+            // thread_num：执行业务回调的工作线程数，为 0（默认）时在IO线程同步执行（不做准入控制）；
+            // 大于 0 时同一个方法的回调会在多个线程中并发执行
+            RpcRouter(size_t thread_num = 0)
+                :_service_manager(std::make_shared<ServiceManager>()),
+                _scheduler(std::make_shared<RpcScheduler>(thread_num))
             {
                 
             }
@@ -217,32 +254,131 @@ namespace rpc
                     return response(conn, request, Json::Value(), RCode::RCODE_NOT_FOUND_SERVICE);
                 }
 
-                // 2.进行参数校验，确定能否提供服务
+                // 参数哈希只算一次，缓存和请求合并共用
+                uint64_t key = 0;
+                if(service->cache() || service->flight())
+                {
+                    key = JSON::hash(request->params());
+                }
+
+                // 2.可缓存的方法先查缓存，命中则直接回复，不排队，也不再执行业务回调和结果序列化
+                if(service->cache())
+                {
+                    auto raw = service->cache()->get(key, request->params());
+                    if(raw)
+                    {
+                        return rawResponse(conn, request, raw);
+                    }
+                }
+
+                // 3.相同参数的请求正在执行，挂到它上面等结果，不再排队
+                if(service->flight() && service->flight()->join(key, conn, request) == false)
+                {
+                    return;
+                }
+
+                // 4.按方法的优先级和并发限制交给调度器排队执行，被准入控制拒绝时直接在IO线程回复过载，不占用工作线程
+                auto task = std::bind(&RpcRouter::process, this, conn, request, service, key);
+                auto reject = std::bind(&RpcRouter::finish, this, conn, request, service, key, RCode::RCODE_OVERLOAD, ResponseCache::RawResult());
+                if(_scheduler->submit(task, reject, service->priority(), service->limit()) == false)
+                {
+                    DLOG("%s 服务过载，拒绝请求！", request->method().c_str());
+                    return finish(conn, request, service, key, RCode::RCODE_OVERLOAD, ResponseCache::RawResult());
+                }
+            }
+
+            void registerMethod(const ServiceDescribe::ptr &service)
+            {
+                return _service_manager->insert(service);
+            }
+
+            // 改为由 thread_num 个工作线程执行业务回调（启用准入控制），在开始处理请求之前调用
+            void setThreads(size_t thread_num)
+            {
+                _scheduler = std::make_shared<RpcScheduler>(thread_num);
+            }
+
+            RpcScheduler::ptr scheduler()
+            {
+                return _scheduler;
+            }
+
+        private:
+            // 在工作线程中执行：参数校验 -> 业务回调 -> 组织响应
+            void process(const BaseConnection::ptr &conn, const RpcRequest::ptr &request, const ServiceDescribe::ptr &service, uint64_t key)
+            {
                 if(service->paramCheck(request->params()) == false)
                 {
                     ELOG("%s 服务参数校验失败！", request->method().c_str());
-                    return response(conn, request, Json::Value(), RCode::RCODE_INVALID_PARAMS);
+                    return finish(conn, request, service, key, RCode::RCODE_INVALID_PARAMS, ResponseCache::RawResult());
                 }
 
-                // 3.调用业务回调接口进行业务处理
                 Json::Value result;
                 bool ret = service->call(request->params(), result);
                 if(ret == false)
                 {
                     ELOG("%s 服务回调处理失败！", request->method().c_str());
-                    return response(conn, request, Json::Value(), RCode::RCODE_INTERNAL_ERROR);
+                    return finish(conn, request, service, key, RCode::RCODE_INTERNAL_ERROR, ResponseCache::RawResult());
+                }
+
+                // 可缓存/可合并的方法：结果只序列化一次，同时用于缓存和所有等待者的响应
+                std::string body;
+                if((service->cache() || service->flight()) && JSON::serialize(result, body))
+                {
+                    auto raw = std::make_shared<const std::string>(std::move(body));
+                    if(service->cache())
+                    {
+                        service->cache()->put(key, request->params(), raw);
+                    }
+                    return finish(conn, request, service, key, RCode::RCODE_OK, raw);
+                }
+
+                if(service->flight())
+                {
+                    for(auto &waiter : service->flight()->finish(key, request->params()))
+                    {
+                        response(waiter.conn, waiter.request, result, RCode::RCODE_OK);
+                    }
                 }
 
-                // 4.处理完得到结果，组织响应，向客户端发送
                 return response(conn, request, result, RCode::RCODE_OK);
             }
 
-            void registerMethod(const ServiceDescribe::ptr &service)
+            // 一次执行结束（成功、失败或过载）：回复本次请求，以及合并到这次执行上的所有请求（各自使用自己的rid）
+            void finish(const BaseConnection::ptr &conn, const RpcRequest::ptr &request, const ServiceDescribe::ptr &service,
+                        uint64_t key, RCode rcode, const ResponseCache::RawResult &raw)
             {
-                return _service_manager->insert(service);
+                std::vector<SingleFlight::Waiter> waiters;
+                if(service->flight())
+                {
+                    waiters = service->flight()->finish(key, request->params());
+                }
+
+                waiters.push_back(SingleFlight::Waiter{conn, request});
+                for(auto &waiter : waiters)
+                {
+                    if(rcode == RCode::RCODE_OK && raw)
+                    {
+                        rawResponse(waiter.conn, waiter.request, raw);
+                    }
+                    else
+                    {
+                        response(waiter.conn, waiter.request, Json::Value(), rcode);
+                    }
+                }
+            }
+
+            // 用序列化好的结果构造成功响应
+            void rawResponse(const BaseConnection::ptr &conn, const RpcRequest::ptr &req, const ResponseCache::RawResult &raw)
+            {
+                auto msg = MessageFactory::create<RawRpcResponse>();
+                msg->setId(req->rid());
+                msg->setMType(rpc::MType::RSP_RPC);
+                msg->setRCode(RCode::RCODE_OK);
+                msg->setRawResult(raw);
+                conn->send(msg);
             }
 
-        private:
             // 统一构造响应再发送
             void response(const BaseConnection::ptr &conn, const RpcRequest::ptr &req, const Json::Value &res, RCode rcode)
             {
@@ -256,6 +392,7 @@ namespace rpc
 
         private:
             ServiceManager::ptr _service_manager;   // 服务注册表
+            RpcScheduler::ptr _scheduler;           // 请求调度与准入控制
         };
     }
 }
\ No newline at end of file
@@ -0,0 +1,429 @@
+/*
+    RPC请求调度：IO线程只负责解析和入队，业务回调交给工作线程执行
+    * 准入控制：参考 CoDel，用"排队时延"而不是"队列长度"来判断是否过载
+    * 过载时新请求在IO线程直接拒绝（RCODE_OVERLOAD），不再进入队列
+    * 排队过久的请求出队时直接丢弃，避免为已经超时的客户端白白做功
+    * 按优先级分队列，加权轮询调度；单个方法可限制最大并发数
+*/
+#pragma once
+#include "../common/detail.hpp"
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+
+namespace rpc
+{
+    namespace server
+    {
+        // 方法的优先级分类，数值越小越优先
+        enum class Priority
+        {
+            CRITICAL = 0, // 关键请求（健康检查、控制面等），要求低延迟
+            NORMAL,       // 普通请求
+            BATCH,        // 批量/低优先级请求，可以被让路
+            PRIORITY_NUM  // 优先级数量，不是有效的优先级
+        };
+
+
+
+        // 准入控制器（非线程安全，由调度器在持锁状态下调用）
+        // 思路：队列在最近一个 interval 内清空过，说明只是突发，允许排队到 interval；
+        //      一直没清空过，说明处于持续过载，最多只允许排队 target，超过的直接拒绝/丢弃
+        class AdmissionController
+        {
+        public:
+            using ptr = std::shared_ptr<AdmissionController>;
+            using Clock = std::chrono::steady_clock;
+
+            AdmissionController(int target_ms = 5, int interval_ms = 100, size_t max_queue = 10000)
+                : _target(std::chrono::milliseconds(target_ms)),
+                  _interval(std::chrono::milliseconds(interval_ms)),
+                  _max_queue(max_queue),
+                  _last_empty(Clock::now())
+            {
+            }
+
+            // 入队前调用：queue_len 当前排队数，head_sojourn 队头请求已等待的时间
+            bool admit(size_t queue_len, Clock::duration head_sojourn, Clock::time_point now)
+            {
+                if (queue_len >= _max_queue)
+                {
+                    return false;
+                }
+
+                // 持续过载且队头已经超过目标时延，新请求排到队尾只会更久，直接拒绝
+                if (overloaded(now) && head_sojourn > _target)
+                {
+                    return false;
+                }
+
+                return true;
+            }
+
+            // 出队时调用：返回 false 表示该请求排队过久，应当丢弃
+            bool onDequeue(Clock::duration sojourn, Clock::time_point now)
+            {
+                Clock::duration limit = overloaded(now) ? _target : _interval;
+                return sojourn <= limit;
+            }
+
+            // 队列被取空时调用，记录最近一次"不拥塞"的时间点
+            void onEmpty(Clock::time_point now)
+            {
+                _last_empty = now;
+            }
+
+            bool overloaded(Clock::time_point now)
+            {
+                return now - _last_empty > _interval;
+            }
+
+        private:
+            Clock::duration _target;       // 过载时允许的最大排队时延
+            Clock::duration _interval;     // 观察窗口，同时也是非过载时允许的最大排队时延
+            size_t _max_queue;             // 队列长度硬上限，防止内存无限增长
+            Clock::time_point _last_empty; // 最近一次队列为空的时间
+        };
+
+
+
+        // 单个方法的并发限制：同一时刻最多有 max 个请求在执行，超出的由调度器暂存
+        // 所有字段由调度器在持锁状态下访问
+        struct ConcurrencyLimit
+        {
+            using ptr = std::shared_ptr<ConcurrencyLimit>;
+
+            size_t max;     // 最大并发数
+            size_t running; // 正在执行的请求数
+
+            ConcurrencyLimit(size_t m)
+                : max(m), running(0)
+            {
+            }
+        };
+
+
+
+        // 请求调度器：固定数量的工作线程 + 按优先级划分、带准入控制的任务队列
+        // 各优先级队列独立做准入控制，低优先级的洪峰不会导致高优先级请求被拒绝；
+        // 出队时按权重轮询（默认 CRITICAL:NORMAL:BATCH = 8:4:1），保证低优先级也不会饿死
+        class RpcScheduler
+        {
+        public:
+            using ptr = std::shared_ptr<RpcScheduler>;
+            using Task = std::function<void()>;
+            using Clock = AdmissionController::Clock;
+
+            // thread_num 为 0（默认）时不启用工作线程，任务直接在调用线程（IO线程）执行，不做准入控制；
+            // 启用工作线程后业务回调会并发执行，需要回调自己保证线程安全
+            RpcScheduler(size_t thread_num = 0)
+                : _stop(false),
+                  _admitted(0),
+                  _rejected(0),
+                  _shed(0)
+            {
+                const int weights[] = {8, 4, 1};
+                for (int i = 0; i < (int)Priority::PRIORITY_NUM; i++)
+                {
+                    _classes[i].admission = std::make_shared<AdmissionController>();
+                    _classes[i].weight = weights[i];
+                    _classes[i].credit = weights[i];
+                }
+
+                for (size_t i = 0; i < thread_num; i++)
+                {
+                    _workers.emplace_back(&RpcScheduler::workerEntry, this);
+                }
+            }
+
+            ~RpcScheduler()
+            {
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _stop = true;
+                }
+
+                _cond.notify_all();
+                for (auto &worker : _workers)
+                {
+                    worker.join();
+                }
+
+                // 还在排队（包括因并发限制暂存）的请求不再执行，回复过载，客户端不必等到超时
+                std::vector<Task> rejects;
+                for (int i = 0; i < (int)Priority::PRIORITY_NUM; i++)
+                {
+                    for (auto &item : _classes[i].queue)
+                    {
+                        rejects.push_back(item.reject);
+                    }
+                    _classes[i].queue.clear();
+                }
+
+                for (auto &parked : _parked)
+                {
+                    for (auto &item : parked.second)
+                    {
+                        rejects.push_back(item.reject);
+                    }
+                }
+                _parked.clear();
+
+                for (auto &reject : rejects)
+                {
+                    if (reject)
+                    {
+                        _shed++;
+                        reject();
+                    }
+                }
+            }
+
+            // 调整某个优先级的调度权重（每一轮最多连续调度的次数）
+            void setWeight(Priority priority, int weight)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _classes[(int)priority].weight = weight > 0 ? weight : 1;
+            }
+
+            // 提交任务：被准入控制拒绝时返回 false，由调用方立即回复过载；
+            // reject 用于任务已入队、但出队时发现排队过久而被丢弃的场景；
+            // limit 不为空时，该任务受所属方法的并发数限制
+            bool submit(const Task &task, const Task &reject,
+                        Priority priority = Priority::NORMAL,
+                        const ConcurrencyLimit::ptr &limit = ConcurrencyLimit::ptr())
+            {
+                if (_workers.empty())
+                {
+                    task();
+                    return true;
+                }
+
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    auto &cls = _classes[(int)priority];
+                    auto now = Clock::now();
+                    if (cls.queue.empty())
+                    {
+                        // 队列空闲本身就说明不拥塞，避免长时间空闲后被误判为过载
+                        cls.admission->onEmpty(now);
+                    }
+
+                    // 被并发限制暂存的请求也计入排队长度，避免单个方法的洪峰无限堆积
+                    size_t queue_len = cls.queue.size();
+                    if (limit)
+                    {
+                        auto it = _parked.find(limit.get());
+                        queue_len += (it == _parked.end() ? 0 : it->second.size());
+                    }
+
+                    Clock::duration head_sojourn = cls.queue.empty() ? Clock::duration::zero() : now - cls.queue.front().enqueue;
+                    if (cls.admission->admit(queue_len, head_sojourn, now) == false)
+                    {
+                        _rejected++;
+                        return false;
+                    }
+
+                    cls.queue.push_back(Item{task, reject, now, priority, limit});
+                    _admitted++;
+                }
+
+                _cond.notify_one();
+                return true;
+            }
+
+            size_t admitted() { return _admitted.load(); } // 成功入队的请求数
+            size_t rejected() { return _rejected.load(); } // 入队时被拒绝的请求数
+            size_t shed() { return _shed.load(); }         // 出队时因排队过久被丢弃的请求数
+
+            // 建议的工作线程数（CPU 核数），需要显式传给构造函数
+            static size_t defaultThreadNum()
+            {
+                size_t num = std::thread::hardware_concurrency();
+                return num == 0 ? 1 : num;
+            }
+
+        private:
+            struct Item
+            {
+                Task task;
+                Task reject;
+                Clock::time_point enqueue;   // 入队时间，用于计算排队时延
+                Priority priority;           // 所属优先级队列
+                ConcurrencyLimit::ptr limit; // 所属方法的并发限制（可为空）
+            };
+
+            // 一个优先级对应的队列及其调度状态
+            struct PriorityClass
+            {
+                std::deque<Item> queue;
+                AdmissionController::ptr admission; // 每个优先级独立的准入控制
+                int weight;                         // 调度权重
+                int credit;                         // 本轮剩余可调度次数
+            };
+
+            // 加权轮询选出下一个要出队的优先级，没有可调度的请求时返回 -1（需持锁调用）
+            int pickClass()
+            {
+                for (int round = 0; round < 2; round++)
+                {
+                    for (int i = 0; i < (int)Priority::PRIORITY_NUM; i++)
+                    {
+                        if (_classes[i].queue.empty() == false && _classes[i].credit > 0)
+                        {
+                            _classes[i].credit--;
+                            return i;
+                        }
+                    }
+
+                    // 有请求的队列都用完了本轮额度，开始新一轮
+                    for (int i = 0; i < (int)Priority::PRIORITY_NUM; i++)
+                    {
+                        _classes[i].credit = _classes[i].weight;
+                    }
+                }
+
+                return -1;
+            }
+
+            bool hasPending()
+            {
+                for (int i = 0; i < (int)Priority::PRIORITY_NUM; i++)
+                {
+                    if (_classes[i].queue.empty() == false)
+                    {
+                        return true;
+                    }
+                }
+
+                return false;
+            }
+
+            void workerEntry()
+            {
+                while (true)
+                {
+                    Item item;
+                    bool expired = false;
+                    {
+                        std::unique_lock<std::mutex> lock(_mutex);
+                        while (true)
+                        {
+                            _cond.wait(lock, [this]() { return _stop || hasPending(); });
+                            if (_stop)
+                            {
+                                return;
+                            }
+
+                            auto &cls = _classes[pickClass()];
+                            item = std::move(cls.queue.front());
+                            cls.queue.pop_front();
+
+                            auto now = Clock::now();
+                            if (cls.queue.empty())
+                            {
+                                cls.admission->onEmpty(now);
+                            }
+
+                            expired = (cls.admission->onDequeue(now - item.enqueue, now) == false);
+                            if (expired || !item.limit || item.limit->running < item.limit->max)
+                            {
+                                break;
+                            }
+
+                            // 该方法的并发已满，暂存起来，等它有请求执行完后再放回队首
+                            _parked[item.limit.get()].push_back(std::move(item));
+                        }
+
+                        if (item.limit)
+                        {
+                            if (expired)
+                            {
+                                // 被丢弃的请求没有占用并发额度，继续放出下一个暂存的请求
+                                unpark(item.limit);
+                            }
+                            else
+                            {
+                                item.limit->running++;
+                            }
+                        }
+                    }
+
+                    // 业务回调和丢弃回复都在锁外执行
+                    if (expired)
+                    {
+                        _shed++;
+                        if (item.reject)
+                        {
+                            item.reject();
+                        }
+                        continue;
+                    }
+
+                    item.task();
+
+                    if (item.limit)
+                    {
+                        release(item.limit);
+                    }
+                }
+            }
+
+            // 一个受并发限制的请求执行完毕：归还并发额度，并放回一个暂存的请求
+            void release(const ConcurrencyLimit::ptr &limit)
+            {
+                bool unparked = false;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    limit->running--;
+                    unparked = unpark(limit);
+                }
+
+                if (unparked)
+                {
+                    _cond.notify_one();
+                }
+            }
+
+            // 并发额度有空余时，把该方法最早暂存的一个请求放回原队列队首（需持锁调用）
+            bool unpark(const ConcurrencyLimit::ptr &limit)
+            {
+                if (limit->running >= limit->max)
+                {
+                    return false;
+                }
+
+                auto it = _parked.find(limit.get());
+                if (it == _parked.end())
+                {
+                    return false;
+                }
+
+                Item item = std::move(it->second.front());
+                it->second.pop_front();
+                if (it->second.empty())
+                {
+                    _parked.erase(it);
+                }
+
+                _classes[(int)item.priority].queue.push_front(std::move(item));
+                return true;
+            }
+
+        private:
+            bool _stop;
+            std::mutex _mutex;
+            std::condition_variable _cond;
+            PriorityClass _classes[(int)Priority::PRIORITY_NUM];               // 各优先级的请求队列
+            std::unordered_map<ConcurrencyLimit *, std::deque<Item>> _parked; // 因方法并发已满而暂存的请求
+            std::vector<std::thread> _workers;                                 // 工作线程
+            std::atomic<size_t> _admitted;
+            std::atomic<size_t> _rejected;
+            std::atomic<size_t> _shed;
+        };
+    }
+}
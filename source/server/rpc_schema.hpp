@@ -0,0 +1,393 @@
+/*
+    RPC参数校验：注册时把参数描述编译成扁平的校验程序，调用时按程序做一次遍历
+    * 字段路径支持嵌套对象（"user.name"）、数组元素类型（"tags[]"、"items[].id"）
+    * 字段可以是必选或可选的
+    * 每一层对象的字段按名称排好序，校验时和对象成员（jsoncpp 内部同样按名称有序）做一次归并，
+      不再对每个字段分别 isMember + operator[] 查找
+*/
+#pragma once
+#include "../common/detail.hpp"
+#include <map>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <algorithm>
+
+namespace rpc
+{
+    namespace server
+    {
+        // 字段类型（用于参数/返回值）
+        enum class VType
+        {
+            BOOL = 0, // bool
+            INTEGRAL, // 整数
+            NUMERIC,  // 数字（小数）
+            STRING,   // string
+            ARRAY,    // 数组
+            OBJECT    // 对象
+        };
+
+
+
+        // 编译好的参数校验程序
+        class ParamsSchema
+        {
+        public:
+            // 一个字段的描述：字段路径 + 类型 + 是否必选
+            struct FieldDescribe
+            {
+                std::string path;
+                VType vtype;
+                bool required;
+
+                FieldDescribe(const std::string &p, VType v, bool r = true)
+                    : path(p), vtype(v), required(r)
+                {
+                }
+            };
+
+            // 编译参数描述，路径冲突（例如同一字段既声明为 STRING 又带有子字段）时返回 false
+            bool compile(const std::vector<FieldDescribe> &descs)
+            {
+                _rules.clear();
+                _nodes.clear();
+                _valid = false;
+
+                std::vector<Draft> drafts(1);
+                drafts[0].vtype = VType::OBJECT;
+                drafts[0].declared = true;
+                for (auto &desc : descs)
+                {
+                    if (addField(drafts, desc) == false)
+                    {
+                        ELOG("参数描述编译失败，字段冲突：%s", desc.path.c_str());
+                        return false;
+                    }
+                }
+
+                flatten(drafts, 0);
+                _valid = true;
+                return true;
+            }
+
+            // 校验参数（顶层必须是对象）
+            bool check(const Json::Value &params) const
+            {
+                if (_valid == false)
+                {
+                    ELOG("参数描述无效，拒绝所有请求！");
+                    return false;
+                }
+
+                return checkRule(0, params);
+            }
+
+            static bool checkType(VType vtype, const Json::Value &val)
+            {
+                switch (vtype)
+                {
+                case VType::BOOL:
+                    return val.isBool();
+                case VType::INTEGRAL:
+                    return val.isIntegral();
+                case VType::NUMERIC:
+                    return val.isNumeric();
+                case VType::STRING:
+                    return val.isString();
+                case VType::ARRAY:
+                    return val.isArray();
+                case VType::OBJECT:
+                    return val.isObject();
+                }
+
+                return false;
+            }
+
+        private:
+            // 编译期的中间结构：一棵按路径展开的树
+            struct Draft
+            {
+                VType vtype = VType::OBJECT;
+                bool declared = false;              // 类型是否被显式声明过（否则是由子路径隐式生成的）
+                bool required = false;
+                bool required_declared = false;     // 必选性是否被显式声明过
+                std::string path;                   // 完整路径，用于错误日志
+                std::map<std::string, int> members; // 对象的子字段，std::map 保证按名称有序
+                int elem = -1;                      // 数组元素
+            };
+
+            // 一条校验规则：值的类型 + 对象的字段表 / 数组元素的规则
+            struct Rule
+            {
+                VType vtype;
+                int node;         // 对象的字段表下标，-1 表示不检查成员
+                int elem;         // 数组元素的规则下标，-1 表示不检查元素
+                std::string path; // 完整路径，用于错误日志
+            };
+
+            struct Field
+            {
+                std::string name;
+                int rule;
+                bool required;
+            };
+
+            // 一个对象的所有字段，按名称升序排列
+            struct Node
+            {
+                std::vector<Field> fields;
+            };
+
+            static bool addField(std::vector<Draft> &drafts, const FieldDescribe &desc)
+            {
+                int cur = 0;
+                size_t pos = 0;
+                while (pos <= desc.path.size())
+                {
+                    size_t dot = desc.path.find('.', pos);
+                    if (dot == std::string::npos)
+                    {
+                        dot = desc.path.size();
+                    }
+
+                    std::string seg = desc.path.substr(pos, dot - pos);
+                    bool last = (dot == desc.path.size());
+                    pos = dot + 1;
+
+                    // 末尾的每一个 "[]" 表示一层数组
+                    size_t dims = 0;
+                    while (seg.size() >= 2 && seg.compare(seg.size() - 2, 2, "[]") == 0)
+                    {
+                        seg.resize(seg.size() - 2);
+                        dims++;
+                    }
+
+                    if (seg.empty() || drafts[cur].vtype != VType::OBJECT)
+                    {
+                        return false;
+                    }
+
+                    // 找到（或创建）对象的子字段
+                    int child;
+                    auto it = drafts[cur].members.find(seg);
+                    if (it == drafts[cur].members.end())
+                    {
+                        child = drafts.size();
+                        drafts.push_back(Draft());
+                        drafts[child].path = drafts[cur].path.empty() ? seg : drafts[cur].path + "." + seg;
+                        drafts[child].vtype = dims > 0 ? VType::ARRAY : VType::OBJECT;
+                        drafts[cur].members[seg] = child;
+                    }
+                    else
+                    {
+                        child = it->second;
+                    }
+
+                    // 显式声明的字段以自己的必选性为准，隐式生成的父字段只要有一个必选的子路径就是必选的
+                    if (last)
+                    {
+                        if (drafts[child].required_declared && drafts[child].required != desc.required)
+                        {
+                            return false;
+                        }
+                        drafts[child].required = desc.required;
+                        drafts[child].required_declared = true;
+                    }
+                    else if (drafts[child].required_declared == false)
+                    {
+                        drafts[child].required = drafts[child].required || desc.required;
+                    }
+
+                    // 逐层进入数组元素
+                    int target = child;
+                    for (size_t i = 0; i < dims; i++)
+                    {
+                        if (setType(drafts[target], VType::ARRAY, false) == false)
+                        {
+                            return false;
+                        }
+
+                        if (drafts[target].elem < 0)
+                        {
+                            int elem = drafts.size();
+                            drafts.push_back(Draft());
+                            drafts[elem].path = drafts[target].path + "[]";
+                            drafts[elem].vtype = (i + 1 < dims) ? VType::ARRAY : VType::OBJECT;
+                            drafts[target].elem = elem;
+                        }
+                        target = drafts[target].elem;
+                    }
+
+                    if (last)
+                    {
+                        return setType(drafts[target], desc.vtype, true) && consistent(drafts[target]);
+                    }
+
+                    if (setType(drafts[target], VType::OBJECT, false) == false)
+                    {
+                        return false;
+                    }
+                    cur = target;
+                }
+
+                return true;
+            }
+
+            // 设置字段类型：隐式类型可以被显式声明覆盖，两个不同的显式声明视为冲突
+            static bool setType(Draft &draft, VType vtype, bool declare)
+            {
+                if (draft.declared)
+                {
+                    return draft.vtype == vtype;
+                }
+
+                if (declare)
+                {
+                    draft.vtype = vtype;
+                    draft.declared = true;
+                }
+                else if (draft.members.empty() && draft.elem < 0)
+                {
+                    draft.vtype = vtype;
+                }
+
+                return draft.vtype == vtype;
+            }
+
+            // 有子字段的必须是对象，有元素描述的必须是数组
+            static bool consistent(const Draft &draft)
+            {
+                if (draft.members.empty() == false && draft.vtype != VType::OBJECT)
+                {
+                    return false;
+                }
+
+                return draft.elem < 0 || draft.vtype == VType::ARRAY;
+            }
+
+            // 把中间树展开成扁平的规则表，返回规则下标
+            int flatten(const std::vector<Draft> &drafts, int idx)
+            {
+                const Draft &draft = drafts[idx];
+                int rule = _rules.size();
+                _rules.push_back(Rule{draft.vtype, -1, -1, draft.path});
+
+                if (draft.members.empty() == false)
+                {
+                    int node = _nodes.size();
+                    _nodes.push_back(Node());
+                    _rules[rule].node = node;
+
+                    for (auto &member : draft.members)
+                    {
+                        int child = flatten(drafts, member.second);
+                        _nodes[node].fields.push_back(Field{member.first, child, drafts[member.second].required});
+                    }
+                }
+
+                if (draft.elem >= 0)
+                {
+                    int elem = flatten(drafts, draft.elem);
+                    _rules[rule].elem = elem;
+                }
+
+                return rule;
+            }
+
+            bool checkRule(int idx, const Json::Value &val) const
+            {
+                const Rule &rule = _rules[idx];
+                if (checkType(rule.vtype, val) == false)
+                {
+                    if (rule.path.empty())
+                    {
+                        ELOG("参数校验失败，参数不是对象！");
+                    }
+                    else
+                    {
+                        ELOG("%s 参数类型校验失败！", rule.path.c_str());
+                    }
+                    return false;
+                }
+
+                if (rule.node >= 0 && checkNode(_nodes[rule.node], val) == false)
+                {
+                    return false;
+                }
+
+                if (rule.elem >= 0)
+                {
+                    for (Json::Value::ArrayIndex i = 0; i < val.size(); i++)
+                    {
+                        if (checkRule(rule.elem, val[i]) == false)
+                        {
+                            return false;
+                        }
+                    }
+                }
+
+                return true;
+            }
+
+            // 对象成员和字段表都按名称有序，归并一遍即可：没有声明的成员忽略，缺少的必选字段报错
+            bool checkNode(const Node &node, const Json::Value &obj) const
+            {
+                auto field = node.fields.begin();
+                for (auto it = obj.begin(); it != obj.end() && field != node.fields.end(); ++it)
+                {
+                    const char *end = nullptr;
+                    const char *name = it.memberName(&end);
+                    int cmp = 0;
+                    while (field != node.fields.end() && (cmp = compare(field->name, name, end - name)) < 0)
+                    {
+                        if (field->required)
+                        {
+                            ELOG("参数校验失败，存在缺失字段：%s", _rules[field->rule].path.c_str());
+                            return false;
+                        }
+                        ++field;
+                    }
+
+                    if (field != node.fields.end() && cmp == 0)
+                    {
+                        if (checkRule(field->rule, *it) == false)
+                        {
+                            return false;
+                        }
+                        ++field;
+                    }
+                }
+
+                for (; field != node.fields.end(); ++field)
+                {
+                    if (field->required)
+                    {
+                        ELOG("参数校验失败，存在缺失字段：%s", _rules[field->rule].path.c_str());
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+
+            // 与 jsoncpp 对象成员相同的排序规则：按字节比较，前缀较短者在前
+            static int compare(const std::string &field, const char *name, size_t len)
+            {
+                size_t n = std::min(field.size(), len);
+                int ret = memcmp(field.data(), name, n);
+                if (ret != 0)
+                {
+                    return ret;
+                }
+
+                return field.size() < len ? -1 : (field.size() > len ? 1 : 0);
+            }
+
+        private:
+            bool _valid = true;       // 空描述（不校验任何字段）也是有效的，只要求顶层是对象
+            std::vector<Rule> _rules{Rule{VType::OBJECT, -1, -1, ""}}; // 下标 0 是顶层参数对象
+            std::vector<Node> _nodes;
+        };
+    }
+}
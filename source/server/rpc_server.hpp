@@ -21,10 +21,16 @@ namespace rpc
         public:
             using ptr = std::shared_ptr<RegistryServer>;
 
-            RegistryServer(int port)
+            // store_dir：持久化目录，非空时把注册信息保存在该目录下，重启后从中恢复
+            RegistryServer(int port, const std::string &store_dir = std::string())
                 : _pd_manager(std::make_shared<PDManager>()),
                   _dispatcher(std::make_shared<rpc::Dispatcher>())
             {
+                if (store_dir.empty() == false && _pd_manager->recover(store_dir) == false)
+                {
+                    ELOG("注册中心持久化开启失败，以空状态启动！");
+                }
+
                 auto service_cb = std::bind(&PDManager::onServiceRequest, _pd_manager.get(), std::placeholders::_1, std::placeholders::_2);
                 _dispatcher->registerHandler<ServiceRequest>(MType::REQ_SERVICE, service_cb);
 
@@ -36,6 +42,12 @@ namespace rpc
                 _server->setCloseCallback(close_cb);
             }
 
+            // 组成注册中心集群：peers 为其他副本的地址，需要在 start 之前调用
+            void setPeers(const std::vector<Address> &peers)
+            {
+                _pd_manager->replicate(peers);
+            }
+
             void start()
             {
                 _server->start();
@@ -64,14 +76,21 @@ namespace rpc
             RpcServer(const Address &access_addr,
                       bool enableRegistry = false,
                       const Address &registry_server_addr = Address())
-                : _enableRegistry(enableRegistry),
+                : RpcServer(access_addr, enableRegistry ? std::vector<Address>(1, registry_server_addr) : std::vector<Address>())
+            {
+            }
+
+            // registry_addrs：注册中心集群的各个副本，为空时不使用注册中心
+            RpcServer(const Address &access_addr, const std::vector<Address> &registry_addrs)
+                : _enableRegistry(registry_addrs.empty() == false),
                   _access_addr(access_addr),
                   _router(std::make_shared<rpc::server::RpcRouter>()),
                   _dispatcher(std::make_shared<rpc::Dispatcher>())
             {
-                if (enableRegistry)
+                if (_enableRegistry)
                 {
-                    _reg_client = std::make_shared<client::RegistryClient>(registry_server_addr.first, registry_server_addr.second);
+                    _reg_client = std::make_shared<client::RegistryClient>(registry_addrs);
+                    _reg_client->enableHeartbeat(1000);
                 }
 
                 auto rpc_cb = std::bind(&RpcRouter::onRpcRequest, _router.get(), std::placeholders::_1, std::placeholders::_2);
@@ -93,6 +112,47 @@ namespace rpc
                 _router->registerMethod(service);
             }
 
+            // 批量注册：先在本地注册所有服务，再一次性向注册中心注册
+            void registerMethods(const std::vector<ServiceDescribe::ptr> &services)
+            {
+                std::vector<std::string> methods;
+                for (auto &service : services)
+                {
+                    _router->registerMethod(service);
+                    methods.push_back(service->method());
+                }
+
+                if (_enableRegistry)
+                {
+                    _reg_client->registryMethods(methods, _access_addr);
+                }
+            }
+
+            // 服务的元数据：权重（weight）、区域（zone）、版本（version）等，注册时一并上报
+            void setMeta(const Json::Value &meta)
+            {
+                if (_enableRegistry)
+                {
+                    _reg_client->setMeta(meta);
+                }
+            }
+
+            // 上报当前负载（0~100），注册中心据此降低该主机被选中的概率
+            void setLoad(int load)
+            {
+                if (_enableRegistry)
+                {
+                    _reg_client->setLoad(load);
+                }
+            }
+
+            // 业务回调交给 thread_num 个工作线程执行并启用过载保护（默认 0，在IO线程中执行），在 start 之前调用；
+            // 开启后回调会并发执行，需要自己保证线程安全，thread_num 可以用 RpcScheduler::defaultThreadNum()
+            void setWorkerThreads(size_t thread_num)
+            {
+                _router->setThreads(thread_num);
+            }
+
             void start()
             {
                 _server->start();
@@ -130,8 +190,70 @@ namespace rpc
                 _server->setCloseCallback(close_cb);
             }
 
+            ~TopicServer()
+            {
+                if (_timer.joinable())
+                {
+                    {
+                        std::unique_lock<std::mutex> lock(_mutex);
+                        _stop = true;
+                    }
+
+                    _cond.notify_all();
+                    _timer.join();
+                }
+            }
+
+            // 慢订阅者的处理：发送缓冲积压超过 high_water 字节后，消息进入该订阅者最多 max_queue 字节的队列，
+            // 队列满了按 policy 丢弃消息或断开连接（默认丢弃最旧的消息，1MB 高水位，8MB 队列），在 start 之前调用
+            void setSlowConsumer(SlowPolicy policy, size_t high_water, size_t max_queue)
+            {
+                _topic_manager->setSlowConsumer(policy, high_water, max_queue);
+            }
+
+            // 创建时没有指定保留条数的主题，默认保留最近 count 条消息供订阅者回放（默认 0，不保留），在 start 之前调用
+            void setRetain(size_t count)
+            {
+                _topic_manager->setRetain(count);
+            }
+
+            // 合并主题最多记住 max_keys 个键的最新值（默认 65536），超过时淘汰最久没有更新的键，在 start 之前调用
+            void setConflateKeys(size_t max_keys)
+            {
+                _topic_manager->setConflateKeys(max_keys);
+            }
+
+            // 开启持久化主题：日志放在 dir 下，并恢复上次的持久化主题；
+            // 后台线程按 config.flush_ms（为 0 时每秒）刷盘并清理过期分段，在 start 之前调用
+            bool persist(const std::string &dir, const TopicLogConfig &config = TopicLogConfig())
+            {
+                if (_topic_manager->persist(dir, config) == false)
+                {
+                    return false;
+                }
+
+                _flush_ms = config.flush_ms > 0 ? config.flush_ms : 1000;
+                return true;
+            }
+
+            // 可靠订阅：每个订阅者最多 window 条未确认的消息，超过 redeliver_ms 没有确认的重发，
+            // 带会话名称的订阅者断开后未确认的消息保留 session_ms（默认 1024 条、1 秒、1 分钟），在 start 之前调用
+            void setReliable(size_t window, int redeliver_ms, int session_ms)
+            {
+                _topic_manager->setReliable(window, redeliver_ms, session_ms);
+            }
+
+            // 网络线程数（默认 0，所有连接都在监听线程中处理）；订阅者达到 fanout 个的主题，
+            // 转发时按订阅者连接所在的网络线程分组，每组交给所在的网络线程发送（默认 256，0 表示不分组），在 start 之前调用
+            void setThreads(int io_threads, size_t fanout = 256)
+            {
+                _server->setThreadNum(io_threads);
+                _topic_manager->setFanout(fanout);
+            }
+
             void start()
             {
+                _timer = std::thread(&TopicServer::timerEntry, this);
                 _server->start();
             }
 
@@ -141,10 +263,43 @@ namespace rpc
                 _topic_manager->onShutdown(conn);
             }
 
+            // 后台定时任务：可靠订阅的超时重发；开启持久化时每 _flush_ms 刷一次盘
+            void timerEntry()
+            {
+                auto last_flush = std::chrono::steady_clock::now();
+                std::unique_lock<std::mutex> lock(_mutex);
+                while (_cond.wait_for(lock, std::chrono::milliseconds(_tick_ms), [this]() { return _stop; }) == false)
+                {
+                    lock.unlock();
+                    _topic_manager->redeliver();
+                    auto now = std::chrono::steady_clock::now();
+                    if (_flush_ms > 0 && now - last_flush >= std::chrono::milliseconds(_flush_ms))
+                    {
+                        _topic_manager->flushLogs();
+                        last_flush = now;
+                    }
+                    lock.lock();
+                }
+
+                // 退出前最后刷一次
+                lock.unlock();
+                if (_flush_ms > 0)
+                {
+                    _topic_manager->flushLogs();
+                }
+            }
+
         private:
             TopicManager::ptr _topic_manager; // 主题管理：创建、删除、订阅等
             Dispatcher::ptr _dispatcher;      // 分发消息
             BaseServer::ptr _server;          // 服务器
+
+            std::mutex _mutex;
+            std::condition_variable _cond;
+            bool _stop = false;
+            int _flush_ms = 0;             // 持久化主题的刷盘间隔，0 表示没有开启持久化
+            const int _tick_ms = 100;      // 定时任务的检查间隔
+            std::thread _timer;            // 执行定时任务的后台线程
         };
     }
 }
\ No newline at end of file
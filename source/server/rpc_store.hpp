@@ -0,0 +1,330 @@
+/*
+    注册中心的持久化：把"方法 → 提供者主机"的上下线变化追加写入日志，定期压缩成快照
+    * 目录下两个文件：registry.snap（快照，全部在线条目）、registry.log（快照之后的变化）
+    * 每条记录：长度(4) | 校验和(4) | 操作类型(1) | 端口(4) | ip长度(2) | ip | 方法名长度(2) | 方法名
+    * 恢复时用 mmap 映射整个文件顺序解析，遇到不完整或校验失败的记录（写到一半时崩溃）就停止，并截掉日志的残缺尾部
+    * 日志条数超过在线条目数（且超过下限）时重写快照：先写临时文件、fsync、rename 替换，再清空日志
+    * 回复请求之前用 fdatasync 把日志落盘（组提交：并发的多个请求由一次 fdatasync 一起落盘），回复过的上下线掉电也不会丢
+    * 文件只在本机使用，数字按主机字节序保存
+    * 除 sync 外本身不加锁，由调用方（ProviderManager）在持锁时调用；sync 不需要持有调用方的锁
+*/
+#pragma once
+#include "../common/detail.hpp"
+#include "../common/message.hpp"
+#include <set>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace rpc
+{
+    namespace server
+    {
+        class RegistryStore
+        {
+        public:
+            using ptr = std::shared_ptr<RegistryStore>;
+            using Entry = std::pair<std::string, Address>; // 方法名 + 提供者主机
+
+            // dir：存放快照和日志的目录（不存在时创建），min_compact：日志至少积累这么多条才压缩
+            RegistryStore(const std::string &dir, size_t min_compact = 4096)
+                : _dir(dir),
+                  _log_fd(-1),
+                  _log_records(0),
+                  _min_compact(min_compact),
+                  _appended(0),
+                  _synced(0)
+            {
+            }
+
+            ~RegistryStore()
+            {
+                if (_log_fd >= 0)
+                {
+                    close(_log_fd);
+                }
+            }
+
+            // 加载快照和日志，恢复出所有在线条目，并打开日志准备追加
+            bool open(std::set<Entry> &state)
+            {
+                if (makeDirs(_dir) == false)
+                {
+                    ELOG("创建注册中心存储目录失败：%s", _dir.c_str());
+                    return false;
+                }
+
+                state.clear();
+                size_t valid = 0;
+                load(snapPath(), state, valid);
+                _log_records = load(logPath(), state, valid);
+
+                _log_fd = ::open(logPath().c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+                if (_log_fd < 0)
+                {
+                    ELOG("打开注册中心日志失败：%s", logPath().c_str());
+                    return false;
+                }
+
+                // 截掉上次崩溃时写了一半的记录，之后的追加才能被正确解析
+                struct stat st;
+                if (fstat(_log_fd, &st) == 0 && (size_t)st.st_size > valid)
+                {
+                    ELOG("注册中心日志尾部不完整，截断 %zu 字节！", (size_t)st.st_size - valid);
+                    if (ftruncate(_log_fd, valid) != 0)
+                    {
+                        ELOG("截断注册中心日志失败！");
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+
+            // 追加一条变化（只记录上线和下线）
+            void append(ServiceOptype optype, const std::string &method, const Address &host)
+            {
+                if (_log_fd < 0)
+                {
+                    return;
+                }
+
+                std::string record;
+                encode(record, optype, method, host);
+                if (write(_log_fd, record.data(), record.size()) != (ssize_t)record.size())
+                {
+                    ELOG("写入注册中心日志失败！");
+                    return;
+                }
+                _log_records++;
+                _appended++;
+            }
+
+            // 把已经追加的日志落盘，返回之后调用之前追加的记录掉电也不会丢；
+            // 多个线程同时调用时，排在后面的线程发现自己的记录已经被前一次 fdatasync 覆盖就直接返回
+            void sync()
+            {
+                uint64_t target = _appended.load();
+                std::unique_lock<std::mutex> lock(_sync_mutex);
+                if (_log_fd < 0 || _synced >= target)
+                {
+                    return;
+                }
+
+                uint64_t upto = _appended.load();
+                if (fdatasync(_log_fd) != 0)
+                {
+                    ELOG("注册中心日志落盘失败！");
+                    return;
+                }
+                _synced = upto;
+            }
+
+            // 日志比在线条目还多时值得压缩
+            bool needCompact(size_t live)
+            {
+                return _log_records >= _min_compact && _log_records > live;
+            }
+
+            // 用当前的全部在线条目重写快照，然后清空日志
+            bool compact(const std::vector<Entry> &live)
+            {
+                std::string data;
+                for (auto &entry : live)
+                {
+                    encode(data, ServiceOptype::SERVICE_ONLINE, entry.first, entry.second);
+                }
+
+                std::string tmp = snapPath() + ".tmp";
+                int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if (fd < 0)
+                {
+                    ELOG("创建注册中心快照失败：%s", tmp.c_str());
+                    return false;
+                }
+
+                bool ok = write(fd, data.data(), data.size()) == (ssize_t)data.size() && fsync(fd) == 0;
+                close(fd);
+                if (ok == false || rename(tmp.c_str(), snapPath().c_str()) != 0)
+                {
+                    ELOG("写入注册中心快照失败！");
+                    return false;
+                }
+
+                // rename 之后的目录项也要落盘，否则掉电后可能还是旧快照，而日志已经被清空
+                int dfd = ::open(_dir.c_str(), O_RDONLY);
+                if (dfd >= 0)
+                {
+                    fsync(dfd);
+                    close(dfd);
+                }
+
+                // 快照已经包含了日志里的全部变化
+                if (_log_fd >= 0 && ftruncate(_log_fd, 0) != 0)
+                {
+                    ELOG("清空注册中心日志失败！");
+                    return false;
+                }
+                _log_records = 0;
+                return true;
+            }
+
+            size_t logRecords() { return _log_records; } // 当前日志中的记录数
+
+        private:
+            std::string snapPath() { return _dir + "/registry.snap"; }
+            std::string logPath() { return _dir + "/registry.log"; }
+
+            // 逐级创建目录（类似 mkdir -p）
+            static bool makeDirs(const std::string &dir)
+            {
+                for (size_t pos = dir.find('/', 1); ; pos = dir.find('/', pos + 1))
+                {
+                    std::string path = dir.substr(0, pos);
+                    if (path.empty() == false && mkdir(path.c_str(), 0755) != 0 && errno != EEXIST)
+                    {
+                        return false;
+                    }
+
+                    if (pos == std::string::npos)
+                    {
+                        return true;
+                    }
+                }
+            }
+
+            static void appendInt(std::string &out, const void *val, size_t len)
+            {
+                out.append((const char *)val, len);
+            }
+
+            static uint32_t checksum(const char *data, size_t len)
+            {
+                uint32_t hash = 2166136261u; // FNV-1a
+                for (size_t i = 0; i < len; i++)
+                {
+                    hash ^= (uint8_t)data[i];
+                    hash *= 16777619u;
+                }
+                return hash;
+            }
+
+            static void encode(std::string &out, ServiceOptype optype, const std::string &method, const Address &host)
+            {
+                std::string payload;
+                uint8_t op = (uint8_t)optype;
+                int32_t port = host.second;
+                uint16_t iplen = host.first.size();
+                uint16_t mlen = method.size();
+                appendInt(payload, &op, sizeof(op));
+                appendInt(payload, &port, sizeof(port));
+                appendInt(payload, &iplen, sizeof(iplen));
+                payload.append(host.first, 0, iplen);
+                appendInt(payload, &mlen, sizeof(mlen));
+                payload.append(method, 0, mlen);
+
+                uint32_t len = payload.size();
+                uint32_t sum = checksum(payload.data(), payload.size());
+                appendInt(out, &len, sizeof(len));
+                appendInt(out, &sum, sizeof(sum));
+                out.append(payload);
+            }
+
+            // 解析一个文件中的所有完整记录并应用到 state 上，返回记录数；valid 为最后一条完整记录的结束位置
+            static size_t load(const std::string &path, std::set<Entry> &state, size_t &valid)
+            {
+                valid = 0;
+                int fd = ::open(path.c_str(), O_RDONLY);
+                if (fd < 0)
+                {
+                    return 0;
+                }
+
+                struct stat st;
+                if (fstat(fd, &st) != 0 || st.st_size == 0)
+                {
+                    close(fd);
+                    return 0;
+                }
+
+                size_t size = st.st_size;
+                void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                close(fd);
+                if (addr == MAP_FAILED)
+                {
+                    ELOG("映射注册中心文件失败：%s", path.c_str());
+                    return 0;
+                }
+
+                const char *data = (const char *)addr;
+                size_t pos = 0, records = 0;
+                while (pos + 8 <= size)
+                {
+                    uint32_t len, sum;
+                    memcpy(&len, data + pos, 4);
+                    memcpy(&sum, data + pos + 4, 4);
+                    if (len < 9 || pos + 8 + len > size || checksum(data + pos + 8, len) != sum)
+                    {
+                        break;
+                    }
+
+                    const char *p = data + pos + 8;
+                    const char *end = p + len;
+                    uint8_t op;
+                    int32_t port;
+                    uint16_t iplen, mlen;
+                    memcpy(&op, p, 1);
+                    memcpy(&port, p + 1, 4);
+                    memcpy(&iplen, p + 5, 2);
+                    p += 7;
+                    if (p + iplen + 2 > end)
+                    {
+                        break;
+                    }
+                    std::string ip(p, iplen);
+                    p += iplen;
+                    memcpy(&mlen, p, 2);
+                    p += 2;
+                    if (p + mlen != end)
+                    {
+                        break;
+                    }
+
+                    Entry entry(std::string(p, mlen), Address(ip, port));
+                    if (op == (uint8_t)ServiceOptype::SERVICE_ONLINE)
+                    {
+                        state.insert(entry);
+                    }
+                    else
+                    {
+                        state.erase(entry);
+                    }
+
+                    pos += 8 + len;
+                    records++;
+                }
+
+                munmap(addr, size);
+                valid = pos;
+                return records;
+            }
+
+        private:
+            std::string _dir;
+            int _log_fd;
+            size_t _log_records; // 日志中的记录数（自上次快照以来）
+            size_t _min_compact; // 压缩的下限，避免条目很少时频繁重写快照
+            std::mutex _sync_mutex;
+            std::atomic<uint64_t> _appended; // 累计追加的记录数
+            uint64_t _synced;                // 已经落盘的记录数（_sync_mutex 保护）
+        };
+    }
+}
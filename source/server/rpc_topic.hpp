@@ -1,25 +1,222 @@
 /*
     处理主题：创建、删除、订阅、取消订阅、发布
+    * 订阅者的发送缓冲积压超过高水位后（慢订阅者），之后的消息先放进该订阅者有上限的队列，
+      积压发完后再按顺序发出；队列满了按策略丢弃或断开连接
+    * 主题名称按 '/' 分层，订阅时可以用 '+'、'#' 通配符订阅一批主题（包括之后才创建的主题），
+      通配符订阅放在订阅树里，发布时的匹配开销只和主题层数有关
+    * 主题可以保留最近若干条组好帧的消息（固定大小的环形缓冲），这类主题的发布消息带主题内连续的序号，
+      订阅时指定从某个序号开始或者最近几条，先回放保留的消息再接收新消息
+    * 开启持久化后可以创建持久化主题：发布消息追加到主题的分段日志（见 rpc_topic_log.hpp），序号就是日志的 offset，
+      消费者按 offset 分批读取（日志中的帧直接发送，不重新编码），追上之后再订阅实时消息
+    * 可靠订阅（至少一次）：推送给该订阅者的帧带它自己连续的投递序号，订阅者按批累计确认，
+      未确认的消息留在有上限的窗口里并定时重发，窗口满了之后的消息按慢订阅者的方式排队；
+      带会话名称的订阅者断开后，未确认的消息留给同名的新连接
+    * 消费组：订阅时指定组名，组内每条消息只发给一个成员，按负载（排队和未确认的消息数）或者按消息的分区键哈希选择
+    * 合并主题（最新值缓存）：按消息的分区键记住每个键最新的一帧，新订阅者订阅时先收到所有键的最新值；
+      订阅者积压时队列中同一个（主题，键）只保留最新的一条，慢订阅者只收到各个键的最新值
+    * 主题按名称、订阅者按连接分片，各分片独立加锁；主题的订阅关系是写时复制的快照，订阅和取消订阅只在替换快照时短暂加锁，
+      不会等正在进行的转发；订阅者多的主题按订阅者连接所在的网络线程分组，每组交给所在的网络线程发送
 */
 #pragma once
 #include "../common/net.hpp"
 #include "../common/message.hpp"
+#include "rpc_trie.hpp"
+#include "rpc_topic_log.hpp"
+#include <algorithm>
 #include <unordered_set>
 #include <vector>
+#include <deque>
+#include <list>
+#include <atomic>
+#include <arpa/inet.h>
 
 
 namespace rpc
 {
     namespace server
     {
+        // 慢订阅者的队列满了之后的处理策略
+        enum class SlowPolicy
+        {
+            DROP_OLDEST = 0, // 丢弃队列中最旧的消息
+            DROP_NEWEST,     // 丢弃新到的消息
+            CONFLATE,        // 同一主题只保留最新的一条（替换队列中该主题的旧消息），没有可替换的再丢弃最旧的
+            DISCONNECT       // 断开订阅者的连接
+        };
+
         // 管理主题
         class TopicManager
         {
         public:
             using ptr = std::shared_ptr<TopicManager>;
+            using Frame = std::shared_ptr<const std::string>; // 组好帧的发布消息，所有订阅者（及其队列）共享
+
+            // shard_num：主题和订阅者各自的分片数
+            TopicManager(size_t shard_num = 16)
+                : _protocol(ProtocolFactory::create()),
+                  _metrics(std::make_shared<Metrics>()),
+                  _policy(SlowPolicy::DROP_OLDEST),
+                  _high_water(1 << 20),
+                  _max_queue(8 << 20),
+                  _retain(0),
+                  _fanout(256),
+                  _conflate_keys(1 << 16),
+                  _ack_window(1024),
+                  _redeliver_ms(1000),
+                  _session_ms(60000),
+                  _topic_shards(shard_num == 0 ? 1 : shard_num),
+                  _subscriber_shards(shard_num == 0 ? 1 : shard_num),
+                  _wildcard_count(0)
+            {
+            }
+
+            // 创建主题时没有指定保留条数的，默认保留最近 count 条消息（0 表示不保留）
+            void setRetain(size_t count)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _retain = count;
+            }
+
+            // 慢订阅者的处理：发送缓冲积压 high_water 字节后开始排队，队列最多 max_queue 字节，满了按 policy 处理
+            // 只影响之后新建的订阅者，需要在开始服务之前调用
+            void setSlowConsumer(SlowPolicy policy, size_t high_water, size_t max_queue)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _policy = policy;
+                _high_water = high_water;
+                _max_queue = max_queue;
+            }
+
+            // 订阅者达到 threshold 个的主题，转发时按订阅者连接所在的网络线程分组，每组交给所在的网络线程发送
+            // （默认 256，0 表示总在发布者的线程中逐个发送），需要在开始服务之前调用
+            void setFanout(size_t threshold)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _fanout = threshold;
+            }
+
+            // 合并主题最多记住 max_keys 个键的最新值（默认 65536），超过时淘汰最久没有更新的键，
+            // 之后的新订阅者不再收到它的当前值；只影响之后创建的主题，需要在开始服务之前调用
+            void setConflateKeys(size_t max_keys)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _conflate_keys = std::max<size_t>(max_keys, 1);
+            }
+
+            size_t congested() { return _metrics->congested.load(); }       // 当前积压中的订阅者数
+            size_t queued() { return _metrics->queued.load(); }             // 进入过订阅者队列的消息数
+            size_t dropped() { return _metrics->dropped.load(); }           // 因队列满被丢弃（或被合并掉）的消息数
+            size_t disconnected() { return _metrics->disconnected.load(); } // 因积压被断开的订阅者数
+            size_t redelivered() { return _metrics->redelivered.load(); }   // 可靠订阅超时重发的消息数
+            size_t conflated() { return _metrics->conflated.load(); }       // 合并主题在订阅者队列中被同一个键的新消息替换掉的消息数
+            size_t evicted() { return _metrics->evicted.load(); }           // 合并主题因键数超过上限被淘汰的键数
+
+            // 可靠订阅：每个订阅者最多 window 条未确认的消息，超过 redeliver_ms 没有确认的重发，
+            // 带会话名称的订阅者断开后未确认的消息保留 session_ms（默认 1024 条、1 秒、1 分钟）
+            void setReliable(size_t window, int redeliver_ms, int session_ms)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _ack_window = std::max<size_t>(window, 1);
+                _redeliver_ms = redeliver_ms;
+                _session_ms = session_ms;
+            }
+
+            // 重发超时未确认的消息，并清理过期的会话（定时调用）
+            void redeliver()
+            {
+                std::vector<Subscriber::ptr> subscribers;
+                auto now = std::chrono::steady_clock::now();
+                {
+                    std::unique_lock<std::mutex> lock(_session_mutex);
+                    subscribers.assign(_reliables.begin(), _reliables.end());
+                    for (auto it = _sessions.begin(); it != _sessions.end();)
+                    {
+                        if (it->second.expire <= now)
+                        {
+                            ILOG("可靠订阅会话 %s 过期，丢弃 %zu 条未确认的消息！", it->first.c_str(), it->second.messages.size());
+                            it = _sessions.erase(it);
+                            continue;
+                        }
+                        ++it;
+                    }
+                }
+
+                for (auto &subscriber : subscribers)
+                {
+                    subscriber->redeliver(now, std::chrono::milliseconds(_redeliver_ms));
+                }
+            }
+
+            // 开启持久化（在开始服务之前调用）：持久化主题的日志放在 dir 下以主题名称命名的子目录中，
+            // 并恢复上次的持久化主题（包括其中的消息）
+            bool persist(const std::string &dir, const TopicLogConfig &config = TopicLogConfig())
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+                {
+                    ELOG("创建主题持久化目录失败：%s", dir.c_str());
+                    return false;
+                }
+
+                DIR *dp = opendir(dir.c_str());
+                if (dp == nullptr)
+                {
+                    ELOG("打开主题持久化目录失败：%s", dir.c_str());
+                    return false;
+                }
+
+                _log_dir = dir;
+                _log_config = config;
+                size_t recovered = 0;
+                struct dirent *ent;
+                while ((ent = readdir(dp)) != nullptr)
+                {
+                    std::string name = ent->d_name;
+                    struct stat st;
+                    if (name[0] == '.' || stat((dir + "/" + name).c_str(), &st) != 0 || S_ISDIR(st.st_mode) == false)
+                    {
+                        continue;
+                    }
+
+                    auto log = std::make_shared<TopicLog>(dir + "/" + name, config);
+                    if (log->open() == false)
+                    {
+                        ELOG("恢复持久化主题失败：%s", name.c_str());
+                        continue;
+                    }
 
-            TopicManager()
+                    std::string topic_name = unescapeName(name);
+                    auto &shard = topicShard(topic_name);
+                    std::unique_lock<std::mutex> shard_lock(shard.mutex);
+                    shard.topics[topic_name] = std::make_shared<Topic>(topic_name, _retain, log);
+                    recovered++;
+                }
+                closedir(dp);
+
+                ILOG("从 %s 恢复了 %zu 个持久化主题！", dir.c_str(), recovered);
+                return true;
+            }
+
+            // 持久化主题的日志刷盘，并按保留策略清理旧分段（开启持久化后定时调用）
+            void flushLogs()
             {
+                std::vector<Topic::ptr> topics;
+                for (auto &shard : _topic_shards)
+                {
+                    std::unique_lock<std::mutex> lock(shard.mutex);
+                    for (auto &it : shard.topics)
+                    {
+                        if (it.second->durable)
+                        {
+                            topics.push_back(it.second);
+                        }
+                    }
+                }
+
+                for (auto &topic : topics)
+                {
+                    topic->flushLog();
+                }
             }
 
             // 处理主题请求
@@ -27,18 +224,32 @@ namespace rpc
             {
                 TopicOptype topic_optype = msg->optype();
                 bool ret = true;
+                RCode rcode = RCode::RCODE_NOT_FOUND_TOPIC; // 失败时的响应码
+
+                if (validNames(msg) == false)
+                {
+                    ELOG("创建、发布的主题名称中不能有通配符层！");
+                    if ((topic_optype == TopicOptype::TOPIC_PUBLISH || topic_optype == TopicOptype::TOPIC_PUBLISH_BATCH) && msg->ack() == false)
+                    {
+                        return;
+                    }
+                    return errorResponse(conn, msg, RCode::RCODE_INVALID_MSG);
+                }
 
                 switch (topic_optype)
                 {
                 case TopicOptype::TOPIC_CREATE:
-                    topicCreate(conn, msg);
+                    if (topicCreate(conn, msg) == false)
+                    {
+                        return errorResponse(conn, msg, RCode::RCODE_INTERNAL_ERROR);
+                    }
                     break;
                 case TopicOptype::TOPIC_REMOVE:
                     ret = topicRemove(conn, msg);
                     break;
                 case TopicOptype::TOPIC_SUBSCRIBE:
                     // 订阅失败（例如主题不存在）需要反馈给上层，不能吞掉返回值
-                    ret = topicSubscribe(conn, msg);
+                    ret = topicSubscribe(conn, msg, rcode);
                     break;
                 case TopicOptype::TOPIC_CANCEL:
                     ret = topicCancel(conn, msg);
@@ -46,13 +257,30 @@ namespace rpc
                 case TopicOptype::TOPIC_PUBLISH:
                     ret = topicPublish(conn, msg);
                     break;
+                case TopicOptype::TOPIC_PUBLISH_BATCH:
+                    ret = topicPublishBatch(conn, msg);
+                    break;
+                case TopicOptype::TOPIC_FETCH:
+                    return topicFetch(conn, msg);
+                case TopicOptype::TOPIC_ACK:
+                    return topicAck(conn, msg);
                 default:
                     return errorResponse(conn, msg, RCode::RCODE_INVALID_OPTYPE);
                 }
 
+                // 发布者不需要响应：只转发消息，失败（主题不存在）也不回复
+                if ((topic_optype == TopicOptype::TOPIC_PUBLISH || topic_optype == TopicOptype::TOPIC_PUBLISH_BATCH) && msg->ack() == false)
+                {
+                    if (!ret)
+                    {
+                        DLOG("不需要响应的发布消息中有主题不存在，消息已丢弃！");
+                    }
+                    return;
+                }
+
                 if (!ret)
                 {
-                    return errorResponse(conn, msg, RCode::RCODE_NOT_FOUND_TOPIC);
+                    return errorResponse(conn, msg, rcode);
                 }
 
                 return topicResponse(conn, msg);
@@ -62,37 +290,99 @@ namespace rpc
             void onShutdown(const BaseConnection::ptr &conn)
             {
                 std::vector<Topic::ptr> topics;
+                std::vector<std::string> filters; // 通配符订阅
+                std::vector<std::string> topic_names;
                 Subscriber::ptr subscriber;
 
                 {
-                    std::unique_lock<std::mutex> lock(_mutex);
-                    auto it = _subscribers.find(conn);
-                    if (it == _subscribers.end())
+                    auto &shard = subscriberShard(conn);
+                    std::unique_lock<std::mutex> lock(shard.mutex);
+                    auto it = shard.subscribers.find(conn);
+                    if (it == shard.subscribers.end())
                     {
                         return;
                     }
 
                     subscriber = it->second;
                     // 先拿订阅列表快照，避免无锁遍历 Subscriber::topics 产生并发竞态
-                    auto topic_names = subscriber->listTopics();
-                    for (auto &topic_name : topic_names)
+                    topic_names = subscriber->listTopics();
+                    shard.subscribers.erase(it);
+                }
+
+                // 订阅者作为消费组成员（组内还有其他成员）的主题：它遗留的这些主题的消息交给组内其他成员
+                std::unordered_map<std::string, std::string> groups; // key：主题名称，val：消费组名称
+                for (auto &topic_name : topic_names)
+                {
+                    auto topic = TopicFilter::isWildcard(topic_name) ? Topic::ptr() : findTopic(topic_name);
+                    std::string group_name = topic ? topic->sharedGroupOf(subscriber) : std::string();
+                    if (group_name.empty() == false)
+                    {
+                        groups[topic_name] = group_name;
+                    }
+                }
+
+                std::unordered_map<std::string, std::vector<Subscriber::Pending>> regroup; // key：主题名称，val：要重新分配的消息
+                {
+                    std::unique_lock<std::mutex> lock(_session_mutex);
+                    _reliables.erase(subscriber);
+
+                    // 关闭之后不会再有新消息进入，消费组也不会再选它；
+                    // 其余的未确认和排队的消息，有会话名称的留给同名的新连接
+                    auto messages = subscriber->close();
+                    std::vector<Subscriber::Pending> rest;
+                    for (auto &item : messages)
                     {
-                        auto topic_it = _topics.find(topic_name);
-                        if (topic_it == _topics.end())
+                        if (groups.count(item.topic) > 0)
                         {
-                            continue;
+                            regroup[item.topic].push_back(item);
+                        }
+                        else
+                        {
+                            rest.push_back(item);
                         }
+                    }
+
+                    if (subscriber->session.empty() == false && rest.empty() == false)
+                    {
+                        Session &session = _sessions[subscriber->session];
+                        session.messages.swap(rest);
+                        session.expire = std::chrono::steady_clock::now() + std::chrono::milliseconds(_session_ms);
+                    }
+                }
 
-                        topics.push_back(topic_it->second);
+                for (auto &topic_name : topic_names)
+                {
+                    if (TopicFilter::isWildcard(topic_name))
+                    {
+                        filters.push_back(topic_name);
+                        continue;
                     }
 
-                    _subscribers.erase(it);
+                    auto topic = findTopic(topic_name);
+                    if (topic)
+                    {
+                        topic->removeSubscriber(subscriber);
+                        auto it = regroup.find(topic_name);
+                        if (it != regroup.end())
+                        {
+                            topic->redispatch(groups[topic_name], it->second);
+                        }
+                    }
                 }
 
-                for (auto &topic : topics)
+                std::unique_lock<std::mutex> lock(_trie_mutex);
+                for (auto &filter : filters)
                 {
-                    topic->removeSubscriber(subscriber);
+                    _wildcards.erase(filter, subscriber);
                 }
+                _wildcard_count = _wildcards.size();
+            }
+
+            // 当前的通配符订阅数
+            size_t wildcards()
+            {
+                std::unique_lock<std::mutex> lock(_trie_mutex);
+                return _wildcards.size();
             }
 
         private:
@@ -116,14 +406,77 @@ namespace rpc
                 conn->send(msg_rsp);
             }
 
-            // 创建主题
-            void topicCreate(const BaseConnection::ptr &conn, const TopicRequest::ptr &msg)
+            // 创建、发布（包括批量发布中的每一条）的主题名称都不能带通配符层，带通配符的只能是订阅的过滤条件
+            bool validNames(const TopicRequest::ptr &msg)
+            {
+                switch (msg->optype())
+                {
+                case TopicOptype::TOPIC_CREATE:
+                case TopicOptype::TOPIC_PUBLISH:
+                    return TopicFilter::validName(msg->topicKey());
+                case TopicOptype::TOPIC_PUBLISH_BATCH:
+                    for (auto &item : msg->batch())
+                    {
+                        if (TopicFilter::validName(item[KEY_TOPIC_KEY].asString()) == false)
+                        {
+                            return false;
+                        }
+                    }
+                    return true;
+                default:
+                    return true;
+                }
+            }
+
+            // 创建主题：已经存在时什么也不做；持久化主题的日志打开失败（或者没有开启持久化）时返回 false
+            bool topicCreate(const BaseConnection::ptr &conn, const TopicRequest::ptr &msg)
             {
-                std::unique_lock<std::mutex> lock(_mutex);
-                // 构造一个主题对象，对其添加映射关系进行管理
                 std::string topic_name = msg->topicKey();
-                auto topic = std::make_shared<Topic>(topic_name);
-                _topics.insert(std::make_pair(topic_name, topic));
+                size_t retain;
+                size_t conflate_keys;
+                std::string log_dir;
+                TopicLogConfig log_config;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    retain = msg->hasRetain() ? std::min(msg->retain(), _max_retain) : _retain;
+                    conflate_keys = _conflate_keys;
+                    log_dir = _log_dir;
+                    log_config = _log_config;
+                }
+
+                // 构造一个主题对象，对其添加映射关系进行管理（持有分片锁，同名主题不会被同时创建两次）
+                auto &shard = topicShard(topic_name);
+                std::unique_lock<std::mutex> lock(shard.mutex);
+                if (shard.topics.count(topic_name) > 0)
+                {
+                    return true;
+                }
+
+                if (msg->durable() && msg->conflate())
+                {
+                    ELOG("主题 %s 不能同时是持久化主题和合并主题！", topic_name.c_str());
+                    return false;
+                }
+
+                TopicLog::ptr log;
+                if (msg->durable())
+                {
+                    if (log_dir.empty())
+                    {
+                        ELOG("没有开启持久化，无法创建持久化主题 %s！", topic_name.c_str());
+                        return false;
+                    }
+
+                    log = std::make_shared<TopicLog>(log_dir + "/" + escapeName(topic_name), log_config);
+                    if (log->open() == false)
+                    {
+                        return false;
+                    }
+                }
+
+                auto topic = std::make_shared<Topic>(topic_name, retain, log, msg->conflate(), conflate_keys, _metrics);
+                shard.topics.insert(std::make_pair(topic_name, topic));
+                return true;
             }
 
             // 删除主题
@@ -131,12 +484,14 @@ namespace rpc
             {
                 std::string topic_name = msg->topicKey();
                 std::unordered_set<Subscriber::ptr> subscribers;
+                Topic::ptr topic;
 
                 {
-                    std::unique_lock<std::mutex> lock(_mutex);
+                    auto &shard = topicShard(topic_name);
+                    std::unique_lock<std::mutex> lock(shard.mutex);
                     // 删除主题之前要先找出会受到影响的订阅者
-                    auto it = _topics.find(topic_name);
-                    if (it == _topics.end())
+                    auto it = shard.topics.find(topic_name);
+                    if (it == shard.topics.end())
                     {
                         // 保持与发布/订阅一致：主题不存在时返回失败
                         return false;
@@ -144,7 +499,8 @@ namespace rpc
 
                     // 先拿订阅者快照，避免无锁读取 Topic::subscribers 产生并发竞态
                     subscribers = it->second->listSubscribers();
-                    _topics.erase(it);
+                    topic = it->second;
+                    shard.topics.erase(it);
                 }
 
                 for (auto &subscriber : subscribers)
@@ -152,176 +508,1447 @@ namespace rpc
                     subscriber->removeTopic(topic_name);
                 }
 
+                // 持久化主题的日志文件一并删除
+                topic->destroyLog();
                 return true;
             }
 
-            // 订阅主题
-            bool topicSubscribe(const BaseConnection::ptr &conn, const TopicRequest::ptr &msg)
+            // 订阅主题：带通配符的过滤条件放进订阅树，不要求主题已经存在；指定了消费组的加入主题的消费组
+            // 持久化主题要回放的消息超过 _max_replay 条时不订阅，rcode 设为 RCODE_REPLAY_TOO_FAR，由客户端先按 offset 拉取
+            bool topicSubscribe(const BaseConnection::ptr &conn, const TopicRequest::ptr &msg, RCode &rcode)
             {
-                Topic::ptr topic;
-                Subscriber::ptr subscriber;
+                std::string key = msg->topicKey();
+                bool wildcard = TopicFilter::isWildcard(key);
+                if (wildcard && TopicFilter::valid(key) == false)
+                {
+                    ELOG("订阅的主题过滤条件 %s 格式错误！", key.c_str());
+                    return false;
+                }
 
+                if (wildcard && msg->group().empty() == false)
                 {
-                    std::unique_lock<std::mutex> lock(_mutex);
-                    auto topic_it = _topics.find(msg->topicKey());
-                    if (topic_it == _topics.end())
+                    ELOG("消费组只能订阅确定的主题，不能使用通配符 %s！", key.c_str());
+                    return false;
+                }
+
+                Topic::ptr topic;
+                if (wildcard == false)
+                {
+                    topic = findTopic(key);
+                    if (!topic)
                     {
                         return false;
                     }
+                }
 
-                    topic = topic_it->second;
-                    auto sub_it = _subscribers.find(conn);
-                    if (sub_it != _subscribers.end())
+                Subscriber::ptr subscriber;
+                {
+                    auto &shard = subscriberShard(conn);
+                    std::unique_lock<std::mutex> lock(shard.mutex);
+                    auto sub_it = shard.subscribers.find(conn);
+                    if (sub_it != shard.subscribers.end())
                     {
                         subscriber = sub_it->second;
                     }
                     else
                     {
-                        subscriber = std::make_shared<Subscriber>(conn);
-                        _subscribers.insert(std::make_pair(conn, subscriber));
+                        subscriber = newSubscriber(conn);
+                        shard.subscribers.insert(std::make_pair(conn, subscriber));
+                    }
+
+                    // 可靠订阅：之后推送给该订阅者的消息都带投递序号；同名会话遗留的消息重新编号后先发出
+                    if (msg->reliable())
+                    {
+                        size_t window;
+                        {
+                            std::unique_lock<std::mutex> config_lock(_mutex);
+                            window = _ack_window;
+                        }
+
+                        std::unique_lock<std::mutex> session_lock(_session_mutex);
+                        subscriber->setReliable(window, msg->session());
+                        _reliables.insert(subscriber);
+                        auto session_it = _sessions.find(msg->session());
+                        if (msg->session().empty() == false && session_it != _sessions.end())
+                        {
+                            subscriber->resume(session_it->second.messages);
+                            _sessions.erase(session_it);
+                        }
+                    }
+
+                    // 通配符订阅在持有连接所在分片的锁时登记，连接同时关闭时 onShutdown 一定能看到并清理
+                    if (wildcard)
+                    {
+                        subscriber->appendTopic(key);
+                        std::unique_lock<std::mutex> trie_lock(_trie_mutex);
+                        _wildcards.insert(key, subscriber);
+                        _wildcard_count = _wildcards.size();
+                        return true;
                     }
                 }
 
-                topic->appendSubscriber(subscriber);
-                subscriber->appendTopic(msg->topicKey());
+                if (msg->group().empty() == false)
+                {
+                    topic->appendMember(msg->group(), msg->balance(), subscriber);
+                }
+                else if (topic->appendSubscriber(subscriber, msg->from(), msg->last(), _max_replay) == false)
+                {
+                    rcode = RCode::RCODE_REPLAY_TOO_FAR;
+                    return false;
+                }
+                subscriber->appendTopic(key);
                 return true;
             }
 
             // 取消订阅主题
             bool topicCancel(const BaseConnection::ptr &conn, const TopicRequest::ptr &msg)
             {
+                std::string key = msg->topicKey();
+                bool wildcard = TopicFilter::isWildcard(key);
                 Topic::ptr topic;
-                Subscriber::ptr subscriber;
-
+                if (wildcard == false)
                 {
-                    std::unique_lock<std::mutex> lock(_mutex);
-                    auto topic_it = _topics.find(msg->topicKey());
-                    if (topic_it == _topics.end())
+                    topic = findTopic(key);
+                    if (!topic)
                     {
                         return false;
                     }
-                    topic = topic_it->second;
+                }
 
-                    auto sub_it = _subscribers.find(conn);
-                    if (sub_it != _subscribers.end())
-                    {
-                        subscriber = sub_it->second;
-                    }
-                    else
-                    {
-                        // 连接不存在订阅者信息时，同样返回失败，避免误报成功
-                        return false;
-                    }
+                // 连接不存在订阅者信息时，同样返回失败，避免误报成功
+                Subscriber::ptr subscriber = findSubscriber(conn);
+                if (!subscriber)
+                {
+                    return false;
+                }
+
+                subscriber->removeTopic(key);
+                if (wildcard)
+                {
+                    std::unique_lock<std::mutex> lock(_trie_mutex);
+                    bool ret = _wildcards.erase(key, subscriber);
+                    _wildcard_count = _wildcards.size();
+                    return ret;
                 }
 
-                subscriber->removeTopic(msg->topicKey());
                 topic->removeSubscriber(subscriber);
                 return true;
             }
 
-            // 发布消息
+            // 发布消息：只组帧一次，同一帧发给所有订阅者
             bool topicPublish(const BaseConnection::ptr &conn, const TopicRequest::ptr &msg)
             {
-                Topic::ptr topic;
-
+                Topic::ptr topic = findTopic(msg->topicKey());
+                if (!topic)
                 {
-                    std::unique_lock<std::mutex> lock(_mutex);
-                    auto topic_it = _topics.find(msg->topicKey());
-                    if (topic_it == _topics.end())
-                    {
-                        return false;
-                    }
-
-                    topic = topic_it->second;
+                    return false;
                 }
 
-                topic->pushMessage(msg);
+                std::vector<Subscriber::ptr> matched;
+                matchWildcards(msg->topicKey(), matched);
+                topic->pushMessage(msg, _protocol, matched, _fanout);
                 return true;
             }
 
-        private:
-            struct Subscriber
+            // 按 offset 读取持久化主题：日志中的消息帧直接发给请求方，之后的响应带下一次读取的 offset
+            void topicFetch(const BaseConnection::ptr &conn, const TopicRequest::ptr &msg)
             {
-                using ptr = std::shared_ptr<Subscriber>;
-                std::mutex _mutex;
-                BaseConnection::ptr conn;               // 存储订阅者连接对象
-                std::unordered_set<std::string> topics; // 订阅者订阅的主题名称
-
-                Subscriber(const BaseConnection::ptr &c)
-                    : conn(c)
+                Topic::ptr topic = findTopic(msg->topicKey());
+                size_t max_bytes = msg->maxBytes() == 0 ? _fetch_bytes : std::min(msg->maxBytes(), _fetch_bytes);
+                uint64_t next = 0;
+                bool more = false;
+                if (!topic || topic->fetch(conn, msg->from(), max_bytes, next, more) == false)
                 {
+                    return errorResponse(conn, msg, RCode::RCODE_NOT_FOUND_TOPIC);
                 }
 
-                // 订阅主题的时候调用，将主题添加到订阅者列表中
-                void appendTopic(const std::string &topic_name)
-                {
-                    std::unique_lock<std::mutex> lock(_mutex);
-                    topics.insert(topic_name);
-                }
+                auto msg_rsp = MessageFactory::create<TopicResponse>();
+                msg_rsp->setId(msg->rid());
+                msg_rsp->setMType(MType::RSP_TOPIC);
+                msg_rsp->setRCode(RCode::RCODE_OK);
+                msg_rsp->setSeq(next);
+                msg_rsp->setMore(more);
+                conn->send(msg_rsp);
+            }
 
-                // 主题被删除或者取消订阅的时候调用，从订阅者的订阅列表中移除主题
-                void removeTopic(const std::string &topic_name)
+            // 订阅者的累计确认：投递序号不大于 seq 的消息都已经处理
+            void topicAck(const BaseConnection::ptr &conn, const TopicRequest::ptr &msg)
+            {
+                Subscriber::ptr subscriber = findSubscriber(conn);
+                if (subscriber)
                 {
-                    std::unique_lock<std::mutex> lock(_mutex);
-                    topics.erase(topic_name);
+                    subscriber->onAck(msg->seq());
                 }
+            }
 
-                // 返回订阅主题快照，供外部安全遍历
-                std::vector<std::string> listTopics()
+            // 批量发布：按顺序拆成单条发布消息转发给各自主题的订阅者（订阅者收到的和单条发布完全一样）
+            // 有主题不存在时返回 false，其余消息照常转发
+            bool topicPublishBatch(const BaseConnection::ptr &conn, const TopicRequest::ptr &msg)
+            {
+                bool ret = true;
+                bool first = true;
+                std::string last_key;
+                Topic::ptr topic;
+                std::vector<Subscriber::ptr> matched;
+                for (auto &item : msg->batch())
                 {
-                    std::unique_lock<std::mutex> lock(_mutex);
-                    return std::vector<std::string>(topics.begin(), topics.end());
+                    // 同一主题的连续消息只查找一次
+                    std::string key = item[KEY_TOPIC_KEY].asString();
+                    if (first || key != last_key)
+                    {
+                        topic = findTopic(key);
+                        last_key = key;
+                        first = false;
+                        matched.clear();
+                        if (topic)
+                        {
+                            matchWildcards(key, matched);
+                        }
+                    }
+
+                    if (!topic)
+                    {
+                        ret = false;
+                        continue;
+                    }
+
+                    auto pub_msg = MessageFactory::create<TopicRequest>();
+                    pub_msg->setId(msg->rid());
+                    pub_msg->setMType(MType::REQ_TOPIC);
+                    pub_msg->setOptype(TopicOptype::TOPIC_PUBLISH);
+                    pub_msg->setTopicKey(key);
+                    pub_msg->setTopicMsg(item[KEY_TOPIC_MSG].asString());
+                    topic->pushMessage(pub_msg, _protocol, matched, _fanout);
                 }
+
+                return ret;
+            }
+
+        private:
+            // 慢订阅者相关的统计，订阅者直接更新
+            struct Metrics
+            {
+                std::atomic<size_t> congested{0};
+                std::atomic<size_t> queued{0};
+                std::atomic<size_t> dropped{0};
+                std::atomic<size_t> disconnected{0};
+                std::atomic<size_t> redelivered{0};
+                std::atomic<size_t> conflated{0};
+                std::atomic<size_t> evicted{0};
             };
 
-            struct Topic
+            struct Subscriber
             {
-                using ptr = std::shared_ptr<Topic>;
+                using ptr = std::shared_ptr<Subscriber>;
                 std::mutex _mutex;
-                std::string topic_name;                          // 主题名字
-                std::unordered_set<Subscriber::ptr> subscribers; // 当前主题的订阅者
+                BaseConnection::ptr conn;               // 存储订阅者连接对象
+                const void *loop;                       // 连接所在的网络线程（创建后不变）
+                std::unordered_set<std::string> topics; // 订阅者订阅的主题名称（包括通配符过滤条件）
 
-                Topic(const std::string &name)
-                    : topic_name(name)
+                // 积压时的待发送队列
+                struct Pending
                 {
-                }
+                    std::string topic;
+                    Frame frame;
+                    std::string slot;             // 合并主题的消息：（主题，键），否则为空
+                };
+                SlowPolicy policy;
+                size_t max_queue;                 // 队列的字节数上限
+                std::shared_ptr<Metrics> metrics;
+                bool congested = false;           // 发送缓冲积压中，新消息进入队列
+                bool closed = false;              // 连接已经关闭（或因积压被断开），不再发送
+                bool disconnecting = false;       // 可靠订阅者因积压正在断开：不再发送，消息继续排队，等 close 取走
+                std::deque<Pending> pending;
+                size_t pending_bytes = 0;
+                size_t dropped = 0;               // 本次积压期间丢弃的消息数
+                std::unordered_map<std::string, Pending *> slots; // 合并主题：（主题，键） -> 队列中该键的消息（deque 两端增删时元素不移动）
 
-                // 添加订阅者：新增订阅的时候进行调用
-                void appendSubscriber(const Subscriber::ptr &subscriber)
+                // 可靠投递：发出的帧带投递序号，确认之前留在窗口里，超时重发
+                struct Unacked
                 {
-                    std::unique_lock<std::mutex> lock(_mutex);
-                    subscribers.insert(subscriber);
-                }
+                    uint64_t seq;
+                    std::string topic;
+                    Frame frame;                                // 带投递序号的帧
+                    std::chrono::steady_clock::time_point sent; // 最近一次发送的时间
+                };
+                bool reliable = false;
+                std::string session;              // 会话名称，为空表示断开后不保留未确认的消息
+                size_t window = 0;                // 未确认消息的条数上限
+                uint64_t next_delivery = 1;       // 下一条消息的投递序号
+                std::deque<Unacked> unacked;
 
-                // 移除订阅者：取消订阅或者订阅者连接断开的时候调用
-                void removeSubscriber(const Subscriber::ptr &subscriber)
+                Subscriber(const BaseConnection::ptr &c, SlowPolicy p, size_t max_q, const std::shared_ptr<Metrics> &m)
+                    : conn(c), loop(c->loop()), policy(p), max_queue(max_q), metrics(m)
                 {
-                    std::unique_lock<std::mutex> lock(_mutex);
-                    subscribers.erase(subscriber);
                 }
 
-                // 发布消息：收到消息发布请求的时候调用
-                void pushMessage(const BaseMessage::ptr &msg)
+                // 发送一条发布消息：没有积压时直接发送，积压时进入队列；
+                // slot 不为空（合并主题）时，队列中已经有同一个（主题，键）的消息就直接替换成这一条
+                void deliver(const std::string &topic_name, const Frame &frame, const std::string &slot = std::string())
                 {
                     std::unique_lock<std::mutex> lock(_mutex);
-                    for (auto &subscriber : subscribers)
+                    if (closed)
                     {
-                        subscriber->conn->send(msg);
+                        return;
+                    }
+
+                    if (reliable)
+                    {
+                        // 可靠投递：窗口满了或者前面还有排队的消息时也要排队，保证按顺序编号
+                        if (disconnecting || congested || pending.empty() == false || unacked.size() >= window)
+                        {
+                            enqueue(topic_name, frame, slot);
+                            return;
+                        }
+                        send(topic_name, frame);
+                        return;
+                    }
+
+                    if (congested == false)
+                    {
+                        conn->sendRaw(*frame);
+                        return;
                     }
+
+                    enqueue(topic_name, frame, slot);
                 }
 
-                // 返回订阅者快照，供外部安全遍历
-                std::unordered_set<Subscriber::ptr> listSubscribers()
+                // 负载：排队和未确认的消息数，发送缓冲积压时再加一（消费组按负载选择成员时使用）；
+                // 已经关闭或者正在断开、不再接收消息的返回 false
+                bool load(size_t &value)
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    value = pending.size() + unacked.size() + (congested ? 1 : 0);
+                    return closed == false && disconnecting == false;
+                }
+
+                // 开启可靠投递（订阅时调用）
+                void setReliable(size_t max_window, const std::string &name)
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    reliable = true;
+                    window = max_window;
+                    if (name.empty() == false)
+                    {
+                        session = name;
+                    }
+                }
+
+                // 累计确认：投递序号不大于 seq 的消息移出窗口，空出来的位置发送排队的消息
+                void onAck(uint64_t seq)
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    while (unacked.empty() == false && unacked.front().seq <= seq)
+                    {
+                        unacked.pop_front();
+                    }
+
+                    if (closed == false && disconnecting == false && congested == false)
+                    {
+                        flushPending();
+                    }
+                }
+
+                // 重发超过 timeout 没有确认的消息；发送缓冲积压时先不重发
+                void redeliver(std::chrono::steady_clock::time_point now, std::chrono::milliseconds timeout)
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    if (closed || disconnecting || congested)
+                    {
+                        return;
+                    }
+
+                    for (auto &item : unacked)
+                    {
+                        if (now - item.sent >= timeout)
+                        {
+                            conn->sendRaw(*item.frame);
+                            item.sent = now;
+                            metrics->redelivered++;
+                        }
+                    }
+                }
+
+                // 接收上一个同名会话遗留的消息：按原来的顺序排在最前面，重新编号发送
+                void resume(std::vector<Pending> &messages)
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    for (auto it = messages.rbegin(); it != messages.rend(); ++it)
+                    {
+                        pending_bytes += it->frame->size();
+                        pending.push_front(*it);
+                    }
+
+                    if (closed == false && disconnecting == false && congested == false)
+                    {
+                        flushPending();
+                    }
+                }
+
+                // 接收消费组里离开的成员遗留的一条消息：排在队列最后，不受队列上限限制（这些消息已经接收过，
+                // 按上限处理会把积压连锁地推给下一个成员），窗口有空位时发出
+                void handover(const Pending &item)
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    if (closed)
+                    {
+                        return;
+                    }
+
+                    pending.push_back(Pending{item.topic, item.frame, std::string()});
+                    pending_bytes += item.frame->size();
+                    if (disconnecting == false && congested == false)
+                    {
+                        flushPending();
+                    }
+                }
+
+                // 发送缓冲达到高水位（网络线程中）
+                void onHighWater()
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    if (closed == false && congested == false)
+                    {
+                        congested = true;
+                        metrics->congested++;
+                    }
+                }
+
+                // 积压发完了（网络线程中）：按顺序发出队列中的消息，之后的消息恢复直接发送
+                void onDrained()
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    if (congested == false)
+                    {
+                        return;
+                    }
+
+                    if (disconnecting == false)
+                    {
+                        flushPending();
+                    }
+                    congested = false;
+                    metrics->congested--;
+                }
+
+                // 连接关闭：清空队列，按顺序返回可靠投递中未确认的和还在排队的消息（转入会话或者交给消费组的其他成员）
+                std::vector<Pending> close()
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    std::vector<Pending> messages;
+                    for (auto &item : unacked)
+                    {
+                        messages.push_back(Pending{item.topic, item.frame, std::string()});
+                    }
+                    messages.insert(messages.end(), pending.begin(), pending.end());
+
+                    closed = true;
+                    pending.clear();
+                    pending_bytes = 0;
+                    slots.clear();
+                    unacked.clear();
+                    if (congested)
+                    {
+                        congested = false;
+                        metrics->congested--;
+                    }
+                    return messages;
+                }
+
+                // 订阅主题的时候调用，将主题添加到订阅者列表中
+                void appendTopic(const std::string &topic_name)
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    topics.insert(topic_name);
+                }
+
+                // 主题被删除或者取消订阅的时候调用，从订阅者的订阅列表中移除主题
+                void removeTopic(const std::string &topic_name)
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    topics.erase(topic_name);
+                }
+
+                // 返回订阅主题快照，供外部安全遍历
+                std::vector<std::string> listTopics()
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    return std::vector<std::string>(topics.begin(), topics.end());
+                }
+
+            private:
+                // 发送一条消息（持有 _mutex）：可靠投递时逐帧换上投递序号放进窗口
+                // （从日志回放时一次是连续的多帧，窗口可能因此超出一些）
+                void send(const std::string &topic_name, const Frame &frame)
+                {
+                    if (reliable == false)
+                    {
+                        conn->sendRaw(*frame);
+                        return;
+                    }
+
+                    auto now = std::chrono::steady_clock::now();
+                    size_t pos = 0;
+                    while (pos < frame->size())
+                    {
+                        uint32_t len;
+                        memcpy(&len, frame->data() + pos, 4);
+                        size_t size = 4 + ntohl(len);
+                        Frame delivery = deliveryFrame(frame->data() + pos, size, next_delivery);
+                        unacked.push_back(Unacked{next_delivery, topic_name, delivery, now});
+                        next_delivery++;
+                        conn->sendRaw(*delivery);
+                        pos += size;
+                    }
+                }
+
+                // 按顺序发出队列中的消息（持有 _mutex）：可靠投递只发到窗口满为止
+                void flushPending()
+                {
+                    while (pending.empty() == false && (reliable == false || unacked.size() < window))
+                    {
+                        send(pending.front().topic, pending.front().frame);
+                        popFront();
+                    }
+
+                    if (pending.empty() && dropped > 0)
+                    {
+                        ILOG("慢订阅者恢复，积压期间丢弃了 %zu 条消息！", dropped);
+                        dropped = 0;
+                    }
+                }
+
+                // 放进队列，超过上限时按策略处理（持有 _mutex）
+                // 可靠投递不丢消息：超过上限时断开连接，窗口和队列里的消息（包括之后到达的）留到 close 时转入会话
+                void enqueue(const std::string &topic_name, const Frame &frame, const std::string &slot)
+                {
+                    if (slot.empty() == false)
+                    {
+                        // 合并主题：同一个键只保留最新的一条，留在旧消息原来的位置
+                        auto it = slots.find(slot);
+                        if (it != slots.end())
+                        {
+                            pending_bytes = pending_bytes - it->second->frame->size() + frame->size();
+                            it->second->frame = frame;
+                            metrics->conflated++;
+                            return;
+                        }
+                    }
+
+                    if (reliable && disconnecting == false && pending_bytes + frame->size() > max_queue)
+                    {
+                        ELOG("可靠订阅者积压超过 %zu 字节，断开连接，未确认和排队的消息转入会话！", max_queue);
+                        disconnecting = true;
+                        metrics->disconnected++;
+                        conn->forceClose();
+                    }
+
+                    // 按主题合并（合并主题已经按键合并过，不能把别的键的消息替换掉）
+                    if (policy == SlowPolicy::CONFLATE && slot.empty() && reliable == false)
+                    {
+                        for (auto &item : pending)
+                        {
+                            if (item.topic == topic_name)
+                            {
+                                pending_bytes = pending_bytes - item.frame->size() + frame->size();
+                                item.frame = frame;
+                                drop(1);
+                                return;
+                            }
+                        }
+                    }
+
+                    if (reliable == false && pending_bytes + frame->size() > max_queue)
+                    {
+                        if (policy == SlowPolicy::DISCONNECT)
+                        {
+                            ELOG("订阅者积压超过 %zu 字节，断开连接！", max_queue);
+                            drop(pending.size() + 1);
+                            closed = true;
+                            pending.clear();
+                            pending_bytes = 0;
+                            slots.clear();
+                            metrics->disconnected++;
+                            conn->forceClose();
+                            return;
+                        }
+
+                        if (policy == SlowPolicy::DROP_NEWEST)
+                        {
+                            drop(1);
+                            return;
+                        }
+
+                        while (pending.empty() == false && pending_bytes + frame->size() > max_queue)
+                        {
+                            popFront();
+                            drop(1);
+                        }
+                    }
+
+                    pending.push_back(Pending{topic_name, frame, slot});
+                    pending_bytes += frame->size();
+                    if (slot.empty() == false)
+                    {
+                        slots[slot] = &pending.back();
+                    }
+                    metrics->queued++;
+                }
+
+                // 移出队首的消息（持有 _mutex）；会话遗留下来的消息也带着 slot，但没有登记，只删除指向它自己的登记
+                void popFront()
+                {
+                    Pending &front = pending.front();
+                    if (front.slot.empty() == false)
+                    {
+                        auto it = slots.find(front.slot);
+                        if (it != slots.end() && it->second == &front)
+                        {
+                            slots.erase(it);
+                        }
+                    }
+                    pending_bytes -= front.frame->size();
+                    pending.pop_front();
+                }
+
+                void drop(size_t count)
+                {
+                    if (dropped == 0)
+                    {
+                        ELOG("订阅者积压的消息超过上限，开始丢弃消息！");
+                    }
+                    dropped += count;
+                    metrics->dropped += count;
+                }
+            };
+
+            struct Topic
+            {
+                using ptr = std::shared_ptr<Topic>;
+                std::mutex _mutex;               // 发布锁：分配序号、写日志和保留消息、按顺序转发（同一主题的发布依次进行）
+                std::string topic_name;          // 主题名字
+                uint64_t next_seq = 1;           // 下一条发布消息的序号（只有保留消息和持久化的主题分配序号）
+
+                // 保留的消息：序号为 seq 的帧放在 retained[seq % 容量]，容量创建后不变（可以无锁判断是否保留），
+                // 创建主题时一次分配好，发布时只替换槽位里的帧（与转发共用同一帧），不再分配内存
+                std::vector<Frame> retained;
+
+                const bool durable;      // 是否是持久化主题（创建后不变，可以无锁判断）
+                TopicLog::ptr log;       // 持久化日志，序号就是日志的 offset；写入失败后置空，之后只转发
+                const size_t replay_chunk = 64 << 10; // 从日志回放时每次发送的字节数
+
+                // 合并主题：latest 中是每个键（消息的分区键，没有时为空）最新的一帧，按更新时间从旧到新排列，新订阅者先收到这些帧；
+                // 最多 max_keys 个键，超过时淘汰最久没有更新的键
+                const bool conflate;
+                const size_t max_keys;
+                std::list<std::pair<std::string, Frame>> latest;
+                std::unordered_map<std::string, std::list<std::pair<std::string, Frame>>::iterator> latest_index;
+                std::shared_ptr<Metrics> metrics;
+
+                // 订阅者数曾经达到分组阈值：之后一直交给各网络线程发送，
+                // 在发布者线程直接发送和交给网络线程之间来回切换会打乱订阅者收到的顺序
+                bool spread = false;
+
+                // 同一个网络线程上的订阅者（按指针排序），没有网络线程的连接都在 loop 为 nullptr 的一组
+                struct Partition
+                {
+                    const void *loop;
+                    std::shared_ptr<const std::vector<Subscriber::ptr>> subscribers;
+                };
+
+                // 消费组：每条消息只发给组内的一个成员
+                struct Group
+                {
+                    std::string name;
+                    GroupBalance balance;                 // 选择成员的方式（由第一个成员决定）
+                    std::vector<Subscriber::ptr> members;
+                    std::shared_ptr<size_t> cursor;       // 按负载选择时，负载相同的成员从这里开始轮流（各个快照共用，持有发布锁时修改）
+                };
+
+                // 订阅关系的快照：发布后不再修改，订阅关系变化时复制一份改好再整体替换（没变的分组和消费组共用），
+                // 转发时拿到快照就不再需要订阅锁
+                struct Members
+                {
+                    std::vector<Partition> partitions;                // 普通订阅者，按网络线程分组
+                    std::vector<std::shared_ptr<const Group>> groups;
+                    size_t count = 0;                                 // 普通订阅者数
+                };
+                std::mutex _member_mutex;                 // 订阅锁：只在读取和替换快照时持有
+                std::shared_ptr<const Members> members;
+
+                Topic(const std::string &name, size_t retain, const TopicLog::ptr &topic_log = TopicLog::ptr(),
+                      bool conflating = false, size_t conflate_keys = 0, const std::shared_ptr<Metrics> &topic_metrics = nullptr)
+                    : topic_name(name),
+                      next_seq(topic_log ? topic_log->endOffset() : 1),
+                      retained(retain),
+                      durable(topic_log != nullptr),
+                      log(topic_log),
+                      conflate(conflating),
+                      max_keys(conflate_keys),
+                      metrics(topic_metrics),
+                      members(std::make_shared<Members>())
+                {
+                }
+
+                // 添加订阅者：新增订阅的时候进行调用，只替换订阅关系的快照，不等待正在进行的转发
+                // from（从该序号开始）或 last（最近几条，from 优先）不为 0 时先回放保留的消息，
+                // 合并主题不回放时先发出每个键的最新值；
+                // 回放时持有发布锁，回放和加入订阅者之间没有新消息，不会遗漏或重复
+                // 持久化主题最多回放 max_replay 条（回放期间持有发布锁），落后更多时返回 false，不订阅
+                bool appendSubscriber(const Subscriber::ptr &subscriber, uint64_t from, size_t last, size_t max_replay)
+                {
+                    if (from == 0 && last == 0 && conflate == false)
+                    {
+                        std::unique_lock<std::mutex> member_lock(_member_mutex);
+                        auto next = std::make_shared<Members>(*members);
+                        leaveGroups(*next, subscriber);
+                        insertSubscriber(*next, subscriber);
+                        members = next;
+                        return true;
+                    }
+
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    if (from == 0 && last > 0)
+                    {
+                        from = next_seq > last ? next_seq - last : 1;
+                    }
+
+                    if (from == 0)
+                    {
+                        for (auto &it : latest)
+                        {
+                            subscriber->deliver(topic_name, it.second, slotOf(it.first));
+                        }
+                    }
+                    else if (log)
+                    {
+                        // 持久化主题从日志回放：日志中的帧按块直接发送
+                        if (from < log->startOffset())
+                        {
+                            ILOG("主题 %s 的回放起点 %llu 已经被清理，从 %llu 开始回放！",
+                                 topic_name.c_str(), (unsigned long long)from, (unsigned long long)log->startOffset());
+                        }
+
+                        uint64_t begin = std::max(from, log->startOffset());
+                        if (log->endOffset() > begin + max_replay)
+                        {
+                            ILOG("主题 %s 要回放 %llu 条消息，超过上限，需要先按 offset 拉取！",
+                                 topic_name.c_str(), (unsigned long long)(log->endOffset() - begin));
+                            return false;
+                        }
+
+                        TopicLog::Slice slice;
+                        while (log->read(from, replay_chunk, slice))
+                        {
+                            subscriber->deliver(topic_name, std::make_shared<const std::string>(slice.data, slice.len));
+                            from = slice.next;
+                        }
+                    }
+                    else if (retained.empty() == false)
+                    {
+                        uint64_t oldest = next_seq > retained.size() ? next_seq - retained.size() : 1;
+                        if (from < oldest)
+                        {
+                            ILOG("主题 %s 的回放起点 %llu 已经不在保留范围内，从 %llu 开始回放！",
+                                 topic_name.c_str(), (unsigned long long)from, (unsigned long long)oldest);
+                            from = oldest;
+                        }
+
+                        for (uint64_t seq = from; seq < next_seq; seq++)
+                        {
+                            subscriber->deliver(topic_name, retained[seq % retained.size()]);
+                        }
+                    }
+
+                    std::unique_lock<std::mutex> member_lock(_member_mutex);
+                    auto next = std::make_shared<Members>(*members);
+                    leaveGroups(*next, subscriber);
+                    insertSubscriber(*next, subscriber);
+                    members = next;
+                    return true;
+                }
+
+                // 加入消费组（同一个订阅者在一个主题上只有一个订阅：普通订阅或者一个消费组，后订阅的替换先订阅的）
+                void appendMember(const std::string &group_name, GroupBalance balance, const Subscriber::ptr &subscriber)
+                {
+                    std::unique_lock<std::mutex> member_lock(_member_mutex);
+                    auto next = std::make_shared<Members>(*members);
+                    eraseSubscriber(*next, subscriber);
+                    leaveGroups(*next, subscriber);
+
+                    auto it = std::find_if(next->groups.begin(), next->groups.end(), [&group_name](const std::shared_ptr<const Group> &group)
+                    {
+                        return group->name == group_name;
+                    });
+                    if (it == next->groups.end())
+                    {
+                        auto group = std::make_shared<Group>();
+                        group->name = group_name;
+                        group->balance = balance;
+                        group->members.push_back(subscriber);
+                        group->cursor = std::make_shared<size_t>(0);
+                        next->groups.push_back(group);
+                    }
+                    else
+                    {
+                        auto group = std::make_shared<Group>(**it);
+                        group->members.push_back(subscriber);
+                        *it = group;
+                    }
+                    members = next;
+                }
+
+                // 订阅者所在的消费组名称：不在消费组中，或者组内没有其他成员时返回空
+                std::string sharedGroupOf(const Subscriber::ptr &subscriber)
+                {
+                    std::unique_lock<std::mutex> member_lock(_member_mutex);
+                    for (auto &group : members->groups)
+                    {
+                        if (group->members.size() > 1 &&
+                            std::find(group->members.begin(), group->members.end(), subscriber) != group->members.end())
+                        {
+                            return group->name;
+                        }
+                    }
+                    return std::string();
+                }
+
+                // 离开消费组的成员没有确认和还在排队的消息，按顺序重新交给组内其他成员（持有发布锁，和新发布的消息依次进行）
+                void redispatch(const std::string &group_name, const std::vector<Subscriber::Pending> &messages)
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    std::shared_ptr<const Members> snapshot;
+                    {
+                        std::unique_lock<std::mutex> member_lock(_member_mutex);
+                        snapshot = members;
+                    }
+
+                    auto it = std::find_if(snapshot->groups.begin(), snapshot->groups.end(), [&group_name](const std::shared_ptr<const Group> &group)
+                    {
+                        return group->name == group_name;
+                    });
+                    if (it == snapshot->groups.end())
+                    {
+                        ELOG("消费组 %s 已经没有成员，丢弃离开的成员遗留的 %zu 条消息！", group_name.c_str(), messages.size());
+                        return;
+                    }
+
+                    for (auto &item : messages)
+                    {
+                        Frame frame = plainFrame(item.frame);
+                        std::string msg_key = (*it)->balance == GroupBalance::KEY_HASH ? msgKeyOf(frame) : std::string();
+                        pick(**it, msg_key)->handover(Subscriber::Pending{topic_name, frame, std::string()});
+                    }
+                }
+
+                // 移除订阅者：取消订阅或者订阅者连接断开的时候调用
+                void removeSubscriber(const Subscriber::ptr &subscriber)
+                {
+                    std::unique_lock<std::mutex> member_lock(_member_mutex);
+                    auto next = std::make_shared<Members>(*members);
+                    eraseSubscriber(*next, subscriber);
+                    leaveGroups(*next, subscriber);
+                    members = next;
+                }
+
+                // 发布消息：收到消息发布请求的时候调用，组帧（只组一次）后发给订阅者，
+                // 保留消息的主题先给消息分配序号，组好的帧放进保留队列；
+                // matched 是通配符命中的订阅者（已去重），同时精确订阅了本主题的不再重复发送；
+                // 订阅者达到 fanout 个后按网络线程分组转发（0 表示不分组）
+                void pushMessage(const TopicRequest::ptr &msg, const BaseProtocol::ptr &protocol, const std::vector<Subscriber::ptr> &matched, size_t fanout)
+                {
+                    if (retained.empty() && durable == false)
+                    {
+                        // 不保留消息的主题无法回放，不需要序号：在锁外组帧，也省掉每条消息多序列化一个字段
+                        Frame frame = std::make_shared<const std::string>(protocol->serialize(msg));
+                        std::unique_lock<std::mutex> lock(_mutex);
+                        return deliver(frame, matched, msg, fanout);
+                    }
+
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    msg->setSeq(next_seq);
+                    Frame frame = std::make_shared<const std::string>(protocol->serialize(msg));
+                    if (log && log->append(*frame) == false)
+                    {
+                        ELOG("主题 %s 的持久化日志写入失败，之后的消息只转发、不再持久化！", topic_name.c_str());
+                        log.reset();
+                    }
+                    if (retained.empty() == false)
+                    {
+                        retained[next_seq % retained.size()] = frame;
+                    }
+                    next_seq++;
+                    deliver(frame, matched, msg, fanout);
+                }
+
+                // 读取持久化日志中从 from 开始的消息直接发给 conn（最多 max_bytes 字节，至少一条），
+                // next 返回下一次读取的 offset，more 表示后面是否还有消息；不是持久化主题时返回 false
+                bool fetch(const BaseConnection::ptr &conn, uint64_t from, size_t max_bytes, uint64_t &next, bool &more)
+                {
+                    TopicLog::Slice slice;
+                    bool ok = false;
+                    {
+                        std::unique_lock<std::mutex> lock(_mutex);
+                        if (!log)
+                        {
+                            return false;
+                        }
+
+                        ok = log->read(from, max_bytes, slice);
+                        next = ok ? slice.next : std::max(std::min(from, next_seq), log->startOffset());
+                        more = next < next_seq;
+                    }
+
+                    // 不持锁发送：slice 持有所在的分段，即使分段这时被保留策略删除，映射也仍然有效
+                    if (ok)
+                    {
+                        conn->sendBytes(slice.data, slice.len);
+                    }
+                    return true;
+                }
+
+                // 日志刷盘并按保留策略清理
+                void flushLog()
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    if (log)
+                    {
+                        log->flush();
+                        log->retain();
+                    }
+                }
+
+                // 删除日志文件（主题被删除时调用）
+                void destroyLog()
                 {
                     std::unique_lock<std::mutex> lock(_mutex);
-                    return subscribers;
+                    if (log)
+                    {
+                        log->destroy();
+                        log.reset();
+                    }
+                }
+
+                // 把一帧发给本主题的订阅者、通配符命中的订阅者和每个消费组选出的一个成员（持有 _mutex）
+                // 按网络线程分组转发时，每组只向所在的网络线程投递一个任务，在该线程中逐个发送（直接写连接，不再为每个连接排队复制一次帧），
+                // 发布者线程很快就能放开发布锁；任务总是排到队列末尾（发布者就在该网络线程中也不立即执行，否则会越过
+                // 其他网络线程上的发布者先投递的任务），同一主题的任务按发布顺序进入各网络线程的队列，订阅者收到的顺序不变
+                void deliver(const Frame &frame, const std::vector<Subscriber::ptr> &matched, const TopicRequest::ptr &msg, size_t fanout)
+                {
+                    std::shared_ptr<const Members> snapshot;
+                    {
+                        std::unique_lock<std::mutex> member_lock(_member_mutex);
+                        snapshot = members;
+                    }
+
+                    if (fanout > 0 && snapshot->count >= fanout)
+                    {
+                        spread = true;
+                    }
+
+                    // 合并主题记下这个键的最新值，订阅者队列按（主题，键）合并
+                    std::string msg_key;
+                    std::string slot;
+                    if (conflate || snapshot->groups.empty() == false)
+                    {
+                        msg_key = msg->msgKey();
+                    }
+                    if (conflate)
+                    {
+                        remember(msg_key, frame);
+                        slot = slotOf(msg_key);
+                    }
+
+                    for (auto &partition : snapshot->partitions)
+                    {
+                        if (spread && partition.loop != nullptr)
+                        {
+                            auto subscribers = partition.subscribers;
+                            std::string name = topic_name;
+                            subscribers->front()->conn->queueInLoop([subscribers, name, frame, slot]()
+                            {
+                                for (auto &subscriber : *subscribers)
+                                {
+                                    subscriber->deliver(name, frame, slot);
+                                }
+                            });
+                            continue;
+                        }
+
+                        for (auto &subscriber : *partition.subscribers)
+                        {
+                            subscriber->deliver(topic_name, frame, slot);
+                        }
+                    }
+
+                    for (auto &subscriber : matched)
+                    {
+                        if (containsSubscriber(*snapshot, subscriber) == false)
+                        {
+                            subscriber->deliver(topic_name, frame, slot);
+                        }
+                    }
+
+                    for (auto &group : snapshot->groups)
+                    {
+                        pick(*group, msg_key)->deliver(topic_name, frame, slot);
+                    }
+                }
+
+                // 返回订阅者（包括消费组成员）快照，供外部安全遍历
+                std::unordered_set<Subscriber::ptr> listSubscribers()
+                {
+                    std::shared_ptr<const Members> snapshot;
+                    {
+                        std::unique_lock<std::mutex> member_lock(_member_mutex);
+                        snapshot = members;
+                    }
+
+                    std::unordered_set<Subscriber::ptr> result;
+                    for (auto &partition : snapshot->partitions)
+                    {
+                        result.insert(partition.subscribers->begin(), partition.subscribers->end());
+                    }
+                    for (auto &group : snapshot->groups)
+                    {
+                        result.insert(group->members.begin(), group->members.end());
+                    }
+                    return result;
+                }
+
+            private:
+                // 记下合并主题一个键的最新值，移到最后（持有 _mutex）；键数超过上限时淘汰最久没有更新的键
+                void remember(const std::string &msg_key, const Frame &frame)
+                {
+                    auto it = latest_index.find(msg_key);
+                    if (it != latest_index.end())
+                    {
+                        it->second->second = frame;
+                        latest.splice(latest.end(), latest, it->second);
+                        return;
+                    }
+
+                    latest.push_back(std::make_pair(msg_key, frame));
+                    latest_index[msg_key] = std::prev(latest.end());
+                    if (max_keys > 0 && latest.size() > max_keys)
+                    {
+                        if (metrics && metrics->evicted++ == 0)
+                        {
+                            ELOG("合并主题 %s 的键超过 %zu 个，开始淘汰最久没有更新的键！", topic_name.c_str(), max_keys);
+                        }
+                        latest_index.erase(latest.front().first);
+                        latest.pop_front();
+                    }
+                }
+
+                // 合并主题中一个键在订阅者队列里的标识：主题名称和键用 '\0' 隔开
+                std::string slotOf(const std::string &msg_key)
+                {
+                    std::string slot = topic_name;
+                    slot += '\0';
+                    slot += msg_key;
+                    return slot;
+                }
+
+                // 把订阅者放进所在网络线程的一组，已经在组里时什么也不做（修改的是还没发布的快照）
+                static void insertSubscriber(Members &next, const Subscriber::ptr &subscriber)
+                {
+                    for (auto &partition : next.partitions)
+                    {
+                        if (partition.loop != subscriber->loop)
+                        {
+                            continue;
+                        }
+
+                        auto &list = *partition.subscribers;
+                        auto pos = std::lower_bound(list.begin(), list.end(), subscriber);
+                        if (pos != list.end() && *pos == subscriber)
+                        {
+                            return;
+                        }
+
+                        // 只复制这一组
+                        auto subscribers = std::make_shared<std::vector<Subscriber::ptr>>();
+                        subscribers->reserve(list.size() + 1);
+                        subscribers->insert(subscribers->end(), list.begin(), pos);
+                        subscribers->push_back(subscriber);
+                        subscribers->insert(subscribers->end(), pos, list.end());
+                        partition.subscribers = subscribers;
+                        next.count++;
+                        return;
+                    }
+
+                    auto subscribers = std::make_shared<std::vector<Subscriber::ptr>>(1, subscriber);
+                    next.partitions.push_back(Partition{subscriber->loop, subscribers});
+                    next.count++;
+                }
+
+                // 从所在网络线程的一组中移除订阅者，组空了一并删除
+                static void eraseSubscriber(Members &next, const Subscriber::ptr &subscriber)
+                {
+                    for (auto it = next.partitions.begin(); it != next.partitions.end(); ++it)
+                    {
+                        if (it->loop != subscriber->loop)
+                        {
+                            continue;
+                        }
+
+                        auto &list = *it->subscribers;
+                        auto pos = std::lower_bound(list.begin(), list.end(), subscriber);
+                        if (pos == list.end() || *pos != subscriber)
+                        {
+                            return;
+                        }
+
+                        next.count--;
+                        if (list.size() == 1)
+                        {
+                            next.partitions.erase(it);
+                            return;
+                        }
+
+                        auto subscribers = std::make_shared<std::vector<Subscriber::ptr>>();
+                        subscribers->reserve(list.size() - 1);
+                        subscribers->insert(subscribers->end(), list.begin(), pos);
+                        subscribers->insert(subscribers->end(), pos + 1, list.end());
+                        it->subscribers = subscribers;
+                        return;
+                    }
+                }
+
+                // 是否是普通订阅者
+                static bool containsSubscriber(const Members &snapshot, const Subscriber::ptr &subscriber)
+                {
+                    for (auto &partition : snapshot.partitions)
+                    {
+                        if (partition.loop == subscriber->loop)
+                        {
+                            return std::binary_search(partition.subscribers->begin(), partition.subscribers->end(), subscriber);
+                        }
+                    }
+                    return false;
                 }
+
+                // 从所有消费组中移除订阅者，没有成员的组一并删除（修改的是还没发布的快照）
+                static void leaveGroups(Members &next, const Subscriber::ptr &subscriber)
+                {
+                    for (auto it = next.groups.begin(); it != next.groups.end();)
+                    {
+                        auto &members = (*it)->members;
+                        if (std::find(members.begin(), members.end(), subscriber) == members.end())
+                        {
+                            ++it;
+                            continue;
+                        }
+
+                        if (members.size() == 1)
+                        {
+                            it = next.groups.erase(it);
+                            continue;
+                        }
+
+                        auto group = std::make_shared<Group>(**it);
+                        group->members.erase(std::remove(group->members.begin(), group->members.end(), subscriber), group->members.end());
+                        *it = group;
+                        ++it;
+                    }
+                }
+
+                // 选出消费组中接收这条消息的成员（持有 _mutex）
+                Subscriber::ptr pick(const Group &group, const std::string &msg_key)
+                {
+                    auto &members = group.members;
+                    if (group.balance == GroupBalance::KEY_HASH && msg_key.empty() == false)
+                    {
+                        // 最高权重哈希：每个成员和键一起算一个分数，取最高的；成员增减时只有落在该成员上的键会换成员
+                        // 已经关闭的成员（连接断开、还没有从组中移除）不参加
+                        size_t key_hash = std::hash<std::string>()(msg_key);
+                        size_t best = members.size();
+                        uint64_t best_score = 0;
+                        for (size_t i = 0; i < members.size(); i++)
+                        {
+                            size_t load;
+                            if (members[i]->load(load) == false)
+                            {
+                                continue;
+                            }
+
+                            uint64_t score = mix(key_hash ^ std::hash<Subscriber *>()(members[i].get()));
+                            if (best == members.size() || score > best_score)
+                            {
+                                best = i;
+                                best_score = score;
+                            }
+                        }
+                        return members[best == members.size() ? 0 : best];
+                    }
+
+                    // 按负载：从 cursor 开始找负载最小的，负载都一样时就是轮流；跳过已经关闭的成员
+                    size_t &cursor = *group.cursor;
+                    size_t best = members.size();
+                    size_t best_load = 0;
+                    for (size_t i = 0; i < members.size(); i++)
+                    {
+                        size_t index = (cursor + i) % members.size();
+                        size_t load;
+                        if (members[index]->load(load) == false)
+                        {
+                            continue;
+                        }
+
+                        if (best == members.size() || load < best_load)
+                        {
+                            best = index;
+                            best_load = load;
+                            if (load == 0)
+                            {
+                                break;
+                            }
+                        }
+                    }
+
+                    // 全部关闭时随便选一个，关闭的订阅者收到消息什么也不做
+                    if (best == members.size())
+                    {
+                        best = cursor % members.size();
+                    }
+                    cursor = best + 1;
+                    return members[best];
+                }
+
+                // 把哈希值打散（splitmix64 的最后一步），避免相近的输入得到相近的分数
+                static uint64_t mix(uint64_t x)
+                {
+                    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+                    return x ^ (x >> 31);
+                }
+            };
+
+            struct TopicShard
+            {
+                std::mutex mutex;
+                std::unordered_map<std::string, Topic::ptr> topics; // key：主题名称，val：主题对象
+            };
+
+            struct SubscriberShard
+            {
+                std::mutex mutex;
+                std::unordered_map<BaseConnection::ptr, Subscriber::ptr> subscribers; // key：连接（客户端），val：订阅者对象
             };
 
+            TopicShard &topicShard(const std::string &key)
+            {
+                return _topic_shards[std::hash<std::string>()(key) % _topic_shards.size()];
+            }
+
+            SubscriberShard &subscriberShard(const BaseConnection::ptr &conn)
+            {
+                return _subscriber_shards[std::hash<BaseConnection::ptr>()(conn) % _subscriber_shards.size()];
+            }
+
+            // 按名称查找主题，不存在时返回空
+            Topic::ptr findTopic(const std::string &key)
+            {
+                auto &shard = topicShard(key);
+                std::unique_lock<std::mutex> lock(shard.mutex);
+                auto topic_it = shard.topics.find(key);
+                if (topic_it == shard.topics.end())
+                {
+                    return Topic::ptr();
+                }
+
+                return topic_it->second;
+            }
+
+            // 查找连接的订阅者，不存在时返回空
+            Subscriber::ptr findSubscriber(const BaseConnection::ptr &conn)
+            {
+                auto &shard = subscriberShard(conn);
+                std::unique_lock<std::mutex> lock(shard.mutex);
+                auto it = shard.subscribers.find(conn);
+                if (it == shard.subscribers.end())
+                {
+                    return Subscriber::ptr();
+                }
+
+                return it->second;
+            }
+
+            // 为连接新建订阅者，并挂上发送缓冲的高水位回调
+            Subscriber::ptr newSubscriber(const BaseConnection::ptr &conn)
+            {
+                Subscriber::ptr subscriber;
+                size_t high_water;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    subscriber = std::make_shared<Subscriber>(conn, _policy, _max_queue, _metrics);
+                    high_water = _high_water;
+                }
+
+                std::weak_ptr<Subscriber> weak = subscriber;
+                conn->setHighWaterMarkCallback(high_water, [weak]()
+                {
+                    auto sub = weak.lock();
+                    if (sub)
+                    {
+                        sub->onHighWater();
+                    }
+                }, [weak]()
+                {
+                    auto sub = weak.lock();
+                    if (sub)
+                    {
+                        sub->onDrained();
+                    }
+                });
+                return subscriber;
+            }
+
+            // 可靠投递的帧：把 [data, data + size) 这一帧的消息 ID 换成 "#投递序号"，正文原样复制，不需要重新序列化
+            static Frame deliveryFrame(const char *data, size_t size, uint64_t seq)
+            {
+                return replaceId(data, size, "#" + std::to_string(seq));
+            }
+
+            // 可靠投递的帧换回普通的消息 ID（重新交给别的订阅者时，对方不一定开启了可靠投递），其他帧原样返回
+            static Frame plainFrame(const Frame &frame)
+            {
+                uint32_t idlen;
+                memcpy(&idlen, frame->data() + 8, 4);
+                if (ntohl(idlen) == 0 || (*frame)[12] != '#')
+                {
+                    return frame;
+                }
+                return replaceId(frame->data(), frame->size(), UUID::uuid());
+            }
+
+            // 一帧发布消息的分区键（只在重新分配消费组的消息时解析）
+            static std::string msgKeyOf(const Frame &frame)
+            {
+                uint32_t idlen;
+                memcpy(&idlen, frame->data() + 8, 4);
+                size_t body = 12 + ntohl(idlen);
+                auto msg = MessageFactory::create<TopicRequest>();
+                if (msg->unserialize(frame->substr(body)) == false)
+                {
+                    return std::string();
+                }
+                return msg->msgKey();
+            }
+
+            // 把一帧的消息 ID 换成 id，正文原样复制
+            static Frame replaceId(const char *data, size_t size, const std::string &id)
+            {
+                uint32_t idlen;
+                memcpy(&idlen, data + 8, 4);
+                size_t body = 12 + ntohl(idlen);
+                uint32_t len = htonl(8 + id.size() + size - body);
+                uint32_t new_idlen = htonl(id.size());
+
+                auto frame = std::make_shared<std::string>();
+                frame->reserve(12 + id.size() + size - body);
+                frame->append((const char *)&len, 4);
+                frame->append(data + 4, 4);
+                frame->append((const char *)&new_idlen, 4);
+                frame->append(id);
+                frame->append(data + body, size - body);
+                return frame;
+            }
+
+            // 主题名称转成目录名：字母、数字和 '-'、'_' 不变，其余字节（包括 '/'、'.'）写成 %XX
+            static std::string escapeName(const std::string &name)
+            {
+                static const char *hex = "0123456789ABCDEF";
+                std::string dir;
+                for (unsigned char c : name)
+                {
+                    if (isalnum(c) || c == '-' || c == '_')
+                    {
+                        dir += (char)c;
+                    }
+                    else
+                    {
+                        dir += '%';
+                        dir += hex[c >> 4];
+                        dir += hex[c & 0xf];
+                    }
+                }
+                return dir;
+            }
+
+            static std::string unescapeName(const std::string &dir)
+            {
+                std::string name;
+                for (size_t i = 0; i < dir.size(); i++)
+                {
+                    if (dir[i] == '%' && i + 2 < dir.size() && isxdigit((unsigned char)dir[i + 1]) && isxdigit((unsigned char)dir[i + 2]))
+                    {
+                        name += (char)std::stoi(dir.substr(i + 1, 2), nullptr, 16);
+                        i += 2;
+                    }
+                    else
+                    {
+                        name += dir[i];
+                    }
+                }
+                return name;
+            }
+
+            // 找出通配符订阅中和主题匹配的订阅者，一个订阅者的多个过滤条件同时命中时只保留一次
+            void matchWildcards(const std::string &key, std::vector<Subscriber::ptr> &matched)
+            {
+                // 没有通配符订阅时不用去拿订阅树的锁
+                if (_wildcard_count.load() == 0)
+                {
+                    return;
+                }
+
+                {
+                    std::unique_lock<std::mutex> lock(_trie_mutex);
+                    _wildcards.match(key, matched);
+                }
+
+                if (matched.size() > 1)
+                {
+                    std::sort(matched.begin(), matched.end());
+                    matched.erase(std::unique(matched.begin(), matched.end()), matched.end());
+                }
+            }
+
         private:
-            std::mutex _mutex;
-            std::unordered_map<std::string, Topic::ptr> _topics;                   // key：主题名称，val：主题对象
-            std::unordered_map<BaseConnection::ptr, Subscriber::ptr> _subscribers; // key：连接（客户端），val：订阅者对象
+            BaseProtocol::ptr _protocol; // 发布消息只组帧一次，同一帧发给所有订阅者
+            std::shared_ptr<Metrics> _metrics;
+            SlowPolicy _policy;          // 慢订阅者队列满了之后的处理策略
+            size_t _high_water;          // 订阅者发送缓冲的高水位（字节）
+            size_t _max_queue;           // 慢订阅者队列的上限（字节）
+            size_t _retain;              // 主题默认保留的消息条数
+            size_t _fanout;              // 订阅者达到这个数的主题按网络线程分组转发，0 表示不分组
+            size_t _conflate_keys;       // 合并主题最多记住的键数
+            const size_t _max_retain = 1 << 16; // 创建请求中指定的保留条数上限
+            const size_t _fetch_bytes = 1 << 20; // 按 offset 读取时一次最多返回的字节数
+            const size_t _max_replay = 1024;     // 订阅持久化主题时最多从日志回放的消息条数，落后更多的先按 offset 拉取
+            std::string _log_dir;                // 持久化主题日志的根目录，为空表示没有开启持久化
+            TopicLogConfig _log_config;
+            size_t _ack_window;          // 可靠订阅未确认消息的条数上限
+            int _redeliver_ms;           // 可靠订阅的重发超时
+            int _session_ms;             // 断开的可靠订阅会话保留多久
+
+            // 断开的可靠订阅会话：未确认和排队的消息，等同名的新连接订阅时接着发送
+            struct Session
+            {
+                std::vector<Subscriber::Pending> messages;
+                std::chrono::steady_clock::time_point expire;
+            };
+            std::mutex _mutex;                               // 保护上面的配置
+            std::vector<TopicShard> _topic_shards;           // 按主题名称分片的主题
+            std::vector<SubscriberShard> _subscriber_shards; // 按连接分片的订阅者
+            std::mutex _session_mutex;                       // 保护 _reliables、_sessions
+            std::unordered_set<Subscriber::ptr> _reliables;  // 开启了可靠投递的订阅者，定时检查重发
+            std::unordered_map<std::string, Session> _sessions; // key：会话名称，val：断开的会话
+            std::mutex _trie_mutex;
+            TopicTrie<Subscriber::ptr> _wildcards;           // 通配符订阅：过滤条件 -> 订阅者
+            std::atomic<size_t> _wildcard_count;             // 通配符订阅数，为 0 时发布不用匹配订阅树
         };
     }
 }
\ No newline at end of file
@@ -0,0 +1,595 @@
+/*
+    主题的持久化日志：发布消息按顺序追加到分段的日志文件，消费者按 offset（即消息序号，从 1 开始）读取
+    * 每个分段两个文件：{起始offset}.log 存放消息帧（与发给订阅者的帧逐字节相同），{起始offset}.idx 是稀疏索引
+    * 分段文件创建时预分配好空间并用 mmap 映射，追加就是一次 memcpy；写满后截到实际长度，换下一个分段
+    * 索引每隔 index_interval 字节记一项：分段内的相对 offset(4) | 文件内位置(4)，按 offset 读取时先二分索引再逐帧跳过
+    * 读取直接返回映射内存中的一段连续帧，发送时不需要重新编码；读出的分段被删除后映射仍然有效，直到最后一个使用者释放
+    * 刷盘：每 flush_messages 条或每 flush_ms 毫秒 msync 一次，都为 0 时交给操作系统，批量刷盘用少量延迟换吞吐
+    * 保留：总大小超过 retention_bytes 或最后一次写入早于 retention_ms 的最旧分段被删除（正在写的分段不删除）
+    * 恢复时最后一个分段从最后一个索引项开始逐帧检查帧头，遇到不完整的帧就截断
+    * 文件只在本机使用，索引中的数字按主机字节序保存（帧本身是网络字节序）
+    * 本身不加锁，由调用方（主题）在持锁时调用
+*/
+#pragma once
+#include "../common/detail.hpp"
+#include "../common/fields.hpp"
+#include <deque>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+namespace rpc
+{
+    namespace server
+    {
+        // 持久化日志的配置
+        struct TopicLogConfig
+        {
+            size_t segment_bytes = 64 << 20; // 每个分段的大小
+            size_t index_interval = 4096;    // 每隔多少字节记一个索引项
+            size_t retention_bytes = 0;      // 保留的总大小上限，0 表示不限
+            int retention_ms = 0;            // 保留的时长，0 表示不限
+            size_t flush_messages = 0;       // 每追加多少条消息刷一次盘，0 表示不按条数
+            int flush_ms = 1000;             // 每隔多少毫秒刷一次盘，0 表示不按时间
+        };
+
+
+
+        class TopicLog
+        {
+        public:
+            using ptr = std::shared_ptr<TopicLog>;
+            using Clock = std::chrono::steady_clock;
+
+            // 日志的一个分段，映射的生命周期跟随对象
+            struct Segment
+            {
+                using ptr = std::shared_ptr<Segment>;
+                uint64_t base = 0;         // 第一条消息的 offset
+                uint64_t count = 0;        // 消息条数
+                char *data = nullptr;      // 日志文件的映射
+                size_t capacity = 0;       // 映射的大小
+                size_t size = 0;           // 已写入的字节数
+                char *index = nullptr;     // 索引文件的映射
+                size_t index_capacity = 0; // 索引最多能放的项数
+                size_t index_entries = 0;  // 已写入的索引项数
+                time_t last_write = 0;     // 最后一次写入的时间（秒），按时长保留时使用
+
+                ~Segment()
+                {
+                    if (data)
+                    {
+                        munmap(data, capacity);
+                    }
+                    if (index)
+                    {
+                        munmap(index, index_capacity * _entry_size);
+                    }
+                }
+
+                // 第 i 个索引项：相对 offset、文件内位置
+                void entry(size_t i, uint32_t &rel, uint32_t &pos) const
+                {
+                    memcpy(&rel, index + i * _entry_size, 4);
+                    memcpy(&pos, index + i * _entry_size + 4, 4);
+                }
+            };
+
+            // 一次读取的结果：[data, data + len) 是 offset 从 first 到 next - 1 的连续帧
+            struct Slice
+            {
+                Segment::ptr segment; // 保证读取期间映射有效
+                const char *data = nullptr;
+                size_t len = 0;
+                uint64_t first = 0;
+                uint64_t next = 0;
+            };
+
+            TopicLog(const std::string &dir, const TopicLogConfig &config)
+                : _dir(dir),
+                  _config(config),
+                  _bytes(0),
+                  _unflushed(0),
+                  _flushed_pos(0),
+                  _last_flush(Clock::now()),
+                  _last_retention(Clock::now())
+            {
+                _config.index_interval = std::max<size_t>(_config.index_interval, 1);
+            }
+
+            // 打开（不存在时创建）日志目录，恢复已有的分段
+            bool open()
+            {
+                if (mkdir(_dir.c_str(), 0755) != 0 && errno != EEXIST)
+                {
+                    ELOG("创建主题日志目录失败：%s", _dir.c_str());
+                    return false;
+                }
+
+                std::vector<uint64_t> bases;
+                DIR *dp = opendir(_dir.c_str());
+                if (dp == nullptr)
+                {
+                    ELOG("打开主题日志目录失败：%s", _dir.c_str());
+                    return false;
+                }
+                struct dirent *ent;
+                while ((ent = readdir(dp)) != nullptr)
+                {
+                    std::string name = ent->d_name;
+                    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".log") == 0)
+                    {
+                        bases.push_back(strtoull(name.c_str(), nullptr, 10));
+                    }
+                }
+                closedir(dp);
+                std::sort(bases.begin(), bases.end());
+
+                for (size_t i = 0; i < bases.size(); i++)
+                {
+                    Segment::ptr seg = (i + 1 == bases.size()) ? openActive(bases[i]) : openSealed(bases[i], bases[i + 1]);
+                    if (!seg)
+                    {
+                        return false;
+                    }
+                    _segments.push_back(seg);
+                    _bytes += seg->size;
+                }
+
+                if (_segments.empty() && roll(1) == false)
+                {
+                    return false;
+                }
+
+                _flushed_pos = _segments.back()->size;
+                return true;
+            }
+
+            uint64_t startOffset() { return _segments.empty() ? 1 : _segments.front()->base; }                          // 最旧一条消息的 offset
+            uint64_t endOffset() { return _segments.empty() ? 1 : _segments.back()->base + _segments.back()->count; } // 下一条消息的 offset
+            size_t bytes() { return _bytes; }                                                                           // 所有分段的总大小
+            size_t segments() { return _segments.size(); }
+
+            // 追加一帧（offset 为追加前的 endOffset），失败后日志不再可用
+            bool append(const std::string &frame)
+            {
+                Segment::ptr seg = _segments.back();
+                if (seg->size + frame.size() > seg->capacity)
+                {
+                    if (frame.size() > _config.segment_bytes || roll(seg->base + seg->count) == false)
+                    {
+                        ELOG("主题日志追加失败：%s", _dir.c_str());
+                        return false;
+                    }
+                    seg = _segments.back();
+                }
+
+                uint32_t last_pos = 0, last_rel = 0;
+                if (seg->index_entries > 0)
+                {
+                    seg->entry(seg->index_entries - 1, last_rel, last_pos);
+                }
+                if ((seg->index_entries == 0 || seg->size - last_pos >= _config.index_interval) && seg->index_entries < seg->index_capacity)
+                {
+                    uint32_t rel = seg->count, pos = seg->size;
+                    memcpy(seg->index + seg->index_entries * _entry_size, &rel, 4);
+                    memcpy(seg->index + seg->index_entries * _entry_size + 4, &pos, 4);
+                    seg->index_entries++;
+                }
+
+                memcpy(seg->data + seg->size, frame.data(), frame.size());
+                seg->size += frame.size();
+                seg->count++;
+                seg->last_write = time(nullptr);
+                _bytes += frame.size();
+                _unflushed++;
+
+                // 按条数或时间批量刷盘，按时长保留最多每秒检查一次
+                if (_config.flush_messages > 0 && _unflushed >= _config.flush_messages)
+                {
+                    flush();
+                }
+                if (_config.flush_ms > 0 || _config.retention_ms > 0)
+                {
+                    auto now = Clock::now();
+                    if (_config.flush_ms > 0 && _unflushed > 0 && now - _last_flush >= std::chrono::milliseconds(_config.flush_ms))
+                    {
+                        flush();
+                    }
+                    if (_config.retention_ms > 0 && now - _last_retention >= std::chrono::seconds(1))
+                    {
+                        _last_retention = now;
+                        retain();
+                    }
+                }
+                return true;
+            }
+
+            // 读取从 offset 开始、总长不超过 max_bytes 的连续帧（至少一帧，不跨分段）
+            // offset 早于最旧的消息时从最旧的开始；没有可读的消息时返回 false
+            bool read(uint64_t offset, size_t max_bytes, Slice &slice)
+            {
+                offset = std::max(offset, startOffset());
+                if (offset >= endOffset())
+                {
+                    return false;
+                }
+
+                // 找到包含 offset 的分段：base 不大于 offset 的最后一个
+                auto it = std::upper_bound(_segments.begin(), _segments.end(), offset,
+                                           [](uint64_t off, const Segment::ptr &seg) { return off < seg->base; });
+                Segment::ptr seg = *(--it);
+                if (offset >= seg->base + seg->count)
+                {
+                    // 空分段（刚换出来还没有写入），消息在下一个分段
+                    return false;
+                }
+
+                // 二分索引找到不大于目标的最后一项，再逐帧跳到目标
+                uint32_t rel = offset - seg->base;
+                size_t lo = 0, hi = seg->index_entries;
+                while (hi - lo > 1)
+                {
+                    size_t mid = (lo + hi) / 2;
+                    uint32_t mid_rel, mid_pos;
+                    seg->entry(mid, mid_rel, mid_pos);
+                    if (mid_rel <= rel)
+                    {
+                        lo = mid;
+                    }
+                    else
+                    {
+                        hi = mid;
+                    }
+                }
+
+                uint32_t cur = 0, pos = 0;
+                if (seg->index_entries > 0)
+                {
+                    seg->entry(lo, cur, pos);
+                }
+                while (cur < rel)
+                {
+                    pos += frameSize(seg->data + pos);
+                    cur++;
+                }
+
+                size_t begin = pos;
+                while (cur < seg->count)
+                {
+                    size_t len = frameSize(seg->data + pos);
+                    if (pos > begin && pos - begin + len > max_bytes)
+                    {
+                        break;
+                    }
+                    pos += len;
+                    cur++;
+                }
+
+                slice.segment = seg;
+                slice.data = seg->data + begin;
+                slice.len = pos - begin;
+                slice.first = offset;
+                slice.next = seg->base + cur;
+                return true;
+            }
+
+            // 把尚未落盘的数据刷到磁盘
+            void flush()
+            {
+                _last_flush = Clock::now();
+                if (_unflushed == 0 || _segments.empty())
+                {
+                    return;
+                }
+
+                Segment::ptr seg = _segments.back();
+                size_t page = sysconf(_SC_PAGESIZE);
+                size_t begin = _flushed_pos / page * page;
+                if (seg->size > begin && msync(seg->data + begin, seg->size - begin, MS_SYNC) != 0)
+                {
+                    ELOG("主题日志刷盘失败：%s", _dir.c_str());
+                }
+                msync(seg->index, seg->index_capacity * _entry_size, MS_SYNC);
+                _flushed_pos = seg->size;
+                _unflushed = 0;
+            }
+
+            // 按保留策略删除最旧的分段
+            void retain()
+            {
+                time_t now = time(nullptr);
+                while (_segments.size() > 1)
+                {
+                    Segment::ptr seg = _segments.front();
+                    bool too_big = _config.retention_bytes > 0 && _bytes > _config.retention_bytes;
+                    bool too_old = _config.retention_ms > 0 && (now - seg->last_write) * 1000 > _config.retention_ms;
+                    if (too_big == false && too_old == false)
+                    {
+                        break;
+                    }
+
+                    unlink(logPath(seg->base).c_str());
+                    unlink(indexPath(seg->base).c_str());
+                    _bytes -= seg->size;
+                    _segments.pop_front();
+                    DLOG("主题日志 %s 删除了起始 offset 为 %llu 的分段", _dir.c_str(), (unsigned long long)seg->base);
+                }
+            }
+
+            // 删除整个日志（主题被删除时调用）
+            void destroy()
+            {
+                for (auto &seg : _segments)
+                {
+                    unlink(logPath(seg->base).c_str());
+                    unlink(indexPath(seg->base).c_str());
+                }
+                _segments.clear();
+                _bytes = 0;
+                rmdir(_dir.c_str());
+            }
+
+        private:
+            std::string segmentName(uint64_t base)
+            {
+                char name[32];
+                snprintf(name, sizeof(name), "%020llu", (unsigned long long)base);
+                return _dir + "/" + name;
+            }
+            std::string logPath(uint64_t base) { return segmentName(base) + ".log"; }
+            std::string indexPath(uint64_t base) { return segmentName(base) + ".idx"; }
+
+            // 帧的总长度：4 字节的长度字段（网络字节序）加上它的值
+            static size_t frameSize(const char *p)
+            {
+                int32_t len;
+                memcpy(&len, p, 4);
+                return 4 + ntohl(len);
+            }
+
+            // 检查 [p, p + avail) 开头是不是一个完整的主题发布帧，是则返回帧长，否则返回 0
+            static size_t validFrame(const char *p, size_t avail)
+            {
+                if (avail < 12)
+                {
+                    return 0;
+                }
+
+                int32_t len, mtype, idlen;
+                memcpy(&len, p, 4);
+                memcpy(&mtype, p + 4, 4);
+                memcpy(&idlen, p + 8, 4);
+                len = ntohl(len);
+                mtype = ntohl(mtype);
+                idlen = ntohl(idlen);
+                if (len < 8 || (size_t)len + 4 > avail || mtype != (int32_t)MType::REQ_TOPIC || idlen < 0 || idlen > len - 8)
+                {
+                    return 0;
+                }
+                return len + 4;
+            }
+
+            // 映射一个文件的前 size 字节，writable 时可写
+            static char *mapFile(const std::string &path, size_t size, bool writable)
+            {
+                int fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+                if (fd < 0)
+                {
+                    return nullptr;
+                }
+                void *addr = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+                close(fd);
+                return addr == MAP_FAILED ? nullptr : (char *)addr;
+            }
+
+            // 把文件的长度设置为 size：先截到 keep 字节（之后的旧内容清零），再预分配到 size，避免写映射时磁盘满导致 SIGBUS
+            static bool resizeFile(const std::string &path, size_t keep, size_t size)
+            {
+                int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+                if (fd < 0)
+                {
+                    return false;
+                }
+
+                bool ok = ftruncate(fd, keep) == 0;
+                if (ok && size > keep)
+                {
+                    int ret = posix_fallocate(fd, 0, size);
+                    ok = (ret == 0) || ((ret == EOPNOTSUPP || ret == EINVAL) && ftruncate(fd, size) == 0);
+                }
+                close(fd);
+                return ok;
+            }
+
+            static size_t fileSize(const std::string &path, time_t *mtime = nullptr)
+            {
+                struct stat st;
+                if (stat(path.c_str(), &st) != 0)
+                {
+                    return 0;
+                }
+                if (mtime)
+                {
+                    *mtime = st.st_mtime;
+                }
+                return st.st_size;
+            }
+
+            size_t indexCapacity()
+            {
+                return _config.segment_bytes / _config.index_interval + 2;
+            }
+
+            // 封存当前分段，开始一个从 base 开始的新分段
+            bool roll(uint64_t base)
+            {
+                if (_segments.empty() == false)
+                {
+                    Segment::ptr last = _segments.back();
+                    flush();
+                    // 截到实际长度（映射仍按原大小保留，之后不会访问超出部分）
+                    if (truncate(logPath(last->base).c_str(), last->size) != 0 ||
+                        truncate(indexPath(last->base).c_str(), last->index_entries * _entry_size) != 0)
+                    {
+                        ELOG("封存主题日志分段失败：%s", _dir.c_str());
+                    }
+                    if (last->count == 0)
+                    {
+                        // 上一个分段一条消息都没有（例如帧比分段还大），直接删掉
+                        unlink(logPath(last->base).c_str());
+                        unlink(indexPath(last->base).c_str());
+                        _segments.pop_back();
+                    }
+                }
+
+                auto seg = std::make_shared<Segment>();
+                seg->base = base;
+                seg->capacity = _config.segment_bytes;
+                seg->index_capacity = indexCapacity();
+                seg->last_write = time(nullptr);
+                if (resizeFile(logPath(base), 0, seg->capacity) == false ||
+                    resizeFile(indexPath(base), 0, seg->index_capacity * _entry_size) == false ||
+                    (seg->data = mapFile(logPath(base), seg->capacity, true)) == nullptr ||
+                    (seg->index = mapFile(indexPath(base), seg->index_capacity * _entry_size, true)) == nullptr)
+                {
+                    ELOG("创建主题日志分段失败：%s", logPath(base).c_str());
+                    return false;
+                }
+
+                // 新文件的目录项也要落盘，否则掉电后可能找不到这个分段
+                int dfd = ::open(_dir.c_str(), O_RDONLY);
+                if (dfd >= 0)
+                {
+                    fsync(dfd);
+                    close(dfd);
+                }
+
+                _segments.push_back(seg);
+                _flushed_pos = 0;
+                _unflushed = 0;
+                retain();
+                return true;
+            }
+
+            // 打开已经封存的分段（只读），消息条数由下一个分段的起始 offset 得出
+            Segment::ptr openSealed(uint64_t base, uint64_t next_base)
+            {
+                auto seg = std::make_shared<Segment>();
+                seg->base = base;
+                seg->count = next_base - base;
+                seg->size = fileSize(logPath(base), &seg->last_write);
+                seg->capacity = seg->size;
+                seg->index_capacity = fileSize(indexPath(base)) / _entry_size;
+                seg->index_entries = seg->index_capacity;
+                if (seg->size == 0 || seg->index_capacity == 0 ||
+                    (seg->data = mapFile(logPath(base), seg->capacity, false)) == nullptr ||
+                    (seg->index = mapFile(indexPath(base), seg->index_capacity * _entry_size, false)) == nullptr)
+                {
+                    ELOG("打开主题日志分段失败：%s", logPath(base).c_str());
+                    return Segment::ptr();
+                }
+                return seg;
+            }
+
+            // 打开最后一个分段继续写：找出有效的索引项和帧，截掉不完整的尾部
+            Segment::ptr openActive(uint64_t base)
+            {
+                auto seg = std::make_shared<Segment>();
+                seg->base = base;
+                size_t file_size = fileSize(logPath(base), &seg->last_write);
+                size_t index_size = fileSize(indexPath(base));
+                seg->capacity = std::max(file_size, _config.segment_bytes);
+                seg->index_capacity = std::max(index_size / _entry_size, indexCapacity());
+
+                // 先只读映射找出有效的范围
+                char *data = file_size > 0 ? mapFile(logPath(base), file_size, false) : nullptr;
+                char *index = index_size >= _entry_size ? mapFile(indexPath(base), index_size, false) : nullptr;
+                uint32_t rel = 0, pos = 0;
+                size_t entries = 0;
+                for (size_t i = 0; index && i < index_size / _entry_size; i++)
+                {
+                    uint32_t r, p;
+                    memcpy(&r, index + i * _entry_size, 4);
+                    memcpy(&p, index + i * _entry_size + 4, 4);
+                    bool ordered = (i == 0) ? (r == 0 && p == 0) : (r > rel && p > pos);
+                    if (ordered == false || data == nullptr || validFrame(data + p, file_size - std::min<size_t>(p, file_size)) == 0)
+                    {
+                        break;
+                    }
+                    rel = r;
+                    pos = p;
+                    entries++;
+                }
+
+                uint64_t count = 0;
+                size_t size = 0;
+                bool torn = false; // 有效数据之后不是预分配的零，说明上次写到一半
+                if (entries > 0)
+                {
+                    count = rel;
+                    size = pos;
+                    size_t len;
+                    while ((len = validFrame(data + size, file_size - size)) > 0)
+                    {
+                        size += len;
+                        count++;
+                    }
+
+                    int32_t next = 0;
+                    if (size + 4 <= file_size)
+                    {
+                        memcpy(&next, data + size, 4);
+                    }
+                    torn = next != 0;
+                }
+                if (data)
+                {
+                    munmap(data, file_size);
+                }
+                if (index)
+                {
+                    munmap(index, index_size);
+                }
+
+                if (torn)
+                {
+                    ILOG("主题日志 %s 的最后一个分段尾部有不完整的消息，已从 %zu 字节处截断！", logPath(base).c_str(), size);
+                }
+
+                seg->count = count;
+                seg->size = size;
+                seg->index_entries = entries;
+                if (resizeFile(logPath(base), size, seg->capacity) == false ||
+                    resizeFile(indexPath(base), entries * _entry_size, seg->index_capacity * _entry_size) == false ||
+                    (seg->data = mapFile(logPath(base), seg->capacity, true)) == nullptr ||
+                    (seg->index = mapFile(indexPath(base), seg->index_capacity * _entry_size, true)) == nullptr)
+                {
+                    ELOG("打开主题日志分段失败：%s", logPath(base).c_str());
+                    return Segment::ptr();
+                }
+                return seg;
+            }
+
+        private:
+            static const size_t _entry_size = 8; // 索引项的大小
+
+            std::string _dir;
+            TopicLogConfig _config;
+            std::deque<Segment::ptr> _segments; // 按起始 offset 排列，最后一个是正在写的分段
+            size_t _bytes;                      // 所有分段的总大小
+            size_t _unflushed;                  // 上次刷盘之后追加的条数
+            size_t _flushed_pos;                // 当前分段已经刷盘的位置
+            Clock::time_point _last_flush;
+            Clock::time_point _last_retention;
+        };
+    }
+}
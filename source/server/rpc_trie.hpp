@@ -0,0 +1,170 @@
+/*
+    主题订阅树：按层级（'/' 分隔）组织带通配符的订阅过滤条件
+    * 每个节点对应过滤条件的一层，普通层按名字分支，'+' 单独一个分支，'#' 记在它前一层的节点上
+    * 发布时沿主题的层级往下走，每层只看同名分支和 '+' 分支，
+      开销只和主题层数、命中的订阅数有关，和订阅总数无关
+*/
+#pragma once
+#include "../common/detail.hpp"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace rpc
+{
+    namespace server
+    {
+        template <typename T>
+        class TopicTrie
+        {
+        public:
+            TopicTrie() : _root(new Node()), _size(0) {}
+
+            // 添加订阅：filter 需要先用 TopicFilter::valid 检查过，同一个值重复订阅同一个过滤条件时返回 false
+            bool insert(const std::string &filter, const T &value)
+            {
+                auto levels = TopicFilter::split(filter);
+                Node *node = _root.get();
+                bool multi = false;
+                for (auto &level : levels)
+                {
+                    if (level == "#")
+                    {
+                        multi = true;
+                        break;
+                    }
+
+                    std::unique_ptr<Node> &child = (level == "+") ? node->plus : node->children[level];
+                    if (!child)
+                    {
+                        child.reset(new Node());
+                    }
+                    node = child.get();
+                }
+
+                auto &values = multi ? node->multi : node->values;
+                if (values.insert(value).second == false)
+                {
+                    return false;
+                }
+
+                _size++;
+                return true;
+            }
+
+            // 删除订阅，不存在时返回 false；删除后变空的节点一并释放
+            bool erase(const std::string &filter, const T &value)
+            {
+                auto levels = TopicFilter::split(filter);
+                std::vector<std::pair<Node *, const std::string *>> path; // 经过的节点和往下走的分支（'+' 分支记为空）
+                Node *node = _root.get();
+                bool multi = false;
+                for (auto &level : levels)
+                {
+                    if (level == "#")
+                    {
+                        multi = true;
+                        break;
+                    }
+
+                    Node *next = nullptr;
+                    if (level == "+")
+                    {
+                        next = node->plus.get();
+                        path.push_back(std::make_pair(node, (const std::string *)nullptr));
+                    }
+                    else
+                    {
+                        auto it = node->children.find(level);
+                        next = (it == node->children.end()) ? nullptr : it->second.get();
+                        path.push_back(std::make_pair(node, &level));
+                    }
+
+                    if (next == nullptr)
+                    {
+                        return false;
+                    }
+                    node = next;
+                }
+
+                auto &values = multi ? node->multi : node->values;
+                if (values.erase(value) == 0)
+                {
+                    return false;
+                }
+                _size--;
+
+                // 从下往上释放空节点
+                while (path.empty() == false && node->empty())
+                {
+                    Node *parent = path.back().first;
+                    const std::string *key = path.back().second;
+                    path.pop_back();
+                    if (key == nullptr)
+                    {
+                        parent->plus.reset();
+                    }
+                    else
+                    {
+                        parent->children.erase(*key);
+                    }
+                    node = parent;
+                }
+                return true;
+            }
+
+            // 找出和主题匹配的订阅追加到 out，同一个值被多个过滤条件命中时会出现多次
+            void match(const std::string &topic, std::vector<T> &out) const
+            {
+                auto levels = TopicFilter::split(topic);
+                collect(_root.get(), levels, 0, out);
+            }
+
+            // 订阅（过滤条件，值）的总数
+            size_t size() const
+            {
+                return _size;
+            }
+
+        private:
+            struct Node
+            {
+                std::unordered_map<std::string, std::unique_ptr<Node>> children; // 普通层级的分支
+                std::unique_ptr<Node> plus;                                      // '+' 分支
+                std::unordered_set<T> values;                                    // 在这一层结束的过滤条件的订阅
+                std::unordered_set<T> multi;                                     // 这一层之后是 '#' 的过滤条件的订阅
+
+                bool empty() const
+                {
+                    return children.empty() && !plus && values.empty() && multi.empty();
+                }
+            };
+
+            void collect(const Node *node, const std::vector<std::string> &levels, size_t depth, std::vector<T> &out) const
+            {
+                // '#' 匹配剩下的所有层，包括零层（"a/#" 也匹配 "a"）
+                out.insert(out.end(), node->multi.begin(), node->multi.end());
+                if (depth == levels.size())
+                {
+                    out.insert(out.end(), node->values.begin(), node->values.end());
+                    return;
+                }
+
+                auto it = node->children.find(levels[depth]);
+                if (it != node->children.end())
+                {
+                    collect(it->second.get(), levels, depth + 1, out);
+                }
+
+                if (node->plus)
+                {
+                    collect(node->plus.get(), levels, depth + 1, out);
+                }
+            }
+
+        private:
+            std::unique_ptr<Node> _root;
+            size_t _size;
+        };
+    }
+}
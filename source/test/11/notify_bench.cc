@@ -0,0 +1,166 @@
+/*
+    上下线通知压测：1000 个服务提供者同时重启（先全部下线，再全部重新注册）
+    对比原来"每个方法、每个主机、每个发现者一条消息"的做法和合并窗口后的做法，
+    统计发给发现者的消息数、编码次数和耗时；连接用内存中的假连接代替，不需要启动任何进程
+*/
+#include "../../server/rpc_registry.hpp"
+#include "../common/bench_util.hpp"
+#include <atomic>
+
+namespace
+{
+    using bench::FakeConnection;
+    using bench::serviceRequest;
+    using bench::since;
+
+    const int PROVIDERS = 1000;  // 服务提供者数量
+    const int METHODS = 10;      // 每个提供者注册的方法数
+    const int DISCOVERERS = 50;  // 关心所有方法的发现者数量
+
+    std::vector<std::string> methodNames()
+    {
+        std::vector<std::string> names;
+        for (int i = 0; i < METHODS; i++)
+        {
+            names.push_back("Method" + std::to_string(i));
+        }
+        return names;
+    }
+
+    rpc::Address providerHost(int i)
+    {
+        return rpc::Address("10.0.0.1", 10000 + i);
+    }
+
+    // 原来的做法：每个方法、每个主机一条通知，发给每个发现者时各自编码一次
+    void baseline(const std::vector<std::string> &names)
+    {
+        auto protocol = rpc::ProtocolFactory::create();
+        size_t messages = 0, bytes = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for (int round = 0; round < 2; round++)
+        {
+            auto optype = round == 0 ? rpc::ServiceOptype::SERVICE_OFFLINE : rpc::ServiceOptype::SERVICE_ONLINE;
+            for (int p = 0; p < PROVIDERS; p++)
+            {
+                for (auto &name : names)
+                {
+                    auto msg = serviceRequest(optype, std::vector<std::string>(1, name), providerHost(p));
+                    for (int d = 0; d < DISCOVERERS; d++)
+                    {
+                        bytes += protocol->serialize(msg).size();
+                        messages++;
+                    }
+                }
+            }
+        }
+
+        printf("逐条通知：   消息 %8zu 条，编码 %8zu 次，%10zu 字节，耗时 %8.1f ms\n", messages, messages, bytes, since(begin));
+    }
+
+    // 从消息帧中取出正文，还原成服务请求
+    rpc::ServiceRequest::ptr decode(const std::string &frame)
+    {
+        int32_t idlen = 0;
+        memcpy(&idlen, frame.data() + 8, 4);
+        idlen = ntohl(idlen);
+        auto req = rpc::MessageFactory::create<rpc::ServiceRequest>();
+        req->unserialize(frame.substr(12 + idlen));
+        return req;
+    }
+}
+
+int main()
+{
+    auto names = methodNames();
+    baseline(names);
+
+    auto pd = std::make_shared<rpc::server::PDManager>();
+    std::vector<FakeConnection::ptr> providers;
+    for (int p = 0; p < PROVIDERS; p++)
+    {
+        providers.push_back(std::make_shared<FakeConnection>());
+        pd->onServiceRequest(providers[p], serviceRequest(rpc::ServiceOptype::SERVICE_REGISTRY, names, providerHost(p)));
+    }
+
+    std::vector<FakeConnection::ptr> discoverers;
+    for (int d = 0; d < DISCOVERERS; d++)
+    {
+        discoverers.push_back(std::make_shared<FakeConnection>());
+        for (auto &name : names)
+        {
+            pd->onServiceRequest(discoverers[d], serviceRequest(rpc::ServiceOptype::SERVICE_DISCOVERY, std::vector<std::string>(1, name), rpc::Address()));
+        }
+        discoverers[d]->messages = 0;
+        discoverers[d]->bytes = 0;
+    }
+    discoverers[0]->keepFrames();
+
+    // 重启风暴：全部下线，再用新连接全部重新注册
+    auto begin = std::chrono::steady_clock::now();
+    for (int p = 0; p < PROVIDERS; p++)
+    {
+        pd->onConnShutdown(providers[p]);
+    }
+    for (int p = 0; p < PROVIDERS; p++)
+    {
+        providers[p] = std::make_shared<FakeConnection>();
+        pd->onServiceRequest(providers[p], serviceRequest(rpc::ServiceOptype::SERVICE_REGISTRY, names, providerHost(p)));
+    }
+    double submit_ms = since(begin);
+
+    // 等后台线程把窗口内的通知发完
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    size_t messages = 0, bytes = 0;
+    for (auto &d : discoverers)
+    {
+        messages += d->messages;
+        bytes += d->bytes;
+    }
+    printf("合并通知：   消息 %8zu 条，编码 %8zu 次，%10zu 字节，注册中心处理耗时 %8.1f ms\n",
+           messages, pd->discoverers()->encoded(), bytes, submit_ms);
+
+    // 校验：按顺序应用发现者 0 收到的变更，每个方法最终应当还是全部主机在线
+    std::map<std::string, std::set<rpc::Address>> hosts;
+    for (auto &name : names)
+    {
+        for (int p = 0; p < PROVIDERS; p++)
+        {
+            hosts[name].insert(providerHost(p));
+        }
+    }
+
+    for (auto &frame : discoverers[0]->frames)
+    {
+        auto msg = decode(frame);
+        auto changes = msg->optype() == rpc::ServiceOptype::SERVICE_DELTA ? msg->changes() : std::vector<rpc::ServiceRequest::ptr>(1, msg);
+        for (auto &change : changes)
+        {
+            for (auto &method : change->methods())
+            {
+                if (change->optype() == rpc::ServiceOptype::SERVICE_ONLINE)
+                {
+                    hosts[method].insert(change->host());
+                }
+                else
+                {
+                    hosts[method].erase(change->host());
+                }
+            }
+        }
+    }
+
+    bool ok = true;
+    for (auto &item : hosts)
+    {
+        ok = ok && (item.second.size() == (size_t)PROVIDERS);
+    }
+
+    size_t max_frame = 0;
+    for (auto &frame : discoverers[0]->frames)
+    {
+        max_frame = std::max(max_frame, frame.size());
+    }
+    printf("发现者 0 收到 %zu 条消息（最大 %zu 字节），应用后主机列表%s\n", discoverers[0]->frames.size(), max_frame, ok ? "正确" : "错误");
+    return 0;
+}
@@ -0,0 +1,23 @@
+#include "../../common/detail.hpp"
+#include "../../server/rpc_server.hpp"
+
+// 三个副本组成的注册中心集群：./reg_server 9090、./reg_server 9091、./reg_server 9092
+int main(int argc, char *argv[])
+{
+    int port = argc > 1 ? atoi(argv[1]) : 9090;
+
+    std::vector<rpc::Address> peers;
+    for (int peer = 9090; peer <= 9092; peer++)
+    {
+        if (peer != port)
+        {
+            peers.push_back(rpc::Address("127.0.0.1", peer));
+        }
+    }
+
+    rpc::server::RegistryServer reg_server(port);
+    reg_server.setPeers(peers);
+    reg_server.start();
+
+    return 0;
+}
@@ -0,0 +1,38 @@
+#include "../../common/detail.hpp"
+#include "../../client/rpc_client.hpp"
+#include <thread>
+
+// 每秒调用一次，期间可以停掉任意一个注册中心副本，调用不受影响
+int main()
+{
+    std::vector<rpc::Address> registry = {
+        rpc::Address("127.0.0.1", 9090),
+        rpc::Address("127.0.0.1", 9091),
+        rpc::Address("127.0.0.1", 9092)};
+    rpc::client::RpcClient client(true, registry);
+
+    // 启动时一次性发现并连接所有要用到的服务，第一次调用不再等待注册中心
+    if (client.prefetch(std::vector<std::string>{"Add"}) == false)
+    {
+        ELOG("服务预热失败！");
+    }
+
+    for (int i = 0; i < 30; i++)
+    {
+        Json::Value params, result;
+        params["num1"] = i;
+        params["num2"] = 100;
+        bool ret = client.call("Add", params, result);
+        if (ret != false)
+        {
+            ILOG("result: %d", result.asInt());
+        }
+        else
+        {
+            ELOG("调用失败！");
+        }
+
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    return 0;
+}
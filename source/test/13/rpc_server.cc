@@ -0,0 +1,29 @@
+#include "../../common/detail.hpp"
+#include "../../server/rpc_server.hpp"
+
+void Add(const Json::Value &req, Json::Value &rsp)
+{
+    int num1 = req["num1"].asInt();
+    int num2 = req["num2"].asInt();
+    rsp = num1 + num2;
+}
+
+int main()
+{
+    std::unique_ptr<rpc::server::ServiceDescribeFactory> desc_factory(new rpc::server::ServiceDescribeFactory());
+    desc_factory->setMethodName("Add");
+    desc_factory->setParamsDesc("num1", rpc::server::VType::INTEGRAL);
+    desc_factory->setParamsDesc("num2", rpc::server::VType::INTEGRAL);
+    desc_factory->setReturnType(rpc::server::VType::INTEGRAL);
+    desc_factory->setCallback(Add);
+
+    // 连接其中一个注册中心副本，它宕机后切换到其他副本并重新注册
+    std::vector<rpc::Address> registry = {
+        rpc::Address("127.0.0.1", 9090),
+        rpc::Address("127.0.0.1", 9091),
+        rpc::Address("127.0.0.1", 9092)};
+    rpc::server::RpcServer server(rpc::Address("127.0.0.1", 8080), registry);
+    server.registerMethod(desc_factory->build());
+    server.start();
+    return 0;
+}
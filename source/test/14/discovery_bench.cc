@@ -0,0 +1,184 @@
+/*
+    服务发现压测：1000 个方法、每个方法 8 个提供者，1000 个发现者反复查询
+    * 对比每次重新编码响应（原来的做法）和使用按方法缓存的响应正文的耗时
+    * 以每秒 10 万次的速率发起服务发现，同时不断有提供者上下线（缓存失效），统计实际速率和编码次数
+    * 解析收到的响应，校验主机列表与注册中心当前的状态一致
+    连接用内存中的假连接代替，不需要启动任何进程
+*/
+#include "../../server/rpc_registry.hpp"
+#include "../common/bench_util.hpp"
+#include <atomic>
+#include <arpa/inet.h>
+
+namespace
+{
+    using bench::FakeConnection;
+    using bench::serviceRequest;
+    using bench::since;
+
+    const int METHODS = 1000;       // 方法数量
+    const int HOSTS = 8;            // 每个方法的提供者数量
+    const int DISCOVERERS = 1000;   // 发现者数量
+    const int ROUNDS = 1000000;     // 单线程对比的查询次数
+    const int RATE = 100000;        // 限速压测的目标速率（次/秒）
+    const int SECONDS = 3;          // 限速压测的时长
+    const int CHURN_MS = 5;         // 每隔多久有一个提供者上线或下线
+
+    std::string methodName(int m)
+    {
+        return "Method" + std::to_string(m);
+    }
+
+    rpc::Address providerHost(int m, int h)
+    {
+        return rpc::Address("10.0." + std::to_string(h) + ".1", 10000 + m);
+    }
+
+    // 原来的做法：每次查询都重新生成主机列表并编码整条响应
+    void encodeEveryTime(const rpc::server::ProviderManager::ptr &providers, const rpc::BaseProtocol::ptr &/*protocol*/,
+                         const rpc::ServiceRequest::ptr &msg, const FakeConnection::ptr &conn)
+    {
+        auto msg_rsp = rpc::MessageFactory::create<rpc::ServiceResponse>();
+        msg_rsp->setId(msg->rid());
+        msg_rsp->setMType(rpc::MType::RSP_SERVICE);
+        msg_rsp->setOptype(rpc::ServiceOptype::SERVICE_DISCOVERY);
+        uint64_t revision = 0;
+        std::vector<rpc::Address> hosts = providers->methodHosts(msg->method(), revision);
+        msg_rsp->setRevision(revision);
+        msg_rsp->setEpoch(providers->epoch());
+        msg_rsp->setRCode(rpc::RCode::RCODE_OK);
+        msg_rsp->setMethod(msg->method());
+        msg_rsp->setHost(hosts);
+        conn->send(msg_rsp);
+    }
+
+    // 解析一帧服务发现响应：长度(4) | 类型(4) | id长度(4) | id | 正文
+    bool parseResponse(const std::string &frame, const std::string &rid, rpc::ServiceResponse::ptr &msg_rsp)
+    {
+        int32_t idlen = 0;
+        memcpy(&idlen, frame.data() + 8, 4);
+        idlen = ntohl(idlen);
+        if (frame.compare(12, idlen, rid) != 0)
+        {
+            return false;
+        }
+
+        msg_rsp = rpc::MessageFactory::create<rpc::ServiceResponse>();
+        return msg_rsp->unserialize(frame.substr(12 + idlen)) && msg_rsp->check();
+    }
+}
+
+int main()
+{
+    auto protocol = rpc::ProtocolFactory::create();
+    auto pd = std::make_shared<rpc::server::PDManager>();
+    auto providers = pd->providers();
+    std::vector<FakeConnection::ptr> provider_conns;
+    for (int m = 0; m < METHODS; m++)
+    {
+        for (int h = 0; h < HOSTS; h++)
+        {
+            provider_conns.push_back(std::make_shared<FakeConnection>(protocol));
+            pd->onServiceRequest(provider_conns.back(), serviceRequest(rpc::ServiceOptype::SERVICE_REGISTRY, methodName(m), providerHost(m, h)));
+        }
+    }
+
+    std::vector<FakeConnection::ptr> discoverers;
+    for (int d = 0; d < DISCOVERERS; d++)
+    {
+        discoverers.push_back(std::make_shared<FakeConnection>(protocol));
+    }
+
+    // 每个方法一条发现请求，反复使用
+    std::vector<rpc::ServiceRequest::ptr> requests;
+    for (int m = 0; m < METHODS; m++)
+    {
+        requests.push_back(serviceRequest(rpc::ServiceOptype::SERVICE_DISCOVERY, methodName(m), rpc::Address()));
+    }
+
+    // 单线程对比：每次编码 vs 缓存正文
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++)
+    {
+        encodeEveryTime(providers, protocol, requests[i % METHODS], discoverers[i % DISCOVERERS]);
+    }
+    double encode_ms = since(begin);
+
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++)
+    {
+        pd->onServiceRequest(discoverers[i % DISCOVERERS], requests[i % METHODS]);
+    }
+    double cached_ms = since(begin);
+    printf("每次编码：   每次服务发现 %6.0f ns\n", encode_ms * 1e6 / ROUNDS);
+    printf("缓存正文：   每次服务发现 %6.0f ns（含登记发现者），编码 %zu 次\n", cached_ms * 1e6 / ROUNDS, providers->encoded());
+
+    // 限速压测：发现请求按 RATE 的速率发出，同时另一个线程让提供者不断上下线
+    std::atomic<bool> stop(false);
+    std::atomic<size_t> churns(0);
+    std::thread churn([&]()
+    {
+        size_t n = 0;
+        while (stop == false)
+        {
+            int m = n % METHODS;
+            auto conn = provider_conns[m * HOSTS];
+            if ((n / METHODS) % 2 == 0)
+            {
+                pd->onConnShutdown(conn);
+            }
+            else
+            {
+                pd->onServiceRequest(conn, serviceRequest(rpc::ServiceOptype::SERVICE_REGISTRY, methodName(m), providerHost(m, 0)));
+            }
+            n++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(CHURN_MS));
+        }
+        churns = n;
+    });
+
+    size_t encoded = providers->encoded();
+    size_t sent = 0;
+    double busy_ms = 0;
+    begin = std::chrono::steady_clock::now();
+    for (int slot = 0; slot < SECONDS * 1000; slot++)
+    {
+        // 每毫秒发出 RATE / 1000 个请求
+        auto slot_begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < RATE / 1000; i++, sent++)
+        {
+            pd->onServiceRequest(discoverers[sent % DISCOVERERS], requests[(sent * 7) % METHODS]);
+        }
+        busy_ms += since(slot_begin);
+        std::this_thread::sleep_until(begin + std::chrono::milliseconds(slot + 1));
+    }
+    double total_ms = since(begin);
+    stop = true;
+    churn.join();
+
+    printf("限速压测：   %zu 次服务发现，实际 %.0f 次/秒，注册中心忙碌 %.1f%%，期间上下线 %zu 次，编码 %zu 次\n",
+           sent, sent * 1000.0 / total_ms, busy_ms * 100.0 / total_ms, churns.load(), providers->encoded() - encoded);
+
+    // 校验：每个方法的发现响应与注册中心当前的主机列表一致
+    bool ok = true;
+    for (int m = 0; m < METHODS && ok; m++)
+    {
+        auto conn = discoverers[m % DISCOVERERS];
+        pd->onServiceRequest(conn, requests[m]);
+
+        rpc::ServiceResponse::ptr msg_rsp;
+        uint64_t revision = 0;
+        auto hosts = providers->methodHosts(methodName(m), revision);
+        std::sort(hosts.begin(), hosts.end());
+        std::vector<rpc::Address> got;
+        ok = parseResponse(conn->last, requests[m]->rid(), msg_rsp);
+        if (ok)
+        {
+            got = msg_rsp->hosts();
+            std::sort(got.begin(), got.end());
+            ok = (got == hosts && msg_rsp->revision() == revision && msg_rsp->method() == methodName(m));
+        }
+    }
+    printf("响应内容与注册中心状态%s\n", ok ? "一致，正确" : "不一致，错误");
+    return 0;
+}
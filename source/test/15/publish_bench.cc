@@ -0,0 +1,234 @@
+/*
+    主题发布压测：发布者和服务端之间模拟单程 100 微秒的网络延迟，4 个订阅者
+    * 同步发布：每条消息等一次响应，吞吐被往返时间限制
+    * 不需要响应的发布：每条消息一帧，不等待
+    * 异步批量发布：消息攒成批次打包发送，一帧包含多条消息
+    统计发布者每秒发出的消息数、发出的帧数，并确认每个订阅者都按顺序收到了全部消息
+    连接用内存中的假连接代替，不需要启动任何进程
+*/
+#include "../../server/rpc_topic.hpp"
+#include "../../client/rpc_topic.hpp"
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <arpa/inet.h>
+
+namespace
+{
+    const int SUBSCRIBERS = 4;    // 订阅者数量
+    const int LATENCY_US = 100;   // 单程网络延迟（微秒）
+    const int SYNC_MSGS = 2000;   // 同步发布的消息数
+    const int ASYNC_MSGS = 200000; // 不需要响应 / 批量发布的消息数
+
+    // 把一帧拆回消息对象（帧格式：长度|类型|ID长度|ID|正文）
+    rpc::BaseMessage::ptr parseFrame(const std::string &frame)
+    {
+        int32_t mtype, idlen;
+        memcpy(&mtype, frame.data() + 4, 4);
+        memcpy(&idlen, frame.data() + 8, 4);
+        idlen = ntohl(idlen);
+        auto msg = rpc::MessageFactory::create((rpc::MType)ntohl(mtype));
+        msg->unserialize(frame.substr(12 + idlen));
+        msg->setId(frame.substr(12, idlen));
+        msg->setMType((rpc::MType)ntohl(mtype));
+        return msg;
+    }
+
+    // 单向链路：帧在发出 LATENCY_US 之后按顺序交给接收方
+    class Link
+    {
+    public:
+        using Receiver = std::function<void(const rpc::BaseMessage::ptr &)>;
+
+        Link(const Receiver &receiver) : _receiver(receiver), _stop(false), frames(0)
+        {
+            _thread = std::thread(&Link::deliverEntry, this);
+        }
+
+        ~Link()
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _cond.notify_all();
+            _thread.join();
+        }
+
+        void push(const std::string &frame)
+        {
+            frames++;
+            std::unique_lock<std::mutex> lock(_mutex);
+            _queue.push_back(std::make_pair(std::chrono::steady_clock::now() + std::chrono::microseconds(LATENCY_US), frame));
+            _cond.notify_one();
+        }
+
+    private:
+        void deliverEntry()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (true)
+            {
+                _cond.wait(lock, [this]() { return _stop || _queue.empty() == false; });
+                if (_stop)
+                {
+                    return;
+                }
+
+                auto item = _queue.front();
+                _queue.pop_front();
+                lock.unlock();
+                std::this_thread::sleep_until(item.first);
+                _receiver(parseFrame(item.second));
+                lock.lock();
+            }
+        }
+
+    private:
+        Receiver _receiver;
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        std::deque<std::pair<std::chrono::steady_clock::time_point, std::string>> _queue;
+        bool _stop;
+        std::thread _thread;
+
+    public:
+        std::atomic<size_t> frames; // 经过链路的帧数
+    };
+
+    // 连接的一端：发出的消息组帧后放进链路
+    class LinkConnection : public rpc::BaseConnection
+    {
+    public:
+        LinkConnection() : _protocol(rpc::ProtocolFactory::create()) {}
+
+        virtual void send(const rpc::BaseMessage::ptr &msg) override
+        {
+            sendRaw(_protocol->serialize(msg));
+        }
+
+        virtual void sendRaw(const std::string &frame) override
+        {
+            link->push(frame);
+        }
+
+        virtual void shutdown() override {}
+        virtual bool connected() override { return true; }
+
+        rpc::BaseProtocol::ptr _protocol;
+        Link *link = nullptr;
+    };
+
+    // 订阅者：只统计收到的消息，并检查消息编号是否连续
+    // 直接在帧里找消息内容，不做完整的反序列化，避免压测本身的开销掩盖服务端的耗时
+    class SubscriberConnection : public rpc::BaseConnection
+    {
+    public:
+        SubscriberConnection() : received(0), ordered(true) {}
+
+        virtual void send(const rpc::BaseMessage::ptr &msg) override {}
+
+        virtual void sendRaw(const std::string &frame) override
+        {
+            size_t pos = frame.find("\"" KEY_TOPIC_MSG "\"");
+            pos = frame.find('"', frame.find(':', pos)) + 1;
+            if (std::strtoul(frame.c_str() + pos, nullptr, 10) != received)
+            {
+                ordered = false;
+            }
+            received++;
+        }
+
+        virtual void shutdown() override {}
+        virtual bool connected() override { return true; }
+
+        std::atomic<size_t> received;
+        bool ordered;
+    };
+
+    double since(std::chrono::steady_clock::time_point begin)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count() / 1000.0;
+    }
+
+    rpc::TopicRequest::ptr topicRequest(rpc::TopicOptype optype, const std::string &key)
+    {
+        auto req = rpc::MessageFactory::create<rpc::TopicRequest>();
+        req->setId(rpc::UUID::uuid());
+        req->setMType(rpc::MType::REQ_TOPIC);
+        req->setOptype(optype);
+        req->setTopicKey(key);
+        return req;
+    }
+}
+
+int main()
+{
+    auto server = std::make_shared<rpc::server::TopicManager>();
+    auto requestor = std::make_shared<rpc::client::Requestor>();
+    auto publisher = std::make_shared<rpc::client::TopicManager>(requestor);
+
+    auto client_conn = std::make_shared<LinkConnection>();
+    auto server_conn = std::make_shared<LinkConnection>();
+    Link to_server([&](const rpc::BaseMessage::ptr &msg)
+    {
+        server->onTopicRequest(server_conn, std::dynamic_pointer_cast<rpc::TopicRequest>(msg));
+    });
+    Link to_client([&](const rpc::BaseMessage::ptr &msg)
+    {
+        rpc::BaseMessage::ptr rsp = msg;
+        requestor->onResponse(client_conn, rsp);
+    });
+    client_conn->link = &to_server;
+    server_conn->link = &to_client;
+
+    std::vector<std::shared_ptr<SubscriberConnection>> subscribers;
+    for (int i = 0; i < SUBSCRIBERS; i++)
+    {
+        subscribers.push_back(std::make_shared<SubscriberConnection>());
+        if (i == 0)
+        {
+            server->onTopicRequest(subscribers.back(), topicRequest(rpc::TopicOptype::TOPIC_CREATE, "bench"));
+        }
+        server->onTopicRequest(subscribers.back(), topicRequest(rpc::TopicOptype::TOPIC_SUBSCRIBE, "bench"));
+    }
+
+    size_t sent = 0;
+    auto run = [&](const char *name, int count, const std::function<void(const std::string &)> &publish)
+    {
+        size_t frames = to_server.frames;
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++)
+        {
+            publish(std::to_string(sent + i));
+        }
+        publisher->flush();
+        double publish_ms = since(begin);
+
+        sent += count;
+        for (auto &subscriber : subscribers)
+        {
+            while (subscriber->received < sent)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        double deliver_ms = since(begin);
+
+        printf("%s %7d 条，发布 %9.0f 条/秒，全部送达 %9.0f 条/秒，发出 %6zu 帧\n",
+               name, count, count * 1000.0 / publish_ms, count * 1000.0 / deliver_ms, to_server.frames - frames);
+    };
+
+    run("同步发布：  ", SYNC_MSGS, [&](const std::string &msg) { publisher->publish(client_conn, "bench", msg); });
+    run("不需要响应：", ASYNC_MSGS, [&](const std::string &msg) { publisher->publishNoAck(client_conn, "bench", msg); });
+    run("异步批量：  ", ASYNC_MSGS, [&](const std::string &msg) { publisher->publishAsync(client_conn, "bench", msg); });
+
+    bool ok = true;
+    for (auto &subscriber : subscribers)
+    {
+        ok = ok && subscriber->ordered && subscriber->received == sent;
+    }
+    printf("订阅者收到的消息%s\n", ok ? "完整且有序，正确" : "缺失或乱序，错误");
+    return 0;
+}
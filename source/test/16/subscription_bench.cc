@@ -0,0 +1,202 @@
+/*
+    通配符订阅压测：1 万个订阅者、每个 100 个通配符过滤条件，共 100 万条订阅
+    主题形如 "site/{站点}/dev/{设备}/{指标}"，过滤条件随机取下面几种：
+    * site/S/dev/D/+     某台设备的所有指标
+    * site/S/dev/D/#     某台设备下的所有主题
+    * site/+/dev/D/M     所有站点上同一编号设备的某个指标
+    * site/S/+/D/M       某个指标（中间一层任意）
+    分别在 10 万和 100 万条订阅时统计每次发布的耗时，并和逐条匹配所有过滤条件的做法对比，
+    校验两者命中的订阅者一致；最后断开所有订阅者，检查订阅树被清空
+    连接用内存中的假连接代替，不需要启动任何进程
+*/
+#include "../../server/rpc_topic.hpp"
+#include <random>
+#include <unistd.h>
+
+namespace
+{
+    const int SUBSCRIBERS = 10000;     // 订阅者数量
+    const int FILTERS_PER_SUB = 100;   // 每个订阅者的过滤条件数
+    const int SITES = 100;             // 站点数
+    const int DEVICES = 1000;          // 每个站点的设备数
+    const int TOPICS = 1000;           // 创建并发布的主题数
+    const int PUBLISHES = 100000;      // 每轮发布的消息数
+    const int LINEAR_PUBLISHES = 10;   // 逐条匹配做对比的发布数
+    const char *METRICS[] = {"temp", "humi", "volt", "amp", "power", "freq", "load", "rpm", "flow", "level"};
+
+    // 订阅者：只统计收到的消息数
+    class CountConnection : public rpc::BaseConnection
+    {
+    public:
+        virtual void send(const rpc::BaseMessage::ptr &msg) override {}
+        virtual void sendRaw(const std::string &frame) override { received++; }
+        virtual void shutdown() override {}
+        virtual bool connected() override { return true; }
+
+        size_t received = 0;
+    };
+
+    double since(std::chrono::steady_clock::time_point begin)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count() / 1000.0;
+    }
+
+    // 进程当前占用的物理内存（MB）
+    double rssMB()
+    {
+        long pages = 0, resident = 0;
+        FILE *fp = fopen("/proc/self/statm", "r");
+        if (fp)
+        {
+            if (fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+            {
+                resident = 0;
+            }
+            fclose(fp);
+        }
+        return resident * sysconf(_SC_PAGESIZE) / 1024.0 / 1024.0;
+    }
+
+    rpc::TopicRequest::ptr topicRequest(rpc::TopicOptype optype, const std::string &key)
+    {
+        auto req = rpc::MessageFactory::create<rpc::TopicRequest>();
+        req->setId(rpc::UUID::uuid());
+        req->setMType(rpc::MType::REQ_TOPIC);
+        req->setOptype(optype);
+        req->setTopicKey(key);
+        return req;
+    }
+
+    std::string randomFilter(std::mt19937 &rng)
+    {
+        std::string site = std::to_string(rng() % SITES);
+        std::string dev = std::to_string(rng() % DEVICES);
+        std::string metric = METRICS[rng() % 10];
+        switch (rng() % 4)
+        {
+        case 0:
+            return "site/" + site + "/dev/" + dev + "/+";
+        case 1:
+            return "site/" + site + "/dev/" + dev + "/#";
+        case 2:
+            return "site/+/dev/" + dev + "/" + metric;
+        default:
+            return "site/" + site + "/+/" + dev + "/" + metric;
+        }
+    }
+
+    std::string randomTopic(std::mt19937 &rng)
+    {
+        return "site/" + std::to_string(rng() % SITES) + "/dev/" + std::to_string(rng() % DEVICES) + "/" + METRICS[rng() % 10];
+    }
+}
+
+int main()
+{
+    std::mt19937 rng(20240601);
+    auto server = std::make_shared<rpc::server::TopicManager>();
+    std::vector<std::shared_ptr<CountConnection>> subscribers;
+    std::vector<std::pair<std::string, size_t>> filters; // 所有订阅（过滤条件，订阅者下标），逐条匹配时使用
+    for (int i = 0; i < SUBSCRIBERS; i++)
+    {
+        subscribers.push_back(std::make_shared<CountConnection>());
+    }
+
+    std::vector<std::string> topics;
+    for (int i = 0; i < TOPICS; i++)
+    {
+        topics.push_back(randomTopic(rng));
+        server->onTopicRequest(subscribers[0], topicRequest(rpc::TopicOptype::TOPIC_CREATE, topics.back()));
+    }
+
+    auto received = [&]()
+    {
+        size_t total = 0;
+        for (auto &subscriber : subscribers)
+        {
+            total += subscriber->received;
+        }
+        return total;
+    };
+
+    auto publish = [&](const std::string &topic)
+    {
+        auto req = topicRequest(rpc::TopicOptype::TOPIC_PUBLISH, topic);
+        req->setTopicMsg("42");
+        req->setAck(false);
+        server->onTopicRequest(subscribers[0], req);
+    };
+
+    // 订阅到 target 条为止：按订阅者轮流添加，每个订阅者的过滤条件数保持均匀
+    auto subscribeTo = [&](size_t target)
+    {
+        size_t begin_count = filters.size();
+        auto begin = std::chrono::steady_clock::now();
+        while (filters.size() < target)
+        {
+            size_t index = filters.size() % SUBSCRIBERS;
+            std::string filter = randomFilter(rng);
+            server->onTopicRequest(subscribers[index], topicRequest(rpc::TopicOptype::TOPIC_SUBSCRIBE, filter));
+            filters.push_back(std::make_pair(filter, index));
+        }
+        double ms = since(begin);
+        printf("订阅 %7zu 条，每条 %.2f 微秒，订阅树中共 %zu 条，进程内存 %.0f MB\n",
+               target - begin_count, ms * 1000 / (target - begin_count), server->wildcards(), rssMB());
+    };
+
+    auto measure = [&]()
+    {
+        size_t before = received();
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < PUBLISHES; i++)
+        {
+            publish(topics[i % TOPICS]);
+        }
+        double ms = since(begin);
+        printf("  订阅树匹配：发布 %d 条，每条 %.2f 微秒，平均每条送达 %.1f 个订阅者\n",
+               PUBLISHES, ms * 1000 / PUBLISHES, (received() - before) / (double)PUBLISHES);
+
+        // 逐条匹配：对每条发布遍历所有过滤条件，并核对命中的订阅者和订阅树一致
+        bool same = true;
+        begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < LINEAR_PUBLISHES; i++)
+        {
+            const std::string &topic = topics[(i * 97) % TOPICS];
+            std::vector<bool> hit(SUBSCRIBERS, false);
+            for (auto &item : filters)
+            {
+                if (rpc::TopicFilter::match(item.first, topic))
+                {
+                    hit[item.second] = true;
+                }
+            }
+
+            std::vector<size_t> counts;
+            for (auto &subscriber : subscribers)
+            {
+                counts.push_back(subscriber->received);
+            }
+            publish(topic);
+            for (int j = 0; j < SUBSCRIBERS; j++)
+            {
+                same = same && (subscribers[j]->received - counts[j] == (hit[j] ? 1u : 0u));
+            }
+        }
+        ms = since(begin);
+        printf("  逐条匹配：  每条 %.2f 毫秒，命中的订阅者与订阅树%s\n", ms / LINEAR_PUBLISHES, same ? "一致，正确" : "不一致，错误");
+    };
+
+    subscribeTo(SUBSCRIBERS * FILTERS_PER_SUB / 10);
+    measure();
+    subscribeTo(SUBSCRIBERS * FILTERS_PER_SUB);
+    measure();
+
+    auto begin = std::chrono::steady_clock::now();
+    for (auto &subscriber : subscribers)
+    {
+        server->onShutdown(subscriber);
+    }
+    printf("断开全部订阅者耗时 %.0f 毫秒，订阅树剩余 %zu 条%s\n",
+           since(begin), server->wildcards(), server->wildcards() == 0 ? "，正确" : "，错误");
+    return 0;
+}
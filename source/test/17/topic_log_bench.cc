@@ -0,0 +1,239 @@
+/*
+    持久化主题压测：消息经过服务端的主题管理写入分段日志
+    * 追加：不同的刷盘批量（每条、每 16 / 256 / 4096 条、交给操作系统）下每秒写入的消息数
+    * 读取：按 offset 分批拉取全部消息，检查消息完整且有序，统计每秒读取的字节数
+    * 保留：总大小超过上限后最旧的分段被删除，检查磁盘上的文件大小不超过上限加一个分段
+    * 恢复：重新打开同一个目录，检查消息条数和之后发布的序号接得上
+    连接用内存中的假连接代替，不需要启动任何进程；数据目录可以通过第一个参数指定（默认 ./topic_log_data），结束时删除
+*/
+#include "../../server/rpc_topic.hpp"
+#include <arpa/inet.h>
+
+namespace
+{
+    const int MESSAGES = 200000;    // 每轮追加的消息数
+    const int SYNC_MESSAGES = 2000; // 每条都刷盘时追加的消息数
+    const size_t MSG_BYTES = 100;   // 每条消息的内容长度
+
+    // 读取方：拉取的消息帧从 sendBytes 到达，响应从 send 到达
+    class FetchConnection : public rpc::BaseConnection
+    {
+    public:
+        virtual void send(const rpc::BaseMessage::ptr &msg) override
+        {
+            response = std::dynamic_pointer_cast<rpc::TopicResponse>(msg);
+        }
+
+        virtual void sendRaw(const std::string &frame) override
+        {
+            sendBytes(frame.data(), frame.size());
+        }
+
+        // 逐帧取出序号，检查是否连续（帧格式：长度|类型|ID长度|ID|正文）
+        virtual void sendBytes(const char *data, size_t len) override
+        {
+            size_t pos = 0;
+            while (pos < len)
+            {
+                int32_t flen, idlen;
+                memcpy(&flen, data + pos, 4);
+                memcpy(&idlen, data + pos + 8, 4);
+                flen = ntohl(flen);
+                idlen = ntohl(idlen);
+
+                auto msg = std::make_shared<rpc::TopicRequest>();
+                msg->unserialize(std::string(data + pos + 12 + idlen, flen - 8 - idlen));
+                ordered = ordered && msg->seq() == next && msg->topicMsg().size() == MSG_BYTES;
+                next = msg->seq() + 1;
+                received++;
+                pos += 4 + flen;
+            }
+            bytes += len;
+        }
+
+        virtual void shutdown() override {}
+        virtual bool connected() override { return true; }
+
+        rpc::TopicResponse::ptr response;
+        uint64_t next = 1;
+        size_t received = 0;
+        size_t bytes = 0;
+        bool ordered = true;
+    };
+
+    double since(std::chrono::steady_clock::time_point begin)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count() / 1000.0;
+    }
+
+    rpc::TopicRequest::ptr topicRequest(rpc::TopicOptype optype, const std::string &key)
+    {
+        auto req = rpc::MessageFactory::create<rpc::TopicRequest>();
+        req->setId(rpc::UUID::uuid());
+        req->setMType(rpc::MType::REQ_TOPIC);
+        req->setOptype(optype);
+        req->setTopicKey(key);
+        return req;
+    }
+
+    void createDurable(const rpc::server::TopicManager::ptr &server, const rpc::BaseConnection::ptr &conn, const std::string &key)
+    {
+        auto req = topicRequest(rpc::TopicOptype::TOPIC_CREATE, key);
+        req->setDurable(true);
+        server->onTopicRequest(conn, req);
+    }
+
+    void publish(const rpc::server::TopicManager::ptr &server, const rpc::BaseConnection::ptr &conn, const std::string &key, int count)
+    {
+        std::string body(MSG_BYTES, 'x');
+        for (int i = 0; i < count; i++)
+        {
+            auto req = topicRequest(rpc::TopicOptype::TOPIC_PUBLISH, key);
+            req->setTopicMsg(body);
+            req->setAck(false);
+            server->onTopicRequest(conn, req);
+        }
+    }
+
+    // 从 from 开始拉取到末尾，返回最后一次响应中的下一个 offset
+    uint64_t fetchAll(const rpc::server::TopicManager::ptr &server, const std::shared_ptr<FetchConnection> &conn, const std::string &key, uint64_t from)
+    {
+        while (true)
+        {
+            auto req = topicRequest(rpc::TopicOptype::TOPIC_FETCH, key);
+            req->setFrom(from);
+            server->onTopicRequest(conn, req);
+            if (!conn->response || conn->response->rcode() != rpc::RCode::RCODE_OK)
+            {
+                return 0;
+            }
+
+            from = conn->response->seq();
+            if (conn->response->more() == false)
+            {
+                return from;
+            }
+        }
+    }
+
+    // 目录下所有文件的总大小
+    size_t dirBytes(const std::string &dir)
+    {
+        size_t total = 0;
+        DIR *dp = opendir(dir.c_str());
+        if (dp == nullptr)
+        {
+            return 0;
+        }
+
+        struct dirent *ent;
+        while ((ent = readdir(dp)) != nullptr)
+        {
+            struct stat st;
+            std::string path = dir + "/" + ent->d_name;
+            if (ent->d_name[0] == '.' || stat(path.c_str(), &st) != 0)
+            {
+                continue;
+            }
+            total += S_ISDIR(st.st_mode) ? dirBytes(path) : st.st_size;
+        }
+        closedir(dp);
+        return total;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::string root = argc > 1 ? argv[1] : "./topic_log_data";
+    if (mkdir(root.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        printf("创建数据目录 %s 失败\n", root.c_str());
+        return 1;
+    }
+
+    auto conn = std::make_shared<FetchConnection>();
+    bool ok = true;
+
+    // 1. 不同刷盘批量下的追加速度
+    size_t batches[] = {1, 16, 256, 4096, 0};
+    for (size_t batch : batches)
+    {
+        rpc::server::TopicLogConfig config;
+        config.flush_messages = batch;
+        config.flush_ms = 0;
+        auto server = std::make_shared<rpc::server::TopicManager>();
+        server->persist(root + "/append_" + std::to_string(batch), config);
+        createDurable(server, conn, "bench");
+
+        int count = batch == 1 ? SYNC_MESSAGES : MESSAGES;
+        auto begin = std::chrono::steady_clock::now();
+        publish(server, conn, "bench", count);
+        server->flushLogs();
+        double ms = since(begin);
+        printf("追加：每 %4zu 条刷盘%s %7d 条，%9.0f 条/秒\n",
+               batch, batch == 0 ? "（交给操作系统）" : "                ", count, count * 1000.0 / ms);
+    }
+
+    // 2. 按 offset 拉取全部消息
+    {
+        auto server = std::make_shared<rpc::server::TopicManager>();
+        server->persist(root + "/append_0");
+        auto begin = std::chrono::steady_clock::now();
+        uint64_t end = fetchAll(server, conn, "bench", 1);
+        double ms = since(begin);
+        bool right = conn->ordered && conn->received == (size_t)MESSAGES && end == (uint64_t)MESSAGES + 1;
+        ok = ok && right;
+        printf("读取（含逐条解析校验）：%zu 条，%.0f MB/秒，消息%s\n",
+               conn->received, conn->bytes / 1024.0 / 1024.0 * 1000 / ms, right ? "完整且有序，正确" : "缺失或乱序，错误");
+    }
+
+    // 3. 按大小保留：1MB 分段，最多保留 4MB
+    {
+        rpc::server::TopicLogConfig config;
+        config.segment_bytes = 1 << 20;
+        config.retention_bytes = 4 << 20;
+        auto server = std::make_shared<rpc::server::TopicManager>();
+        std::string dir = root + "/retention";
+        server->persist(dir, config);
+        createDurable(server, conn, "bench");
+        publish(server, conn, "bench", MESSAGES);
+        server->flushLogs();
+
+        size_t bytes = dirBytes(dir);
+        bool right = bytes <= config.retention_bytes + config.segment_bytes + (64 << 10);
+        ok = ok && right;
+        printf("保留：写入约 %zu MB，磁盘上剩余 %.1f MB，%s\n",
+               MESSAGES * (MSG_BYTES + 80) >> 20, bytes / 1024.0 / 1024.0, right ? "不超过上限，正确" : "超过上限，错误");
+    }
+
+    // 4. 重新打开后恢复，之后发布的序号接在后面
+    {
+        std::string dir = root + "/recovery";
+        {
+            auto server = std::make_shared<rpc::server::TopicManager>();
+            server->persist(dir);
+            createDurable(server, conn, "a/b");
+            publish(server, conn, "a/b", 1000);
+        }
+
+        auto server = std::make_shared<rpc::server::TopicManager>();
+        auto begin = std::chrono::steady_clock::now();
+        server->persist(dir);
+        double ms = since(begin);
+        publish(server, conn, "a/b", 1);
+
+        conn = std::make_shared<FetchConnection>();
+        uint64_t end = fetchAll(server, conn, "a/b", 1);
+        bool right = conn->ordered && conn->received == 1001 && end == 1002;
+        ok = ok && right;
+        printf("恢复：打开耗时 %.2f 毫秒，读到 %zu 条，%s\n", ms, conn->received, right ? "序号连续，正确" : "序号不连续，错误");
+    }
+
+    std::string cmd = "rm -rf '" + root + "'";
+    if (system(cmd.c_str()) != 0)
+    {
+        printf("删除数据目录 %s 失败\n", root.c_str());
+    }
+    printf("%s\n", ok ? "全部检查通过" : "存在错误");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,319 @@
+/*
+    大主题转发压测：一个主题 8000 个订阅者，连接平均分在 4 个网络线程上
+    * 转发：不分组（在发布者线程中逐个发送）和按网络线程分组（每个网络线程一个任务）各发布 1000 条，
+      统计发布者每条消息占用的时间、全部送达的总耗时，并检查每个订阅者按顺序收到了全部消息
+    * 网络线程中发布：分组后每个网络线程中各有一个发布者，轮流发布（第 i 条由第 i % 4 个网络线程发布），
+      发布期间其他网络线程投递的任务排在发布者后面，发布者所在网络线程的订阅者也不能越过它们先收到，检查每个订阅者仍然按顺序收到
+    * 订阅：发布者线程不停地向大主题发布（不分组，转发时间最长）的同时，另一个线程反复订阅、取消订阅同一个主题，
+      统计订阅和取消的耗时，和每次转发的耗时对比（订阅关系是快照，订阅不需要等转发结束）
+    网络线程用带任务队列的线程代替，发送只是把帧追加到连接自己的缓冲里，不需要启动任何进程
+*/
+#include "../../server/rpc_topic.hpp"
+#include <condition_variable>
+#include <thread>
+
+namespace
+{
+    const int LOOPS = 4;           // 网络线程数
+    const int SUBSCRIBERS = 8000;  // 大主题的订阅者数
+    const int PUBLISHES = 1000;    // 每轮发布的消息数
+    const int SUBSCRIBES = 2000;   // 订阅压测中订阅/取消的次数
+
+    // 模拟的网络线程：按顺序执行投递进来的任务
+    class TaskLoop
+    {
+    public:
+        TaskLoop() : _busy(false), _stop(false), _thread(&TaskLoop::entry, this) {}
+
+        ~TaskLoop()
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _cond.notify_all();
+            _thread.join();
+        }
+
+        // 当前就在该线程中时立即执行
+        void run(const std::function<void()> &task)
+        {
+            if (std::this_thread::get_id() == _thread.get_id())
+            {
+                return task();
+            }
+
+            queue(task);
+        }
+
+        // 总是追加到队列末尾，当前就在该线程中也不立即执行
+        void queue(const std::function<void()> &task)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _tasks.push_back(task);
+            _cond.notify_all();
+        }
+
+        // 等待已经投递的任务全部执行完
+        void wait()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _idle.wait(lock, [this]() { return _tasks.empty() && _busy == false; });
+        }
+
+    private:
+        void entry()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (true)
+            {
+                _cond.wait(lock, [this]() { return _stop || _tasks.empty() == false; });
+                if (_tasks.empty())
+                {
+                    return;
+                }
+
+                std::deque<std::function<void()>> tasks;
+                tasks.swap(_tasks);
+                _busy = true;
+                lock.unlock();
+                for (auto &task : tasks)
+                {
+                    task();
+                }
+                lock.lock();
+                _busy = false;
+                _idle.notify_all();
+            }
+        }
+
+    private:
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        std::condition_variable _idle;
+        std::deque<std::function<void()>> _tasks;
+        bool _busy;
+        bool _stop;
+        std::thread _thread;
+    };
+
+    // 订阅者连接：帧追加到自己的发送缓冲（代替写 socket），并检查消息编号是否连续
+    class LoopConnection : public rpc::BaseConnection
+    {
+    public:
+        LoopConnection(TaskLoop *loop) : _loop(loop) {}
+
+        virtual void send(const rpc::BaseMessage::ptr &msg) override {}
+
+        virtual void sendRaw(const std::string &frame) override
+        {
+            _buffer.append(frame);
+            if (_buffer.size() > (64 << 10))
+            {
+                _buffer.clear();
+            }
+
+            // 消息内容是 "#编号#"，跳过 12 字节的帧头再找
+            size_t pos = frame.find('#', 12);
+            int index = atoi(frame.c_str() + pos + 1);
+            ordered = ordered && index == next;
+            next = index + 1;
+            received++;
+        }
+
+        virtual void shutdown() override {}
+        virtual bool connected() override { return true; }
+        virtual const void *loop() override { return _loop; }
+        virtual void runInLoop(const std::function<void()> &task) override { _loop->run(task); }
+        virtual void queueInLoop(const std::function<void()> &task) override { _loop->queue(task); }
+
+        size_t received = 0;
+        int next = 0;
+        bool ordered = true;
+
+    private:
+        TaskLoop *_loop;
+        std::string _buffer;
+    };
+
+    double since(std::chrono::steady_clock::time_point begin)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count() / 1000.0;
+    }
+
+    rpc::TopicRequest::ptr topicRequest(rpc::TopicOptype optype, const std::string &key)
+    {
+        auto req = rpc::MessageFactory::create<rpc::TopicRequest>();
+        req->setId(rpc::UUID::uuid());
+        req->setMType(rpc::MType::REQ_TOPIC);
+        req->setOptype(optype);
+        req->setTopicKey(key);
+        return req;
+    }
+
+    rpc::TopicRequest::ptr publishRequest(const std::string &key, int index)
+    {
+        auto req = topicRequest(rpc::TopicOptype::TOPIC_PUBLISH, key);
+        req->setTopicMsg("#" + std::to_string(index) + "#");
+        req->setAck(false);
+        return req;
+    }
+
+    // 创建大主题并让所有订阅者订阅
+    void prepare(const rpc::server::TopicManager::ptr &server, const std::vector<std::shared_ptr<LoopConnection>> &subscribers)
+    {
+        server->onTopicRequest(subscribers[0], topicRequest(rpc::TopicOptype::TOPIC_CREATE, "big"));
+        for (auto &subscriber : subscribers)
+        {
+            server->onTopicRequest(subscriber, topicRequest(rpc::TopicOptype::TOPIC_SUBSCRIBE, "big"));
+        }
+    }
+}
+
+int main()
+{
+    std::vector<std::unique_ptr<TaskLoop>> loops;
+    for (int i = 0; i < LOOPS; i++)
+    {
+        loops.emplace_back(new TaskLoop());
+    }
+
+    auto makeSubscribers = [&]()
+    {
+        std::vector<std::shared_ptr<LoopConnection>> subscribers;
+        for (int i = 0; i < SUBSCRIBERS; i++)
+        {
+            subscribers.push_back(std::make_shared<LoopConnection>(loops[i % LOOPS].get()));
+        }
+        return subscribers;
+    };
+
+    bool ok = true;
+
+    // 1. 不分组和按网络线程分组的转发
+    size_t fanouts[] = {0, 256};
+    for (size_t fanout : fanouts)
+    {
+        auto server = std::make_shared<rpc::server::TopicManager>();
+        server->setFanout(fanout);
+        auto subscribers = makeSubscribers();
+        prepare(server, subscribers);
+
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < PUBLISHES; i++)
+        {
+            server->onTopicRequest(subscribers[0], publishRequest("big", i));
+        }
+        double publish_ms = since(begin);
+        for (auto &loop : loops)
+        {
+            loop->wait();
+        }
+        double total_ms = since(begin);
+
+        bool right = true;
+        for (auto &subscriber : subscribers)
+        {
+            right = right && subscriber->ordered && subscriber->received == (size_t)PUBLISHES;
+        }
+        ok = ok && right;
+        printf("%s：发布者每条占用 %8.1f 微秒，全部送达 %7.0f 毫秒（每秒送达 %.0f 万条），%s\n",
+               fanout == 0 ? "不分组        " : "按网络线程分组",
+               publish_ms * 1000 / PUBLISHES, total_ms, PUBLISHES * (double)SUBSCRIBERS / total_ms / 10,
+               right ? "全部按顺序收到，正确" : "缺失或乱序，错误");
+    }
+
+    // 2. 分组后在网络线程中发布：每个网络线程中的发布者轮流发布，第 i 条由第 i % LOOPS 个网络线程中的连接发布
+    {
+        auto server = std::make_shared<rpc::server::TopicManager>();
+        server->setFanout(256);
+        auto subscribers = makeSubscribers();
+        prepare(server, subscribers);
+
+        std::atomic<int> turn(0);
+        auto begin = std::chrono::steady_clock::now();
+        for (int index = 0; index < LOOPS; index++)
+        {
+            // subscribers[index] 就在第 index 个网络线程上，发布者占着这个网络线程直到发布完
+            loops[index]->queue([&server, &subscribers, &turn, index]()
+            {
+                for (int i = index; i < PUBLISHES; i += LOOPS)
+                {
+                    while (turn.load() != i)
+                    {
+                        std::this_thread::yield();
+                    }
+                    server->onTopicRequest(subscribers[index], publishRequest("big", i));
+                    turn = i + 1;
+                }
+            });
+        }
+        for (auto &loop : loops)
+        {
+            loop->wait();
+        }
+        double total_ms = since(begin);
+
+        bool right = true;
+        for (auto &subscriber : subscribers)
+        {
+            right = right && subscriber->ordered && subscriber->received == (size_t)PUBLISHES;
+        }
+        ok = ok && right;
+        printf("网络线程中发布：全部送达 %7.0f 毫秒，%s\n", total_ms, right ? "全部按顺序收到，正确" : "缺失或乱序，错误");
+    }
+
+    // 3. 大主题持续转发时订阅和取消订阅
+    {
+        auto server = std::make_shared<rpc::server::TopicManager>();
+        server->setFanout(0);
+        auto subscribers = makeSubscribers();
+        prepare(server, subscribers);
+
+        std::atomic<bool> stop(false);
+        std::atomic<int> published(0);
+        std::thread publisher([&]()
+        {
+            for (int i = 0; !stop; i++)
+            {
+                server->onTopicRequest(subscribers[0], publishRequest("big", i));
+                published++;
+            }
+        });
+
+        // 先让发布跑起来
+        while (published.load() < 10)
+        {
+            std::this_thread::yield();
+        }
+
+        auto conn = std::make_shared<LoopConnection>(loops[0].get());
+        std::vector<double> costs;
+        auto begin = std::chrono::steady_clock::now();
+        int start = published.load();
+        for (int i = 0; i < SUBSCRIBES; i++)
+        {
+            rpc::TopicOptype optype = i % 2 == 0 ? rpc::TopicOptype::TOPIC_SUBSCRIBE : rpc::TopicOptype::TOPIC_CANCEL;
+            auto op_begin = std::chrono::steady_clock::now();
+            server->onTopicRequest(conn, topicRequest(optype, "big"));
+            costs.push_back(since(op_begin) * 1000);
+        }
+        double ms = since(begin);
+        int count = published.load() - start;
+        stop = true;
+        publisher.join();
+
+        std::sort(costs.begin(), costs.end());
+        double sum = 0;
+        for (double cost : costs)
+        {
+            sum += cost;
+        }
+        printf("订阅/取消 %d 次（同时发布了 %d 条，每条转发约 %.0f 微秒）：平均 %.1f 微秒，中位数 %.1f 微秒，P99 %.1f 微秒\n",
+               SUBSCRIBES, count, count > 0 ? ms * 1000 / count : 0.0,
+               sum / costs.size(), costs[costs.size() / 2], costs[costs.size() * 99 / 100]);
+    }
+
+    printf("%s\n", ok ? "全部检查通过" : "存在错误");
+    return ok ? 0 : 1;
+}
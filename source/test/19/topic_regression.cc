@@ -0,0 +1,772 @@
+/*
+    主题功能回归测试：客户端的 TopicManager 和服务端的 TopicManager 在同一个进程中通过假连接直接对接
+    * 客户端发出的请求直接交给服务端处理，服务端的响应直接交给客户端的 Requestor
+    * 服务端推送的消息帧先放进队列，由测试调用 pump 交给客户端（可以模拟延迟、丢帧）
+    * 每个 case 检查实际结果，输出 PASS/FAIL，可以用 --case 只运行其中一个
+    不需要启动任何进程
+*/
+#include "../../server/rpc_topic.hpp"
+#include "../../client/rpc_topic.hpp"
+#include "../../client/rpc_executor.hpp"
+#include <arpa/inet.h>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+    enum class CaseStatus
+    {
+        PASS = 0,
+        FAIL = 1,
+        SKIP = 2
+    };
+
+    struct CaseResult
+    {
+        std::string name;
+        CaseStatus status;
+        std::string detail;
+    };
+
+    CaseResult makeResult(const std::string &name, bool ok, const std::string &detail)
+    {
+        return CaseResult{name, ok ? CaseStatus::PASS : CaseStatus::FAIL, detail};
+    }
+
+    // 解析一帧消息：长度(4) | 类型(4) | id长度(4) | id | 正文
+    rpc::BaseMessage::ptr parseFrame(const std::string &frame)
+    {
+        int32_t mtype = 0, idlen = 0;
+        memcpy(&mtype, frame.data() + 4, 4);
+        memcpy(&idlen, frame.data() + 8, 4);
+        idlen = ntohl(idlen);
+        auto msg = rpc::MessageFactory::create((rpc::MType)ntohl(mtype));
+        msg->unserialize(frame.substr(12 + idlen));
+        msg->setId(frame.substr(12, idlen));
+        msg->setMType((rpc::MType)ntohl(mtype));
+        return msg;
+    }
+
+    // 客户端一侧的连接：发出的请求直接交给服务端处理
+    class ClientConnection : public rpc::BaseConnection
+    {
+    public:
+        using ptr = std::shared_ptr<ClientConnection>;
+        virtual void send(const rpc::BaseMessage::ptr &msg) override
+        {
+            auto msg_req = std::dynamic_pointer_cast<rpc::TopicRequest>(msg);
+            if (before)
+            {
+                before(msg_req);
+            }
+            server->onTopicRequest(peer.lock(), msg_req);
+        }
+        virtual void sendRaw(const std::string &/*frame*/) override {}
+        virtual void shutdown() override {}
+        virtual bool connected() override { return true; }
+
+        rpc::server::TopicManager::ptr server;
+        std::weak_ptr<rpc::BaseConnection> peer;
+        std::function<void(const rpc::TopicRequest::ptr &)> before; // 请求交给服务端之前调用（模拟这期间发生的事）
+    };
+
+    // 服务端一侧的连接：响应直接交给客户端，推送的消息帧排队等 pump
+    class ServerConnection : public rpc::BaseConnection
+    {
+    public:
+        using ptr = std::shared_ptr<ServerConnection>;
+        virtual void send(const rpc::BaseMessage::ptr &msg) override
+        {
+            rpc::BaseMessage::ptr rsp = msg;
+            requestor->onResponse(peer, rsp);
+        }
+        // 可能是连续的多帧（从持久化日志回放、拉取时），按长度字段拆开
+        virtual void sendRaw(const std::string &data) override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            size_t pos = 0;
+            while (pos + 4 <= data.size())
+            {
+                int32_t len = 0;
+                memcpy(&len, data.data() + pos, 4);
+                size_t frame_len = 4 + ntohl(len);
+                frames.push_back(data.substr(pos, frame_len));
+                pos += frame_len;
+                sent++;
+            }
+        }
+        virtual void shutdown() override {}
+        virtual bool connected() override { return true; }
+        virtual void setHighWaterMarkCallback(size_t /*mark*/, const std::function<void()> &high, const std::function<void()> &drain) override
+        {
+            on_high = high;
+            on_drain = drain;
+        }
+
+        // 把排队的消息帧交给客户端，drop 中的投递 id（"#序号"）丢弃一次；返回交付的帧数
+        size_t pump()
+        {
+            size_t count = 0;
+            while (true)
+            {
+                std::string frame;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    if (frames.empty())
+                    {
+                        return count;
+                    }
+                    frame = frames.front();
+                    frames.pop_front();
+                }
+
+                auto msg = parseFrame(frame);
+                if (drop.erase(msg->rid()) > 0)
+                {
+                    continue;
+                }
+                client->onPublish(peer, std::dynamic_pointer_cast<rpc::TopicRequest>(msg));
+                count++;
+            }
+        }
+
+        size_t queued()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            return frames.size();
+        }
+
+        rpc::client::Requestor::ptr requestor;
+        rpc::client::TopicManager::ptr client;
+        ClientConnection::ptr peer;
+        std::set<std::string> drop;
+        std::atomic<size_t> sent{0};
+        std::function<void()> on_high;  // 调用它模拟发送缓冲积压到高水位
+        std::function<void()> on_drain; // 调用它模拟积压发完
+
+    private:
+        std::mutex _mutex;
+        std::deque<std::string> frames;
+    };
+
+    // 一个客户端：客户端的主题管理和它与服务端之间的一对假连接
+    struct Client
+    {
+        rpc::client::TopicManager::ptr topics;
+        ClientConnection::ptr conn;     // 客户端调用接口时使用
+        ServerConnection::ptr server;   // 服务端看到的连接
+
+        ~Client()
+        {
+            // 打破两个连接之间的循环引用
+            if (server)
+            {
+                server->peer.reset();
+            }
+        }
+    };
+
+    std::shared_ptr<Client> connect(const rpc::server::TopicManager::ptr &server)
+    {
+        auto client = std::make_shared<Client>();
+        auto requestor = std::make_shared<rpc::client::Requestor>();
+        client->topics = std::make_shared<rpc::client::TopicManager>(requestor);
+        client->conn = std::make_shared<ClientConnection>();
+        client->server = std::make_shared<ServerConnection>();
+        client->conn->server = server;
+        client->conn->peer = client->server;
+        client->server->peer = client->conn;
+        client->server->requestor = requestor;
+        client->server->client = client->topics;
+        return client;
+    }
+
+    // 把收到的消息内容记录下来的订阅回调
+    struct Received
+    {
+        std::mutex mutex;
+        std::vector<std::string> messages;
+
+        rpc::client::TopicManager::SubCallback callback()
+        {
+            return [this](const std::string &, const std::string &msg)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                messages.push_back(msg);
+            };
+        }
+
+        size_t size()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            return messages.size();
+        }
+    };
+
+    std::string join(const std::vector<std::string> &items)
+    {
+        std::ostringstream out;
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            out << (i == 0 ? "" : ",") << items[i];
+        }
+        return out.str();
+    }
+
+    // 1. 创建、发布的主题名称不能带通配符层，通配符只能出现在订阅的过滤条件中
+    CaseResult caseWildcardName()
+    {
+        auto server = std::make_shared<rpc::server::TopicManager>();
+        auto client = connect(server);
+        auto &topics = client->topics;
+
+        bool create_plus = topics->create(client->conn, "sensor/+/temp");
+        bool create_hash = topics->create(client->conn, "sensor/#");
+        bool create_ok = topics->create(client->conn, "sensor/a+b/temp");
+
+        Received received;
+        bool subscribed = topics->subscribe(client->conn, "sensor/+/temp", received.callback());
+        bool publish_plus = topics->publish(client->conn, "sensor/+/temp", "x");
+        bool publish_ok = topics->publish(client->conn, "sensor/a+b/temp", "y");
+        bool batch = topics->publishBatch(client->conn, {{"sensor/a+b/temp", "z"}, {"sensor/#", "w"}}, true);
+        client->server->pump();
+
+        bool ok = create_plus == false && create_hash == false && create_ok && subscribed &&
+                  publish_plus == false && publish_ok && batch == false &&
+                  received.messages == std::vector<std::string>{"y"};
+        std::ostringstream detail;
+        detail << "create(+)=" << create_plus << " create(#)=" << create_hash << " create(a+b)=" << create_ok
+               << " publish(+)=" << publish_plus << " publish(a+b)=" << publish_ok << " batch=" << batch
+               << " received=[" << join(received.messages) << "]";
+        return makeResult("wildcard_name", ok, detail.str());
+    }
+
+    // 2. 保留最近的消息：按条数、按序号回放，断线重连后用 lastSeq 补上断开期间的消息，回放之后的新消息接在后面
+    CaseResult caseRetain()
+    {
+        auto server = std::make_shared<rpc::server::TopicManager>();
+        auto publisher = connect(server);
+        bool created = publisher->topics->create(publisher->conn, "news", 5);
+        auto publish = [&](int begin, int end)
+        {
+            for (int i = begin; i <= end; i++)
+            {
+                publisher->topics->publish(publisher->conn, "news", "m" + std::to_string(i));
+            }
+        };
+        publish(1, 8);
+
+        // 最近 3 条
+        auto last = connect(server);
+        Received last_received;
+        last->topics->subscribeLast(last->conn, "news", 3, last_received.callback());
+        last->server->pump();
+        uint64_t seq = last->topics->lastSeq("news");
+
+        // 断开期间又发布了两条，重连后从 lastSeq + 1 开始回放
+        server->onShutdown(last->server);
+        publish(9, 10);
+        auto resumed = connect(server);
+        Received resumed_received;
+        resumed->topics->subscribeFrom(resumed->conn, "news", seq + 1, resumed_received.callback());
+
+        // 要求的序号已经不在保留范围内时，回放保留的全部消息
+        auto oldest = connect(server);
+        Received oldest_received;
+        oldest->topics->subscribeFrom(oldest->conn, "news", 1, oldest_received.callback());
+
+        publish(11, 11);
+        resumed->server->pump();
+        oldest->server->pump();
+
+        bool ok = created && seq == 8 &&
+                  last_received.messages == std::vector<std::string>{"m6", "m7", "m8"} &&
+                  resumed_received.messages == std::vector<std::string>{"m9", "m10", "m11"} &&
+                  oldest_received.messages == std::vector<std::string>{"m6", "m7", "m8", "m9", "m10", "m11"} &&
+                  resumed->topics->lastSeq("news") == 11;
+        std::ostringstream detail;
+        detail << "last=[" << join(last_received.messages) << "] lastSeq=" << seq
+               << " resumed=[" << join(resumed_received.messages) << "]"
+               << " from1=[" << join(oldest_received.messages) << "]";
+        return makeResult("retain", ok, detail.str());
+    }
+
+    // 3. 持久化主题：落后太多的订阅被拒绝（回放要持有发布锁），consume 先拉取再订阅；
+    //    拉取结束到订阅之间又发布了很多条时，consume 接着拉取，消息不遗漏、不重复
+    CaseResult caseDurableReplay()
+    {
+        const std::string dir = "./topic_regression_data";
+        system(("rm -rf '" + dir + "'").c_str());
+        auto server = std::make_shared<rpc::server::TopicManager>();
+        bool persisted = server->persist(dir);
+
+        auto publisher = connect(server);
+        bool created = publisher->topics->createDurable(publisher->conn, "orders");
+        int next = 1;
+        auto publish = [&](int count)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                publisher->topics->publishNoAck(publisher->conn, "orders", std::to_string(next++));
+            }
+        };
+        publish(3000);
+
+        // 直接从头订阅：要回放 3000 条，超过上限
+        auto direct = connect(server);
+        Received direct_received;
+        bool direct_ok = direct->topics->subscribeFrom(direct->conn, "orders", 1, direct_received.callback());
+        direct->server->pump();
+
+        // 离末尾不远时可以直接订阅回放
+        auto near = connect(server);
+        Received near_received;
+        bool near_ok = near->topics->subscribeFrom(near->conn, "orders", 2991, near_received.callback());
+        near->server->pump();
+
+        // consume：第一次订阅之前又发布了 2000 条，订阅被拒绝后接着拉取
+        auto consumer = connect(server);
+        Received consumed;
+        int subscribes = 0;
+        consumer->conn->before = [&](const rpc::TopicRequest::ptr &msg)
+        {
+            if (msg->optype() == rpc::TopicOptype::TOPIC_SUBSCRIBE && subscribes++ == 0)
+            {
+                publish(2000);
+            }
+        };
+        bool consume_ok = consumer->topics->consume(consumer->conn, "orders", 1, consumed.callback());
+        publish(5);
+        consumer->server->pump();
+        direct->server->pump();
+        near->server->pump();
+
+        bool ordered = consumed.messages.size() == 5005;
+        for (size_t i = 0; ordered && i < consumed.messages.size(); i++)
+        {
+            ordered = consumed.messages[i] == std::to_string(i + 1);
+        }
+
+        bool ok = persisted && created && direct_ok == false && direct_received.messages.empty() &&
+                  near_ok && near_received.size() == 2015 && consume_ok && subscribes == 2 && ordered;
+        std::ostringstream detail;
+        detail << "subscribeFrom(1)=" << direct_ok << " subscribeFrom(2991)=" << near_ok << " got " << near_received.size()
+               << " consume=" << consume_ok << " subscribes=" << subscribes << " consumed=" << consumed.size()
+               << " ordered=" << ordered;
+
+        server.reset();
+        system(("rm -rf '" + dir + "'").c_str());
+        return makeResult("durable_replay", ok, detail.str());
+    }
+
+    // 把收到的消息当作整数记录，检查是否从 first 开始连续、不重复
+    bool consecutive(const std::vector<std::string> &messages, int first, size_t count)
+    {
+        if (messages.size() != count)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < messages.size(); i++)
+        {
+            if (messages[i] != std::to_string(first + (int)i))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 反复把推送交给客户端并刷新确认，直到服务端不再发出新的消息
+    void drain(const std::shared_ptr<Client> &client)
+    {
+        while (client->server->pump() > 0)
+        {
+            client->topics->flush();
+        }
+        client->topics->flush();
+        client->server->pump();
+    }
+
+    // 4. 可靠订阅：丢帧后超时重发且去重，确认之后不再重发；断开后同名会话接着收到未确认的消息；
+    //    积压超过上限时不丢消息，断开连接并把窗口和队列中的消息全部转入会话
+    CaseResult caseReliable()
+    {
+        auto server = std::make_shared<rpc::server::TopicManager>();
+        server->setReliable(100, 20, 60000);
+        server->setSlowConsumer(rpc::server::SlowPolicy::DROP_OLDEST, 1 << 20, 4096);
+        auto publisher = connect(server);
+        publisher->topics->create(publisher->conn, "jobs");
+        int next = 0;
+        auto publish = [&](int count)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                publisher->topics->publishNoAck(publisher->conn, "jobs", std::to_string(next++));
+            }
+        };
+
+        auto first = connect(server);
+        Received received;
+        first->topics->subscribeReliable(first->conn, "jobs", received.callback(), "s1");
+        for (int i = 0; i < 300; i++)
+        {
+            publish(1);
+            first->server->pump();
+        }
+        bool in_order = consecutive(received.messages, 0, 300);
+
+        // 丢掉三帧，超时后重发补上，重复的被客户端去掉
+        first->server->drop = {"#305", "#306", "#307"};
+        publish(10);
+        first->server->pump();
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        server->redeliver();
+        first->server->pump();
+        std::set<std::string> unique(received.messages.begin(), received.messages.end());
+        bool recovered = received.size() == 310 && unique.size() == 310 && server->redelivered() >= 3;
+
+        // 全部确认之后不再重发
+        first->topics->flush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        size_t before = first->server->sent;
+        server->redeliver();
+        size_t resent = first->server->sent - before;
+
+        // 还没处理的 5 条在连接断开后留在会话里，新连接用同一个会话名称订阅时收到
+        publish(5);
+        server->onShutdown(first->server);
+        auto second = connect(server);
+        Received resumed;
+        second->topics->subscribeReliable(second->conn, "jobs", resumed.callback(), "s1");
+        second->server->pump();
+        bool resumed_ok = consecutive(resumed.messages, 310, 5);
+        server->onShutdown(second->server);
+
+        // 不确认也不读取：窗口满了之后排队，队列超过上限时断开，一条都不丢
+        auto slow = connect(server);
+        Received slow_received;
+        slow->topics->subscribeReliable(slow->conn, "jobs", slow_received.callback(), "s2");
+        int slow_first = next;
+        publish(400);
+        size_t disconnected = server->disconnected();
+        server->onShutdown(slow->server);
+        auto again = connect(server);
+        Received again_received;
+        again->topics->subscribeReliable(again->conn, "jobs", again_received.callback(), "s2");
+        drain(again);
+        bool kept = disconnected == 1 && server->dropped() == 0 && consecutive(again_received.messages, slow_first, 400);
+
+        bool ok = in_order && recovered && resent == 0 && resumed_ok && kept;
+        std::ostringstream detail;
+        detail << "ordered=" << in_order << " after_loss=" << received.size() << "/" << unique.size()
+               << " resent_after_ack=" << resent << " resumed=[" << join(resumed.messages) << "]"
+               << " overflow: disconnected=" << disconnected << " dropped=" << server->dropped()
+               << " resumed " << again_received.size() << "/400";
+        return makeResult("reliable", ok, detail.str());
+    }
+
+    // 5. 消费组：按负载轮流分配；按键分配时同一个键总是同一个成员；
+    //    成员积压被断开后不再被选中，连接关闭时它没有确认和排队的消息交给组内其他成员，一条不丢
+    CaseResult caseGroup()
+    {
+        auto server = std::make_shared<rpc::server::TopicManager>();
+        server->setReliable(20, 20, 60000);
+        server->setSlowConsumer(rpc::server::SlowPolicy::DROP_OLDEST, 1 << 20, 2048);
+        auto publisher = connect(server);
+        publisher->topics->create(publisher->conn, "work");
+        publisher->topics->create(publisher->conn, "orders");
+        publisher->topics->create(publisher->conn, "jobs");
+
+        // 按负载：三个成员都及时处理，轮流分到
+        std::vector<std::shared_ptr<Client>> workers;
+        std::vector<std::shared_ptr<Received>> work_received;
+        for (int i = 0; i < 3; i++)
+        {
+            workers.push_back(connect(server));
+            work_received.push_back(std::make_shared<Received>());
+            workers[i]->topics->subscribeGroup(workers[i]->conn, "work", "g", work_received[i]->callback());
+        }
+        for (int i = 0; i < 300; i++)
+        {
+            publisher->topics->publishNoAck(publisher->conn, "work", std::to_string(i));
+            for (auto &worker : workers)
+            {
+                worker->server->pump();
+            }
+        }
+        bool balanced = true;
+        for (auto &received : work_received)
+        {
+            balanced = balanced && received->size() == 100;
+        }
+
+        // 按键：同一个键的消息都在同一个成员上
+        std::vector<std::shared_ptr<Client>> shards;
+        std::vector<std::shared_ptr<Received>> shard_received;
+        for (int i = 0; i < 2; i++)
+        {
+            shards.push_back(connect(server));
+            shard_received.push_back(std::make_shared<Received>());
+            shards[i]->topics->subscribeGroup(shards[i]->conn, "orders", "g", shard_received[i]->callback(),
+                                              rpc::GroupBalance::KEY_HASH);
+        }
+        for (int i = 0; i < 200; i++)
+        {
+            std::string key = "k" + std::to_string(i % 20);
+            publisher->topics->publishKeyed(publisher->conn, "orders", key, key);
+        }
+        std::map<std::string, std::set<int>> owners;
+        for (int i = 0; i < 2; i++)
+        {
+            shards[i]->server->pump();
+            for (auto &key : shard_received[i]->messages)
+            {
+                owners[key].insert(i);
+            }
+        }
+        bool sticky = owners.size() == 20 && shard_received[0]->size() + shard_received[1]->size() == 200;
+        for (auto &item : owners)
+        {
+            sticky = sticky && item.second.size() == 1;
+        }
+
+        // 故障转移：可靠的按键分配组，一个成员卡住不处理，另一个正常处理
+        auto stuck = connect(server);
+        auto healthy = connect(server);
+        Received stuck_received, healthy_received;
+        stuck->topics->subscribeGroup(stuck->conn, "jobs", "g", stuck_received.callback(), rpc::GroupBalance::KEY_HASH, true);
+        healthy->topics->subscribeGroup(healthy->conn, "jobs", "g", healthy_received.callback(), rpc::GroupBalance::KEY_HASH, true);
+        for (int i = 0; i < 200; i++)
+        {
+            publisher->topics->publishKeyed(publisher->conn, "jobs", "k" + std::to_string(i % 20), std::to_string(i));
+            drain(healthy);
+        }
+        size_t before_close = healthy_received.size();
+        size_t disconnected = server->disconnected();
+        server->onShutdown(stuck->server);
+        drain(healthy);
+
+        std::set<int> jobs;
+        for (auto &msg : healthy_received.messages)
+        {
+            jobs.insert(std::stoi(msg));
+        }
+        bool failover = disconnected == 1 && before_close < 200 && jobs.size() == 200 &&
+                        *jobs.begin() == 0 && *jobs.rbegin() == 199 && server->dropped() == 0;
+
+        bool ok = balanced && sticky && failover;
+        std::ostringstream detail;
+        detail << "least_loaded=" << work_received[0]->size() << "/" << work_received[1]->size() << "/" << work_received[2]->size()
+               << " key_hash sticky=" << sticky << " (" << shard_received[0]->size() << "/" << shard_received[1]->size() << ")"
+               << " failover: stuck disconnected=" << disconnected << " healthy before close=" << before_close
+               << " after=" << healthy_received.size() << " unique=" << jobs.size();
+        return makeResult("group", ok, detail.str());
+    }
+
+    // 6. 合并主题：积压的订阅者队列里同一个键只保留最新的一条，新订阅者先收到每个键的当前值；
+    //    键数超过上限时淘汰最久没有更新的键
+    CaseResult caseConflate()
+    {
+        auto server = std::make_shared<rpc::server::TopicManager>();
+        server->setConflateKeys(3);
+        auto publisher = connect(server);
+        bool created = publisher->topics->createConflated(publisher->conn, "px");
+
+        auto fast = connect(server);
+        auto slow = connect(server);
+        Received fast_received, slow_received;
+        fast->topics->subscribe(fast->conn, "px", fast_received.callback());
+        slow->topics->subscribe(slow->conn, "px", slow_received.callback());
+        auto publish = [&](const std::string &key, int version)
+        {
+            publisher->topics->publishKeyed(publisher->conn, "px", key, key + std::to_string(version));
+        };
+
+        // slow 积压期间同一个键的消息留在旧消息原来的位置
+        slow->server->on_high();
+        publish("AAPL", 1);
+        publish("MSFT", 1);
+        publish("AAPL", 2);
+        publish("GOOG", 1);
+        publish("AAPL", 3);
+        fast->server->pump();
+        slow->server->on_drain();
+        slow->server->pump();
+
+        // 新订阅者按更新时间从旧到新收到每个键的当前值
+        auto late = connect(server);
+        Received late_received;
+        late->topics->subscribe(late->conn, "px", late_received.callback());
+        late->server->pump();
+
+        // 第四个键淘汰最久没有更新的 MSFT，当前值之后的新消息接在后面
+        publish("TSLA", 1);
+        auto later = connect(server);
+        Received later_received;
+        later->topics->subscribe(later->conn, "px", later_received.callback());
+        publish("GOOG", 2);
+        later->server->pump();
+
+        bool ok = created &&
+                  fast_received.messages == std::vector<std::string>{"AAPL1", "MSFT1", "AAPL2", "GOOG1", "AAPL3"} &&
+                  slow_received.messages == std::vector<std::string>{"AAPL3", "MSFT1", "GOOG1"} &&
+                  server->conflated() == 2 &&
+                  late_received.messages == std::vector<std::string>{"MSFT1", "GOOG1", "AAPL3"} &&
+                  later_received.messages == std::vector<std::string>{"GOOG1", "AAPL3", "TSLA1", "GOOG2"} &&
+                  server->evicted() == 1;
+        std::ostringstream detail;
+        detail << "fast=[" << join(fast_received.messages) << "] slow=[" << join(slow_received.messages) << "]"
+               << " conflated=" << server->conflated() << " late=[" << join(late_received.messages) << "]"
+               << " after evict=[" << join(later_received.messages) << "] evicted=" << server->evicted();
+        return makeResult("conflate", ok, detail.str());
+    }
+
+    // 7. 回调交给执行器：同一主题的回调按顺序依次执行，慢主题不耽误其他主题，pump 不等回调执行完；
+    //    可靠订阅的确认来自回调线程，窗口满了之后要等确认，等待期间一直 pump
+    //    （可靠订阅在另一个连接上：同一连接的消息都按可靠投递，累计确认会被慢主题挡住）
+    CaseResult caseExecutor()
+    {
+        auto server = std::make_shared<rpc::server::TopicManager>();
+        server->setReliable(100, 1000, 60000);
+        auto publisher = connect(server);
+        publisher->topics->create(publisher->conn, "slow");
+        publisher->topics->create(publisher->conn, "fast");
+        publisher->topics->create(publisher->conn, "rel");
+
+        // 回调线程池在客户端之后构造、之前析构，析构前执行完交给它的任务
+        auto client = connect(server);
+        auto reliable = connect(server);
+        auto pool = std::make_shared<rpc::client::WorkerPool>(2);
+        client->topics->setExecutor([pool](const std::function<void()> &task) { pool->submit(task); });
+        reliable->topics->setExecutor([pool](const std::function<void()> &task) { pool->submit(task); });
+
+        Received slow_received, fast_received, rel_received;
+        std::atomic<int> running(0), max_running(0);
+        std::atomic<bool> fast_first(false);
+        client->topics->subscribe(client->conn, "slow", [&](const std::string &key, const std::string &msg)
+        {
+            int now = ++running;
+            if (now > max_running)
+            {
+                max_running = now;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            --running;
+            slow_received.callback()(key, msg);
+        });
+        client->topics->subscribe(client->conn, "fast", [&](const std::string &key, const std::string &msg)
+        {
+            fast_received.callback()(key, msg);
+            if (fast_received.size() == 1000 && slow_received.size() < 20)
+            {
+                fast_first = true;
+            }
+        });
+        reliable->topics->subscribeReliable(reliable->conn, "rel", rel_received.callback());
+
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < 1000; i++)
+        {
+            if (i < 20)
+            {
+                publisher->topics->publishNoAck(publisher->conn, "slow", std::to_string(i));
+            }
+            publisher->topics->publishNoAck(publisher->conn, "fast", std::to_string(i));
+            publisher->topics->publishNoAck(publisher->conn, "rel", std::to_string(i));
+        }
+        client->server->pump();
+        reliable->server->pump();
+        auto pump_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+
+        auto deadline = begin + std::chrono::seconds(10);
+        while (slow_received.size() < 20 || fast_received.size() < 1000 || rel_received.size() < 1000)
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+            {
+                break;
+            }
+            client->server->pump();
+            reliable->server->pump();
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+
+        bool ordered = consecutive(slow_received.messages, 0, 20) && consecutive(fast_received.messages, 0, 1000) &&
+                       consecutive(rel_received.messages, 0, 1000);
+        // 慢主题的回调在网络线程中执行要 400 毫秒
+        bool ok = ordered && pump_ms < 400 && fast_first && max_running == 1;
+        std::ostringstream detail;
+        detail << "ordered=" << ordered << " pump_ms=" << pump_ms << " fast_before_slow=" << fast_first
+               << " max_concurrent_slow=" << max_running << " slow=" << slow_received.size()
+               << " fast=" << fast_received.size() << " rel=" << rel_received.size();
+        return makeResult("executor", ok, detail.str());
+    }
+
+    void printCaseResult(const CaseResult &res)
+    {
+        const char *status = (res.status == CaseStatus::PASS ? "PASS" :
+                             (res.status == CaseStatus::FAIL ? "FAIL" : "SKIP"));
+        std::cout << "[" << status << "] " << res.name << " - " << res.detail << std::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::pair<std::string, std::function<CaseResult()>>> cases;
+    cases.push_back(std::make_pair("wildcard_name", caseWildcardName));
+    cases.push_back(std::make_pair("retain", caseRetain));
+    cases.push_back(std::make_pair("durable_replay", caseDurableReplay));
+    cases.push_back(std::make_pair("reliable", caseReliable));
+    cases.push_back(std::make_pair("group", caseGroup));
+    cases.push_back(std::make_pair("conflate", caseConflate));
+    cases.push_back(std::make_pair("executor", caseExecutor));
+
+    std::string only;
+    if (argc == 3 && std::string(argv[1]) == "--case")
+    {
+        only = argv[2];
+    }
+
+    int pass = 0;
+    int fail = 0;
+    int skip = 0;
+    bool found = false;
+
+    for (auto &item : cases)
+    {
+        if (only.empty() == false && item.first != only)
+        {
+            continue;
+        }
+
+        found = true;
+        CaseResult res = item.second();
+        printCaseResult(res);
+        if (res.status == CaseStatus::PASS)
+        {
+            pass++;
+        }
+        else if (res.status == CaseStatus::FAIL)
+        {
+            fail++;
+        }
+        else
+        {
+            skip++;
+        }
+    }
+
+    if (found == false)
+    {
+        std::cerr << "[FAIL] 未知 case: " << only << std::endl;
+        return 1;
+    }
+
+    std::cout << "[SUMMARY] pass=" << pass
+              << " fail=" << fail
+              << " skip=" << skip << std::endl;
+
+    return fail == 0 ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+/*
+    消息校验回归测试：把构造好的消息正文直接交给各个请求的 check()
+    * 格式错误的正文必须返回 false，不能抛出异常（协议层在网络线程中调用 check()，异常会让整个进程退出）
+    * 合法的正文返回 true，之后读取字段（watches、changes）也不抛出异常
+    * 每个 case 输出 PASS/FAIL，可以用 --case 只运行其中一个
+    不需要启动任何进程
+*/
+#include "../../common/message.hpp"
+#include <functional>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    enum class CaseStatus
+    {
+        PASS = 0,
+        FAIL = 1,
+        SKIP = 2
+    };
+
+    struct CaseResult
+    {
+        std::string name;
+        CaseStatus status;
+        std::string detail;
+    };
+
+    CaseResult makeResult(const std::string &name, bool ok, const std::string &detail)
+    {
+        return CaseResult{name, ok ? CaseStatus::PASS : CaseStatus::FAIL, detail};
+    }
+
+    // 一条待校验的消息正文和期望的结果
+    struct Sample
+    {
+        std::string body;
+        bool valid;
+    };
+
+    // 依次校验每个正文：结果和期望不同或者抛出异常的记入 detail；after 在校验通过后读取字段
+    template <typename T>
+    bool checkAll(const std::vector<Sample> &samples, std::ostringstream &detail,
+                  const std::function<void(const std::shared_ptr<T> &)> &after = nullptr)
+    {
+        bool ok = true;
+        size_t rejected = 0;
+        std::ostringstream errors;
+        for (auto &sample : samples)
+        {
+            auto msg = rpc::MessageFactory::create<T>();
+            std::string error;
+            bool valid = false;
+            try
+            {
+                if (msg->unserialize(sample.body) == false)
+                {
+                    error = "unserialize";
+                }
+                else
+                {
+                    valid = msg->check();
+                    if (valid && after)
+                    {
+                        after(msg);
+                    }
+                }
+            }
+            catch (const std::exception &e)
+            {
+                error = std::string("throw: ") + e.what();
+            }
+
+            if (error.empty() == false || valid != sample.valid)
+            {
+                ok = false;
+                errors << " [" << sample.body << " => " << (error.empty() ? (valid ? "true" : "false") : error) << "]";
+            }
+            rejected += valid ? 0 : 1;
+        }
+
+        detail << "samples=" << samples.size() << " rejected=" << rejected << errors.str();
+        return ok;
+    }
+
+    // 1. 服务订阅：订阅项必须是对象，版本号是非负整数，epoch 没有或者是字符串
+    CaseResult caseWatch()
+    {
+        std::vector<Sample> samples = {
+            {R"({"optype":5,"watch":[{"method":"add","revision":3}]})", true},
+            {R"({"optype":5,"watch":[{"method":"add","revision":3,"epoch":"e1"}]})", true},
+            {R"({"optype":5,"prefix":"calc."})", true},
+            {R"({"optype":5,"watch":[1]})", false},
+            {R"({"optype":5,"watch":["add"]})", false},
+            {R"({"optype":5,"watch":[[]]})", false},
+            {R"({"optype":5,"watch":[{"method":"add","revision":-1}]})", false},
+            {R"({"optype":5,"watch":[{"method":"add","revision":"3"}]})", false},
+            {R"({"optype":5,"watch":[{"method":"add","revision":1.5}]})", false},
+            {R"({"optype":5,"watch":[{"method":"add","revision":3,"epoch":{}}]})", false},
+            {R"({"optype":5,"watch":[{"method":"add","revision":3,"epoch":7}]})", false},
+            {R"({"optype":5,"watch":[{"revision":3}]})", false},
+            {R"({"optype":5,"watch":{}})", false},
+        };
+
+        std::ostringstream detail;
+        bool ok = checkAll<rpc::ServiceRequest>(samples, detail, [](const rpc::ServiceRequest::ptr &msg) { msg->watches(); });
+        return makeResult("watch", ok, detail.str());
+    }
+
+    // 2. 服务变更和副本同步：变更列表的每一项都必须是完整的上线/下线请求
+    CaseResult caseChanges()
+    {
+        std::vector<Sample> samples;
+        for (int optype : {(int)rpc::ServiceOptype::SERVICE_DELTA, (int)rpc::ServiceOptype::SERVICE_SYNC})
+        {
+            std::string head = R"({"optype":)" + std::to_string(optype) + R"(,"changes":)";
+            std::string tail = "}";
+            samples.push_back({head + R"([{"optype":2,"method":"add","host":{"ip":"127.0.0.1","port":9000}}])" + tail, true});
+            samples.push_back({head + R"([])" + tail, true});
+            samples.push_back({head + R"([1])" + tail, false});
+            samples.push_back({head + R"(["add"])" + tail, false});
+            samples.push_back({head + R"([[]])" + tail, false});
+            samples.push_back({head + R"([null])" + tail, false});
+            samples.push_back({head + R"([{"optype":2,"method":"add","host":{"ip":"127.0.0.1","port":9000}},1])" + tail, false});
+            samples.push_back({head + R"([{"optype":1,"method":"add"}])" + tail, false});
+            samples.push_back({head + R"([{"optype":2,"method":"add","host":1}])" + tail, false});
+            samples.push_back({head + R"({})" + tail, false});
+        }
+
+        std::ostringstream detail;
+        bool ok = checkAll<rpc::ServiceRequest>(samples, detail, [](const rpc::ServiceRequest::ptr &msg) { msg->changes(); });
+        return makeResult("changes", ok, detail.str());
+    }
+
+    // 3. 批量发布：每一项都必须是带主题名称和消息内容的对象
+    CaseResult casePublishBatch()
+    {
+        std::vector<Sample> samples = {
+            {R"({"optype":5,"batch":[{"topic_key":"news","topic_msg":"m1"},{"topic_key":"sport","topic_msg":"m2"}]})", true},
+            {R"({"optype":5,"batch":[1]})", false},
+            {R"({"optype":5,"batch":["news"]})", false},
+            {R"({"optype":5,"batch":[[]]})", false},
+            {R"({"optype":5,"batch":[{"topic_key":"news","topic_msg":"m1"},null]})", false},
+            {R"({"optype":5,"batch":[{"topic_key":1,"topic_msg":"m1"}]})", false},
+            {R"({"optype":5,"batch":[{"topic_key":"news"}]})", false},
+            {R"({"optype":5,"batch":{}})", false},
+        };
+
+        std::ostringstream detail;
+        bool ok = checkAll<rpc::TopicRequest>(samples, detail);
+        return makeResult("publish_batch", ok, detail.str());
+    }
+
+    void printCaseResult(const CaseResult &res)
+    {
+        const char *status = (res.status == CaseStatus::PASS ? "PASS" :
+                             (res.status == CaseStatus::FAIL ? "FAIL" : "SKIP"));
+        std::cout << "[" << status << "] " << res.name << " - " << res.detail << std::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::pair<std::string, std::function<CaseResult()>>> cases;
+    cases.push_back(std::make_pair("watch", caseWatch));
+    cases.push_back(std::make_pair("changes", caseChanges));
+    cases.push_back(std::make_pair("publish_batch", casePublishBatch));
+
+    std::string only;
+    if (argc == 3 && std::string(argv[1]) == "--case")
+    {
+        only = argv[2];
+    }
+
+    int pass = 0;
+    int fail = 0;
+    int skip = 0;
+    bool found = false;
+
+    for (auto &item : cases)
+    {
+        if (only.empty() == false && item.first != only)
+        {
+            continue;
+        }
+
+        found = true;
+        CaseResult res = item.second();
+        printCaseResult(res);
+        if (res.status == CaseStatus::PASS)
+        {
+            pass++;
+        }
+        else if (res.status == CaseStatus::FAIL)
+        {
+            fail++;
+        }
+        else
+        {
+            skip++;
+        }
+    }
+
+    if (found == false)
+    {
+        std::cerr << "[FAIL] 未知 case: " << only << std::endl;
+        return 1;
+    }
+
+    std::cout << "[SUMMARY] pass=" << pass
+              << " fail=" << fail
+              << " skip=" << skip << std::endl;
+
+    return fail == 0 ? 0 : 1;
+}
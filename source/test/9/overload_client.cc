@@ -0,0 +1,75 @@
+/*
+    过载压测：以固定速率（开环）发送请求，逐步提高发送速率，
+    观察超过服务端处理能力后，有效吞吐（goodput）是否保持平稳而不是崩塌
+    用法：先启动 ./overload_server，再执行 ./overload_client
+*/
+#include "../../client/rpc_client.hpp"
+#include <atomic>
+#include <thread>
+
+namespace
+{
+    const int WORK_US = 200;             // 每个请求的服务端CPU开销
+    const int ROUND_SECONDS = 3;         // 每一档速率的持续时间
+    const int DEADLINE_MS = 1000;        // 超过该时延返回的结果视为无效（与同步调用超时一致）
+
+    struct RoundStat
+    {
+        std::atomic<int> ok{0};       // 在截止时间内成功返回
+        std::atomic<int> late{0};     // 成功返回但已超过截止时间
+        std::atomic<int> rejected{0}; // 被服务端拒绝（过载等错误）
+    };
+
+    void runRound(rpc::client::RpcClient &client, int rate)
+    {
+        auto stat = std::make_shared<RoundStat>();
+        auto interval = std::chrono::nanoseconds(1000000000LL / rate);
+        auto begin = std::chrono::steady_clock::now();
+        auto next = begin;
+        int sent = 0;
+
+        Json::Value params;
+        params["work_us"] = WORK_US;
+        while (std::chrono::steady_clock::now() - begin < std::chrono::seconds(ROUND_SECONDS))
+        {
+            auto start = std::chrono::steady_clock::now();
+            auto cb = [stat, start](const Json::Value &result) {
+                auto cost = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+                if (result.isNull())
+                {
+                    stat->rejected++;
+                }
+                else if (cost > DEADLINE_MS)
+                {
+                    stat->late++;
+                }
+                else
+                {
+                    stat->ok++;
+                }
+            };
+
+            client.call("Work", params, cb);
+            sent++;
+            next += interval;
+            std::this_thread::sleep_until(next);
+        }
+
+        // 等待在途请求返回
+        std::this_thread::sleep_for(std::chrono::milliseconds(DEADLINE_MS * 2));
+        ILOG("offered: %6d req/s, goodput: %6d req/s, late: %6d, rejected: %6d, sent: %d",
+             rate, stat->ok.load() / ROUND_SECONDS, stat->late.load(), stat->rejected.load(), sent);
+    }
+}
+
+int main()
+{
+    rpc::client::RpcClient client(false, "127.0.0.1", 8080);
+    int rates[] = {1000, 2000, 5000, 10000, 20000, 40000, 80000};
+    for (int rate : rates)
+    {
+        runRound(client, rate);
+    }
+
+    return 0;
+}
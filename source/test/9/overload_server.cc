@@ -0,0 +1,28 @@
+#include "../../server/rpc_server.hpp"
+
+// 模拟一个有固定CPU开销的业务：忙等 work_us 微秒
+void Work(const Json::Value &req, Json::Value &rsp)
+{
+    int work_us = req["work_us"].asInt();
+    auto begin = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - begin < std::chrono::microseconds(work_us))
+    {
+    }
+
+    rsp = work_us;
+}
+
+int main()
+{
+    std::unique_ptr<rpc::server::ServiceDescribeFactory> desc_factory(new rpc::server::ServiceDescribeFactory());
+    desc_factory->setMethodName("Work");
+    desc_factory->setParamsDesc("work_us", rpc::server::VType::INTEGRAL);
+    desc_factory->setReturnType(rpc::server::VType::INTEGRAL);
+    desc_factory->setCallback(Work);
+
+    rpc::server::RpcServer server(rpc::Address("127.0.0.1", 8080));
+    server.registerMethod(desc_factory->build());
+    server.setWorkerThreads(rpc::server::RpcScheduler::defaultThreadNum());
+    server.start();
+    return 0;
+}
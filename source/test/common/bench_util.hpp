@@ -0,0 +1,91 @@
+/*
+    注册中心压测共用的部分（test/11、test/12、test/14）
+    * FakeConnection：内存中的假连接，统计发送的消息数和字节数，保存最后一帧，可选保存全部帧
+    * serviceRequest：构造服务请求
+    * since：从 begin 到现在经过的毫秒数
+*/
+#pragma once
+#include "../../common/message.hpp"
+#include <atomic>
+#include <mutex>
+#include <chrono>
+
+namespace bench
+{
+    class FakeConnection : public rpc::BaseConnection
+    {
+    public:
+        using ptr = std::shared_ptr<FakeConnection>;
+
+        FakeConnection(const rpc::BaseProtocol::ptr &protocol = rpc::ProtocolFactory::create())
+            : _protocol(protocol), messages(0), bytes(0)
+        {
+        }
+
+        virtual void send(const rpc::BaseMessage::ptr &msg) override
+        {
+            sendRaw(_protocol->serialize(msg));
+        }
+
+        virtual void sendRaw(const std::string &frame) override
+        {
+            messages++;
+            bytes += frame.size();
+            std::unique_lock<std::mutex> lock(_mutex);
+            last = frame;
+            if (_keep)
+            {
+                frames.push_back(frame);
+            }
+        }
+
+        virtual void shutdown() override {}
+        virtual bool connected() override { return true; }
+
+        // 之后发送的帧全部保存在 frames 中
+        void keepFrames() { _keep = true; }
+
+        rpc::BaseProtocol::ptr _protocol;
+        std::string last;                // 最后发送的一帧
+        std::vector<std::string> frames; // keepFrames 之后发送的所有帧
+        std::atomic<size_t> messages;
+        std::atomic<size_t> bytes;
+
+    private:
+        bool _keep = false;
+        std::mutex _mutex;
+    };
+
+    // methods 只有一个时放在 method 字段，多个时放在 methods 字段；host 的端口为 0 时不设置主机
+    inline rpc::ServiceRequest::ptr serviceRequest(rpc::ServiceOptype optype, const std::vector<std::string> &methods, const rpc::Address &host)
+    {
+        auto req = rpc::MessageFactory::create<rpc::ServiceRequest>();
+        req->setId(rpc::UUID::uuid());
+        req->setMType(rpc::MType::REQ_SERVICE);
+        req->setOptype(optype);
+        if (host.second != 0)
+        {
+            req->setHost(host);
+        }
+        if (methods.size() == 1)
+        {
+            req->setMethod(methods[0]);
+        }
+        else if (methods.empty() == false)
+        {
+            req->setMethods(methods);
+        }
+        return req;
+    }
+
+    // method 为空时不设置方法（例如心跳）
+    inline rpc::ServiceRequest::ptr serviceRequest(rpc::ServiceOptype optype, const std::string &method, const rpc::Address &host)
+    {
+        return serviceRequest(optype, method.empty() ? std::vector<std::string>() : std::vector<std::string>(1, method), host);
+    }
+
+    inline double since(std::chrono::steady_clock::time_point begin)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count() / 1000.0;
+    }
+}